@@ -142,6 +142,22 @@ struct data_block
     cab_UWORD   uncompressed;
 };
 
+/* a data block being compressed, possibly on a worker thread */
+struct compress_slot
+{
+    struct FCI_Int      *fci;
+    unsigned char       *in;
+    unsigned char       *out;
+    cab_UWORD            uncompressed;
+    cab_UWORD            compressed;
+#ifdef HAVE_ZLIB
+    z_stream             stream;
+    BOOL                 stream_init;
+#endif
+};
+
+#define FCI_MAX_THREADS 8
+
 typedef struct FCI_Int
 {
   unsigned int       magic;
@@ -188,7 +204,13 @@ typedef struct FCI_Int
   cab_ULONG          pending_data_size;   /* size of data not yet assigned to a folder */
   cab_ULONG          folders_data_size;   /* total size of data contained in the current folders */
   TCOMP              compression;
-  cab_UWORD        (*compress)(struct FCI_Int *);
+  cab_UWORD        (*compress)(struct FCI_Int *, struct compress_slot *);
+  struct compress_slot main_slot;         /* compresses data_in into data_out */
+  struct compress_slot *slots;            /* blocks compressed in parallel, NULL if single-threaded */
+  unsigned int       nb_slots;
+  unsigned int       used_slots;          /* number of full blocks waiting in slots */
+  LONG               slots_pending;       /* blocks not yet compressed by the worker threads */
+  HANDLE             slots_done;
 } FCI_Int;
 
 #define FCI_INT_MAGIC 0xfcfcfc05
@@ -309,13 +331,19 @@ static void free_file( FCI_Int *fci, struct file *file )
     fci->free( file );
 }
 
-/* create a new data block for the data in fci->data_in */
-static BOOL add_data_block( FCI_Int *fci, PFNFCISTATUS status_callback )
+static BOOL init_compress_slot( FCI_Int *fci, struct compress_slot *slot );
+
+/* write a compressed block to the data temp file */
+static BOOL write_data_block( FCI_Int *fci, struct compress_slot *slot, PFNFCISTATUS status_callback )
 {
     int err;
     struct data_block *block;
 
-    if (!fci->cdata_in) return TRUE;
+    if (!slot->compressed)
+    {
+        set_error( fci, FCIERR_ALLOC_FAIL, ERROR_NOT_ENOUGH_MEMORY );
+        return FALSE;
+    }
 
     if (fci->data.handle == -1 && !create_temp_file( fci, &fci->data )) return FALSE;
 
@@ -324,10 +352,10 @@ static BOOL add_data_block( FCI_Int *fci, PFNFCISTATUS status_callback )
         set_error( fci, FCIERR_ALLOC_FAIL, ERROR_NOT_ENOUGH_MEMORY );
         return FALSE;
     }
-    block->uncompressed = fci->cdata_in;
-    block->compressed   = fci->compress( fci );
+    block->uncompressed = slot->uncompressed;
+    block->compressed   = slot->compressed;
 
-    if (fci->write( fci->data.handle, fci->data_out,
+    if (fci->write( fci->data.handle, slot->out,
                     block->compressed, &err, fci->pv ) != block->compressed)
     {
         set_error( fci, FCIERR_TEMP_FILE, err );
@@ -335,7 +363,6 @@ static BOOL add_data_block( FCI_Int *fci, PFNFCISTATUS status_callback )
         return FALSE;
     }
 
-    fci->cdata_in = 0;
     fci->pending_data_size += sizeof(CFDATA) + fci->ccab.cbReserveCFData + block->compressed;
     fci->cCompressedBytesInFolder += block->compressed;
     fci->cDataBlocks++;
@@ -349,6 +376,73 @@ static BOOL add_data_block( FCI_Int *fci, PFNFCISTATUS status_callback )
     return TRUE;
 }
 
+static DWORD CALLBACK compress_slot_proc( void *arg )
+{
+    struct compress_slot *slot = arg;
+    FCI_Int *fci = slot->fci;
+
+    slot->compressed = fci->compress( fci, slot );
+    if (!InterlockedDecrement( &fci->slots_pending )) SetEvent( fci->slots_done );
+    return 0;
+}
+
+/* compress all the queued blocks in parallel and write them out in order */
+static BOOL flush_compress_slots( FCI_Int *fci, PFNFCISTATUS status_callback )
+{
+    unsigned int i, count = fci->used_slots;
+    BOOL ret = TRUE;
+
+    if (!count) return TRUE;
+    fci->used_slots = 0;
+
+    fci->slots_pending = count;
+    for (i = 1; i < count; i++)
+    {
+        if (!QueueUserWorkItem( compress_slot_proc, &fci->slots[i], WT_EXECUTEDEFAULT ))
+            compress_slot_proc( &fci->slots[i] );
+    }
+    /* the calling thread takes the first block, and only waits if some
+     * other block is still being worked on after that */
+    fci->slots[0].compressed = fci->compress( fci, &fci->slots[0] );
+    if (InterlockedDecrement( &fci->slots_pending )) WaitForSingleObject( fci->slots_done, INFINITE );
+
+    for (i = 0; ret && i < count; i++) ret = write_data_block( fci, &fci->slots[i], status_callback );
+    return ret;
+}
+
+/* create a new data block for the data in fci->data_in */
+static BOOL add_data_block( FCI_Int *fci, PFNFCISTATUS status_callback )
+{
+    struct compress_slot *slot;
+
+    if (!fci->cdata_in) return TRUE;
+
+    /* full blocks are queued while a parallel batch can be built, anything
+     * else flushes the queue first so that blocks stay in order */
+    if (fci->slots && fci->cdata_in == CAB_BLOCKMAX)
+    {
+        slot = &fci->slots[fci->used_slots++];
+        memcpy( slot->in, fci->data_in, fci->cdata_in );
+        slot->uncompressed = fci->cdata_in;
+        fci->cdata_in = 0;
+        if (fci->used_slots < fci->nb_slots) return TRUE;
+        return flush_compress_slots( fci, status_callback );
+    }
+
+    if (!flush_compress_slots( fci, status_callback )) return FALSE;
+
+    slot = &fci->main_slot;
+    if (!init_compress_slot( fci, slot ))
+    {
+        set_error( fci, FCIERR_ALLOC_FAIL, ERROR_NOT_ENOUGH_MEMORY );
+        return FALSE;
+    }
+    slot->uncompressed = fci->cdata_in;
+    slot->compressed   = fci->compress( fci, slot );
+    fci->cdata_in = 0;
+    return write_data_block( fci, slot, status_callback );
+}
+
 /* add compressed blocks for all the data that can be read from the file */
 static BOOL add_file_data( FCI_Int *fci, char *sourcefile, char *filename, BOOL execute,
                            PFNFCIGETOPENINFO get_open_info, PFNFCISTATUS status_callback )
@@ -376,15 +470,20 @@ static BOOL add_file_data( FCI_Int *fci, char *sourcefile, char *filename, BOOL
 
         if (len == -1)
         {
+            fci->used_slots = 0;
             set_error( fci, FCIERR_READ_SRC, err );
             return FALSE;
         }
         file->size += len;
         fci->cdata_in += len;
-        if (fci->cdata_in == CAB_BLOCKMAX && !add_data_block( fci, status_callback )) return FALSE;
+        if (fci->cdata_in == CAB_BLOCKMAX && !add_data_block( fci, status_callback ))
+        {
+            fci->used_slots = 0;
+            return FALSE;
+        }
     }
     fci->close( handle, &err, fci->pv );
-    return TRUE;
+    return flush_compress_slots( fci, status_callback );
 }
 
 static void free_data_block( FCI_Int *fci, struct data_block *block )
@@ -903,10 +1002,10 @@ static BOOL add_files_to_folder( FCI_Int *fci, struct folder *folder, cab_ULONG
     return TRUE;
 }
 
-static cab_UWORD compress_NONE( FCI_Int *fci )
+static cab_UWORD compress_NONE( FCI_Int *fci, struct compress_slot *slot )
 {
-    memcpy( fci->data_out, fci->data_in, fci->cdata_in );
-    return fci->cdata_in;
+    memcpy( slot->out, slot->in, slot->uncompressed );
+    return slot->uncompressed;
 }
 
 #ifdef HAVE_ZLIB
@@ -923,32 +1022,98 @@ static void zfree( void *opaque, void *ptr )
     fci->free( ptr );
 }
 
-static cab_UWORD compress_MSZIP( FCI_Int *fci )
+/* may be called from a worker thread, so it must not use the FCI callbacks;
+ * the stream is allocated beforehand by init_compress_slot */
+static cab_UWORD compress_MSZIP( FCI_Int *fci, struct compress_slot *slot )
 {
-    z_stream stream;
+    z_stream *stream = &slot->stream;
 
-    stream.zalloc = zalloc;
-    stream.zfree  = zfree;
-    stream.opaque = fci;
-    if (deflateInit2( &stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY ) != Z_OK)
-    {
-        set_error( fci, FCIERR_ALLOC_FAIL, ERROR_NOT_ENOUGH_MEMORY );
-        return 0;
-    }
-    stream.next_in   = fci->data_in;
-    stream.avail_in  = fci->cdata_in;
-    stream.next_out  = fci->data_out + 2;
-    stream.avail_out = sizeof(fci->data_out) - 2;
+    if (deflateReset( stream ) != Z_OK) return 0;
+    stream->next_in   = slot->in;
+    stream->avail_in  = slot->uncompressed;
+    stream->next_out  = slot->out + 2;
+    stream->avail_out = 2 * CAB_BLOCKMAX - 2;
     /* insert the signature */
-    fci->data_out[0] = 'C';
-    fci->data_out[1] = 'K';
-    deflate( &stream, Z_FINISH );
-    deflateEnd( &stream );
-    return stream.total_out + 2;
+    slot->out[0] = 'C';
+    slot->out[1] = 'K';
+    deflate( stream, Z_FINISH );
+    return stream->total_out + 2;
 }
 
 #endif  /* HAVE_ZLIB */
 
+static BOOL init_compress_slot( FCI_Int *fci, struct compress_slot *slot )
+{
+#ifdef HAVE_ZLIB
+    if (fci->compress != compress_MSZIP || slot->stream_init) return TRUE;
+
+    slot->stream.zalloc = zalloc;
+    slot->stream.zfree  = zfree;
+    slot->stream.opaque = fci;
+    if (deflateInit2( &slot->stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY ) != Z_OK)
+        return FALSE;
+    slot->stream_init = TRUE;
+#endif
+    return TRUE;
+}
+
+static void free_compress_slot( FCI_Int *fci, struct compress_slot *slot )
+{
+#ifdef HAVE_ZLIB
+    if (slot->stream_init) deflateEnd( &slot->stream );
+    slot->stream_init = FALSE;
+#endif
+}
+
+static void free_compress_slots( FCI_Int *fci )
+{
+    unsigned int i;
+
+    if (!fci->slots) return;
+    for (i = 0; i < fci->nb_slots; i++)
+    {
+        free_compress_slot( fci, &fci->slots[i] );
+        fci->free( fci->slots[i].in );
+    }
+    fci->free( fci->slots );
+    if (fci->slots_done) CloseHandle( fci->slots_done );
+    fci->slots_done = NULL;
+    fci->slots = NULL;
+    fci->nb_slots = fci->used_slots = 0;
+}
+
+/* set up one slot per CPU so that full data blocks can be compressed in parallel;
+ * blocks are compressed independently, so the output doesn't depend on this */
+static void create_compress_slots( FCI_Int *fci )
+{
+    SYSTEM_INFO si;
+    unsigned int i, count;
+    unsigned char *buffer;
+
+    GetSystemInfo( &si );
+    count = min( si.dwNumberOfProcessors, FCI_MAX_THREADS );
+    if (count < 2 || fci->slots) return;
+
+    if (!(fci->slots = fci->alloc( count * sizeof(*fci->slots) ))) return;
+    memset( fci->slots, 0, count * sizeof(*fci->slots) );
+    if (!(fci->slots_done = CreateEventW( NULL, FALSE, FALSE, NULL ))) goto failed;
+
+    for (i = 0; i < count; i++)
+    {
+        if (!(buffer = fci->alloc( 3 * CAB_BLOCKMAX ))) goto failed;
+        fci->slots[i].fci = fci;
+        fci->slots[i].in  = buffer;
+        fci->slots[i].out = buffer + CAB_BLOCKMAX;
+        fci->nb_slots = i + 1;
+        if (!init_compress_slot( fci, &fci->slots[i] )) goto failed;
+    }
+    return;
+
+failed:
+    /* fall back to compressing on the calling thread */
+    free_compress_slots( fci );
+}
+
 
 /***********************************************************************
  *		FCICreate (CABINET.10)
@@ -1054,6 +1219,9 @@ HFCI __cdecl FCICreate(
   p_fci_internal->pv = pv;
   p_fci_internal->data.handle = -1;
   p_fci_internal->compress = compress_NONE;
+  p_fci_internal->main_slot.fci = p_fci_internal;
+  p_fci_internal->main_slot.in  = p_fci_internal->data_in;
+  p_fci_internal->main_slot.out = p_fci_internal->data_out;
 
   list_init( &p_fci_internal->folders_list );
   list_init( &p_fci_internal->files_list );
@@ -1424,6 +1592,7 @@ BOOL __cdecl FCIAddFile(
 #ifdef HAVE_ZLIB
           p_fci_internal->compression = tcompTYPE_MSZIP;
           p_fci_internal->compress    = compress_MSZIP;
+          create_compress_slots( p_fci_internal );
           break;
 #endif
       default:
@@ -1432,6 +1601,7 @@ BOOL __cdecl FCIAddFile(
       case tcompTYPE_NONE:
           p_fci_internal->compression = tcompTYPE_NONE;
           p_fci_internal->compress    = compress_NONE;
+          free_compress_slots( p_fci_internal );
           break;
       }
   }
@@ -1733,6 +1903,8 @@ BOOL __cdecl FCIDestroy(HFCI hfci)
     }
 
     close_temp_file( p_fci_internal, &p_fci_internal->data );
+    free_compress_slot( p_fci_internal, &p_fci_internal->main_slot );
+    free_compress_slots( p_fci_internal );
 
     /* hfci can now be removed */
     p_fci_internal->free(hfci);
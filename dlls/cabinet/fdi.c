@@ -142,7 +142,7 @@ typedef struct fdi_cds_fwd {
   cab_UBYTE *outpos;               /* (high level) start of data to use up  */
   cab_UWORD outlen;                /* (high level) amount of data to use up */
   int (*decompress)(int, int, struct fdi_cds_fwd *); /* chosen compress fn  */
-  cab_UBYTE inbuf[CAB_INPUTMAX+2]; /* +2 for lzx bitbuffer overflows!       */
+  cab_UBYTE inbuf[CAB_INPUTMAX+16]; /* +16 for bitbuffer overflows!         */
   cab_UBYTE outbuf[CAB_BLOCKMAX];
   union {
     struct ZIPstate zip;
@@ -204,6 +204,54 @@ static FDI_Int *get_fdi_ptr( HFDI hfdi )
     return fdi;
 }
 
+/* reads 8 bytes, the inflate bit buffer only uses what it needs of them */
+static inline UINT64 read_le64(const cab_UBYTE *p) {
+#ifdef WORDS_BIGENDIAN
+  return (UINT64)p[0] | ((UINT64)p[1] << 8) | ((UINT64)p[2] << 16) | ((UINT64)p[3] << 24) |
+         ((UINT64)p[4] << 32) | ((UINT64)p[5] << 40) | ((UINT64)p[6] << 48) | ((UINT64)p[7] << 56);
+#else
+  UINT64 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+#endif
+}
+
+/****************************************************************
+ * copy_match (internal)
+ *
+ * Copies a match of len bytes within the window. The source may overlap
+ * the destination, in which case the output repeats the dest - src bytes
+ * before it, as a bytewise copy would.
+ */
+static inline void copy_match(cab_UBYTE *dest, const cab_UBYTE *src, cab_ULONG len) {
+  cab_ULONG dist;
+
+  if (len <= 8) {
+    while (len--) *dest++ = *src++;
+    return;
+  }
+
+  if (src >= dest || src + len <= dest) {
+    memmove(dest, src, len);
+    return;
+  }
+
+  dist = dest - src;
+  if (dist == 1) {
+    memset(dest, *src, len);
+    return;
+  }
+
+  /* each copy doubles the repeated part, so the regions never overlap */
+  while (len > dist) {
+    memcpy(dest, src, dist);
+    dest += dist;
+    len -= dist;
+    dist <<= 1;
+  }
+  memcpy(dest, src, len);
+}
+
 /****************************************************************
  * QTMupdatemodel (internal)
  */
@@ -1066,13 +1114,15 @@ static cab_LONG fdi_Zipinflate_codes(const struct Ziphuft *tl, const struct Ziph
   cab_ULONG w;              /* current window position */
   const struct Ziphuft *t;  /* pointer to table entry */
   cab_ULONG ml, md;         /* masks for bl and bd bits */
-  register cab_ULONG b;     /* bit buffer */
+  register UINT64 b;        /* bit buffer */
   register cab_ULONG k;     /* number of bits in bit buffer */
+  cab_UBYTE *inpos;
 
   /* make local copies of globals */
   b = ZIP(bb);                       /* initialize bit buffer */
   k = ZIP(bk);
   w = ZIP(window_posn);                       /* initialize window position */
+  inpos = ZIP(inpos);
 
   /* inflate the coded data */
   ml = Zipmask[bl];           	/* precompute masks for speed */
@@ -1080,7 +1130,15 @@ static cab_LONG fdi_Zipinflate_codes(const struct Ziphuft *tl, const struct Ziph
 
   for(;;)
   {
-    ZIPNEEDBITS((cab_ULONG)bl)
+    /* a length code with its extra bits and the following distance code
+     * with its extra bits take at most 48 bits, so filling the bit buffer
+     * once per symbol is enough */
+    if (k <= 56) {
+      b |= read_le64(inpos) << k;
+      inpos += (63 - k) >> 3;
+      k |= 56;
+    }
+
     if((e = (t = tl + (b & ml))->e) > 16)
       do
       {
@@ -1088,7 +1146,6 @@ static cab_LONG fdi_Zipinflate_codes(const struct Ziphuft *tl, const struct Ziph
           return 1;
         ZIPDUMPBITS(t->b)
         e -= 16;
-        ZIPNEEDBITS(e)
       } while ((e = (t = t->v.t + (b & Zipmask[e]))->e) > 16);
     ZIPDUMPBITS(t->b)
     if (e == 16)                /* then it's a literal */
@@ -1100,22 +1157,18 @@ static cab_LONG fdi_Zipinflate_codes(const struct Ziphuft *tl, const struct Ziph
         break;
 
       /* get length of block to copy */
-      ZIPNEEDBITS(e)
       n = t->v.n + (b & Zipmask[e]);
       ZIPDUMPBITS(e);
 
       /* decode distance of block to copy */
-      ZIPNEEDBITS((cab_ULONG)bd)
       if ((e = (t = td + (b & md))->e) > 16)
         do {
           if (e == 99)
             return 1;
           ZIPDUMPBITS(t->b)
           e -= 16;
-          ZIPNEEDBITS(e)
         } while ((e = (t = t->v.t + (b & Zipmask[e]))->e) > 16);
       ZIPDUMPBITS(t->b)
-      ZIPNEEDBITS(e)
       d = w - t->v.n - (b & Zipmask[e]);
       ZIPDUMPBITS(e)
       do
@@ -1124,18 +1177,22 @@ static cab_LONG fdi_Zipinflate_codes(const struct Ziphuft *tl, const struct Ziph
         e = ZIPWSIZE - max(d, w);
         e = min(e, n);
         n -= e;
-        do
-        {
-          CAB(outbuf)[w++] = CAB(outbuf)[d++];
-        } while (--e);
+        copy_match(CAB(outbuf) + w, CAB(outbuf) + d, e);
+        w += e;
+        d += e;
       } while (n);
     }
   }
 
+  /* give back the whole bytes that were read ahead */
+  inpos -= k >> 3;
+  k &= 7;
+
   /* restore the globals from the locals */
   ZIP(window_posn) = w;              /* restore global window pointer */
-  ZIP(bb) = b;                       /* restore global bit buffer */
+  ZIP(bb) = (cab_ULONG)b & Zipmask[k]; /* restore global bit buffer */
   ZIP(bk) = k;
+  ZIP(inpos) = inpos;
 
   /* done */
   return 0;
@@ -1530,14 +1587,15 @@ static int QTMfdi_decomp(int inlen, int outlen, fdi_decomp_state *decomp_state)
         if (copy_length < match_length) {
           match_length -= copy_length;
           window_posn += copy_length;
-          while (copy_length-- > 0) *rundest++ = *runsrc++;
+          copy_match(rundest, runsrc, copy_length);
+          rundest += copy_length;
           runsrc = window;
         }
       }
       window_posn += match_length;
 
       /* copy match data - no worries about destination wraps */
-      while (match_length-- > 0) *rundest++ = *runsrc++;
+      copy_match(rundest, runsrc, match_length);
     }
   } /* while (togo > 0) */
 
@@ -1768,14 +1826,15 @@ static int LZXfdi_decomp(int inlen, int outlen, fdi_decomp_state *decomp_state)
               if (copy_length < match_length) {
                 match_length -= copy_length;
                 window_posn += copy_length;
-                while (copy_length-- > 0) *rundest++ = *runsrc++;
+                copy_match(rundest, runsrc, copy_length);
+                rundest += copy_length;
                 runsrc = window;
               }
             }
             window_posn += match_length;
 
             /* copy match data - no worries about destination wraps */
-            while (match_length-- > 0) *rundest++ = *runsrc++;
+            copy_match(rundest, runsrc, match_length);
           }
         }
         break;
@@ -1857,14 +1916,15 @@ static int LZXfdi_decomp(int inlen, int outlen, fdi_decomp_state *decomp_state)
               if (copy_length < match_length) {
                 match_length -= copy_length;
                 window_posn += copy_length;
-                while (copy_length-- > 0) *rundest++ = *runsrc++;
+                copy_match(rundest, runsrc, copy_length);
+                rundest += copy_length;
                 runsrc = window;
               }
             }
             window_posn += match_length;
 
             /* copy match data - no worries about destination wraps */
-            while (match_length-- > 0) *rundest++ = *runsrc++;
+            copy_match(rundest, runsrc, match_length);
           }
         }
         break;
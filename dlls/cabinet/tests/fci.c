@@ -0,0 +1,443 @@
+/*
+ * Unit tests for the File Compression Interface
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <stdio.h>
+#include <windows.h>
+#include "fci.h"
+#include "fdi.h"
+#include "wine/test.h"
+
+#define BLOCK_SIZE   0x8000
+#define NB_CHUNKS    5
+#define BIG_SIZE     (NB_CHUNKS * BLOCK_SIZE + 1000)
+
+static CHAR CURR_DIR[MAX_PATH];
+
+#include "pshpack1.h"
+
+struct cab_header
+{
+    char  signature[4];
+    DWORD reserved1;
+    DWORD cbCabinet;
+    DWORD reserved2;
+    DWORD coffFiles;
+    DWORD reserved3;
+    BYTE  versionMinor;
+    BYTE  versionMajor;
+    WORD  cFolders;
+    WORD  cFiles;
+    WORD  flags;
+    WORD  setID;
+    WORD  iCabinet;
+};
+
+struct cab_folder
+{
+    DWORD coffCabStart;
+    WORD  cCFData;
+    WORD  typeCompress;
+};
+
+struct cab_data
+{
+    DWORD csum;
+    WORD  cbData;
+    WORD  cbUncomp;
+};
+
+#include "poppack.h"
+
+static ULONG status_blocks[16];
+static unsigned int nb_status_blocks;
+
+/* FCI callbacks */
+
+static void * CDECL mem_alloc(ULONG cb)
+{
+    return HeapAlloc(GetProcessHeap(), 0, cb);
+}
+
+static void CDECL mem_free(void *memory)
+{
+    HeapFree(GetProcessHeap(), 0, memory);
+}
+
+static BOOL CDECL get_next_cabinet(PCCAB pccab, ULONG cbPrevCab, void *pv)
+{
+    return TRUE;
+}
+
+static LONG CDECL progress(UINT typeStatus, ULONG cb1, ULONG cb2, void *pv)
+{
+    if (typeStatus == statusFile && nb_status_blocks < ARRAY_SIZE(status_blocks))
+        status_blocks[nb_status_blocks++] = cb2;
+    return 0;
+}
+
+static int CDECL file_placed(PCCAB pccab, char *pszFile, LONG cbFile,
+                             BOOL fContinuation, void *pv)
+{
+    return 0;
+}
+
+static INT_PTR CDECL fci_open(char *pszFile, int oflag, int pmode, int *err, void *pv)
+{
+    DWORD disposition = GetFileAttributesA(pszFile) != INVALID_FILE_ATTRIBUTES ? OPEN_EXISTING : CREATE_NEW;
+    HANDLE handle;
+
+    handle = CreateFileA(pszFile, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                         NULL, disposition, 0, NULL);
+    ok(handle != INVALID_HANDLE_VALUE, "Failed to CreateFile %s\n", pszFile);
+    return (INT_PTR)handle;
+}
+
+static UINT CDECL fci_read(INT_PTR hf, void *memory, UINT cb, int *err, void *pv)
+{
+    DWORD read;
+    BOOL res;
+
+    res = ReadFile((HANDLE)hf, memory, cb, &read, NULL);
+    ok(res, "Failed to ReadFile\n");
+    return read;
+}
+
+static UINT CDECL fci_write(INT_PTR hf, void *memory, UINT cb, int *err, void *pv)
+{
+    DWORD written;
+    BOOL res;
+
+    res = WriteFile((HANDLE)hf, memory, cb, &written, NULL);
+    ok(res, "Failed to WriteFile\n");
+    return written;
+}
+
+static int CDECL fci_close(INT_PTR hf, int *err, void *pv)
+{
+    ok(CloseHandle((HANDLE)hf), "Failed to CloseHandle\n");
+    return 0;
+}
+
+static LONG CDECL fci_seek(INT_PTR hf, LONG dist, int seektype, int *err, void *pv)
+{
+    DWORD ret;
+
+    ret = SetFilePointer((HANDLE)hf, dist, NULL, seektype);
+    ok(ret != INVALID_SET_FILE_POINTER, "Failed to SetFilePointer\n");
+    return ret;
+}
+
+static int CDECL fci_delete(char *pszFile, int *err, void *pv)
+{
+    BOOL ret = DeleteFileA(pszFile);
+    ok(ret, "Failed to DeleteFile %s\n", pszFile);
+    return 0;
+}
+
+static BOOL CDECL get_temp_file(char *pszTempName, int cbTempName, void *pv)
+{
+    char tempname[MAX_PATH];
+
+    if (!GetTempFileNameA(".", "xx", 0, tempname) || strlen(tempname) >= (unsigned)cbTempName)
+        return FALSE;
+    lstrcpyA(pszTempName, tempname);
+    return TRUE;
+}
+
+static INT_PTR CDECL get_open_info(char *pszName, USHORT *pdate, USHORT *ptime,
+                                   USHORT *pattribs, int *err, void *pv)
+{
+    BY_HANDLE_FILE_INFORMATION finfo;
+    FILETIME filetime;
+    HANDLE handle;
+
+    handle = CreateFileA(pszName, GENERIC_READ, FILE_SHARE_READ, NULL,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    ok(handle != INVALID_HANDLE_VALUE, "Failed to CreateFile %s\n", pszName);
+
+    GetFileInformationByHandle(handle, &finfo);
+    FileTimeToLocalFileTime(&finfo.ftLastWriteTime, &filetime);
+    FileTimeToDosDateTime(&filetime, pdate, ptime);
+    *pattribs = 0;
+    return (INT_PTR)handle;
+}
+
+/* FDI callbacks */
+
+static void * CDECL fdi_alloc(ULONG cb)
+{
+    return HeapAlloc(GetProcessHeap(), 0, cb);
+}
+
+static void CDECL fdi_free(void *pv)
+{
+    HeapFree(GetProcessHeap(), 0, pv);
+}
+
+static INT_PTR CDECL fdi_open(char *pszFile, int oflag, int pmode)
+{
+    HANDLE handle;
+
+    handle = CreateFileA(pszFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return 0;
+    return (INT_PTR)handle;
+}
+
+static UINT CDECL fdi_read(INT_PTR hf, void *pv, UINT cb)
+{
+    DWORD read;
+
+    if (ReadFile((HANDLE)hf, pv, cb, &read, NULL)) return read;
+    return 0;
+}
+
+static UINT CDECL fdi_write(INT_PTR hf, void *pv, UINT cb)
+{
+    DWORD written;
+
+    if (WriteFile((HANDLE)hf, pv, cb, &written, NULL)) return written;
+    return 0;
+}
+
+static int CDECL fdi_close(INT_PTR hf)
+{
+    return CloseHandle((HANDLE)hf) ? 0 : -1;
+}
+
+static LONG CDECL fdi_seek(INT_PTR hf, LONG dist, int seektype)
+{
+    return SetFilePointer((HANDLE)hf, dist, NULL, seektype);
+}
+
+static INT_PTR CDECL extract_notify(FDINOTIFICATIONTYPE fdint, FDINOTIFICATION *info)
+{
+    switch (fdint)
+    {
+    case fdintCOPY_FILE:
+    {
+        HANDLE file;
+
+        /* only the multi-block file is extracted */
+        if (strcmp(info->psz1, "big.dat")) return 0;
+        ok(info->cb == BIG_SIZE, "expected %u, got %u\n", BIG_SIZE, info->cb);
+        ok(info->iFolder == 0, "expected folder 0, got %u\n", info->iFolder);
+        file = CreateFileA("big.out", GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+        ok(file != INVALID_HANDLE_VALUE, "failed to create big.out\n");
+        return (INT_PTR)file;
+    }
+    case fdintCLOSE_FILE_INFO:
+        CloseHandle((HANDLE)info->hf);
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void fill_data(BYTE *data, DWORD size)
+{
+    DWORD i, seed = 4321;
+
+    /* every block gets different contents, so that blocks written out of
+     * order can't compare equal */
+    for (i = 0; i < size; i++)
+    {
+        if ((i / 1024) % 3)
+            data[i] = (i / BLOCK_SIZE) * 7 + "wine"[i % 4];
+        else
+        {
+            seed = seed * 1103515245 + 12345;
+            data[i] = seed >> 16;
+        }
+    }
+}
+
+static void write_file(const char *name, const BYTE *data, DWORD size)
+{
+    HANDLE file;
+    DWORD written;
+
+    file = CreateFileA(name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "failed to create %s\n", name);
+    WriteFile(file, data, size, &written, NULL);
+    ok(written == size, "expected %u, got %u\n", size, written);
+    CloseHandle(file);
+}
+
+static BYTE *read_file(const char *name, DWORD *size)
+{
+    HANDLE file;
+    BYTE *data;
+
+    file = CreateFileA(name, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "failed to open %s\n", name);
+    *size = GetFileSize(file, NULL);
+    data = HeapAlloc(GetProcessHeap(), 0, *size);
+    ReadFile(file, data, *size, size, NULL);
+    CloseHandle(file);
+    return data;
+}
+
+static void add_file(HFCI hfci, char *file)
+{
+    char path[MAX_PATH];
+    BOOL res;
+
+    lstrcpyA(path, CURR_DIR);
+    lstrcatA(path, "\\");
+    lstrcatA(path, file);
+
+    res = FCIAddFile(hfci, path, file, FALSE, get_next_cabinet, progress,
+                     get_open_info, tcompTYPE_MSZIP);
+    ok(res, "Expected FCIAddFile to succeed\n");
+}
+
+/* The data blocks of a file are compressed independently of each other, and
+ * are written in order whether or not they are compressed in parallel. The
+ * cabinet holds the multi-block file in the first folder, followed by one
+ * folder per 32K chunk of it; each block of the first folder must be equal
+ * to the only block of the matching chunk folder. */
+static void test_FCIAddFile_mszip_blocks(void)
+{
+    static char big_dat[] = "big.dat";
+    char chunk_name[NB_CHUNKS][16];
+    char path[MAX_PATH + 1];
+    const struct cab_header *header;
+    const struct cab_folder *folders;
+    const struct cab_data *block, *blocks[1 + NB_CHUNKS];
+    BYTE *data, *cab, *out;
+    unsigned int i, n;
+    CCAB params;
+    DWORD size, offset;
+    HFCI hfci;
+    HFDI hfdi;
+    ERF erf;
+    BOOL ret;
+
+    data = HeapAlloc(GetProcessHeap(), 0, BIG_SIZE);
+    fill_data(data, BIG_SIZE);
+    write_file(big_dat, data, BIG_SIZE);
+    for (i = 0; i < NB_CHUNKS; i++)
+    {
+        sprintf(chunk_name[i], "chunk%u.dat", i);
+        write_file(chunk_name[i], data + i * BLOCK_SIZE, BLOCK_SIZE);
+    }
+
+    memset(&params, 0, sizeof(params));
+    params.cb = 999999999;
+    params.cbFolderThresh = 900000;
+    params.setID = 0xbeef;
+    lstrcpyA(params.szCabPath, CURR_DIR);
+    lstrcatA(params.szCabPath, "\\");
+    lstrcpyA(params.szCab, "blocks.cab");
+
+    hfci = FCICreate(&erf, file_placed, mem_alloc, mem_free, fci_open,
+                     fci_read, fci_write, fci_close, fci_seek,
+                     fci_delete, get_temp_file, &params, NULL);
+    ok(hfci != NULL, "Failed to create an FCI context\n");
+
+    nb_status_blocks = 0;
+    add_file(hfci, big_dat);
+    ok(nb_status_blocks == NB_CHUNKS + 1, "got %u blocks\n", nb_status_blocks);
+    for (i = 0; i < nb_status_blocks; i++)
+        ok(status_blocks[i] == (i < NB_CHUNKS ? BLOCK_SIZE : BIG_SIZE - NB_CHUNKS * BLOCK_SIZE),
+           "block %u: got size %u\n", i, status_blocks[i]);
+
+    for (i = 0; i < NB_CHUNKS; i++)
+    {
+        ret = FCIFlushFolder(hfci, get_next_cabinet, progress);
+        ok(ret, "Failed to flush the folder\n");
+        add_file(hfci, chunk_name[i]);
+    }
+    ret = FCIFlushCabinet(hfci, FALSE, get_next_cabinet, progress);
+    ok(ret, "Failed to flush the cabinet\n");
+    FCIDestroy(hfci);
+
+    cab = read_file("blocks.cab", &size);
+    header = (const struct cab_header *)cab;
+    ok(!memcmp(header->signature, "MSCF", 4), "wrong signature\n");
+    ok(header->cbCabinet == size, "expected size %u, got %u\n", size, header->cbCabinet);
+    ok(header->cFolders == 1 + NB_CHUNKS, "got %u folders\n", header->cFolders);
+    ok(header->cFiles == 1 + NB_CHUNKS, "got %u files\n", header->cFiles);
+    folders = (const struct cab_folder *)(header + 1);
+
+    if (header->cFolders == 1 + NB_CHUNKS)
+    {
+        /* folders are stored back to back, in the order they were flushed */
+        offset = folders[0].coffCabStart;
+        for (i = 0; i <= NB_CHUNKS; i++)
+        {
+            ok((folders[i].typeCompress & 0x0f) == tcompTYPE_MSZIP, "folder %u: got type %#x\n",
+               i, folders[i].typeCompress);
+            ok(folders[i].coffCabStart == offset, "folder %u: expected offset %u, got %u\n",
+               i, offset, folders[i].coffCabStart);
+            ok(folders[i].cCFData == (i ? 1 : NB_CHUNKS + 1), "folder %u: got %u blocks\n",
+               i, folders[i].cCFData);
+            if (folders[i].coffCabStart != offset) break;
+
+            blocks[i] = block = (const struct cab_data *)(cab + offset);
+            for (n = 0; n < folders[i].cCFData && offset + sizeof(*block) <= size; n++)
+            {
+                ok(!memcmp(block + 1, "CK", 2), "folder %u block %u: missing MSZIP signature\n", i, n);
+                offset += sizeof(*block) + block->cbData;
+                block = (const struct cab_data *)(cab + offset);
+            }
+        }
+        ok(offset == size, "expected data to end at %u, got %u\n", size, offset);
+
+        block = blocks[0];
+        for (i = 0; i < NB_CHUNKS; i++)
+        {
+            ok(block->cbUncomp == BLOCK_SIZE, "block %u: got size %u\n", i, block->cbUncomp);
+            ok(block->cbData == blocks[i + 1]->cbData &&
+               !memcmp(block, blocks[i + 1], sizeof(*block) + block->cbData),
+               "block %u differs from the block compressed on its own\n", i);
+            block = (const struct cab_data *)((const BYTE *)(block + 1) + block->cbData);
+        }
+        ok(block->cbUncomp == BIG_SIZE - NB_CHUNKS * BLOCK_SIZE, "last block: got size %u\n",
+           block->cbUncomp);
+    }
+    HeapFree(GetProcessHeap(), 0, cab);
+
+    lstrcpyA(path, CURR_DIR);
+    lstrcatA(path, "\\");
+    hfdi = FDICreate(fdi_alloc, fdi_free, fdi_open, fdi_read,
+                     fdi_write, fdi_close, fdi_seek, cpuUNKNOWN, &erf);
+    ret = FDICopy(hfdi, params.szCab, path, 0, extract_notify, NULL, 0);
+    ok(ret, "FDICopy error %d\n", erf.erfOper);
+    FDIDestroy(hfdi);
+
+    out = read_file("big.out", &size);
+    ok(size == BIG_SIZE, "expected %u, got %u\n", BIG_SIZE, size);
+    ok(size == BIG_SIZE && !memcmp(data, out, BIG_SIZE), "extracted data differs\n");
+    HeapFree(GetProcessHeap(), 0, out);
+
+    DeleteFileA("big.out");
+    DeleteFileA("blocks.cab");
+    DeleteFileA(big_dat);
+    for (i = 0; i < NB_CHUNKS; i++) DeleteFileA(chunk_name[i]);
+    HeapFree(GetProcessHeap(), 0, data);
+}
+
+START_TEST(fci)
+{
+    GetCurrentDirectoryA(MAX_PATH, CURR_DIR);
+    if (CURR_DIR[lstrlenA(CURR_DIR) - 1] == '\\')
+        CURR_DIR[lstrlenA(CURR_DIR) - 1] = 0;
+
+    test_FCIAddFile_mszip_blocks();
+}
@@ -949,6 +949,111 @@ static void test_FDICopy(void)
     FDIDestroy(hfdi);
 }
 
+#define BIG_FILE_SIZE  (200 * 1024)
+
+static void fill_big_data(BYTE *data, DWORD size)
+{
+    DWORD i, seed = 12345;
+
+    /* mix of noise, byte runs and short repeating patterns, so that the
+     * decoder sees literals as well as overlapping matches of various lengths */
+    for (i = 0; i < size; i++)
+    {
+        switch ((i / 4096) % 4)
+        {
+        case 0:
+            seed = seed * 1103515245 + 12345;
+            data[i] = seed >> 16;
+            break;
+        case 1:
+            data[i] = (i / 1000) & 0xff;
+            break;
+        case 2:
+            data[i] = "abc"[i % 3];
+            break;
+        default:
+            data[i] = (i % 37) ^ (i / 4096);
+            break;
+        }
+    }
+}
+
+static INT_PTR CDECL big_notify(FDINOTIFICATIONTYPE fdint, FDINOTIFICATION *info)
+{
+    switch (fdint)
+    {
+    case fdintCOPY_FILE:
+    {
+        HANDLE file = CreateFileA("big.out", GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+        ok(file != INVALID_HANDLE_VALUE, "failed to create big.out\n");
+        ok(info->cb == BIG_FILE_SIZE, "expected %u, got %u\n", BIG_FILE_SIZE, info->cb);
+        return (INT_PTR)file;
+    }
+    case fdintCLOSE_FILE_INFO:
+        CloseHandle((HANDLE)info->hf);
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void test_FDICopy_mszip(void)
+{
+    static CHAR big_dat[] = "big.dat";
+    char name[] = "extract.cab";
+    char path[MAX_PATH + 1];
+    BYTE *data, *out;
+    CCAB cabParams;
+    HANDLE file;
+    DWORD size;
+    HFDI hfdi;
+    HFCI hfci;
+    ERF erf;
+    BOOL ret;
+
+    data = HeapAlloc(GetProcessHeap(), 0, BIG_FILE_SIZE);
+    out = HeapAlloc(GetProcessHeap(), 0, BIG_FILE_SIZE);
+    fill_big_data(data, BIG_FILE_SIZE);
+
+    file = CreateFileA(big_dat, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "failed to create %s\n", big_dat);
+    WriteFile(file, data, BIG_FILE_SIZE, &size, NULL);
+    CloseHandle(file);
+
+    set_cab_parameters(&cabParams);
+    hfci = FCICreate(&erf, file_placed, mem_alloc, mem_free, fci_open,
+                     fci_read, fci_write, fci_close, fci_seek,
+                     fci_delete, get_temp_file, &cabParams, NULL);
+    ok(hfci != NULL, "Failed to create an FCI context\n");
+    add_file(hfci, big_dat);
+    ret = FCIFlushCabinet(hfci, FALSE, get_next_cabinet, progress);
+    ok(ret, "Failed to flush the cabinet\n");
+    FCIDestroy(hfci);
+
+    lstrcpyA(path, CURR_DIR);
+    lstrcatA(path, "\\");
+
+    hfdi = FDICreate(fdi_alloc, fdi_free, fdi_open, fdi_read,
+                     fdi_write, fdi_close, fdi_seek, cpuUNKNOWN, &erf);
+    ret = FDICopy(hfdi, name, path, 0, big_notify, NULL, 0);
+    ok(ret, "FDICopy error %d\n", erf.erfOper);
+    FDIDestroy(hfdi);
+
+    file = CreateFileA("big.out", GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "failed to open big.out\n");
+    size = 0;
+    ReadFile(file, out, BIG_FILE_SIZE, &size, NULL);
+    CloseHandle(file);
+    ok(size == BIG_FILE_SIZE, "expected %u, got %u\n", BIG_FILE_SIZE, size);
+    ok(!memcmp(data, out, BIG_FILE_SIZE), "extracted data differs\n");
+
+    DeleteFileA("big.out");
+    DeleteFileA(big_dat);
+    DeleteFileA(name);
+    HeapFree(GetProcessHeap(), 0, data);
+    HeapFree(GetProcessHeap(), 0, out);
+}
+
 
 START_TEST(fdi)
 {
@@ -956,4 +1061,5 @@ START_TEST(fdi)
     test_FDIDestroy();
     test_FDIIsCabinet();
     test_FDICopy();
+    test_FDICopy_mszip();
 }
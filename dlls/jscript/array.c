@@ -32,6 +32,14 @@ typedef struct {
     jsdisp_t dispex;
 
     DWORD length;
+
+    /* Elements [0, elems_cnt) are stored in elems as long as the array has no holes
+     * and no element with non-default attributes. Otherwise the array is sparse and
+     * all elements are ordinary dispex properties. */
+    jsval_t *elems;
+    DWORD elems_cnt;
+    DWORD elems_size;
+    BOOL sparse;
 } ArrayInstance;
 
 static const WCHAR lengthW[] = {'l','e','n','g','t','h',0};
@@ -103,10 +111,19 @@ static HRESULT get_length(script_ctx_t *ctx, vdisp_t *vdisp, jsdisp_t **jsthis,
     return S_OK;
 }
 
+static void truncate_elems(ArrayInstance *array, DWORD length)
+{
+    while(array->elems_cnt > length)
+        jsval_release(array->elems[--array->elems_cnt]);
+}
+
 static HRESULT set_length(jsdisp_t *obj, DWORD length)
 {
     if(is_class(obj, JSCLASS_ARRAY)) {
-        array_from_jsdisp(obj)->length = length;
+        ArrayInstance *array = array_from_jsdisp(obj);
+
+        truncate_elems(array, length);
+        array->length = length;
         return S_OK;
     }
 
@@ -153,10 +170,14 @@ static HRESULT Array_set_length(script_ctx_t *ctx, jsdisp_t *jsthis, jsval_t val
     if(len!=(DWORD)len)
         return throw_range_error(ctx, JS_E_INVALID_LENGTH, NULL);
 
-    for(i=len; i < This->length; i++) {
-        hres = jsdisp_delete_idx(&This->dispex, i);
-        if(FAILED(hres))
-            return hres;
+    truncate_elems(This, len);
+
+    if(This->sparse) {
+        for(i=len; i < This->length; i++) {
+            hres = jsdisp_delete_idx(&This->dispex, i);
+            if(FAILED(hres))
+                return hres;
+        }
     }
 
     This->length = len;
@@ -1106,10 +1127,44 @@ static HRESULT Array_map(script_ctx_t *ctx, vdisp_t *vthis, WORD flags, unsigned
     return hres;
 }
 
+static HRESULT unshift_elems(ArrayInstance *array, unsigned argc, jsval_t *argv)
+{
+    unsigned i;
+    HRESULT hres;
+
+    if(array->elems_cnt+argc > array->elems_size) {
+        DWORD new_size = max(array->elems_size*2, array->elems_cnt+argc);
+        jsval_t *new_elems;
+
+        new_elems = heap_realloc(array->elems, new_size*sizeof(*new_elems));
+        if(!new_elems)
+            return E_OUTOFMEMORY;
+
+        array->elems = new_elems;
+        array->elems_size = new_size;
+    }
+
+    memmove(array->elems+argc, array->elems, array->elems_cnt*sizeof(*array->elems));
+    for(i=0; i < argc; i++) {
+        hres = jsval_copy(argv[i], array->elems+i);
+        if(FAILED(hres)) {
+            while(i--)
+                jsval_release(array->elems[i]);
+            memmove(array->elems, array->elems+argc, array->elems_cnt*sizeof(*array->elems));
+            return hres;
+        }
+    }
+
+    array->elems_cnt += argc;
+    array->length = array->elems_cnt;
+    return S_OK;
+}
+
 /* ECMA-262 3rd Edition    15.4.4.13 */
 static HRESULT Array_unshift(script_ctx_t *ctx, vdisp_t *vthis, WORD flags, unsigned argc, jsval_t *argv,
         jsval_t *r)
 {
+    ArrayInstance *array;
     jsdisp_t *jsthis;
     WCHAR buf[14], *buf_end, *str;
     DWORD i, length;
@@ -1123,6 +1178,17 @@ static HRESULT Array_unshift(script_ctx_t *ctx, vdisp_t *vthis, WORD flags, unsi
     if(FAILED(hres))
         return hres;
 
+    array = array_this(vthis);
+    if(argc && array && !array->sparse && array->elems_cnt == length) {
+        hres = unshift_elems(array, argc, argv);
+        if(FAILED(hres))
+            return hres;
+
+        if(r)
+            *r = ctx->version < 2 ? jsval_undefined() : jsval_number(array->length);
+        return S_OK;
+    }
+
     if(argc) {
         buf_end = buf + ARRAY_SIZE(buf)-1;
         *buf_end-- = 0;
@@ -1178,7 +1244,11 @@ static HRESULT Array_get_value(script_ctx_t *ctx, jsdisp_t *jsthis, jsval_t *r)
 
 static void Array_destructor(jsdisp_t *dispex)
 {
-    heap_free(dispex);
+    ArrayInstance *array = array_from_jsdisp(dispex);
+
+    truncate_elems(array, 0);
+    heap_free(array->elems);
+    heap_free(array);
 }
 
 static void Array_on_put(jsdisp_t *dispex, const WCHAR *name)
@@ -1202,6 +1272,87 @@ static void Array_on_put(jsdisp_t *dispex, const WCHAR *name)
         array->length = id+1;
 }
 
+static unsigned Array_idx_length(jsdisp_t *dispex)
+{
+    return array_from_jsdisp(dispex)->elems_cnt;
+}
+
+static HRESULT Array_idx_get(jsdisp_t *dispex, unsigned idx, jsval_t *r)
+{
+    ArrayInstance *array = array_from_jsdisp(dispex);
+
+    TRACE("%p[%u]\n", array, idx);
+
+    return jsval_copy(array->elems[idx], r);
+}
+
+static HRESULT Array_idx_put(jsdisp_t *dispex, unsigned idx, jsval_t val)
+{
+    ArrayInstance *array = array_from_jsdisp(dispex);
+    jsval_t copy;
+    HRESULT hres;
+
+    TRACE("%p[%u] = %s\n", array, idx, debugstr_jsval(val));
+
+    hres = jsval_copy(val, &copy);
+    if(FAILED(hres))
+        return hres;
+
+    jsval_release(array->elems[idx]);
+    array->elems[idx] = copy;
+    return S_OK;
+}
+
+static HRESULT Array_idx_add(jsdisp_t *dispex, unsigned idx)
+{
+    ArrayInstance *array = array_from_jsdisp(dispex);
+
+    /* Only appending keeps the array free of holes. */
+    if(array->sparse || idx != array->elems_cnt)
+        return S_FALSE;
+
+    if(array->elems_cnt == array->elems_size) {
+        DWORD new_size = array->elems_size ? array->elems_size*2 : 4;
+        jsval_t *new_elems;
+
+        new_elems = heap_realloc(array->elems, new_size*sizeof(*new_elems));
+        if(!new_elems)
+            return E_OUTOFMEMORY;
+
+        array->elems = new_elems;
+        array->elems_size = new_size;
+    }
+
+    array->elems[array->elems_cnt++] = jsval_undefined();
+    if(array->length < array->elems_cnt)
+        array->length = array->elems_cnt;
+    return S_OK;
+}
+
+static HRESULT Array_idx_delete(jsdisp_t *dispex, unsigned idx)
+{
+    ArrayInstance *array = array_from_jsdisp(dispex);
+
+    if(idx != array->elems_cnt-1)
+        return S_FALSE;
+
+    truncate_elems(array, idx);
+    return S_OK;
+}
+
+static void Array_idx_detach(jsdisp_t *dispex)
+{
+    ArrayInstance *array = array_from_jsdisp(dispex);
+
+    TRACE("%p\n", array);
+
+    truncate_elems(array, 0);
+    heap_free(array->elems);
+    array->elems = NULL;
+    array->elems_cnt = array->elems_size = 0;
+    array->sparse = TRUE;
+}
+
 static const builtin_prop_t Array_props[] = {
     {concatW,                Array_concat,               PROPF_METHOD|1},
     {forEachW,               Array_forEach,              PROPF_METHOD|PROPF_ES5|1},
@@ -1227,7 +1378,13 @@ static const builtin_info_t Array_info = {
     ARRAY_SIZE(Array_props),
     Array_props,
     Array_destructor,
-    Array_on_put
+    Array_on_put,
+    Array_idx_length,
+    Array_idx_get,
+    Array_idx_put,
+    Array_idx_add,
+    Array_idx_delete,
+    Array_idx_detach
 };
 
 static const builtin_prop_t ArrayInst_props[] = {
@@ -1240,7 +1397,13 @@ static const builtin_info_t ArrayInst_info = {
     ARRAY_SIZE(ArrayInst_props),
     ArrayInst_props,
     Array_destructor,
-    Array_on_put
+    Array_on_put,
+    Array_idx_length,
+    Array_idx_get,
+    Array_idx_put,
+    Array_idx_add,
+    Array_idx_delete,
+    Array_idx_detach
 };
 
 /* ECMA-262 5.1 Edition    15.4.3.2 */
@@ -163,6 +163,30 @@ static jsstr_t *compiler_alloc_string(compiler_ctx_t *ctx, const WCHAR *str)
     return compiler_alloc_string_len(ctx, str, strlenW(str));
 }
 
+static BOOL alloc_prop_cache(compiler_ctx_t *ctx, DWORD flags, unsigned *ret)
+{
+    if(!ctx->code->prop_cache_size) {
+        ctx->code->prop_caches = heap_alloc(8 * sizeof(prop_cache_t));
+        if(!ctx->code->prop_caches)
+            return FALSE;
+        ctx->code->prop_cache_size = 8;
+    }else if(ctx->code->prop_cache_size == ctx->code->prop_cache_cnt) {
+        prop_cache_t *new_caches;
+
+        new_caches = heap_realloc(ctx->code->prop_caches, ctx->code->prop_cache_size*2*sizeof(prop_cache_t));
+        if(!new_caches)
+            return FALSE;
+
+        ctx->code->prop_caches = new_caches;
+        ctx->code->prop_cache_size *= 2;
+    }
+
+    memset(ctx->code->prop_caches+ctx->code->prop_cache_cnt, 0, sizeof(prop_cache_t));
+    ctx->code->prop_caches[ctx->code->prop_cache_cnt].flags = flags;
+    *ret = ctx->code->prop_cache_cnt++;
+    return TRUE;
+}
+
 static BOOL ensure_bstr_slot(compiler_ctx_t *ctx)
 {
     if(!ctx->code->bstr_pool_size) {
@@ -305,6 +329,17 @@ static HRESULT push_instr_bstr_uint(compiler_ctx_t *ctx, jsop_t op, const WCHAR
     return S_OK;
 }
 
+/* Pushes a member access instruction with its own property lookup cache. */
+static HRESULT push_instr_member(compiler_ctx_t *ctx, jsop_t op, const WCHAR *name, DWORD flags)
+{
+    unsigned cache;
+
+    if(!alloc_prop_cache(ctx, flags, &cache))
+        return E_OUTOFMEMORY;
+
+    return push_instr_bstr_uint(ctx, op, name, cache);
+}
+
 static HRESULT push_instr_uint_str(compiler_ctx_t *ctx, jsop_t op, unsigned arg1, const WCHAR *arg2)
 {
     unsigned instr;
@@ -387,7 +422,7 @@ static HRESULT compile_member_expression(compiler_ctx_t *ctx, member_expression_
     if(FAILED(hres))
         return hres;
 
-    return push_instr_bstr(ctx, OP_member, expr->identifier);
+    return push_instr_member(ctx, OP_member, expr->identifier, 0);
 }
 
 #define LABEL_FLAG 0x80000000
@@ -485,22 +520,12 @@ static HRESULT compile_memberid_expression(compiler_ctx_t *ctx, expression_t *ex
     }
     case EXPR_MEMBER: {
         member_expression_t *member_expr = (member_expression_t*)expr;
-        jsstr_t *jsstr;
 
         hres = compile_expression(ctx, member_expr->expression, TRUE);
         if(FAILED(hres))
             return hres;
 
-        /* FIXME: Potential optimization */
-        jsstr = compiler_alloc_string(ctx, member_expr->identifier);
-        if(!jsstr)
-            return E_OUTOFMEMORY;
-
-        hres = push_instr_str(ctx, OP_str, jsstr);
-        if(FAILED(hres))
-            return hres;
-
-        hres = push_instr_uint(ctx, OP_memberid, flags);
+        hres = push_instr_member(ctx, OP_member_ref, member_expr->identifier, flags);
         break;
     }
     DEFAULT_UNREACHABLE;
@@ -2228,6 +2253,7 @@ void release_bytecode(bytecode_t *code)
     heap_pool_free(&code->heap);
     heap_free(code->bstr_pool);
     heap_free(code->str_pool);
+    heap_free(code->prop_caches);
     heap_free(code->instrs);
     heap_free(code);
 }
@@ -2447,12 +2473,172 @@ static HRESULT compile_arguments(compiler_ctx_t *ctx, const WCHAR *args)
     return parse_arguments(ctx, args, ctx->code->global_code.params, NULL);
 }
 
+/*
+ * Hosts like mshtml tend to compile the same script text again and again, for example
+ * when a page is reloaded, and scripts do the same with eval. Compiled code doesn't
+ * depend on the script context, so it's kept in a per-thread cache keyed on the text
+ * and everything else that affects compilation. Caches are per-thread because strings
+ * referenced by the code are not thread safe.
+ */
+#define CODE_CACHE_SIZE 64
+
+typedef struct {
+    struct list entry;
+    unsigned hash;
+    WCHAR *source;
+    WCHAR *args;
+    WCHAR *delimiter;
+    DWORD version;
+    BOOL html_mode;
+    BOOL from_eval;
+    BOOL use_decode;
+    bytecode_t *code;
+} code_cache_entry_t;
+
+typedef struct {
+    struct list entries;
+    unsigned cnt;
+} code_cache_t;
+
+static DWORD code_cache_tls = TLS_OUT_OF_INDEXES;
+
+static unsigned hash_str(unsigned hash, const WCHAR *str)
+{
+    if(str) {
+        while(*str)
+            hash = hash * 31 + *str++;
+    }
+    return hash;
+}
+
+static inline BOOL str_eq(const WCHAR *str1, const WCHAR *str2)
+{
+    return str1 && str2 ? !strcmpW(str1, str2) : str1 == str2;
+}
+
+static void free_code_cache_entry(code_cache_entry_t *entry)
+{
+    list_remove(&entry->entry);
+    release_bytecode(entry->code);
+    heap_free(entry->source);
+    heap_free(entry->args);
+    heap_free(entry->delimiter);
+    heap_free(entry);
+}
+
+static bytecode_t *lookup_code_cache(script_ctx_t *ctx, unsigned hash, const WCHAR *source, const WCHAR *args,
+        const WCHAR *delimiter, BOOL from_eval, BOOL use_decode)
+{
+    code_cache_entry_t *entry;
+    code_cache_t *cache;
+
+    if(code_cache_tls == TLS_OUT_OF_INDEXES || !(cache = TlsGetValue(code_cache_tls)))
+        return NULL;
+
+    LIST_FOR_EACH_ENTRY(entry, &cache->entries, code_cache_entry_t, entry) {
+        if(entry->hash == hash && entry->version == ctx->version && entry->html_mode == ctx->html_mode
+           && entry->from_eval == from_eval && entry->use_decode == use_decode
+           && str_eq(entry->source, source) && str_eq(entry->args, args)
+           && str_eq(entry->delimiter, delimiter)) {
+            list_remove(&entry->entry);
+            list_add_head(&cache->entries, &entry->entry);
+            return bytecode_addref(entry->code);
+        }
+    }
+
+    return NULL;
+}
+
+static void add_code_cache(script_ctx_t *ctx, unsigned hash, const WCHAR *source, const WCHAR *args,
+        const WCHAR *delimiter, BOOL from_eval, BOOL use_decode, bytecode_t *code)
+{
+    code_cache_entry_t *entry;
+    code_cache_t *cache;
+
+    if(code_cache_tls == TLS_OUT_OF_INDEXES)
+        return;
+
+    cache = TlsGetValue(code_cache_tls);
+    if(!cache) {
+        cache = heap_alloc(sizeof(*cache));
+        if(!cache)
+            return;
+        list_init(&cache->entries);
+        cache->cnt = 0;
+        TlsSetValue(code_cache_tls, cache);
+    }
+
+    entry = heap_alloc_zero(sizeof(*entry));
+    if(!entry)
+        return;
+
+    entry->source = heap_strdupW(source);
+    entry->args = heap_strdupW(args);
+    entry->delimiter = heap_strdupW(delimiter);
+    if(!entry->source || (args && !entry->args) || (delimiter && !entry->delimiter)) {
+        heap_free(entry->source);
+        heap_free(entry->args);
+        heap_free(entry->delimiter);
+        heap_free(entry);
+        return;
+    }
+
+    entry->hash = hash;
+    entry->version = ctx->version;
+    entry->html_mode = ctx->html_mode;
+    entry->from_eval = from_eval;
+    entry->use_decode = use_decode;
+    entry->code = bytecode_addref(code);
+    list_add_head(&cache->entries, &entry->entry);
+
+    if(cache->cnt == CODE_CACHE_SIZE)
+        free_code_cache_entry(LIST_ENTRY(list_tail(&cache->entries), code_cache_entry_t, entry));
+    else
+        cache->cnt++;
+}
+
+BOOL init_code_cache(void)
+{
+    code_cache_tls = TlsAlloc();
+    return code_cache_tls != TLS_OUT_OF_INDEXES;
+}
+
+void free_code_cache(BOOL process_detach)
+{
+    code_cache_entry_t *entry, *next;
+    code_cache_t *cache;
+
+    if(code_cache_tls == TLS_OUT_OF_INDEXES)
+        return;
+
+    cache = TlsGetValue(code_cache_tls);
+    if(cache) {
+        LIST_FOR_EACH_ENTRY_SAFE(entry, next, &cache->entries, code_cache_entry_t, entry)
+            free_code_cache_entry(entry);
+        heap_free(cache);
+        TlsSetValue(code_cache_tls, NULL);
+    }
+
+    if(process_detach) {
+        TlsFree(code_cache_tls);
+        code_cache_tls = TLS_OUT_OF_INDEXES;
+    }
+}
+
 HRESULT compile_script(script_ctx_t *ctx, const WCHAR *code, const WCHAR *args, const WCHAR *delimiter,
         BOOL from_eval, BOOL use_decode, bytecode_t **ret)
 {
     compiler_ctx_t compiler = {0};
+    unsigned hash;
     HRESULT hres;
 
+    /* Conditional compilation state is kept in script context and may affect parsing. */
+    hash = hash_str(hash_str(hash_str(0, code), args), delimiter);
+    if(!ctx->cc && (*ret = lookup_code_cache(ctx, hash, code, args, delimiter, from_eval, use_decode))) {
+        TRACE("using cached code %p\n", *ret);
+        return S_OK;
+    }
+
     hres = init_code(&compiler, code);
     if(FAILED(hres))
         return hres;
@@ -2486,6 +2672,9 @@ HRESULT compile_script(script_ctx_t *ctx, const WCHAR *code, const WCHAR *args,
         return hres;
     }
 
+    if(!ctx->cc)
+        add_code_cache(ctx, hash, code, args, delimiter, from_eval, use_decode, compiler.code);
+
     *ret = compiler.code;
     return S_OK;
 }
@@ -28,6 +28,15 @@ WINE_DEFAULT_DEBUG_CHANNEL(jscript);
 #define FDEX_VERSION_MASK 0xf0000000
 #define GOLDEN_RATIO 0x9E3779B9U
 
+/* DISPIDs above IDX_DISPID_BASE address elements provided by idx_* hooks directly,
+ * without a property entry. They are handed out to external callers as well, by
+ * GetDispID with fdexNameEnsure and by GetNextDispID; that's fine since they are
+ * derived from the index alone: they stay valid for as long as the element exists,
+ * and get_prop maps them to the named property once the object has detached its
+ * elements. Real property ids are indexes into props and never get that high. */
+#define IDX_DISPID_BASE 0x40000000
+#define IDX_MAX (0x7fffffff - IDX_DISPID_BASE)
+
 typedef enum {
     PROP_JSVAL,
     PROP_BUILTIN,
@@ -63,12 +72,82 @@ static inline DISPID prop_to_id(jsdisp_t *This, dispex_prop_t *prop)
     return prop - This->props;
 }
 
+static BOOL is_idx_name(const WCHAR *name, unsigned *ret)
+{
+    unsigned idx = 0;
+
+    if(!isdigitW(*name) || (*name == '0' && name[1]))
+        return FALSE;
+
+    for(; isdigitW(*name); name++) {
+        if(idx > (IDX_MAX - (*name-'0')) / 10)
+            return FALSE;
+        idx = idx*10 + (*name-'0');
+    }
+
+    if(*name)
+        return FALSE;
+
+    *ret = idx;
+    return TRUE;
+}
+
+static DWORD get_idx_flags(jsdisp_t *This)
+{
+    DWORD flags = This->builtin_info->idx_put ? PROPF_WRITABLE : 0;
+
+    /* Elements that may be deleted are ordinary array elements. */
+    if(This->builtin_info->idx_delete)
+        flags |= PROPF_ENUMERABLE | PROPF_CONFIGURABLE;
+    return flags;
+}
+
+/* Elements provided by idx_* hooks may come and go without dispex knowing about it
+ * (think of Array push and pop), so their property entries are updated lazily. */
+static void update_idx_prop(jsdisp_t *This, dispex_prop_t *prop)
+{
+    unsigned idx;
+
+    switch(prop->type) {
+    case PROP_IDX:
+        if(prop->u.idx >= This->builtin_info->idx_length(This))
+            prop->type = PROP_DELETED;
+        break;
+    case PROP_PROTREF:
+    case PROP_DELETED:
+        if(prop->name && is_idx_name(prop->name, &idx) && idx < This->builtin_info->idx_length(This)) {
+            prop->type = PROP_IDX;
+            prop->flags = get_idx_flags(This);
+            prop->u.idx = idx;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static dispex_prop_t *get_idx_prop(jsdisp_t *This, unsigned idx);
+
 static inline dispex_prop_t *get_prop(jsdisp_t *This, DISPID id)
 {
-    if(id < 0 || id >= This->prop_cnt || This->props[id].type == PROP_DELETED)
+    dispex_prop_t *prop;
+
+    if(id >= IDX_DISPID_BASE)
+        return get_idx_prop(This, id - IDX_DISPID_BASE);
+    if(id < 0 || id >= This->prop_cnt)
         return NULL;
 
-    return This->props+id;
+    prop = This->props+id;
+    if(This->builtin_info->idx_length)
+        update_idx_prop(This, prop);
+    return prop->type == PROP_DELETED ? NULL : prop;
+}
+
+/* Ids of elements that don't exist yet, see jsdisp_get_idx_id. */
+static inline BOOL is_pending_idx_id(jsdisp_t *This, DISPID id)
+{
+    return id >= IDX_DISPID_BASE && This->builtin_info->idx_add
+        && id - IDX_DISPID_BASE >= This->builtin_info->idx_length(This);
 }
 
 static DWORD get_flags(jsdisp_t *This, dispex_prop_t *prop)
@@ -161,6 +240,84 @@ static inline HRESULT resize_props(jsdisp_t *This)
     return S_OK;
 }
 
+/* Layouts with more properties or more variants than these get no shared shape. */
+#define MAX_SHAPE_PROPS 32
+#define MAX_SHAPE_CHILDREN 8
+
+static LONG last_shape_id;
+
+void init_prop_shape_root(prop_shape_t *root)
+{
+    root->id = InterlockedIncrement(&last_shape_id);
+    list_init(&root->children);
+}
+
+static void release_shape(prop_shape_t *shape)
+{
+    prop_shape_t *parent;
+
+    /* The root is owned by the script context. */
+    while(shape->parent && !--shape->ref) {
+        parent = shape->parent;
+        list_remove(&shape->entry);
+        parent->children_cnt--;
+        heap_free(shape->name);
+        heap_free(shape);
+        shape = parent;
+    }
+}
+
+static prop_shape_t *get_child_shape(prop_shape_t *shape, const WCHAR *name, unsigned hash)
+{
+    prop_shape_t *child;
+
+    LIST_FOR_EACH_ENTRY(child, &shape->children, prop_shape_t, entry) {
+        if(child->hash == hash && !strcmpW(child->name, name)) {
+            child->ref++;
+            return child;
+        }
+    }
+
+    if(shape->children_cnt >= MAX_SHAPE_CHILDREN)
+        return NULL;
+
+    child = heap_alloc(sizeof(*child));
+    if(!child)
+        return NULL;
+
+    child->name = heap_strdupW(name);
+    if(!child->name) {
+        heap_free(child);
+        return NULL;
+    }
+
+    child->ref = 1;
+    child->id = InterlockedIncrement(&last_shape_id);
+    child->parent = shape;
+    child->hash = hash;
+    list_init(&child->children);
+    child->children_cnt = 0;
+
+    shape->ref++;
+    list_add_tail(&shape->children, &child->entry);
+    shape->children_cnt++;
+    return child;
+}
+
+static void update_shape(jsdisp_t *This, const WCHAR *name, unsigned hash)
+{
+    prop_shape_t *shape = NULL;
+
+    if(This->shape) {
+        if(This->prop_cnt <= MAX_SHAPE_PROPS)
+            shape = get_child_shape(This->shape, name, hash);
+        release_shape(This->shape);
+    }
+
+    This->shape = shape;
+    This->shape_id = shape ? shape->id : InterlockedIncrement(&last_shape_id);
+}
+
 static inline dispex_prop_t* alloc_prop(jsdisp_t *This, const WCHAR *name, prop_type_t type, DWORD flags)
 {
     dispex_prop_t *prop;
@@ -180,6 +337,8 @@ static inline dispex_prop_t* alloc_prop(jsdisp_t *This, const WCHAR *name, prop_
     bucket = get_props_idx(This, prop->hash);
     prop->bucket_next = This->props[bucket].bucket_head;
     This->props[bucket].bucket_head = This->prop_cnt++;
+
+    update_shape(This, prop->name, prop->hash);
     return prop;
 }
 
@@ -195,11 +354,9 @@ static dispex_prop_t *alloc_protref(jsdisp_t *This, const WCHAR *name, DWORD ref
     return ret;
 }
 
-static HRESULT find_prop_name(jsdisp_t *This, unsigned hash, const WCHAR *name, dispex_prop_t **ret)
+static dispex_prop_t *lookup_prop(jsdisp_t *This, unsigned hash, const WCHAR *name)
 {
-    const builtin_prop_t *builtin;
     unsigned bucket, pos, prev = 0;
-    dispex_prop_t *prop;
 
     bucket = get_props_idx(This, hash);
     pos = This->props[bucket].bucket_head;
@@ -211,14 +368,30 @@ static HRESULT find_prop_name(jsdisp_t *This, unsigned hash, const WCHAR *name,
                 This->props[bucket].bucket_head = pos;
             }
 
-            *ret = &This->props[pos];
-            return S_OK;
+            return &This->props[pos];
         }
 
         prev = pos;
         pos = This->props[pos].bucket_next;
     }
 
+    return NULL;
+}
+
+static HRESULT find_prop_name(jsdisp_t *This, unsigned hash, const WCHAR *name, dispex_prop_t **ret)
+{
+    const builtin_prop_t *builtin;
+    dispex_prop_t *prop;
+    unsigned idx;
+
+    prop = lookup_prop(This, hash, name);
+    if(prop) {
+        if(This->builtin_info->idx_length)
+            update_idx_prop(This, prop);
+        *ret = prop;
+        return S_OK;
+    }
+
     builtin = find_builtin_prop(This, name);
     if(builtin) {
         unsigned flags = builtin->flags;
@@ -236,27 +409,94 @@ static HRESULT find_prop_name(jsdisp_t *This, unsigned hash, const WCHAR *name,
         return S_OK;
     }
 
-    if(This->builtin_info->idx_length) {
-        const WCHAR *ptr;
-        unsigned idx = 0;
+    if(This->builtin_info->idx_length && is_idx_name(name, &idx)
+       && idx < This->builtin_info->idx_length(This)) {
+        prop = alloc_prop(This, name, PROP_IDX, get_idx_flags(This));
+        if(!prop)
+            return E_OUTOFMEMORY;
 
-        for(ptr = name; isdigitW(*ptr) && idx < 0x10000; ptr++)
-            idx = idx*10 + (*ptr-'0');
-        if(!*ptr && idx < This->builtin_info->idx_length(This)) {
-            prop = alloc_prop(This, name, PROP_IDX, This->builtin_info->idx_put ? PROPF_WRITABLE : 0);
-            if(!prop)
-                return E_OUTOFMEMORY;
+        prop->u.idx = idx;
+        *ret = prop;
+        return S_OK;
+    }
 
-            prop->u.idx = idx;
-            *ret = prop;
-            return S_OK;
+    *ret = NULL;
+    return S_OK;
+}
+
+static dispex_prop_t *get_idx_prop(jsdisp_t *This, unsigned idx)
+{
+    dispex_prop_t *prop;
+    WCHAR name[12];
+    HRESULT hres;
+
+    static const WCHAR formatW[] = {'%','d',0};
+
+    if(!This->builtin_info->idx_length)
+        return NULL;
+
+    /* Elements past the hooks' length may still exist as ordinary properties, if the
+     * id was obtained before the object detached its elements. */
+    sprintfW(name, formatW, idx);
+    hres = find_prop_name(This, string_hash(name), name, &prop);
+    if(FAILED(hres) || !prop || prop->type == PROP_DELETED)
+        return NULL;
+    return prop;
+}
+
+/* Turns all elements provided by idx_* hooks into ordinary properties. Used when an
+ * operation can't be expressed in terms of the hooks, like creating a hole. */
+static HRESULT detach_idx_props(jsdisp_t *This)
+{
+    dispex_prop_t *prop;
+    WCHAR name[12];
+    unsigned i, len;
+    jsval_t val;
+    HRESULT hres;
+
+    static const WCHAR formatW[] = {'%','d',0};
+
+    TRACE("%p\n", This);
+
+    len = This->builtin_info->idx_length(This);
+    for(i = 0; i < len; i++) {
+        hres = This->builtin_info->idx_get(This, i, &val);
+        if(FAILED(hres))
+            return hres;
+
+        sprintfW(name, formatW, i);
+        prop = lookup_prop(This, string_hash(name), name);
+        if(!prop) {
+            prop = alloc_prop(This, name, PROP_DELETED, 0);
+            if(!prop) {
+                jsval_release(val);
+                return E_OUTOFMEMORY;
+            }
+        }else if(prop->type == PROP_JSVAL) {
+            jsval_release(prop->u.val);
         }
+
+        prop->type = PROP_JSVAL;
+        prop->flags = PROPF_ENUMERABLE | PROPF_CONFIGURABLE | PROPF_WRITABLE;
+        prop->u.val = val;
     }
 
-    *ret = NULL;
+    This->builtin_info->idx_detach(This);
     return S_OK;
 }
 
+/* Called before an own element is created. Either the idx_* storage takes it, or
+ * all elements are detached and the caller creates an ordinary property. */
+static HRESULT add_idx_prop(jsdisp_t *This, unsigned idx)
+{
+    HRESULT hres;
+
+    hres = This->builtin_info->idx_add(This, idx);
+    if(hres == S_FALSE)
+        hres = detach_idx_props(This);
+    return hres;
+}
+
 static HRESULT find_prop_name_prot(jsdisp_t *This, unsigned hash, const WCHAR *name, dispex_prop_t **ret)
 {
     dispex_prop_t *prop, *del=NULL;
@@ -299,9 +539,16 @@ static HRESULT find_prop_name_prot(jsdisp_t *This, unsigned hash, const WCHAR *n
 static HRESULT ensure_prop_name(jsdisp_t *This, const WCHAR *name, DWORD create_flags, dispex_prop_t **ret)
 {
     dispex_prop_t *prop;
+    unsigned idx;
     HRESULT hres;
 
     hres = find_prop_name_prot(This, string_hash(name), name, &prop);
+    if(SUCCEEDED(hres) && (!prop || prop->type == PROP_DELETED) && This->builtin_info->idx_add
+       && is_idx_name(name, &idx)) {
+        hres = add_idx_prop(This, idx);
+        if(SUCCEEDED(hres))
+            hres = find_prop_name_prot(This, string_hash(name), name, &prop);
+    }
     if(SUCCEEDED(hres) && (!prop || prop->type == PROP_DELETED)) {
         TRACE("creating prop %s flags %x\n", debugstr_w(name), create_flags);
 
@@ -373,6 +620,17 @@ static HRESULT convert_params(const DISPPARAMS *dp, jsval_t *buf, unsigned *argc
     return S_OK;
 }
 
+static HRESULT get_idx_value(jsdisp_t *This, dispex_prop_t *prop, jsval_t *r)
+{
+    /* The element may be gone if prop was reached through a PROTREF. */
+    if(prop->u.idx >= This->builtin_info->idx_length(This)) {
+        *r = jsval_undefined();
+        return S_OK;
+    }
+
+    return This->builtin_info->idx_get(This, prop->u.idx, r);
+}
+
 static HRESULT invoke_prop_func(jsdisp_t *This, IDispatch *jsthis, dispex_prop_t *prop, WORD flags,
         unsigned argc, jsval_t *argv, jsval_t *r, IServiceProvider *caller)
 {
@@ -418,9 +676,24 @@ static HRESULT invoke_prop_func(jsdisp_t *This, IDispatch *jsthis, dispex_prop_t
     case PROP_ACCESSOR:
         FIXME("accessor\n");
         return E_NOTIMPL;
-    case PROP_IDX:
-        FIXME("Invoking PROP_IDX not yet supported\n");
-        return E_NOTIMPL;
+    case PROP_IDX: {
+        jsval_t val;
+
+        hres = get_idx_value(This, prop, &val);
+        if(FAILED(hres))
+            return hres;
+
+        if(is_object_instance(val)) {
+            TRACE("call %s %p\n", debugstr_w(prop->name), get_object(val));
+            hres = disp_call_value(This->ctx, get_object(val), jsthis, flags, argc, argv, r);
+        }else {
+            FIXME("invoke %s\n", debugstr_jsval(val));
+            hres = E_FAIL;
+        }
+
+        jsval_release(val);
+        return hres;
+    }
     case PROP_DELETED:
         assert(0);
     }
@@ -472,7 +745,7 @@ static HRESULT prop_get(jsdisp_t *This, dispex_prop_t *prop,  jsval_t *r)
         }
         break;
     case PROP_IDX:
-        hres = prop_obj->builtin_info->idx_get(prop_obj, prop->u.idx, r);
+        hres = get_idx_value(prop_obj, prop, r);
         break;
     default:
         ERR("type %d\n", prop->type);
@@ -490,8 +763,12 @@ static HRESULT prop_get(jsdisp_t *This, dispex_prop_t *prop,  jsval_t *r)
 
 static HRESULT prop_put(jsdisp_t *This, dispex_prop_t *prop, jsval_t val)
 {
+    unsigned idx;
     HRESULT hres;
 
+    if(This->builtin_info->idx_length)
+        update_idx_prop(This, prop);
+
     if(prop->type == PROP_PROTREF) {
         dispex_prop_t *prop_iter = prop;
         jsdisp_t *prototype_iter = This;
@@ -514,6 +791,19 @@ static HRESULT prop_put(jsdisp_t *This, dispex_prop_t *prop, jsval_t val)
         return prop->u.p->setter(This->ctx, This, val);
     case PROP_PROTREF:
     case PROP_DELETED:
+        if(This->builtin_info->idx_add && prop->name && is_idx_name(prop->name, &idx)) {
+            DISPID id = prop_to_id(This, prop);
+
+            hres = add_idx_prop(This, idx);
+            if(FAILED(hres))
+                return hres;
+
+            /* props may have been reallocated */
+            prop = This->props+id;
+            update_idx_prop(This, prop);
+            if(prop->type == PROP_IDX)
+                return This->builtin_info->idx_put(This, idx, val);
+        }
         prop->type = PROP_JSVAL;
         prop->flags = PROPF_ENUMERABLE | PROPF_CONFIGURABLE | PROPF_WRITABLE;
         prop->u.val = jsval_undefined();
@@ -714,7 +1004,7 @@ static HRESULT WINAPI DispatchEx_InvokeEx(IDispatchEx *iface, DISPID id, LCID lc
         V_VT(pvarRes) = VT_EMPTY;
 
     prop = get_prop(This, id);
-    if(!prop || prop->type == PROP_DELETED) {
+    if((!prop || prop->type == PROP_DELETED) && !is_pending_idx_id(This, id)) {
         TRACE("invalid id\n");
         return DISP_E_MEMBERNOTFOUND;
     }
@@ -730,6 +1020,9 @@ static HRESULT WINAPI DispatchEx_InvokeEx(IDispatchEx *iface, DISPID id, LCID lc
         jsval_t *argv, buf[6], r;
         unsigned argc;
 
+        if(!prop)
+            return DISP_E_MEMBERNOTFOUND;
+
         hres = convert_params(pdp, buf, &argc, &argv);
         if(FAILED(hres))
             return hres;
@@ -746,7 +1039,7 @@ static HRESULT WINAPI DispatchEx_InvokeEx(IDispatchEx *iface, DISPID id, LCID lc
     case DISPATCH_PROPERTYGET: {
         jsval_t r;
 
-        hres = prop_get(This, prop, &r);
+        hres = prop ? prop_get(This, prop, &r) : jsdisp_propget(This, id, &r);
         if(SUCCEEDED(hres)) {
             hres = jsval_to_variant(r, pvarRes);
             jsval_release(r);
@@ -771,7 +1064,7 @@ static HRESULT WINAPI DispatchEx_InvokeEx(IDispatchEx *iface, DISPID id, LCID lc
         if(FAILED(hres))
             return hres;
 
-        hres = prop_put(This, prop, val);
+        hres = prop ? prop_put(This, prop, val) : jsdisp_propput_idx(This, id - IDX_DISPID_BASE, val);
         jsval_release(val);
         break;
     }
@@ -785,8 +1078,10 @@ static HRESULT WINAPI DispatchEx_InvokeEx(IDispatchEx *iface, DISPID id, LCID lc
     return hres;
 }
 
-static HRESULT delete_prop(dispex_prop_t *prop, BOOL *ret)
+static HRESULT delete_prop(jsdisp_t *This, dispex_prop_t *prop, BOOL *ret)
 {
+    HRESULT hres;
+
     if(!(prop->flags & PROPF_CONFIGURABLE)) {
         *ret = FALSE;
         return S_OK;
@@ -794,6 +1089,20 @@ static HRESULT delete_prop(dispex_prop_t *prop, BOOL *ret)
 
     *ret = TRUE; /* FIXME: not exactly right */
 
+    if(prop->type == PROP_IDX && This->builtin_info->idx_delete) {
+        DISPID id = prop_to_id(This, prop);
+
+        hres = This->builtin_info->idx_delete(This, prop->u.idx);
+        if(hres != S_FALSE)
+            return hres;
+
+        /* Deleting the element would leave a hole, it needs to be an ordinary property. */
+        hres = detach_idx_props(This);
+        if(FAILED(hres))
+            return hres;
+        prop = This->props+id;
+    }
+
     if(prop->type == PROP_JSVAL) {
         jsval_release(prop->u.val);
         prop->type = PROP_DELETED;
@@ -823,7 +1132,7 @@ static HRESULT WINAPI DispatchEx_DeleteMemberByName(IDispatchEx *iface, BSTR bst
         return S_OK;
     }
 
-    return delete_prop(prop, &b);
+    return delete_prop(This, prop, &b);
 }
 
 static HRESULT WINAPI DispatchEx_DeleteMemberByDispID(IDispatchEx *iface, DISPID id)
@@ -840,7 +1149,7 @@ static HRESULT WINAPI DispatchEx_DeleteMemberByDispID(IDispatchEx *iface, DISPID
         return DISP_E_MEMBERNOTFOUND;
     }
 
-    return delete_prop(prop, &b);
+    return delete_prop(This, prop, &b);
 }
 
 static HRESULT WINAPI DispatchEx_GetMemberProperties(IDispatchEx *iface, DISPID id, DWORD grfdexFetch, DWORD *pgrfdex)
@@ -882,6 +1191,17 @@ static HRESULT WINAPI DispatchEx_GetNextDispID(IDispatchEx *iface, DWORD grfdex,
             return hres;
     }
 
+    /* Elements provided by idx_* hooks are enumerated first, in index order. */
+    if((id == DISPID_STARTENUM || id >= IDX_DISPID_BASE) && This->builtin_info->idx_length
+       && (get_idx_flags(This) & PROPF_ENUMERABLE)) {
+        id = id == DISPID_STARTENUM ? IDX_DISPID_BASE : id+1;
+        if(id - IDX_DISPID_BASE < This->builtin_info->idx_length(This)) {
+            *pid = id;
+            return S_OK;
+        }
+        id = DISPID_STARTENUM;
+    }
+
     if(id+1>=0 && id+1<This->prop_cnt) {
         iter = &This->props[id+1];
     }else {
@@ -890,7 +1210,10 @@ static HRESULT WINAPI DispatchEx_GetNextDispID(IDispatchEx *iface, DWORD grfdex,
     }
 
     while(iter < This->props + This->prop_cnt) {
-        if(iter->name && (get_flags(This, iter) & PROPF_ENUMERABLE) && iter->type!=PROP_DELETED) {
+        if(This->builtin_info->idx_length)
+            update_idx_prop(This, iter);
+        if(iter->name && (get_flags(This, iter) & PROPF_ENUMERABLE) && iter->type!=PROP_DELETED
+           && iter->type!=PROP_IDX) {
             *pid = prop_to_id(This, iter);
             return S_OK;
         }
@@ -944,6 +1267,8 @@ HRESULT init_dispex(jsdisp_t *dispex, script_ctx_t *ctx, const builtin_info_t *b
     dispex->IDispatchEx_iface.lpVtbl = &DispatchExVtbl;
     dispex->ref = 1;
     dispex->builtin_info = builtin_info;
+    dispex->shape = &ctx->shape_root;
+    dispex->shape_id = ctx->shape_root.id;
 
     dispex->props = heap_alloc_zero(sizeof(dispex_prop_t)*(dispex->buf_size=4));
     if(!dispex->props)
@@ -1017,6 +1342,8 @@ void jsdisp_free(jsdisp_t *obj)
         heap_free(prop->name);
     }
     heap_free(obj->props);
+    if(obj->shape)
+        release_shape(obj->shape);
     script_release(obj->ctx);
     if(obj->prototype)
         jsdisp_release(obj->prototype);
@@ -1085,7 +1412,7 @@ jsdisp_t *iface_to_jsdisp(IDispatch *iface)
         : NULL;
 }
 
-HRESULT jsdisp_get_id(jsdisp_t *jsdisp, const WCHAR *name, DWORD flags, DISPID *id)
+static HRESULT get_id(jsdisp_t *jsdisp, const WCHAR *name, DWORD flags, DISPID *id)
 {
     dispex_prop_t *prop;
     HRESULT hres;
@@ -1107,6 +1434,77 @@ HRESULT jsdisp_get_id(jsdisp_t *jsdisp, const WCHAR *name, DWORD flags, DISPID *
     return DISP_E_UNKNOWNNAME;
 }
 
+HRESULT jsdisp_get_id(jsdisp_t *jsdisp, const WCHAR *name, DWORD flags, DISPID *id)
+{
+    unsigned idx;
+
+    if((flags & fdexNameEnsure) && jsdisp->builtin_info->idx_add && is_idx_name(name, &idx))
+        return jsdisp_get_idx_id(jsdisp, idx, flags, id);
+
+    return get_id(jsdisp, name, flags, id);
+}
+
+HRESULT jsdisp_get_id_cached(jsdisp_t *jsdisp, const WCHAR *name, prop_cache_t *cache, DISPID *id)
+{
+    dispex_prop_t *prop;
+    HRESULT hres;
+
+    if(cache->shape_id == jsdisp->shape_id) {
+        prop = jsdisp->props + cache->id;
+        if(jsdisp->builtin_info->idx_length)
+            update_idx_prop(jsdisp, prop);
+
+        /* A deleted property may need to be looked up in the prototype again. */
+        if(prop->type != PROP_DELETED) {
+            *id = cache->id;
+            return S_OK;
+        }
+    }
+
+    hres = jsdisp_get_id(jsdisp, name, cache->flags, id);
+    if(SUCCEEDED(hres) && *id < IDX_DISPID_BASE) {
+        cache->shape_id = jsdisp->shape_id;
+        cache->id = *id;
+    }
+    return hres;
+}
+
+HRESULT jsdisp_get_idx_id(jsdisp_t *jsdisp, DWORD idx, DWORD flags, DISPID *id)
+{
+    WCHAR name[12];
+
+    static const WCHAR formatW[] = {'%','d',0};
+
+    if(jsdisp->builtin_info->idx_length && idx <= IDX_MAX) {
+        unsigned len = jsdisp->builtin_info->idx_length(jsdisp);
+        dispex_prop_t *prop;
+        HRESULT hres;
+
+        if(idx < len) {
+            *id = IDX_DISPID_BASE + idx;
+            return S_OK;
+        }
+
+        /* Missing elements get a pending id. They are only created once a value is stored
+         * (see jsdisp_propput_idx), so that evaluating the assigned expression sees the old
+         * length and a failed assignment doesn't leave the element behind. */
+        if((flags & fdexNameEnsure) && jsdisp->builtin_info->idx_add) {
+            sprintfW(name, formatW, idx);
+            hres = find_prop_name_prot(jsdisp, string_hash(name), name, &prop);
+            if(FAILED(hres))
+                return hres;
+
+            if(!prop || prop->type == PROP_DELETED) {
+                *id = IDX_DISPID_BASE + idx;
+                return S_OK;
+            }
+        }
+    }
+
+    sprintfW(name, formatW, idx);
+    return get_id(jsdisp, name, flags, id);
+}
+
 HRESULT jsdisp_call_value(jsdisp_t *jsfunc, IDispatch *jsthis, WORD flags, unsigned argc, jsval_t *argv, jsval_t *r)
 {
     HRESULT hres;
@@ -1373,6 +1771,15 @@ HRESULT jsdisp_propput_idx(jsdisp_t *obj, DWORD idx, jsval_t val)
 
     static const WCHAR formatW[] = {'%','d',0};
 
+    if(obj->builtin_info->idx_put && idx <= IDX_MAX) {
+        unsigned len = obj->builtin_info->idx_length(obj);
+
+        if(idx == len && obj->builtin_info->idx_add && obj->builtin_info->idx_add(obj, idx) == S_OK)
+            len++;
+        if(idx < len)
+            return obj->builtin_info->idx_put(obj, idx, val);
+    }
+
     sprintfW(buf, formatW, idx);
     return jsdisp_propput_name(obj, buf, val);
 }
@@ -1386,11 +1793,13 @@ HRESULT disp_propput(script_ctx_t *ctx, IDispatch *disp, DISPID id, jsval_t val)
     if(jsdisp) {
         dispex_prop_t *prop;
 
-        prop = get_prop(jsdisp, id);
-        if(prop)
+        if(id >= IDX_DISPID_BASE) {
+            hres = jsdisp_propput_idx(jsdisp, id - IDX_DISPID_BASE, val);
+        }else if((prop = get_prop(jsdisp, id))) {
             hres = prop_put(jsdisp, prop, val);
-        else
+        }else {
             hres = DISP_E_MEMBERNOTFOUND;
+        }
 
         jsdisp_release(jsdisp);
     }else {
@@ -1451,6 +1860,9 @@ HRESULT jsdisp_get_idx(jsdisp_t *obj, DWORD idx, jsval_t *r)
 
     static const WCHAR formatW[] = {'%','d',0};
 
+    if(obj->builtin_info->idx_length && idx < obj->builtin_info->idx_length(obj))
+        return obj->builtin_info->idx_get(obj, idx, r);
+
     sprintfW(name, formatW, idx);
 
     hres = find_prop_name_prot(obj, string_hash(name), name, &prop);
@@ -1469,6 +1881,14 @@ HRESULT jsdisp_propget(jsdisp_t *jsdisp, DISPID id, jsval_t *val)
 {
     dispex_prop_t *prop;
 
+    if(id >= IDX_DISPID_BASE && jsdisp->builtin_info->idx_length) {
+        HRESULT hres;
+
+        /* The element may not exist (yet), look it up like any other missing index. */
+        hres = jsdisp_get_idx(jsdisp, id - IDX_DISPID_BASE, val);
+        return hres == DISP_E_UNKNOWNNAME ? S_OK : hres;
+    }
+
     prop = get_prop(jsdisp, id);
     if(!prop)
         return DISP_E_MEMBERNOTFOUND;
@@ -1520,13 +1940,17 @@ HRESULT jsdisp_delete_idx(jsdisp_t *obj, DWORD idx)
     BOOL b;
     HRESULT hres;
 
+    if(obj->builtin_info->idx_delete && idx < obj->builtin_info->idx_length(obj)
+       && obj->builtin_info->idx_delete(obj, idx) == S_OK)
+        return S_OK;
+
     sprintfW(buf, formatW, idx);
 
     hres = find_prop_name(obj, string_hash(buf), buf, &prop);
     if(FAILED(hres) || !prop)
         return hres;
 
-    return delete_prop(prop, &b);
+    return delete_prop(obj, prop, &b);
 }
 
 HRESULT disp_delete(IDispatch *disp, DISPID id, BOOL *ret)
@@ -1541,7 +1965,7 @@ HRESULT disp_delete(IDispatch *disp, DISPID id, BOOL *ret)
 
         prop = get_prop(jsdisp, id);
         if(prop)
-            hres = delete_prop(prop, ret);
+            hres = delete_prop(jsdisp, prop, ret);
         else
             hres = DISP_E_MEMBERNOTFOUND;
 
@@ -1584,7 +2008,7 @@ HRESULT disp_delete_name(script_ctx_t *ctx, IDispatch *disp, jsstr_t *name, BOOL
 
         hres = find_prop_name(jsdisp, string_hash(ptr), ptr, &prop);
         if(prop) {
-            hres = delete_prop(prop, ret);
+            hres = delete_prop(jsdisp, prop, ret);
         }else {
             *ret = TRUE;
             hres = S_OK;
@@ -1641,6 +2065,7 @@ HRESULT jsdisp_get_own_property(jsdisp_t *obj, const WCHAR *name, BOOL flags_onl
     switch(prop->type) {
     case PROP_BUILTIN:
     case PROP_JSVAL:
+    case PROP_IDX:
         desc->mask |= PROPF_WRITABLE;
         desc->explicit_value = TRUE;
         if(!flags_only) {
@@ -1670,8 +2095,16 @@ HRESULT jsdisp_get_own_property(jsdisp_t *obj, const WCHAR *name, BOOL flags_onl
 HRESULT jsdisp_define_property(jsdisp_t *obj, const WCHAR *name, property_desc_t *desc)
 {
     dispex_prop_t *prop;
+    unsigned idx;
     HRESULT hres;
 
+    /* idx_* storage can't express custom attributes */
+    if(obj->builtin_info->idx_detach && is_idx_name(name, &idx)) {
+        hres = detach_idx_props(obj);
+        if(FAILED(hres))
+            return hres;
+    }
+
     hres = find_prop_name(obj, string_hash(name), name, &prop);
     if(FAILED(hres))
         return hres;
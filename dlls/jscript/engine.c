@@ -726,6 +726,12 @@ static inline unsigned get_op_int(script_ctx_t *ctx, int i)
     return frame->bytecode->instrs[frame->ip].u.arg[i].lng;
 }
 
+static inline prop_cache_t *get_op_prop_cache(script_ctx_t *ctx, int i)
+{
+    call_frame_t *frame = ctx->call_ctx;
+    return frame->bytecode->prop_caches + frame->bytecode->instrs[frame->ip].u.arg[i].uint;
+}
+
 static inline jsstr_t *get_op_str(script_ctx_t *ctx, int i)
 {
     call_frame_t *frame = ctx->call_ctx;
@@ -1014,6 +1020,11 @@ static HRESULT interp_func(script_ctx_t *ctx)
     return stack_push(ctx, jsval_obj(dispex));
 }
 
+static inline BOOL is_idx_number(jsval_t v)
+{
+    return is_number(v) && get_number(v) >= 0 && is_int32(get_number(v));
+}
+
 /* ECMA-262 3rd Edition    11.2.1 */
 static HRESULT interp_array(script_ctx_t *ctx)
 {
@@ -1021,6 +1032,7 @@ static HRESULT interp_array(script_ctx_t *ctx)
     const WCHAR *name;
     jsval_t v, namev;
     IDispatch *obj;
+    jsdisp_t *jsdisp;
     DISPID id;
     HRESULT hres;
 
@@ -1034,6 +1046,18 @@ static HRESULT interp_array(script_ctx_t *ctx)
         return hres;
     }
 
+    /* Fast path for element access, skips converting the index to string. */
+    if(is_idx_number(namev) && (jsdisp = to_jsdisp(obj))) {
+        hres = jsdisp_get_idx(jsdisp, get_number(namev), &v);
+        IDispatch_Release(obj);
+        if(hres == DISP_E_UNKNOWNNAME)
+            hres = S_OK;
+        if(FAILED(hres))
+            return hres;
+
+        return stack_push(ctx, v);
+    }
+
     hres = to_flat_string(ctx, namev, &name_str, &name);
     jsval_release(namev);
     if(FAILED(hres)) {
@@ -1060,6 +1084,8 @@ static HRESULT interp_array(script_ctx_t *ctx)
 static HRESULT interp_member(script_ctx_t *ctx)
 {
     const BSTR arg = get_op_bstr(ctx, 0);
+    prop_cache_t *cache = get_op_prop_cache(ctx, 1);
+    jsdisp_t *jsdisp;
     IDispatch *obj;
     jsval_t v;
     DISPID id;
@@ -1071,9 +1097,13 @@ static HRESULT interp_member(script_ctx_t *ctx)
     if(FAILED(hres))
         return hres;
 
-    hres = disp_get_id(ctx, obj, arg, arg, 0, &id);
+    jsdisp = to_jsdisp(obj);
+    if(jsdisp)
+        hres = jsdisp_get_id_cached(jsdisp, arg, cache, &id);
+    else
+        hres = disp_get_id(ctx, obj, arg, arg, 0, &id);
     if(SUCCEEDED(hres)) {
-        hres = disp_propget(ctx, obj, id, &v);
+        hres = jsdisp ? jsdisp_propget(jsdisp, id, &v) : disp_propget(ctx, obj, id, &v);
     }else if(hres == DISP_E_UNKNOWNNAME) {
         v = jsval_undefined();
         hres = S_OK;
@@ -1085,6 +1115,48 @@ static HRESULT interp_member(script_ctx_t *ctx)
     return stack_push(ctx, v);
 }
 
+/* ECMA-262 3rd Edition    11.2.1 */
+static HRESULT interp_member_ref(script_ctx_t *ctx)
+{
+    const BSTR arg = get_op_bstr(ctx, 0);
+    prop_cache_t *cache = get_op_prop_cache(ctx, 1);
+    jsdisp_t *jsdisp;
+    IDispatch *obj;
+    exprval_t ref;
+    jsval_t objv;
+    DISPID id;
+    HRESULT hres;
+
+    TRACE("%s\n", debugstr_w(arg));
+
+    objv = stack_pop(ctx);
+    hres = to_object(ctx, objv, &obj);
+    jsval_release(objv);
+    if(FAILED(hres))
+        return hres;
+
+    if((jsdisp = to_jsdisp(obj)))
+        hres = jsdisp_get_id_cached(jsdisp, arg, cache, &id);
+    else
+        hres = disp_get_id(ctx, obj, arg, arg, cache->flags, &id);
+    if(SUCCEEDED(hres)) {
+        ref.type = EXPRVAL_IDREF;
+        ref.u.idref.disp = obj;
+        ref.u.idref.id = id;
+    }else {
+        IDispatch_Release(obj);
+        if(hres == DISP_E_UNKNOWNNAME && !(cache->flags & fdexNameEnsure)) {
+            exprval_set_exception(&ref, JS_E_INVALID_PROPERTY);
+            hres = S_OK;
+        }else {
+            ERR("failed %08x\n", hres);
+            return hres;
+        }
+    }
+
+    return stack_push_exprval(ctx, &ref);
+}
+
 /* ECMA-262 3rd Edition    11.2.1 */
 static HRESULT interp_memberid(script_ctx_t *ctx)
 {
@@ -1093,6 +1165,7 @@ static HRESULT interp_memberid(script_ctx_t *ctx)
     const WCHAR *name;
     jsstr_t *name_str;
     IDispatch *obj;
+    jsdisp_t *jsdisp;
     exprval_t ref;
     DISPID id;
     HRESULT hres;
@@ -1104,17 +1177,24 @@ static HRESULT interp_memberid(script_ctx_t *ctx)
 
     hres = to_object(ctx, objv, &obj);
     jsval_release(objv);
-    if(SUCCEEDED(hres)) {
+    if(FAILED(hres)) {
+        jsval_release(namev);
+        return hres;
+    }
+
+    if(is_idx_number(namev) && (jsdisp = to_jsdisp(obj))) {
+        hres = jsdisp_get_idx_id(jsdisp, get_number(namev), arg, &id);
+    }else {
         hres = to_flat_string(ctx, namev, &name_str, &name);
-        if(FAILED(hres))
+        jsval_release(namev);
+        if(FAILED(hres)) {
             IDispatch_Release(obj);
-    }
-    jsval_release(namev);
-    if(FAILED(hres))
-        return hres;
+            return hres;
+        }
 
-    hres = disp_get_id(ctx, obj, name, NULL, arg, &id);
-    jsstr_release(name_str);
+        hres = disp_get_id(ctx, obj, name, NULL, arg, &id);
+        jsstr_release(name_str);
+    }
     if(SUCCEEDED(hres)) {
         ref.type = EXPRVAL_IDREF;
         ref.u.idref.disp = obj;
@@ -1457,6 +1537,10 @@ static HRESULT interp_obj_prop(script_ctx_t *ctx)
 
     /* FIXME: we should pass it as jsstr_t */
     name = jsstr_flatten(name_arg);
+    if(!name) {
+        jsval_release(val);
+        return E_OUTOFMEMORY;
+    }
 
     assert(is_object_instance(stack_top(ctx)));
     obj = as_jsdisp(get_object(stack_top(ctx)));
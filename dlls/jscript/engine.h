@@ -55,7 +55,8 @@
     X(lshift,     1, 0,0)                  \
     X(lt,         1, 0,0)                  \
     X(lteq,       1, 0,0)                  \
-    X(member,     1, ARG_BSTR,   0)        \
+    X(member,     1, ARG_BSTR,   ARG_UINT) \
+    X(member_ref, 1, ARG_BSTR,   ARG_UINT) \
     X(memberid,   1, ARG_UINT,   0)        \
     X(minus,      1, 0,0)                  \
     X(mod,        1, 0,0)                  \
@@ -185,7 +186,9 @@ typedef struct _bytecode_t {
     unsigned str_pool_size;
     unsigned str_cnt;
 
-    struct _bytecode_t *next;
+    prop_cache_t *prop_caches;
+    unsigned prop_cache_size;
+    unsigned prop_cache_cnt;
 } bytecode_t;
 
 HRESULT compile_script(script_ctx_t*,const WCHAR*,const WCHAR*,const WCHAR*,BOOL,BOOL,bytecode_t**) DECLSPEC_HIDDEN;
@@ -60,10 +60,16 @@ typedef struct {
 
     IActiveScriptSite *site;
 
-    bytecode_t *queue_head;
-    bytecode_t *queue_tail;
+    struct list queued_code;
 } JScript;
 
+/* Compiled code may be shared with other script engines on the thread, so it's
+ * queued through separate entries. */
+typedef struct {
+    struct list entry;
+    bytecode_t *code;
+} queued_code_t;
+
 void script_release(script_ctx_t *ctx)
 {
     if(--ctx->ref)
@@ -74,6 +80,7 @@ void script_release(script_ctx_t *ctx)
     if(ctx->cc)
         release_cc(ctx->cc);
     heap_pool_free(&ctx->tmp_heap);
+    clear_regexp_cache(ctx);
     if(ctx->last_match)
         jsstr_release(ctx->last_match);
     assert(!ctx->stack_top);
@@ -117,28 +124,21 @@ static HRESULT exec_global_code(JScript *This, bytecode_t *code)
 
 static void clear_script_queue(JScript *This)
 {
-    bytecode_t *iter, *iter2;
-
-    if(!This->queue_head)
-        return;
+    queued_code_t *iter, *iter2;
 
-    iter = This->queue_head;
-    while(iter) {
-        iter2 = iter->next;
-        iter->next = NULL;
-        release_bytecode(iter);
-        iter = iter2;
+    LIST_FOR_EACH_ENTRY_SAFE(iter, iter2, &This->queued_code, queued_code_t, entry) {
+        list_remove(&iter->entry);
+        release_bytecode(iter->code);
+        heap_free(iter);
     }
-
-    This->queue_head = This->queue_tail = NULL;
 }
 
 static void exec_queued_code(JScript *This)
 {
-    bytecode_t *iter;
+    queued_code_t *iter;
 
-    for(iter = This->queue_head; iter; iter = iter->next)
-        exec_global_code(This, iter);
+    LIST_FOR_EACH_ENTRY(iter, &This->queued_code, queued_code_t, entry)
+        exec_global_code(This, iter->code);
 
     clear_script_queue(This);
 }
@@ -718,6 +718,7 @@ static HRESULT WINAPI JScriptParse_InitNew(IActiveScriptParse *iface)
     ctx->ei.val = jsval_undefined();
     ctx->acc = jsval_undefined();
     heap_pool_init(&ctx->tmp_heap);
+    init_prop_shape_root(&ctx->shape_root);
 
     hres = create_jscaller(ctx);
     if(FAILED(hres)) {
@@ -793,10 +794,16 @@ static HRESULT WINAPI JScriptParse_ParseScriptText(IActiveScriptParse *iface,
      * script is executed immediately, even if it's not in started state yet.
      */
     if(!pvarResult && !is_started(This->ctx)) {
-        if(This->queue_tail)
-            This->queue_tail = This->queue_tail->next = code;
-        else
-            This->queue_head = This->queue_tail = code;
+        queued_code_t *queued;
+
+        queued = heap_alloc(sizeof(*queued));
+        if(!queued) {
+            release_bytecode(code);
+            return E_OUTOFMEMORY;
+        }
+
+        queued->code = code;
+        list_add_tail(&This->queued_code, &queued->entry);
         return S_OK;
     }
 
@@ -1089,6 +1096,7 @@ HRESULT create_jscript_object(BOOL is_encode, REFIID riid, void **ppv)
     ret->ref = 1;
     ret->safeopt = INTERFACE_USES_DISPEX;
     ret->is_encode = is_encode;
+    list_init(&ret->queued_code);
 
     hres = IActiveScript_QueryInterface(&ret->IActiveScript_iface, riid, ppv);
     IActiveScript_Release(&ret->IActiveScript_iface);
@@ -219,8 +219,25 @@ typedef struct {
     unsigned (*idx_length)(jsdisp_t*);
     HRESULT (*idx_get)(jsdisp_t*,unsigned,jsval_t*);
     HRESULT (*idx_put)(jsdisp_t*,unsigned,jsval_t);
+    HRESULT (*idx_add)(jsdisp_t*,unsigned);
+    HRESULT (*idx_delete)(jsdisp_t*,unsigned);
+    void (*idx_detach)(jsdisp_t*);
 } builtin_info_t;
 
+/* Objects that allocated the same property names in the same order have the same
+ * property table layout and share its shape. Shapes form a tree rooted in the script
+ * context, each node adding one name to its parent's layout. */
+typedef struct _prop_shape_t {
+    unsigned ref;
+    unsigned id;
+    struct _prop_shape_t *parent;
+    WCHAR *name;
+    unsigned hash;
+    struct list children;
+    unsigned children_cnt;
+    struct list entry;
+} prop_shape_t;
+
 struct jsdisp_t {
     IDispatchEx IDispatchEx_iface;
 
@@ -234,8 +251,21 @@ struct jsdisp_t {
     jsdisp_t *prototype;
 
     const builtin_info_t *builtin_info;
+
+    /* NULL once the layout got too unusual to be shared, shape_id is then unique
+     * to this object and changes with every allocated property. */
+    prop_shape_t *shape;
+    unsigned shape_id;
 };
 
+/* Per-site property lookup cache. Property ids never change once allocated, so
+ * the cached id is valid for every object with the same layout. */
+typedef struct {
+    unsigned shape_id;
+    DISPID id;
+    DWORD flags;
+} prop_cache_t;
+
 static inline IDispatch *to_disp(jsdisp_t *jsdisp)
 {
     return (IDispatch*)&jsdisp->IDispatchEx_iface;
@@ -244,6 +274,7 @@ static inline IDispatch *to_disp(jsdisp_t *jsdisp)
 jsdisp_t *as_jsdisp(IDispatch*) DECLSPEC_HIDDEN;
 jsdisp_t *to_jsdisp(IDispatch*) DECLSPEC_HIDDEN;
 void jsdisp_free(jsdisp_t*) DECLSPEC_HIDDEN;
+void init_prop_shape_root(prop_shape_t*) DECLSPEC_HIDDEN;
 
 #ifndef TRACE_REFCNT
 
@@ -290,6 +321,8 @@ HRESULT jsdisp_propput_idx(jsdisp_t*,DWORD,jsval_t) DECLSPEC_HIDDEN;
 HRESULT jsdisp_propget_name(jsdisp_t*,LPCWSTR,jsval_t*) DECLSPEC_HIDDEN;
 HRESULT jsdisp_get_idx(jsdisp_t*,DWORD,jsval_t*) DECLSPEC_HIDDEN;
 HRESULT jsdisp_get_id(jsdisp_t*,const WCHAR*,DWORD,DISPID*) DECLSPEC_HIDDEN;
+HRESULT jsdisp_get_idx_id(jsdisp_t*,DWORD,DWORD,DISPID*) DECLSPEC_HIDDEN;
+HRESULT jsdisp_get_id_cached(jsdisp_t*,const WCHAR*,prop_cache_t*,DISPID*) DECLSPEC_HIDDEN;
 HRESULT disp_delete(IDispatch*,DISPID,BOOL*) DECLSPEC_HIDDEN;
 HRESULT disp_delete_name(script_ctx_t*,IDispatch*,jsstr_t*,BOOL*) DECLSPEC_HIDDEN;
 HRESULT jsdisp_delete_idx(jsdisp_t*,DWORD) DECLSPEC_HIDDEN;
@@ -399,6 +432,12 @@ typedef struct {
     unsigned length;
 } match_result_t;
 
+typedef struct {
+    jsstr_t *src;
+    DWORD flags;
+    struct regexp_t *regexp;
+} regexp_cache_entry_t;
+
 struct _script_ctx_t {
     LONG ref;
 
@@ -431,6 +470,11 @@ struct _script_ctx_t {
     DWORD last_match_index;
     DWORD last_match_length;
 
+    regexp_cache_entry_t regexp_cache[16];
+    unsigned regexp_cache_next;
+
+    prop_shape_t shape_root;
+
     jsdisp_t *global;
     jsdisp_t *function_constr;
     jsdisp_t *array_constr;
@@ -486,6 +530,7 @@ struct match_state_t;
 HRESULT regexp_match_next(script_ctx_t*,jsdisp_t*,DWORD,jsstr_t*,struct match_state_t**) DECLSPEC_HIDDEN;
 HRESULT parse_regexp_flags(const WCHAR*,DWORD,DWORD*) DECLSPEC_HIDDEN;
 HRESULT regexp_string_match(script_ctx_t*,jsdisp_t*,jsstr_t*,jsval_t*) DECLSPEC_HIDDEN;
+void clear_regexp_cache(script_ctx_t*) DECLSPEC_HIDDEN;
 
 BOOL bool_obj_value(jsdisp_t*) DECLSPEC_HIDDEN;
 unsigned array_get_length(jsdisp_t*) DECLSPEC_HIDDEN;
@@ -578,6 +623,8 @@ static inline BOOL is_jscript_error(HRESULT hres)
 const char *debugstr_jsval(const jsval_t) DECLSPEC_HIDDEN;
 
 HRESULT create_jscript_object(BOOL,REFIID,void**) DECLSPEC_HIDDEN;
+BOOL init_code_cache(void) DECLSPEC_HIDDEN;
+void free_code_cache(BOOL) DECLSPEC_HIDDEN;
 
 extern LONG module_ref DECLSPEC_HIDDEN;
 
@@ -138,13 +138,16 @@ BOOL WINAPI DllMain(HINSTANCE hInstDLL, DWORD fdwReason, LPVOID lpv)
 
     switch(fdwReason) {
     case DLL_PROCESS_ATTACH:
-        DisableThreadLibraryCalls(hInstDLL);
         jscript_hinstance = hInstDLL;
-        if(!init_strings())
+        if(!init_strings() || !init_code_cache())
             return FALSE;
         break;
+    case DLL_THREAD_DETACH:
+        free_code_cache(FALSE);
+        break;
     case DLL_PROCESS_DETACH:
         if (lpv) break;
+        free_code_cache(TRUE);
         free_strings();
     }
 
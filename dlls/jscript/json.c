@@ -721,7 +721,6 @@ static HRESULT stringify(stringify_ctx_t *ctx, jsval_t val)
                 break;
 
             ptr = jsstr_flatten(str);
-            assert(ptr != NULL);
             hres = ptr && !append_string_len(ctx, ptr, jsstr_length(str)) ? E_OUTOFMEMORY : S_OK;
             jsstr_release(str);
         }else {
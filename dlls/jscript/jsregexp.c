@@ -575,9 +575,10 @@ static void RegExp_destructor(jsdisp_t *dispex)
     RegExpInstance *This = regexp_from_jsdisp(dispex);
 
     if(This->jsregexp)
-        regexp_destroy(This->jsregexp);
+        regexp_release(This->jsregexp);
     jsval_release(This->last_index_val);
-    jsstr_release(This->str);
+    if(This->str)
+        jsstr_release(This->str);
     heap_free(This);
 }
 
@@ -641,6 +642,58 @@ static HRESULT alloc_regexp(script_ctx_t *ctx, jsdisp_t *object_prototype, RegEx
     return S_OK;
 }
 
+/* Scripts tend to create the same regular expression over and over, for example
+ * from a literal in a loop. Compiled programs are not modified by matching, so
+ * instances created from the same source and flags share them. */
+static regexp_t *get_compiled_regexp(script_ctx_t *ctx, jsstr_t *src, DWORD flags, jsstr_t **ret_str)
+{
+    regexp_cache_entry_t *entry;
+    const WCHAR *str;
+    regexp_t *ret;
+    unsigned i;
+
+    for(i = 0; i < ARRAY_SIZE(ctx->regexp_cache); i++) {
+        entry = ctx->regexp_cache + i;
+        if(entry->regexp && entry->flags == flags && jsstr_eq(entry->src, src)) {
+            *ret_str = jsstr_addref(entry->src);
+            return regexp_addref(entry->regexp);
+        }
+    }
+
+    str = jsstr_flatten(src);
+    if(!str)
+        return NULL;
+
+    ret = regexp_new(ctx, &ctx->tmp_heap, str, jsstr_length(src), flags, FALSE);
+    if(!ret)
+        return NULL;
+
+    entry = ctx->regexp_cache + ctx->regexp_cache_next++ % ARRAY_SIZE(ctx->regexp_cache);
+    if(entry->regexp) {
+        jsstr_release(entry->src);
+        regexp_release(entry->regexp);
+    }
+    entry->src = jsstr_addref(src);
+    entry->flags = flags;
+    entry->regexp = regexp_addref(ret);
+
+    *ret_str = jsstr_addref(src);
+    return ret;
+}
+
+void clear_regexp_cache(script_ctx_t *ctx)
+{
+    unsigned i;
+
+    for(i = 0; i < ARRAY_SIZE(ctx->regexp_cache); i++) {
+        if(!ctx->regexp_cache[i].regexp)
+            continue;
+        jsstr_release(ctx->regexp_cache[i].src);
+        regexp_release(ctx->regexp_cache[i].regexp);
+        ctx->regexp_cache[i].regexp = NULL;
+    }
+}
+
 HRESULT create_regexp(script_ctx_t *ctx, jsstr_t *src, DWORD flags, jsdisp_t **ret)
 {
     RegExpInstance *regexp;
@@ -657,10 +710,11 @@ HRESULT create_regexp(script_ctx_t *ctx, jsstr_t *src, DWORD flags, jsdisp_t **r
     if(FAILED(hres))
         return hres;
 
-    regexp->str = jsstr_addref(src);
     regexp->last_index_val = jsval_number(0);
 
-    regexp->jsregexp = regexp_new(ctx, &ctx->tmp_heap, str, jsstr_length(regexp->str), flags, FALSE);
+    /* The compiled program refers to its source string, so the instance keeps
+     * the string the program was compiled from. */
+    regexp->jsregexp = get_compiled_regexp(ctx, src, flags, &regexp->str);
     if(!regexp->jsregexp) {
         WARN("regexp_new failed\n");
         jsdisp_release(&regexp->dispex);
@@ -34,6 +34,32 @@
  */
 #define JSSTR_MAX_ROPE_DEPTH 100
 
+/*
+ * Repeated appending to the same string (think of s += x in a loop) would build a
+ * degenerate rope and copy the whole string each time the rope reaches its max depth.
+ * Instead, such strings are moved to a growable buffer. A string sharing the buffer may
+ * append in place as long as it's the longest one, so other strings only see the prefix
+ * they were created with.
+ */
+typedef struct {
+    unsigned ref;
+    unsigned len;
+    unsigned size;
+    BOOL frozen;
+    WCHAR buf[1];
+} jsstr_buffer_t;
+
+static inline jsstr_buffer_t *jsstr_get_buffer(jsstr_heap_t *str)
+{
+    return CONTAINING_RECORD(str->buf, jsstr_buffer_t, buf);
+}
+
+static void jsstr_buffer_release(jsstr_buffer_t *buffer)
+{
+    if(!--buffer->ref)
+        heap_free(buffer);
+}
+
 const char *debugstr_jsstr(jsstr_t *str)
 {
     return jsstr_is_inline(str) ? debugstr_wn(jsstr_as_inline(str)->buf, jsstr_length(str))
@@ -45,7 +71,10 @@ void jsstr_free(jsstr_t *str)
 {
     switch(jsstr_tag(str)) {
     case JSSTR_HEAP:
-        heap_free(jsstr_as_heap(str)->buf);
+        if(str->length_flags & JSSTR_FLAG_BUFFER)
+            jsstr_buffer_release(jsstr_get_buffer(jsstr_as_heap(str)));
+        else
+            heap_free(jsstr_as_heap(str)->buf);
         break;
     case JSSTR_ROPE: {
         jsstr_rope_t *rope = jsstr_as_rope(str);
@@ -207,6 +236,115 @@ int jsstr_cmp(jsstr_t *str1, jsstr_t *str2)
     return ropes_cmp(jsstr_as_rope(str1), jsstr_as_rope(str2));
 }
 
+static jsstr_t *jsstr_alloc_buffer_str(jsstr_buffer_t *buffer, unsigned len)
+{
+    jsstr_heap_t *ret;
+
+    ret = heap_alloc(sizeof(*ret));
+    if(!ret)
+        return NULL;
+
+    jsstr_init(&ret->str, len, JSSTR_HEAP);
+    ret->str.length_flags |= JSSTR_FLAG_BUFFER;
+    ret->buf = buffer->buf;
+    buffer->ref++;
+    return &ret->str;
+}
+
+static unsigned buffer_size(unsigned len)
+{
+    return len < JSSTR_MAX_LENGTH/2 ? max(len*2, 64) : JSSTR_MAX_LENGTH;
+}
+
+/* Returns TRUE if str is the longest string using its append buffer. */
+static BOOL is_buffer_end(jsstr_t *str)
+{
+    return jsstr_is_heap(str) && (str->length_flags & JSSTR_FLAG_BUFFER)
+        && jsstr_get_buffer(jsstr_as_heap(str))->len == jsstr_length(str);
+}
+
+/* Returns the buffer of str, which has to be its longest string, if it may be
+ * extended in place to len characters. */
+static jsstr_buffer_t *get_append_buffer(jsstr_t *str, unsigned len)
+{
+    jsstr_heap_t *heap = jsstr_as_heap(str);
+    jsstr_buffer_t *buffer = jsstr_get_buffer(heap);
+
+    if(buffer->frozen)
+        return NULL;
+
+    if(len > buffer->size) {
+        unsigned size = buffer_size(len);
+
+        /* Other strings point to the buffer, we can't move it. */
+        if(buffer->ref > 1)
+            return NULL;
+
+        buffer = heap_realloc(buffer, FIELD_OFFSET(jsstr_buffer_t, buf[size+1]));
+        if(!buffer)
+            return NULL;
+        buffer->size = size;
+        heap->buf = buffer->buf;
+    }
+
+    return buffer;
+}
+
+/* Appends str2 to str1 in buffer, or in a newly allocated buffer if it's NULL. */
+static jsstr_t *jsstr_buffer_concat(jsstr_buffer_t *buffer, jsstr_t *str1, jsstr_t *str2)
+{
+    unsigned len1 = jsstr_length(str1), len2 = jsstr_length(str2);
+    jsstr_t *ret;
+
+    if(buffer) {
+        jsstr_flush(str2, buffer->buf+len1);
+        buffer->len = len1+len2;
+        buffer->buf[buffer->len] = 0;
+        return jsstr_alloc_buffer_str(buffer, buffer->len);
+    }
+
+    buffer = heap_alloc(FIELD_OFFSET(jsstr_buffer_t, buf[buffer_size(len1+len2)+1]));
+    if(!buffer)
+        return NULL;
+
+    buffer->ref = 1;
+    buffer->size = buffer_size(len1+len2);
+    buffer->frozen = FALSE;
+    jsstr_flush(str1, buffer->buf);
+    jsstr_flush(str2, buffer->buf+len1);
+    buffer->len = len1+len2;
+    buffer->buf[buffer->len] = 0;
+
+    ret = jsstr_alloc_buffer_str(buffer, buffer->len);
+    jsstr_buffer_release(buffer);
+    return ret;
+}
+
+const WCHAR *jsstr_buffer_flatten(jsstr_heap_t *str)
+{
+    jsstr_buffer_t *buffer = jsstr_get_buffer(str);
+    unsigned len = jsstr_length(&str->str);
+    WCHAR *buf;
+
+    /* The caller expects a null-terminated string that stays valid, so no
+     * more in place appends are allowed. */
+    if(buffer->len == len) {
+        buffer->frozen = TRUE;
+        return str->buf;
+    }
+
+    buf = heap_alloc((len+1) * sizeof(WCHAR));
+    if(!buf)
+        return NULL;
+
+    memcpy(buf, str->buf, len*sizeof(WCHAR));
+    buf[len] = 0;
+
+    jsstr_buffer_release(buffer);
+    str->str.length_flags &= ~JSSTR_FLAG_BUFFER;
+    return str->buf = buf;
+}
+
 jsstr_t *jsstr_concat(jsstr_t *str1, jsstr_t *str2)
 {
     unsigned len1, len2;
@@ -221,6 +359,15 @@ jsstr_t *jsstr_concat(jsstr_t *str1, jsstr_t *str2)
     if(!len2)
         return jsstr_addref(str1);
 
+    if(len1+len2 > JSSTR_MAX_LENGTH)
+        return NULL;
+
+    /* If the buffer can't be extended in place, because a flattened pointer to it was
+     * handed out or because other strings keep it from being moved, the result moves
+     * to a new buffer. The string keeps growing with amortized constant cost. */
+    if(is_buffer_end(str1))
+        return jsstr_buffer_concat(get_append_buffer(str1, len1+len2), str1, str2);
+
     if(len1 + len2 >= JSSTR_SHORT_STRING_LENGTH) {
         unsigned depth, depth2;
         jsstr_rope_t *rope;
@@ -231,9 +378,6 @@ jsstr_t *jsstr_concat(jsstr_t *str1, jsstr_t *str2)
             depth = depth2;
 
         if(depth++ < JSSTR_MAX_ROPE_DEPTH) {
-            if(len1+len2 > JSSTR_MAX_LENGTH)
-                return NULL;
-
             rope = heap_alloc(sizeof(*rope));
             if(!rope)
                 return NULL;
@@ -244,6 +388,9 @@ jsstr_t *jsstr_concat(jsstr_t *str1, jsstr_t *str2)
             rope->depth = depth;
             return &rope->str;
         }
+
+        /* The string is likely being built by appending, give it room to grow. */
+        return jsstr_buffer_concat(NULL, str1, str2);
     }
 
     ret = jsstr_alloc_buf(len1+len2, &ptr);
@@ -46,6 +46,9 @@ struct _jsstr_t {
 #define JSSTR_FLAG_FLAT     2
 #define JSSTR_FLAG_TAG_MASK 3
 
+/* Heap string sharing an append buffer with other strings, see jsstr_concat. */
+#define JSSTR_FLAG_BUFFER   4
+
 typedef enum {
     JSSTR_INLINE = JSSTR_FLAG_FLAT,
     JSSTR_HEAP   = JSSTR_FLAG_FLAT|JSSTR_FLAG_LBIT,
@@ -132,11 +135,13 @@ static inline jsstr_rope_t *jsstr_as_rope(jsstr_t *str)
 }
 
 const WCHAR *jsstr_rope_flatten(jsstr_rope_t*) DECLSPEC_HIDDEN;
+const WCHAR *jsstr_buffer_flatten(jsstr_heap_t*) DECLSPEC_HIDDEN;
 
 static inline const WCHAR *jsstr_flatten(jsstr_t *str)
 {
     return jsstr_is_inline(str) ? jsstr_as_inline(str)->buf
-        : jsstr_is_heap(str) ? jsstr_as_heap(str)->buf
+        : jsstr_is_heap(str) ? (str->length_flags & JSSTR_FLAG_BUFFER
+                                ? jsstr_buffer_flatten(jsstr_as_heap(str)) : jsstr_as_heap(str)->buf)
         : jsstr_rope_flatten(jsstr_as_rope(str));
 }
 
@@ -1096,6 +1096,70 @@ ok(tmp === (invokeVersion < 2 ? undefined : 3), "unshift returned " +tmp);
 ok(arr.length === 3, "arr.length = " + arr.length);
 ok(arr[0] === 0 && arr[1] === 1 && arr[2] === 2, "unexpected array");
 
+arr = [];
+for(i = 0; i < 100; i++)
+    arr.push(i);
+arr.pop();
+arr[arr.length] = "x";
+ok(arr.length === 100, "arr.length = " + arr.length);
+ok(arr[98] === 98 && arr[99] === "x" && arr[100] === undefined, "unexpected array");
+ok((99 in arr) && !(100 in arr) && ("99" in arr), "unexpected in result");
+arr.length = 50;
+ok(arr.length === 50 && arr[50] === undefined && !(50 in arr), "unexpected array after truncating");
+tmp = 0;
+for(i in arr)
+    tmp++;
+ok(tmp === 50, "enumerated " + tmp + " elements");
+delete arr[49];
+ok(arr.length === 50 && !(49 in arr), "unexpected array after deleting last element");
+delete arr[10];
+ok(arr.length === 50 && !(10 in arr) && arr[11] === 11, "unexpected array after deleting element");
+tmp = 0;
+for(i in arr)
+    tmp++;
+ok(tmp === 48, "enumerated " + tmp + " elements");
+arr[10] = 10;
+arr[60] = 60;
+ok(arr.length === 61 && arr[10] === 10 && arr[60] === 60, "unexpected array after filling hole");
+ok(arr.slice(9, 12).toString() === "9,10,11", "arr.slice(9, 12) = " + arr.slice(9, 12));
+
+arr = [1,2];
+arr["01"] = 3;
+ok(arr.length === 2 && arr[1] === 2 && arr["01"] === 3, "unexpected array");
+arr[0] = function() { return this; };
+ok(arr[0]() === arr, "arr[0]() !== arr");
+arr[1]++;
+ok(arr[1] === 3, "arr[1] = " + arr[1]);
+arr.unshift(0);
+ok(arr.length === 3 && arr[2] === 3, "unexpected array after unshift");
+
+arr = [1,2];
+arr[arr.length] = arr.length;
+ok(arr.length === 3 && arr[2] === 2, "unexpected array " + arr);
+arr = [1,2];
+try {
+    arr[arr.length] = (function() { throw 1; })();
+}catch(e) {}
+ok(arr.length === 2 && !(2 in arr), "arr.length = " + arr.length);
+try {
+    arr[5] = (function() { throw 1; })();
+}catch(e) {}
+ok(arr.length === 2 && !(5 in arr), "arr.length = " + arr.length);
+arr = [1,2];
+arr[arr.length]++;
+ok(arr.length === 3 && isNaN(arr[2]), "unexpected array " + arr);
+
+arr = [];
+arr.foo = true;
+arr[0] = 1;
+arr.push(2);
+Array.prototype.bar = true;
+tmp = "";
+for(i in arr)
+    tmp += i + ",";
+delete Array.prototype.bar;
+ok(tmp === "0,1,foo,bar,", "for in enumerated " + tmp);
+
 arr = [1,2,,4];
 tmp = arr.shift();
 ok(tmp === 1, "[1,2,,4].shift() = " + tmp);
@@ -2965,4 +3029,53 @@ ok(tmp.toArray() == "2,3,12,13,22,23,32,33,42,43", "tmp.toArray() = " + tmp.toAr
 ok(createArray().toArray() == "2,3,12,13,22,23,32,33,42,43",
         "createArray.toArray()=" + createArray().toArray());
 
+function testStringAppend() {
+    var s = "", prefix, prefix2, i;
+
+    for(i = 0; i < 1000; i++) {
+        s += String.fromCharCode(0x61 + i % 26);
+        if(i == 300)
+            prefix = s;
+    }
+    ok(s.length === 1000, "s.length = " + s.length);
+    ok(s.substr(0, 27) === "abcdefghijklmnopqrstuvwxyza", "s.substr(0, 27) = " + s.substr(0, 27));
+    ok(s.charAt(999) === "l", "s.charAt(999) = " + s.charAt(999));
+
+    ok(prefix.length === 301, "prefix.length = " + prefix.length);
+    prefix2 = prefix + "X";
+    ok(prefix2.length === 302, "prefix2.length = " + prefix2.length);
+    ok(prefix2.charAt(301) === "X", "prefix2.charAt(301) = " + prefix2.charAt(301));
+    ok(s.charAt(301) === "p", "s.charAt(301) = " + s.charAt(301));
+    ok(prefix === s.substr(0, 301), "prefix !== s.substr(0, 301)");
+
+    /* flattening a string must not be affected by later appends */
+    prefix = s;
+    ok(prefix.indexOf("lmn") === 11, "prefix.indexOf(\"lmn\") = " + prefix.indexOf("lmn"));
+    s += "end";
+    ok(prefix.length === 1000, "prefix.length = " + prefix.length);
+    ok(s.length === 1003, "s.length = " + s.length);
+    ok(s.substr(1000) === "end", "s.substr(1000) = " + s.substr(1000));
+    ok(prefix.lastIndexOf("end") === -1, "prefix.lastIndexOf(\"end\") = " + prefix.lastIndexOf("end"));
+
+    s += s;
+    ok(s.length === 2006, "s.length = " + s.length);
+    ok(s.substr(1003, 3) === "abc", "s.substr(1003, 3) = " + s.substr(1003, 3));
+
+    /* appending after flattening keeps earlier results intact */
+    prefix = [];
+    for(i = 0; i < 300; i++) {
+        s += "#";
+        ok(s.indexOf("#") === 2006, "s.indexOf(\"#\") = " + s.indexOf("#"));
+        if(i % 100 == 0)
+            prefix.push(s);
+    }
+    ok(s.length === 2306, "s.length = " + s.length);
+    for(i = 0; i < prefix.length; i++) {
+        ok(prefix[i].length === 2007 + i*100, "prefix[" + i + "].length = " + prefix[i].length);
+        ok(prefix[i].lastIndexOf("#") === 2006 + i*100,
+           "prefix[" + i + "].lastIndexOf(\"#\") = " + prefix[i].lastIndexOf("#"));
+    }
+}
+testStringAppend();
+
 reportSuccess();
@@ -1885,6 +1885,70 @@ ok(Date === 1, "Date = " + Date);
 Error = 1;
 ok(Error === 1, "Error = " + Error);
 
+function testMemberCache() {
+    function Proto() {}
+    Proto.prototype.x = "proto";
+
+    var objs = [new Proto(), new Proto(), {x: "own"}], res = "", i, o;
+
+    function getX(o) { return o.x; }
+    function setX(o, v) { o.x = v; }
+
+    for(i = 0; i < 3; i++)
+        res += getX(objs[i]) + ",";
+    ok(res === "proto,proto,own,", "res = " + res);
+
+    o = objs[0];
+    ok(getX(o) === "proto", "getX(o) = " + getX(o));
+    setX(o, "set");
+    ok(getX(o) === "set", "getX(o) = " + getX(o));
+    delete o.x;
+    ok(getX(o) === "proto", "getX(o) after delete = " + getX(o));
+    Proto.prototype.x = "changed";
+    ok(getX(o) === "changed", "getX(o) after prototype change = " + getX(o));
+    delete Proto.prototype.x;
+    ok(getX(o) === undefined, "getX(o) after prototype delete = " + getX(o));
+    setX(o, 1);
+    ok(getX(o) === 1, "getX(o) = " + getX(o));
+
+    o = [1,2,3];
+    for(i = 0; i < 3; i++) {
+        ok(o.length === 3-i, "o.length = " + o.length);
+        o.pop();
+    }
+
+    /* objects with the same layout share cache entries */
+    function Point(x, y) { this.x = x; this.y = y; }
+    objs = [new Point(1, 2), new Point(3, 4), {y: 5, x: 6}, new Point(7, 8)];
+    delete objs[1].x;
+    objs[3].z = 9;
+    res = "";
+    for(i = 0; i < objs.length; i++)
+        res += getX(objs[i]) + ",";
+    ok(res === "1,undefined,6,7,", "res = " + res);
+    Point.prototype.x = "proto";
+    res = "";
+    for(i = 0; i < objs.length; i++)
+        res += getX(objs[i]) + ",";
+    ok(res === "1,proto,6,7,", "res = " + res);
+}
+
+testMemberCache();
+
+function testEvalCache() {
+    var i, f;
+
+    for(i = 0; i < 3; i++) {
+        ok(eval("i * 2") === i * 2, "eval(\"i * 2\") = " + eval("i * 2"));
+        f = new Function("a", "return a + 1;");
+        ok(f(i) === i + 1, "f(i) = " + f(i));
+    }
+    ok(eval("var evalCacheVar = 3; evalCacheVar") === 3, "evalCacheVar = " + evalCacheVar);
+    ok(eval("var evalCacheVar = 3; evalCacheVar") === 3, "evalCacheVar = " + evalCacheVar);
+}
+
+testEvalCache();
+
 /* Keep this test in the end of file */
 undefined = 6;
 ok(undefined === 6, "undefined = " + undefined);
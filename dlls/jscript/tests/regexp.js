@@ -677,4 +677,28 @@ ok(re.ignoreCase === false, "re.ignoreCase = " + re.ignoreCase);
 ok(re.multiline === true, "re.multiline = " + re.multiline);
 ok(re.global === true, "re.global = " + re.global);
 
+for(i = 0; i < 3; i++) {
+    re = new RegExp("b+c", i ? "g" : "");
+    ok(re.global === !!i, "re.global = " + re.global);
+    re.lastIndex = 0;
+    m = re.exec("abbcabc");
+    ok(m[0] === "bbc", "m[0] = " + m[0]);
+    ok(m.index === 1, "m.index = " + m.index);
+    if(i) {
+        m = re.exec("abbcabc");
+        ok(m[0] === "bc", "m[0] = " + m[0]);
+        ok(m.index === 5, "m.index = " + m.index);
+    }
+    ok(re.source === "b+c", "re.source = " + re.source);
+}
+
+re = /[0-9]+x/g;
+ok("ab12x3y45x".replace(re, "_") === "ab_3y_", "replace returned " + "ab12x3y45x".replace(re, "_"));
+ok("abc".search(/[0-9]/) === -1, "search returned " + "abc".search(/[0-9]/));
+ok("a\nab".search(/^b/m) === -1, "search returned " + "a\nab".search(/^b/m));
+ok("a\nba".search(/^b/m) === 2, "search returned " + "a\nba".search(/^b/m));
+ok("ba".search(/^a/) === -1, "search returned " + "ba".search(/^a/));
+ok("xxAbc".search(/abc/i) === 2, "search returned " + "xxAbc".search(/abc/i));
+ok("xxabd abc".search(/abc/) === 6, "search returned " + "xxabd abc".search(/abc/));
+
 reportSuccess();
@@ -2897,6 +2897,8 @@ static void run_benchmarks(void)
 {
     trace("Running benchmarks...\n");
 
+    run_benchmark("append.js");
+    run_benchmark("fannkuch.js");
     run_benchmark("dna.js");
     run_benchmark("base64.js");
     run_benchmark("validateinput.js");
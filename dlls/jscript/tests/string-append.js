@@ -0,0 +1,13 @@
+/* Builds a long string one character at a time, the way scripts generating HTML
+ * or CSV output do, and searches it every now and then. */
+
+var s = "", i;
+
+for(i = 0; i < 1000000; i++) {
+    s += String.fromCharCode(0x61 + i % 26);
+    if(i % 10000 == 0 && s.indexOf("za") != (i ? 25 : -1))
+        throw "ERROR: bad indexOf result at " + i;
+}
+
+if(s.length != 1000000)
+    throw "ERROR: bad length: expected 1000000 but got " + s.length;
@@ -203,7 +203,7 @@ static UINT copy_file(MSIFILE *file, LPWSTR source)
     return ERROR_SUCCESS;
 }
 
-static UINT copy_install_file(MSIPACKAGE *package, MSIFILE *file, LPWSTR source)
+static UINT copy_install_file(MSIFILE *file, LPWSTR source, BOOL *need_reboot)
 {
     UINT gle;
 
@@ -247,7 +247,7 @@ static UINT copy_install_file(MSIPACKAGE *package, MSIFILE *file, LPWSTR source)
             MoveFileExW(file->TargetPath, NULL, MOVEFILE_DELAY_UNTIL_REBOOT) &&
             MoveFileExW(tmpfileW, file->TargetPath, MOVEFILE_DELAY_UNTIL_REBOOT))
         {
-            package->need_reboot_at_end = 1;
+            *need_reboot = TRUE;
             gle = ERROR_SUCCESS;
         }
         else
@@ -262,6 +262,119 @@ static UINT copy_install_file(MSIPACKAGE *package, MSIFILE *file, LPWSTR source)
     return gle;
 }
 
+/* uncompressed files are copied in the thread pool, a few at a time */
+struct copy_queue
+{
+    CRITICAL_SECTION   cs;
+    CONDITION_VARIABLE done;
+    UINT               pending;
+    UINT               max_pending;
+    UINT               error;
+    BOOL               need_reboot;
+};
+
+struct copy_job
+{
+    struct copy_queue *queue;
+    MSIFILE           *file;
+    WCHAR             *source;
+    BOOL               set_installed;
+};
+
+static void copy_queue_init( struct copy_queue *queue )
+{
+    SYSTEM_INFO si;
+
+    GetSystemInfo( &si );
+
+    InitializeCriticalSection( &queue->cs );
+    queue->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": copy_queue.cs");
+    InitializeConditionVariable( &queue->done );
+    queue->pending = 0;
+    queue->max_pending = si.dwNumberOfProcessors > 1 ? min( si.dwNumberOfProcessors, 8 ) : 0;
+    queue->error = ERROR_SUCCESS;
+    queue->need_reboot = FALSE;
+}
+
+static void copy_queue_destroy( struct copy_queue *queue )
+{
+    queue->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection( &queue->cs );
+}
+
+static void copy_job_complete( struct copy_job *job, UINT rc, BOOL need_reboot )
+{
+    struct copy_queue *queue = job->queue;
+
+    if (rc != ERROR_SUCCESS)
+        ERR("Failed to copy %s to %s (%u)\n", debugstr_w(job->source), debugstr_w(job->file->TargetPath), rc);
+    else if (job->set_installed)
+        job->file->state = msifs_installed;
+
+    EnterCriticalSection( &queue->cs );
+    if (rc != ERROR_SUCCESS && queue->error == ERROR_SUCCESS) queue->error = rc;
+    if (need_reboot) queue->need_reboot = TRUE;
+    queue->pending--;
+    WakeAllConditionVariable( &queue->done );
+    LeaveCriticalSection( &queue->cs );
+
+    msi_free( job->source );
+    msi_free( job );
+}
+
+static DWORD WINAPI copy_job_proc( void *arg )
+{
+    struct copy_job *job = arg;
+    BOOL need_reboot = FALSE;
+    UINT rc;
+
+    rc = copy_install_file( job->file, job->source, &need_reboot );
+    copy_job_complete( job, rc, need_reboot );
+    return 0;
+}
+
+/* takes ownership of source */
+static UINT copy_queue_add( struct copy_queue *queue, MSIFILE *file, WCHAR *source, BOOL set_installed )
+{
+    struct copy_job *job;
+
+    if (!(job = msi_alloc( sizeof(*job) )))
+    {
+        msi_free( source );
+        return ERROR_OUTOFMEMORY;
+    }
+    job->queue = queue;
+    job->file = file;
+    job->source = source;
+    job->set_installed = set_installed;
+
+    EnterCriticalSection( &queue->cs );
+    while (queue->max_pending && queue->pending >= queue->max_pending)
+        SleepConditionVariableCS( &queue->done, &queue->cs, INFINITE );
+    queue->pending++;
+    LeaveCriticalSection( &queue->cs );
+
+    if (!queue->max_pending || !QueueUserWorkItem( copy_job_proc, job, WT_EXECUTEDEFAULT ))
+        copy_job_proc( job );
+
+    return ERROR_SUCCESS;
+}
+
+/* waits for the queued copies to finish, returns the first error */
+static UINT copy_queue_wait( MSIPACKAGE *package, struct copy_queue *queue )
+{
+    UINT rc;
+
+    EnterCriticalSection( &queue->cs );
+    while (queue->pending)
+        SleepConditionVariableCS( &queue->done, &queue->cs, INFINITE );
+    rc = queue->error;
+    LeaveCriticalSection( &queue->cs );
+
+    if (queue->need_reboot) package->need_reboot_at_end = 1;
+    return rc;
+}
+
 static UINT msi_create_directory( MSIPACKAGE *package, const WCHAR *dir )
 {
     MSIFOLDER *folder;
@@ -353,6 +466,7 @@ WCHAR *msi_resolve_file_source( MSIPACKAGE *package, MSIFILE *file )
  */
 UINT ACTION_InstallFiles(MSIPACKAGE *package)
 {
+    struct copy_queue queue;
     MSIMEDIAINFO *mi;
     UINT rc = ERROR_SUCCESS;
     MSIFILE *file;
@@ -364,10 +478,12 @@ UINT ACTION_InstallFiles(MSIPACKAGE *package)
 
     schedule_install_files(package);
     mi = msi_alloc_zero( sizeof(MSIMEDIAINFO) );
+    copy_queue_init( &queue );
 
     LIST_FOR_EACH_ENTRY( file, &package->files, MSIFILE, entry )
     {
         BOOL is_global_assembly = msi_is_global_assembly( file->Component );
+        UINT disk_id = mi->disk_id;
 
         msi_file_update_ui( package, file, szInstallFiles );
 
@@ -379,6 +495,13 @@ UINT ACTION_InstallFiles(MSIPACKAGE *package)
             goto done;
         }
 
+        /* the source media may be about to change */
+        if (mi->disk_id != disk_id && copy_queue_wait( package, &queue ))
+        {
+            rc = ERROR_INSTALL_FAILURE;
+            goto done;
+        }
+
         if (file->state != msifs_hashmatch &&
             file->state != msifs_skipped &&
             (file->state != msifs_present || !msi_get_property_int( package->db, szInstalled, 0 )) &&
@@ -420,16 +543,12 @@ UINT ACTION_InstallFiles(MSIPACKAGE *package)
             {
                 msi_create_directory(package, file->Component->Directory);
             }
-            rc = copy_install_file(package, file, source);
+            rc = copy_queue_add(&queue, file, source, !is_global_assembly);
             if (rc != ERROR_SUCCESS)
             {
-                ERR("Failed to copy %s to %s (%u)\n", debugstr_w(source), debugstr_w(file->TargetPath), rc);
                 rc = ERROR_INSTALL_FAILURE;
-                msi_free(source);
                 goto done;
             }
-            if (!is_global_assembly) file->state = msifs_installed;
-            msi_free(source);
         }
         else if (!is_global_assembly && file->state != msifs_installed &&
                  !(file->Attributes & msidbFileAttributesPatchAdded))
@@ -439,6 +558,11 @@ UINT ACTION_InstallFiles(MSIPACKAGE *package)
             goto done;
         }
     }
+    if (copy_queue_wait( package, &queue ))
+    {
+        rc = ERROR_INSTALL_FAILURE;
+        goto done;
+    }
     LIST_FOR_EACH_ENTRY( file, &package->files, MSIFILE, entry )
     {
         MSICOMPONENT *comp = file->Component;
@@ -457,6 +581,8 @@ UINT ACTION_InstallFiles(MSIPACKAGE *package)
     }
 
 done:
+    copy_queue_wait( package, &queue );
+    copy_queue_destroy( &queue );
     msi_free_media_info(mi);
     return rc;
 }
@@ -121,8 +121,20 @@ static void CDECL cabinet_free(void *pv)
     msi_free(pv);
 }
 
+/* FDI file handle. Data of an extracted file goes through the writer of
+ * the extraction, if there is one. */
+struct cab_file
+{
+    HANDLE             handle;
+    IStream           *stream;
+    struct cab_writer *writer;
+    void              *item;
+};
+
 static INT_PTR CDECL cabinet_open(char *pszFile, int oflag, int pmode)
 {
+    struct cab_file *file;
+    HANDLE handle;
     DWORD dwAccess = 0;
     DWORD dwShareMode = 0;
     DWORD dwCreateDisposition = OPEN_EXISTING;
@@ -148,27 +160,223 @@ static INT_PTR CDECL cabinet_open(char *pszFile, int oflag, int pmode)
     else if (oflag & _O_CREAT)
         dwCreateDisposition = CREATE_ALWAYS;
 
-    return (INT_PTR)CreateFileA(pszFile, dwAccess, dwShareMode, NULL,
-                                dwCreateDisposition, 0, NULL);
+    handle = CreateFileA(pszFile, dwAccess, dwShareMode, NULL,
+                         dwCreateDisposition, 0, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return -1;
+
+    if (!(file = msi_alloc_zero( sizeof(*file) )))
+    {
+        CloseHandle( handle );
+        return -1;
+    }
+    file->handle = handle;
+    return (INT_PTR)file;
 }
 
 static UINT CDECL cabinet_read(INT_PTR hf, void *pv, UINT cb)
 {
-    HANDLE handle = (HANDLE)hf;
+    struct cab_file *file = (struct cab_file *)hf;
     DWORD read;
 
-    if (ReadFile(handle, pv, cb, &read, NULL))
+    if (ReadFile(file->handle, pv, cb, &read, NULL))
         return read;
 
     return 0;
 }
 
+/* Each extraction writes the extracted files from a separate thread, so that
+ * decompressing the cabinet overlaps with writing to disk. Requests are
+ * processed in order, closing a file is queued after its data. Files are
+ * only reported as extracted once they have been closed. */
+struct cab_write
+{
+    struct list entry;
+    HANDLE      handle;
+    BOOL        close;
+    FILETIME    time;
+    WCHAR      *name;
+    void       *item;
+    UINT        size;
+    BYTE        data[1];
+};
+
+struct cab_writer
+{
+    CRITICAL_SECTION   cs;
+    CONDITION_VARIABLE queued;
+    CONDITION_VARIABLE written;
+    struct list        queue;
+    struct list        extracted;
+    UINT               pending;
+    BOOL               busy;
+    BOOL               done;
+    BOOL               failed;
+    HANDLE             thread;
+};
+
+#define CAB_WRITER_MAX_PENDING (16 * 1024 * 1024)
+
+static BOOL cab_write_process( struct cab_write *req )
+{
+    DWORD written;
+
+    if (req->close)
+    {
+        BOOL ret = SetFileTime( req->handle, &req->time, 0, &req->time );
+        CloseHandle( req->handle );
+        return ret;
+    }
+    return WriteFile( req->handle, req->data, req->size, &written, NULL ) && written == req->size;
+}
+
+static DWORD WINAPI cab_writer_proc( void *arg )
+{
+    struct cab_writer *writer = arg;
+    struct cab_write *req;
+    BOOL ret;
+
+    EnterCriticalSection( &writer->cs );
+    for (;;)
+    {
+        while (list_empty( &writer->queue ) && !writer->done)
+            SleepConditionVariableCS( &writer->queued, &writer->cs, INFINITE );
+        if (list_empty( &writer->queue )) break;
+
+        req = LIST_ENTRY( list_head( &writer->queue ), struct cab_write, entry );
+        list_remove( &req->entry );
+        writer->busy = TRUE;
+        LeaveCriticalSection( &writer->cs );
+
+        if (!(ret = cab_write_process( req )))
+            WARN("failed to write extracted file (error %u)\n", GetLastError());
+
+        EnterCriticalSection( &writer->cs );
+        if (!ret) writer->failed = TRUE;
+        writer->pending -= req->size;
+        writer->busy = FALSE;
+        WakeAllConditionVariable( &writer->written );
+        if (ret && req->close)
+            list_add_tail( &writer->extracted, &req->entry );
+        else
+        {
+            msi_free( req->name );
+            msi_free( req );
+        }
+    }
+    LeaveCriticalSection( &writer->cs );
+    return 0;
+}
+
+static struct cab_writer *cab_writer_create(void)
+{
+    struct cab_writer *writer;
+
+    if (!(writer = msi_alloc_zero( sizeof(*writer) ))) return NULL;
+
+    InitializeCriticalSection( &writer->cs );
+    writer->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": cab_writer.cs");
+    InitializeConditionVariable( &writer->queued );
+    InitializeConditionVariable( &writer->written );
+    list_init( &writer->queue );
+    list_init( &writer->extracted );
+
+    if (!(writer->thread = CreateThread( NULL, 0, cab_writer_proc, writer, 0, NULL )))
+    {
+        writer->cs.DebugInfo->Spare[0] = 0;
+        DeleteCriticalSection( &writer->cs );
+        msi_free( writer );
+        return NULL;
+    }
+    return writer;
+}
+
+static void cab_writer_queue( struct cab_writer *writer, struct cab_write *req )
+{
+    EnterCriticalSection( &writer->cs );
+    /* don't let the decompressor get too far ahead of the disk */
+    while (writer->pending && writer->pending + req->size > CAB_WRITER_MAX_PENDING)
+        SleepConditionVariableCS( &writer->written, &writer->cs, INFINITE );
+    list_add_tail( &writer->queue, &req->entry );
+    writer->pending += req->size;
+    WakeConditionVariable( &writer->queued );
+    LeaveCriticalSection( &writer->cs );
+}
+
+/* waits until all queued requests are processed */
+static BOOL cab_writer_flush( struct cab_writer *writer )
+{
+    BOOL ret;
+
+    EnterCriticalSection( &writer->cs );
+    while (!list_empty( &writer->queue ) || writer->busy)
+        SleepConditionVariableCS( &writer->written, &writer->cs, INFINITE );
+    ret = !writer->failed;
+    LeaveCriticalSection( &writer->cs );
+    return ret;
+}
+
+/* reports the files that have been written and closed */
+static void cab_writer_notify( struct cab_writer *writer, MSICABDATA *data )
+{
+    struct cab_write *req, *next;
+    struct list extracted;
+
+    list_init( &extracted );
+    EnterCriticalSection( &writer->cs );
+    list_move_tail( &extracted, &writer->extracted );
+    LeaveCriticalSection( &writer->cs );
+
+    LIST_FOR_EACH_ENTRY_SAFE( req, next, &extracted, struct cab_write, entry )
+    {
+        list_remove( &req->entry );
+        data->cb( data->package, req->name, MSICABEXTRACT_FILEEXTRACTED, NULL, NULL, &req->item );
+        msi_free( req->name );
+        msi_free( req );
+    }
+}
+
+static BOOL cab_writer_destroy( struct cab_writer *writer, MSICABDATA *data )
+{
+    BOOL ret;
+
+    EnterCriticalSection( &writer->cs );
+    writer->done = TRUE;
+    WakeConditionVariable( &writer->queued );
+    LeaveCriticalSection( &writer->cs );
+
+    WaitForSingleObject( writer->thread, INFINITE );
+    CloseHandle( writer->thread );
+    cab_writer_notify( writer, data );
+
+    ret = !writer->failed;
+    writer->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection( &writer->cs );
+    msi_free( writer );
+    return ret;
+}
+
 static UINT CDECL cabinet_write(INT_PTR hf, void *pv, UINT cb)
 {
-    HANDLE handle = (HANDLE)hf;
+    struct cab_file *file = (struct cab_file *)hf;
+    struct cab_write *req;
     DWORD written;
 
-    if (WriteFile(handle, pv, cb, &written, NULL))
+    if (file->writer && (req = msi_alloc( FIELD_OFFSET(struct cab_write, data[cb]) )))
+    {
+        req->handle = file->handle;
+        req->close  = FALSE;
+        req->name   = NULL;
+        req->size   = cb;
+        memcpy( req->data, pv, cb );
+        cab_writer_queue( file->writer, req );
+        return cb;
+    }
+
+    /* keep the writes to a file in order */
+    if (file->writer) cab_writer_flush( file->writer );
+
+    if (WriteFile(file->handle, pv, cb, &written, NULL))
         return written;
 
     return 0;
@@ -176,15 +384,26 @@ static UINT CDECL cabinet_write(INT_PTR hf, void *pv, UINT cb)
 
 static int CDECL cabinet_close(INT_PTR hf)
 {
-    HANDLE handle = (HANDLE)hf;
-    return CloseHandle(handle) ? 0 : -1;
+    struct cab_file *file = (struct cab_file *)hf;
+    int ret = 0;
+
+    if (file->stream)
+        IStream_Release( file->stream );
+    else
+    {
+        /* the handle may still be in use by the writer */
+        if (file->writer) cab_writer_flush( file->writer );
+        if (!CloseHandle( file->handle )) ret = -1;
+    }
+    msi_free( file );
+    return ret;
 }
 
 static LONG CDECL cabinet_seek(INT_PTR hf, LONG dist, int seektype)
 {
-    HANDLE handle = (HANDLE)hf;
+    struct cab_file *file = (struct cab_file *)hf;
     /* flags are compatible and so are passed straight through */
-    return SetFilePointer(handle, dist, NULL, seektype);
+    return SetFilePointer(file->handle, dist, NULL, seektype);
 }
 
 struct package_disk
@@ -198,6 +417,7 @@ static struct package_disk package_disk;
 static INT_PTR CDECL cabinet_open_stream( char *pszFile, int oflag, int pmode )
 {
     MSICABINETSTREAM *cab;
+    struct cab_file *file;
     IStream *stream;
 
     if (!(cab = msi_get_cabinet_stream( package_disk.package, package_disk.id )))
@@ -232,38 +452,37 @@ static INT_PTR CDECL cabinet_open_stream( char *pszFile, int oflag, int pmode )
             return -1;
         }
     }
-    return (INT_PTR)stream;
+    if (!(file = msi_alloc_zero( sizeof(*file) )))
+    {
+        IStream_Release( stream );
+        return -1;
+    }
+    file->stream = stream;
+    return (INT_PTR)file;
 }
 
 static UINT CDECL cabinet_read_stream( INT_PTR hf, void *pv, UINT cb )
 {
-    IStream *stm = (IStream *)hf;
+    struct cab_file *file = (struct cab_file *)hf;
     DWORD read;
     HRESULT hr;
 
-    hr = IStream_Read( stm, pv, cb, &read );
+    hr = IStream_Read( file->stream, pv, cb, &read );
     if (hr == S_OK || hr == S_FALSE)
         return read;
 
     return 0;
 }
 
-static int CDECL cabinet_close_stream( INT_PTR hf )
-{
-    IStream *stm = (IStream *)hf;
-    IStream_Release( stm );
-    return 0;
-}
-
 static LONG CDECL cabinet_seek_stream( INT_PTR hf, LONG dist, int seektype )
 {
-    IStream *stm = (IStream *)hf;
+    struct cab_file *file = (struct cab_file *)hf;
     LARGE_INTEGER move;
     ULARGE_INTEGER newpos;
     HRESULT hr;
 
     move.QuadPart = dist;
-    hr = IStream_Seek( stm, move, seektype, &newpos );
+    hr = IStream_Seek( file->stream, move, seektype, &newpos );
     if (SUCCEEDED(hr))
     {
         if (newpos.QuadPart <= MAXLONG) return newpos.QuadPart;
@@ -420,10 +639,14 @@ static INT_PTR cabinet_copy_file(FDINOTIFICATIONTYPE fdint,
                                  PFDINOTIFICATION pfdin)
 {
     MSICABDATA *data = pfdin->pv;
+    struct cab_file *file;
     HANDLE handle = 0;
     LPWSTR path = NULL;
     DWORD attrs;
 
+    /* report files written since the last notification first */
+    if (data->writer) cab_writer_notify( data->writer, data );
+
     data->curfile = strdupAtoW(pfdin->psz1);
     if (!data->cb(data->package, data->curfile, MSICABEXTRACT_BEGINEXTRACT, &path,
                   &attrs, data->user))
@@ -441,6 +664,13 @@ static INT_PTR cabinet_copy_file(FDINOTIFICATIONTYPE fdint,
 
     handle = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0,
                          NULL, CREATE_ALWAYS, attrs, NULL);
+    if (handle == INVALID_HANDLE_VALUE && data->writer && GetLastError() == ERROR_SHARING_VIOLATION)
+    {
+        /* an earlier copy of the file may not have been closed yet */
+        cab_writer_flush( data->writer );
+        handle = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0,
+                             NULL, CREATE_ALWAYS, attrs, NULL);
+    }
     if (handle == INVALID_HANDLE_VALUE)
     {
         DWORD err = GetLastError();
@@ -467,13 +697,13 @@ static INT_PTR cabinet_copy_file(FDINOTIFICATIONTYPE fdint,
 
             TRACE("file in use, scheduling rename operation\n");
 
-            if (!(tmppathW = strdupW( path ))) return ERROR_OUTOFMEMORY;
+            if (!(tmppathW = strdupW( path ))) goto done;
             if ((p = strrchrW(tmppathW, '\\'))) *p = 0;
             len = strlenW( tmppathW ) + 16;
             if (!(tmpfileW = msi_alloc(len * sizeof(WCHAR))))
             {
                 msi_free( tmppathW );
-                return ERROR_OUTOFMEMORY;
+                goto done;
             }
             if (!GetTempFileNameW(tmppathW, szMsi, 0, tmpfileW)) tmpfileW[0] = 0;
             msi_free( tmppathW );
@@ -500,7 +730,20 @@ static INT_PTR cabinet_copy_file(FDINOTIFICATIONTYPE fdint,
 done:
     msi_free(path);
 
-    return (INT_PTR)handle;
+    if (!handle || handle == INVALID_HANDLE_VALUE)
+        return (INT_PTR)handle;
+
+    if (!(file = msi_alloc( sizeof(*file) )))
+    {
+        CloseHandle( handle );
+        return -1;
+    }
+    file->handle = handle;
+    file->stream = NULL;
+    file->writer = data->writer;
+    /* the callback stores the file it is extracting in user */
+    file->item   = *(void **)data->user;
+    return (INT_PTR)file;
 }
 
 static INT_PTR cabinet_close_file_info(FDINOTIFICATIONTYPE fdint,
@@ -509,7 +752,8 @@ static INT_PTR cabinet_close_file_info(FDINOTIFICATIONTYPE fdint,
     MSICABDATA *data = pfdin->pv;
     FILETIME ft;
     FILETIME ftLocal;
-    HANDLE handle = (HANDLE)pfdin->hf;
+    struct cab_file *file = (struct cab_file *)pfdin->hf;
+    struct cab_write *req;
 
     data->mi->is_continuous = FALSE;
 
@@ -517,15 +761,38 @@ static INT_PTR cabinet_close_file_info(FDINOTIFICATIONTYPE fdint,
         return -1;
     if (!LocalFileTimeToFileTime(&ft, &ftLocal))
         return -1;
-    if (!SetFileTime(handle, &ftLocal, 0, &ftLocal))
-        return -1;
 
-    CloseHandle(handle);
+    if (file->writer && (req = msi_alloc( sizeof(*req) )))
+    {
+        /* the writer reports the file once it is closed */
+        req->handle = file->handle;
+        req->close  = TRUE;
+        req->time   = ftLocal;
+        req->name   = data->curfile;
+        req->item   = file->item;
+        req->size   = 0;
+        cab_writer_queue( file->writer, req );
+    }
+    else
+    {
+        if (file->writer)
+        {
+            if (!cab_writer_flush( file->writer ))
+                return -1;
+            cab_writer_notify( file->writer, data );
+        }
+        if (!SetFileTime(file->handle, &ftLocal, 0, &ftLocal))
+            return -1;
+
+        CloseHandle(file->handle);
 
-    data->cb(data->package, data->curfile, MSICABEXTRACT_FILEEXTRACTED, NULL, NULL,
-             data->user);
+        data->cb(data->package, data->curfile, MSICABEXTRACT_FILEEXTRACTED, NULL, NULL,
+                 data->user);
 
-    msi_free(data->curfile);
+        msi_free(data->curfile);
+    }
+
+    msi_free(file);
     data->curfile = NULL;
 
     return 1;
@@ -627,7 +894,7 @@ static BOOL extract_cabinet_stream( MSIPACKAGE *package, MSIMEDIAINFO *mi, LPVOI
     TRACE("extracting %s disk id %u\n", debugstr_w(mi->cabinet), mi->disk_id);
 
     hfdi = FDICreate( cabinet_alloc, cabinet_free, cabinet_open_stream, cabinet_read_stream,
-                      cabinet_write, cabinet_close_stream, cabinet_seek_stream, 0, &erf );
+                      cabinet_write, cabinet_close, cabinet_seek_stream, 0, &erf );
     if (!hfdi)
     {
         ERR("FDICreate failed\n");
@@ -652,11 +919,27 @@ static BOOL extract_cabinet_stream( MSIPACKAGE *package, MSIMEDIAINFO *mi, LPVOI
  */
 BOOL msi_cabextract(MSIPACKAGE* package, MSIMEDIAINFO *mi, LPVOID data)
 {
+    MSICABDATA *cab_data = data;
+    BOOL ret;
+
+    if (!(cab_data->writer = cab_writer_create()))
+        WARN("writing extracted files synchronously\n");
+
     if (mi->cabinet[0] == '#')
+        ret = extract_cabinet_stream( package, mi, data );
+    else
+        ret = extract_cabinet( package, mi, data );
+
+    if (cab_data->writer)
     {
-        return extract_cabinet_stream( package, mi, data );
+        if (!cab_writer_destroy( cab_data->writer, cab_data ))
+        {
+            ERR("failed to write extracted files\n");
+            ret = FALSE;
+        }
+        cab_data->writer = NULL;
     }
-    return extract_cabinet( package, mi, data );
+    return ret;
 }
 
 void msi_free_media_info(MSIMEDIAINFO *mi)
@@ -340,6 +340,17 @@ typedef struct tagMSIVIEWOPS
      * drop - drops the table from the database
      */
     UINT (*drop)( struct tagMSIVIEW *view );
+
+    /*
+     * find_matching_rows - iterates through rows that match a value
+     *
+     *  The value is compared with what fetch_int returns for the column,
+     *   so a string ID should be passed in for string columns.
+     *  The handle keeps track of the current position in the iteration. It
+     *   must be initialised to NULL before the first call and passed in to
+     *   subsequent calls.
+     */
+    UINT (*find_matching_rows)( struct tagMSIVIEW *view, UINT col, UINT val, UINT *row, MSIITERHANDLE *handle );
 } MSIVIEWOPS;
 
 struct tagMSIVIEW
@@ -1074,6 +1085,7 @@ typedef struct
     PMSICABEXTRACTCB cb;
     LPWSTR curfile;
     PVOID user;
+    struct cab_writer *writer;
 } MSICABDATA;
 
 extern UINT ready_media(MSIPACKAGE *package, BOOL compressed, MSIMEDIAINFO *mi) DECLSPEC_HIDDEN;
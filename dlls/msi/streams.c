@@ -391,6 +391,7 @@ static const MSIVIEWOPS streams_ops =
     NULL,
     NULL,
     NULL,
+    NULL,
 };
 
 static HRESULT open_stream( MSIDATABASE *db, const WCHAR *name, IStream **stream )
@@ -40,6 +40,7 @@
 WINE_DEFAULT_DEBUG_CHANNEL(msidb);
 
 #define MSITABLE_HASH_TABLE_SIZE 37
+#define MSITABLE_HASH_LOAD_FACTOR 4
 
 typedef struct tagMSICOLUMNHASHENTRY
 {
@@ -58,6 +59,7 @@ typedef struct tagMSICOLUMNINFO
     INT     ref_count;
     BOOL    temporary;
     MSICOLUMNHASHENTRY **hash_table;
+    UINT    hash_size;
 } MSICOLUMNINFO;
 
 struct tagMSITABLE
@@ -1490,6 +1492,17 @@ static UINT TABLE_set_row( struct tagMSIVIEW *view, UINT row, MSIRECORD *rec, UI
     return r;
 }
 
+static void table_free_hash_tables( MSITABLEVIEW *tv )
+{
+    UINT i;
+
+    for (i = 0; i < tv->num_cols; i++)
+    {
+        msi_free( tv->columns[i].hash_table );
+        tv->columns[i].hash_table = NULL;
+    }
+}
+
 static UINT table_create_new_row( struct tagMSIVIEW *view, UINT *num, BOOL temporary )
 {
     MSITABLEVIEW *tv = (MSITABLEVIEW*)view;
@@ -1546,6 +1559,87 @@ static UINT table_create_new_row( struct tagMSIVIEW *view, UINT *num, BOOL tempo
 
     (*row_count)++;
 
+    /* the new row shifts the rows after it */
+    table_free_hash_tables( tv );
+
+    return ERROR_SUCCESS;
+}
+
+static UINT TABLE_find_matching_rows( struct tagMSIVIEW *view, UINT col,
+    UINT val, UINT *row, MSIITERHANDLE *handle )
+{
+    MSITABLEVIEW *tv = (MSITABLEVIEW*)view;
+    MSICOLUMNINFO *column;
+    const MSICOLUMNHASHENTRY *entry;
+
+    TRACE("%p, %d, %u, %p\n", view, col, val, *handle);
+
+    if( !tv->table )
+         return ERROR_INVALID_PARAMETER;
+
+    if( (col==0) || (col > tv->num_cols) )
+         return ERROR_INVALID_PARAMETER;
+
+    column = &tv->columns[col - 1];
+    if( !column->hash_table )
+    {
+        UINT i, size;
+        UINT num_rows = tv->table->row_count;
+        MSICOLUMNHASHENTRY **hash_table;
+        MSICOLUMNHASHENTRY *new_entry;
+
+        if( column->offset >= tv->row_size )
+        {
+            ERR("Stuffed up %d >= %d\n", column->offset, tv->row_size );
+            ERR("%p %p\n", tv, tv->columns );
+            return ERROR_FUNCTION_FAILED;
+        }
+
+        /* keep the chains short for big tables */
+        size = max( MSITABLE_HASH_TABLE_SIZE, (num_rows / MSITABLE_HASH_LOAD_FACTOR) | 1 );
+
+        /* allocate contiguous memory for the table and its entries so we
+         * don't have to do an expensive cleanup */
+        hash_table = msi_alloc( size * sizeof(MSICOLUMNHASHENTRY *) +
+                                num_rows * sizeof(MSICOLUMNHASHENTRY) );
+        if( !hash_table )
+            return ERROR_OUTOFMEMORY;
+
+        memset( hash_table, 0, size * sizeof(MSICOLUMNHASHENTRY *) );
+        new_entry = (MSICOLUMNHASHENTRY *)(hash_table + size);
+
+        /* insert backwards so that each chain lists its rows in ascending order */
+        for( i = num_rows; i > 0; i-- )
+        {
+            UINT row_value;
+
+            if( view->ops->fetch_int( view, i - 1, col, &row_value ) != ERROR_SUCCESS )
+                continue;
+
+            new_entry->value = row_value;
+            new_entry->row = i - 1;
+            new_entry->next = hash_table[row_value % size];
+            hash_table[row_value % size] = new_entry++;
+        }
+
+        column->hash_table = hash_table;
+        column->hash_size = size;
+    }
+
+    if( !*handle )
+        entry = column->hash_table[val % column->hash_size];
+    else
+        entry = (*handle)->next;
+
+    while( entry && entry->value != val )
+        entry = entry->next;
+
+    *handle = entry;
+    if( !entry )
+        return ERROR_NO_MORE_ITEMS;
+
+    *row = entry->row;
+
     return ERROR_SUCCESS;
 }
 
@@ -1776,12 +1870,7 @@ static UINT TABLE_delete_row( struct tagMSIVIEW *view, UINT row )
     num_rows = tv->table->row_count;
     tv->table->row_count--;
 
-    /* reset the hash tables */
-    for (i = 0; i < tv->num_cols; i++)
-    {
-        msi_free( tv->columns[i].hash_table );
-        tv->columns[i].hash_table = NULL;
-    }
+    table_free_hash_tables( tv );
 
     for (i = row + 1; i < num_rows; i++)
     {
@@ -2145,6 +2234,7 @@ static const MSIVIEWOPS table_ops =
     TABLE_add_column,
     NULL,
     TABLE_drop,
+    TABLE_find_matching_rows,
 };
 
 UINT TABLE_CreateView( MSIDATABASE *db, LPCWSTR name, MSIVIEW **view )
@@ -9109,6 +9109,106 @@ static void test_viewmodify_insert(void)
     DeleteFileA(msifile);
 }
 
+static void test_where_lookup(void)
+{
+    MSIHANDLE view, rec, db = create_db();
+    UINT r;
+
+    r = run_query(db, 0, "CREATE TABLE `T` (`A` SHORT, `B` CHAR(32), `C` LONG PRIMARY KEY `A`)");
+    ok(!r, "got %u\n", r);
+    r = run_query(db, 0, "CREATE TABLE `U` (`D` CHAR(32), `E` SHORT PRIMARY KEY `D`)");
+    ok(!r, "got %u\n", r);
+
+    r = run_query(db, 0, "INSERT INTO `T` (`A`, `B`, `C`) VALUES (1, 'one', -1)");
+    ok(!r, "got %u\n", r);
+    r = run_query(db, 0, "INSERT INTO `T` (`A`, `B`, `C`) VALUES (2, 'two', 100000)");
+    ok(!r, "got %u\n", r);
+    r = run_query(db, 0, "INSERT INTO `T` (`A`, `B`, `C`) VALUES (3, 'one', 100000)");
+    ok(!r, "got %u\n", r);
+    r = run_query(db, 0, "INSERT INTO `T` (`A`, `B`) VALUES (4, '')");
+    ok(!r, "got %u\n", r);
+    r = run_query(db, 0, "INSERT INTO `U` (`D`, `E`) VALUES ('one', 1)");
+    ok(!r, "got %u\n", r);
+    r = run_query(db, 0, "INSERT INTO `U` (`D`, `E`) VALUES ('two', 3)");
+    ok(!r, "got %u\n", r);
+
+    r = MsiDatabaseOpenViewA(db, "SELECT `A` FROM `T` WHERE `B` = ? AND `C` = ?", &view);
+    ok(!r, "got %u\n", r);
+    rec = MsiCreateRecord(2);
+    MsiRecordSetStringA(rec, 1, "one");
+    MsiRecordSetInteger(rec, 2, 100000);
+    r = MsiViewExecute(view, rec);
+    ok(!r, "got %u\n", r);
+    MsiCloseHandle(rec);
+
+    r = MsiViewFetch(view, &rec);
+    ok(!r, "got %u\n", r);
+    check_record(rec, 1, "3");
+    MsiCloseHandle(rec);
+    r = MsiViewFetch(view, &rec);
+    ok(r == ERROR_NO_MORE_ITEMS, "got %u\n", r);
+    MsiViewClose(view);
+
+    rec = MsiCreateRecord(2);
+    MsiRecordSetStringA(rec, 1, "three");
+    MsiRecordSetInteger(rec, 2, 100000);
+    r = MsiViewExecute(view, rec);
+    ok(!r, "got %u\n", r);
+    MsiCloseHandle(rec);
+
+    r = MsiViewFetch(view, &rec);
+    ok(r == ERROR_NO_MORE_ITEMS, "got %u\n", r);
+    MsiViewClose(view);
+    MsiCloseHandle(view);
+
+    r = do_query(db, "SELECT `A` FROM `T` WHERE `B` = '' AND `C` = 0", &rec);
+    ok(r == ERROR_NO_MORE_ITEMS, "got %u\n", r);
+    r = do_query(db, "SELECT `A` FROM `T` WHERE `B` = ''", &rec);
+    ok(!r, "got %u\n", r);
+    check_record(rec, 1, "4");
+    MsiCloseHandle(rec);
+
+    r = MsiDatabaseOpenViewA(db, "SELECT `A`, `E` FROM `T`, `U` WHERE `E` = `A` AND `D` = `B`", &view);
+    ok(!r, "got %u\n", r);
+    r = MsiViewExecute(view, 0);
+    ok(!r, "got %u\n", r);
+
+    r = MsiViewFetch(view, &rec);
+    ok(!r, "got %u\n", r);
+    check_record(rec, 2, "1", "1");
+    MsiCloseHandle(rec);
+    r = MsiViewFetch(view, &rec);
+    ok(r == ERROR_NO_MORE_ITEMS, "got %u\n", r);
+    MsiViewClose(view);
+
+    /* modifications are visible to later lookups */
+    r = run_query(db, 0, "UPDATE `U` SET `E` = 3 WHERE `D` = 'one'");
+    ok(!r, "got %u\n", r);
+    r = run_query(db, 0, "INSERT INTO `U` (`D`, `E`) VALUES ('a', 2)");
+    ok(!r, "got %u\n", r);
+    r = run_query(db, 0, "UPDATE `T` SET `B` = 'a' WHERE `A` = 2");
+    ok(!r, "got %u\n", r);
+
+    r = MsiViewExecute(view, 0);
+    ok(!r, "got %u\n", r);
+
+    r = MsiViewFetch(view, &rec);
+    ok(!r, "got %u\n", r);
+    check_record(rec, 2, "2", "2");
+    MsiCloseHandle(rec);
+    r = MsiViewFetch(view, &rec);
+    ok(!r, "got %u\n", r);
+    check_record(rec, 2, "3", "3");
+    MsiCloseHandle(rec);
+    r = MsiViewFetch(view, &rec);
+    ok(r == ERROR_NO_MORE_ITEMS, "got %u\n", r);
+    MsiViewClose(view);
+    MsiCloseHandle(view);
+
+    MsiCloseHandle(db);
+    DeleteFileA(msifile);
+}
+
 START_TEST(db)
 {
     test_msidatabase();
@@ -9167,4 +9267,5 @@ START_TEST(db)
     test_primary_keys();
     test_viewmodify_merge();
     test_viewmodify_insert();
+    test_where_lookup();
 }
@@ -404,6 +404,13 @@ static const CHAR mm_file_dat[] = "File\tComponent_\tFileName\tFileSize\tVersion
                                   "augustus\taugustus\taugustus\t500\t\t\t512\t2\n"
                                   "caesar\tcaesar\tcaesar\t500\t\t\t16384\t3";
 
+static const CHAR mfc_file_dat[] = "File\tComponent_\tFileName\tFileSize\tVersion\tLanguage\tAttributes\tSequence\n"
+                                   "s72\ts72\tl255\ti4\tS72\tS20\tI2\ti2\n"
+                                   "File\tFile\n"
+                                   "maximus\tmaximus\tmaximus\t500\t\t\t16384\t1\n"
+                                   "augustus\taugustus\taugustus\t50000\t\t\t16384\t2\n"
+                                   "caesar\tcaesar\tcaesar\t500\t\t\t16384\t3";
+
 static const CHAR mm_media_dat[] = "DiskId\tLastSequence\tDiskPrompt\tCabinet\tVolumeLabel\tSource\n"
                                    "i2\ti4\tL64\tS255\tS32\tS72\n"
                                    "Media\tDiskId\n"
@@ -1551,6 +1558,18 @@ static const msi_table mm_tables[] =
     ADD_TABLE(property),
 };
 
+static const msi_table mfc_tables[] =
+{
+    ADD_TABLE(cc_component),
+    ADD_TABLE(directory),
+    ADD_TABLE(cc_feature),
+    ADD_TABLE(cc_feature_comp),
+    ADD_TABLE(mfc_file),
+    ADD_TABLE(install_exec_seq),
+    ADD_TABLE(mm_media),
+    ADD_TABLE(property),
+};
+
 static const msi_table ss_tables[] =
 {
     ADD_TABLE(cc_component),
@@ -5247,6 +5266,52 @@ static BOOL file_matches_data(LPCSTR file, LPCSTR data)
     return FALSE;
 }
 
+static void test_multifile_cab(void)
+{
+    static const char *files[] = {"maximus", "augustus", "caesar"};
+    static const DWORD sizes[] = {500, 50000, 500};
+    char path[MAX_PATH];
+    UINT r, i;
+
+    if (is_process_limited())
+    {
+        skip("process is limited\n");
+        return;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(files); i++)
+        create_file(files[i], sizes[i]);
+    create_cab_file("test1.cab", MEDIA_SIZE, "maximus\0augustus\0caesar\0");
+    create_database(msifile, mfc_tables, ARRAY_SIZE(mfc_tables));
+
+    MsiSetInternalUI(INSTALLUILEVEL_NONE, NULL);
+
+    r = MsiInstallProductA(msifile, NULL);
+    if (r == ERROR_INSTALL_PACKAGE_REJECTED)
+    {
+        skip("Not enough rights to perform tests\n");
+        goto error;
+    }
+    ok(r == ERROR_SUCCESS, "Expected ERROR_SUCCESS, got %u\n", r);
+
+    for (i = 0; i < ARRAY_SIZE(files); i++)
+    {
+        sprintf(path, "%s\\msitest\\%s", PROG_FILES_DIR, files[i]);
+        ok(file_matches_data(path, files[i]), "%s: wrong data\n", files[i]);
+        sprintf(path, "msitest\\%s", files[i]);
+        ok(get_pf_file_size(path) == sizes[i], "%s: expected size %u, got %u\n",
+           files[i], sizes[i], get_pf_file_size(path));
+        ok(delete_pf(path, TRUE), "%s not installed\n", files[i]);
+    }
+    ok(delete_pf("msitest", FALSE), "Directory not created\n");
+
+error:
+    for (i = 0; i < ARRAY_SIZE(files); i++)
+        DeleteFileA(files[i]);
+    DeleteFileA("test1.cab");
+    DeleteFileA(msifile);
+}
+
 static void test_file_in_use(void)
 {
     UINT r;
@@ -6265,6 +6330,7 @@ START_TEST(install)
     test_shortcut();
     test_preselected();
     test_installed_prop();
+    test_multifile_cab();
     test_file_in_use();
     test_file_in_use_cab();
     test_allusers_prop();
@@ -52,6 +52,12 @@ typedef struct tagJOINTABLE
     UINT col_count;
     UINT row_count;
     UINT table_index;
+    /* equality used to look up matching rows, see plan_lookup */
+    struct expr *key_value;
+    UINT key_column;
+    BOOL key_string;
+    UINT key_bias;
+    UINT key_rec_index;
 } JOINTABLE;
 
 typedef struct tagMSIORDERINFO
@@ -647,38 +653,115 @@ static UINT WHERE_evaluate( MSIWHEREVIEW *wv, const UINT rows[],
     return ERROR_SUCCESS;
 }
 
+static UINT check_condition( MSIWHEREVIEW *wv, MSIRECORD *record, JOINTABLE **tables,
+                             UINT table_rows[] );
+
+/* evaluates the condition for the current row of the first table,
+ * returns TRUE if the iteration should stop */
+static BOOL check_row( MSIWHEREVIEW *wv, MSIRECORD *record, JOINTABLE **tables,
+                       UINT table_rows[], UINT *r )
+{
+    INT val = 0;
+
+    wv->rec_index = 0;
+    *r = WHERE_evaluate( wv, table_rows, wv->cond, &val, record );
+    if (*r != ERROR_SUCCESS && *r != ERROR_CONTINUE)
+        return TRUE;
+    if (val)
+    {
+        if (*(tables + 1))
+        {
+            *r = check_condition(wv, record, tables + 1, table_rows);
+            if (*r != ERROR_SUCCESS)
+                return TRUE;
+        }
+        else
+        {
+            if (*r != ERROR_SUCCESS)
+                return TRUE;
+            add_row (wv, table_rows);
+        }
+    }
+    return FALSE;
+}
+
+/* computes the value to look up in the key column of table, returns
+ * ERROR_CONTINUE if all rows have to be scanned instead */
+static UINT get_lookup_key( MSIWHEREVIEW *wv, MSIRECORD *record, const JOINTABLE *table,
+                            const UINT table_rows[], UINT *key )
+{
+    UINT r;
+
+    wv->rec_index = table->key_rec_index;
+
+    if (table->key_string)
+    {
+        const WCHAR *str;
+
+        r = STRING_evaluate( wv, table_rows, table->key_value, record, &str );
+        if (r != ERROR_SUCCESS)
+            return ERROR_CONTINUE;
+
+        /* null and empty strings compare equal to each other */
+        if (!str || !*str)
+            return ERROR_CONTINUE;
+
+        if (msi_string2id( wv->db->strings, str, -1, key ) != ERROR_SUCCESS)
+            return ERROR_NO_MORE_ITEMS;
+    }
+    else
+    {
+        INT val;
+
+        r = WHERE_evaluate( wv, table_rows, table->key_value, &val, record );
+        if (r != ERROR_SUCCESS)
+            return ERROR_CONTINUE;
+
+        *key = val + table->key_bias;
+    }
+    return ERROR_SUCCESS;
+}
+
 static UINT check_condition( MSIWHEREVIEW *wv, MSIRECORD *record, JOINTABLE **tables,
                              UINT table_rows[] )
 {
-    UINT r = ERROR_FUNCTION_FAILED;
-    INT val;
+    JOINTABLE *table = *tables;
+    UINT r = ERROR_FUNCTION_FAILED, key;
 
-    for (table_rows[(*tables)->table_index] = 0;
-         table_rows[(*tables)->table_index] < (*tables)->row_count;
-         table_rows[(*tables)->table_index]++)
+    if (table->key_value &&
+        (r = get_lookup_key( wv, record, table, table_rows, &key )) != ERROR_CONTINUE)
     {
-        val = 0;
-        wv->rec_index = 0;
-        r = WHERE_evaluate( wv, table_rows, wv->cond, &val, record );
-        if (r != ERROR_SUCCESS && r != ERROR_CONTINUE)
-            break;
-        if (val)
+        MSIITERHANDLE handle = NULL;
+        UINT row;
+
+        if (r == ERROR_NO_MORE_ITEMS)
         {
-            if (*(tables + 1))
-            {
-                r = check_condition(wv, record, tables + 1, table_rows);
-                if (r != ERROR_SUCCESS)
-                    break;
-            }
-            else
+            /* the value is not in the string table, so no row can match */
+            r = ERROR_SUCCESS;
+        }
+        else
+        {
+            /* the full condition is still evaluated for each candidate row */
+            while (table->view->ops->find_matching_rows( table->view, table->key_column,
+                                                         key, &row, &handle ) == ERROR_SUCCESS)
             {
-                if (r != ERROR_SUCCESS)
+                table_rows[table->table_index] = row;
+                if (check_row( wv, record, tables, table_rows, &r ))
                     break;
-                add_row (wv, table_rows);
             }
         }
     }
-    table_rows[(*tables)->table_index] = INVALID_ROW_INDEX;
+    else
+    {
+        for (table_rows[table->table_index] = 0;
+             table_rows[table->table_index] < table->row_count;
+             table_rows[table->table_index]++)
+        {
+            if (check_row( wv, record, tables, table_rows, &r ))
+                break;
+        }
+    }
+    table_rows[table->table_index] = INVALID_ROW_INDEX;
     return r;
 }
 
@@ -811,6 +894,144 @@ static JOINTABLE **ordertables( MSIWHEREVIEW *wv )
     return tables;
 }
 
+static BOOL in_array_before( JOINTABLE **array, UINT count, const JOINTABLE *elem )
+{
+    UINT i;
+
+    for (i = 0; i < count; i++)
+        if (array[i] == elem)
+            return TRUE;
+    return FALSE;
+}
+
+static BOOL is_key_column( const struct expr *expr, const JOINTABLE *table, BOOL string )
+{
+    if (string)
+    {
+        if (expr->type != EXPR_COL_NUMBER_STRING)
+            return FALSE;
+    }
+    else if (expr->type != EXPR_COL_NUMBER && expr->type != EXPR_COL_NUMBER32)
+        return FALSE;
+
+    return expr->u.column.parsed.table == table;
+}
+
+/* values known before the rows of the table at index are iterated */
+static BOOL is_key_value( const struct expr *expr, JOINTABLE **ordered_tables,
+                          UINT index, BOOL string )
+{
+    switch (expr->type)
+    {
+    case EXPR_WILDCARD:
+        return TRUE;
+    case EXPR_SVAL:
+        return string;
+    case EXPR_UVAL:
+        return !string;
+    case EXPR_COL_NUMBER:
+    case EXPR_COL_NUMBER32:
+        return !string && in_array_before(ordered_tables, index, expr->u.column.parsed.table);
+    case EXPR_COL_NUMBER_STRING:
+        return string && in_array_before(ordered_tables, index, expr->u.column.parsed.table);
+    default:
+        return FALSE;
+    }
+}
+
+/* finds an equality between a column of the table at index and a known
+ * value that the whole condition depends on */
+static BOOL find_key( struct expr *cond, JOINTABLE **ordered_tables, UINT index,
+                      struct expr **column, struct expr **value )
+{
+    JOINTABLE *table = ordered_tables[index];
+    struct expr *left, *right;
+    BOOL string;
+
+    if (cond->type == EXPR_COMPLEX && cond->u.expr.op == OP_AND)
+        return find_key(cond->u.expr.left, ordered_tables, index, column, value) ||
+               find_key(cond->u.expr.right, ordered_tables, index, column, value);
+
+    if (cond->type == EXPR_STRCMP)
+        string = TRUE;
+    else if (cond->type == EXPR_COMPLEX)
+        string = FALSE;
+    else
+        return FALSE;
+
+    if (cond->u.expr.op != OP_EQ)
+        return FALSE;
+
+    left = cond->u.expr.left;
+    right = cond->u.expr.right;
+    if (is_key_column(left, table, string) && is_key_value(right, ordered_tables, index, string))
+    {
+        *column = left;
+        *value = right;
+        return TRUE;
+    }
+    if (is_key_column(right, table, string) && is_key_value(left, ordered_tables, index, string))
+    {
+        *column = right;
+        *value = left;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/* counts the parameters used before expr when the condition is evaluated */
+static BOOL count_wildcards( const struct expr *cond, const struct expr *expr, UINT *count )
+{
+    if (cond == expr)
+        return TRUE;
+
+    switch (cond->type)
+    {
+    case EXPR_WILDCARD:
+        (*count)++;
+        return FALSE;
+    case EXPR_COMPLEX:
+    case EXPR_STRCMP:
+        return count_wildcards(cond->u.expr.left, expr, count) ||
+               count_wildcards(cond->u.expr.right, expr, count);
+    default:
+        return FALSE;
+    }
+}
+
+/* lets check_condition look up the matching rows of a table in the column
+ * hash instead of scanning all of them */
+static void plan_lookup( MSIWHEREVIEW *wv, JOINTABLE **ordered_tables, UINT index )
+{
+    JOINTABLE *table = ordered_tables[index];
+    struct expr *column, *value;
+
+    table->key_value = NULL;
+
+    if (!wv->cond || !table->view->ops->find_matching_rows)
+        return;
+
+    if (!find_key(wv->cond, ordered_tables, index, &column, &value))
+        return;
+
+    TRACE("looking up rows of table %u in column %u\n", table->table_index, column->u.column.parsed.column);
+
+    table->key_column = column->u.column.parsed.column;
+    table->key_string = column->type == EXPR_COL_NUMBER_STRING;
+    if (column->type == EXPR_COL_NUMBER32)
+        table->key_bias = 0x80000000;
+    else if (column->type == EXPR_COL_NUMBER)
+        table->key_bias = 0x8000;
+    else
+        table->key_bias = 0;
+
+    table->key_rec_index = 0;
+    if (value->type == EXPR_WILDCARD)
+        count_wildcards(wv->cond, value, &table->key_rec_index);
+
+    table->key_value = value;
+}
+
 static UINT WHERE_execute( struct tagMSIVIEW *view, MSIRECORD *record )
 {
     MSIWHEREVIEW *wv = (MSIWHEREVIEW*)view;
@@ -847,6 +1068,8 @@ static UINT WHERE_execute( struct tagMSIVIEW *view, MSIRECORD *record )
     while ((table = table->next));
 
     ordered_tables = ordertables( wv );
+    for (i = 0; ordered_tables[i]; i++)
+        plan_lookup( wv, ordered_tables, i );
 
     rows = msi_alloc( wv->table_count * sizeof(*rows) );
     for (i = 0; i < wv->table_count; i++)
@@ -1133,6 +1356,7 @@ static const MSIVIEWOPS where_ops =
     NULL,
     WHERE_sort,
     NULL,
+    NULL,
 };
 
 static UINT WHERE_VerifyCondition( MSIWHEREVIEW *wv, struct expr *cond,
@@ -721,6 +721,7 @@ static NTSTATUS get_io_timeouts( HANDLE handle, enum server_fd_type type, ULONG
         break;
     case FD_TYPE_SOCKET:
     case FD_TYPE_CHAR:
+    case FD_TYPE_PIPE:
         if (is_read) timeouts->interval = 0;  /* return as soon as we got something */
         break;
     default:
@@ -773,6 +774,7 @@ static NTSTATUS get_io_avail_mode( HANDLE handle, enum server_fd_type type, BOOL
     case FD_TYPE_MAILSLOT:
     case FD_TYPE_SOCKET:
     case FD_TYPE_CHAR:
+    case FD_TYPE_PIPE:
         *avail_mode = TRUE;
         break;
     default:
@@ -863,6 +865,13 @@ NTSTATUS WINAPI NtReadFile(HANDLE hFile, HANDLE hEvent,
     if (status == STATUS_BAD_DEVICE_TYPE)
         return server_read_file( hFile, hEvent, apc, apc_user, io_status, buffer, length, offset, key );
 
+    /* zero-length pipe reads wait for data to arrive, which only the server can tell */
+    if (type == FD_TYPE_PIPE && !length)
+    {
+        if (needs_close) close( unix_handle );
+        return server_read_file( hFile, hEvent, apc, apc_user, io_status, buffer, length, offset, key );
+    }
+
     async_read = !(options & (FILE_SYNCHRONOUS_IO_ALERT | FILE_SYNCHRONOUS_IO_NONALERT));
 
     if (type == FD_TYPE_FILE)
@@ -942,6 +951,10 @@ NTSTATUS WINAPI NtReadFile(HANDLE hFile, HANDLE hEvent,
                         goto done;
                     }
                     break;
+                case FD_TYPE_PIPE:
+                    /* the connection is gone, the server knows whether it was closed or disconnected */
+                    if (needs_close) close( unix_handle );
+                    return server_read_file( hFile, hEvent, apc, apc_user, io_status, buffer, length, offset, key );
                 default:
                     status = STATUS_PIPE_BROKEN;
                     goto err;
@@ -1028,6 +1041,11 @@ err:
     ret_status = async_read && type == FD_TYPE_FILE && status == STATUS_SUCCESS
             ? STATUS_PENDING : status;
 
+    /* the server would drop the completion anyway */
+    if (send_completion && ret_status != STATUS_PENDING &&
+        (options & FILE_WINE_SKIP_COMPLETION_PORT_ON_SUCCESS))
+        send_completion = FALSE;
+
     if (send_completion) NTDLL_AddCompletion( hFile, cvalue, status, total, ret_status == STATUS_PENDING );
     return ret_status;
 }
@@ -1244,6 +1262,13 @@ NTSTATUS WINAPI NtWriteFile(HANDLE hFile, HANDLE hEvent,
     if (status == STATUS_BAD_DEVICE_TYPE)
         return server_write_file( hFile, hEvent, apc, apc_user, io_status, buffer, length, offset, key );
 
+    /* zero-length pipe writes only check the pipe state */
+    if (type == FD_TYPE_PIPE && !length)
+    {
+        if (needs_close) close( unix_handle );
+        return server_write_file( hFile, hEvent, apc, apc_user, io_status, buffer, length, offset, key );
+    }
+
     if (type == FD_TYPE_FILE)
     {
         if (async_write &&
@@ -1331,6 +1356,12 @@ NTSTATUS WINAPI NtWriteFile(HANDLE hFile, HANDLE hEvent,
         else if (errno != EAGAIN)
         {
             if (errno == EINTR) continue;
+            if (errno == EPIPE && type == FD_TYPE_PIPE && !total)
+            {
+                /* the connection is gone, the server knows whether it was closed or disconnected */
+                if (needs_close) close( unix_handle );
+                return server_write_file( hFile, hEvent, apc, apc_user, io_status, buffer, length, offset, key );
+            }
             if (!total)
             {
                 if (errno == EFAULT) status = STATUS_INVALID_USER_BUFFER;
@@ -1422,6 +1453,12 @@ err:
     }
 
     ret_status = async_write && type == FD_TYPE_FILE && status == STATUS_SUCCESS ? STATUS_PENDING : status;
+
+    /* the server would drop the completion anyway */
+    if (send_completion && ret_status != STATUS_PENDING &&
+        (options & FILE_WINE_SKIP_COMPLETION_PORT_ON_SUCCESS))
+        send_completion = FALSE;
+
     if (send_completion) NTDLL_AddCompletion( hFile, cvalue, status, total, ret_status == STATUS_PENDING );
 
     return ret_status;
@@ -1704,6 +1741,17 @@ NTSTATUS WINAPI NtFsControlFile(HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc
         if (!status) status = DIR_unmount_device( handle );
         return status;
 
+    case FSCTL_PIPE_DISCONNECT:
+        status = server_ioctl_file( handle, event, apc, apc_context, io, code,
+                                    in_buffer, in_size, out_buffer, out_size );
+        if (!status)
+        {
+            /* the socket of the old connection is of no further use */
+            int fd = server_remove_fd_from_cache( handle );
+            if (fd != -1) close( fd );
+        }
+        return status;
+
     case FSCTL_PIPE_IMPERSONATE:
         FIXME("FSCTL_PIPE_IMPERSONATE: impersonating self\n");
         status = RtlImpersonateSelf( SecurityImpersonation );
@@ -2306,6 +2354,7 @@ NTSTATUS WINAPI NtQueryInformationFile( HANDLE hFile, PIO_STATUS_BLOCK io,
     };
 
     struct stat st;
+    enum server_fd_type type;
     int fd, needs_close = FALSE;
     ULONG attr;
 
@@ -2320,11 +2369,17 @@ NTSTATUS WINAPI NtQueryInformationFile( HANDLE hFile, PIO_STATUS_BLOCK io,
     if (len < info_sizes[class])
         return io->u.Status = STATUS_INFO_LENGTH_MISMATCH;
 
-    if ((io->u.Status = server_get_unix_fd( hFile, 0, &fd, &needs_close, NULL, NULL )))
+    if ((io->u.Status = server_get_unix_fd( hFile, 0, &fd, &needs_close, &type, NULL )))
     {
         if (io->u.Status != STATUS_BAD_DEVICE_TYPE) return io->u.Status;
         return server_get_file_info( hFile, io, ptr, len, class );
     }
+    if (type == FD_TYPE_PIPE)
+    {
+        /* pipes backed by a socket keep their state in the server */
+        if (needs_close) close( fd );
+        return server_get_file_info( hFile, io, ptr, len, class );
+    }
 
     switch (class)
     {
@@ -2682,6 +2737,7 @@ NTSTATUS WINAPI NtSetInformationFile(HANDLE handle, PIO_STATUS_BLOCK io,
                 io->u.Status  = wine_server_call( req );
             }
             SERVER_END_REQ;
+            if (!io->u.Status) server_set_fd_completion_flags( handle, info->Flags );
         } else
             io->u.Status = STATUS_INFO_LENGTH_MISMATCH;
         break;
@@ -3118,11 +3174,18 @@ NTSTATUS WINAPI NtQueryVolumeInformationFile( HANDLE handle, PIO_STATUS_BLOCK io
                                               PVOID buffer, ULONG length,
                                               FS_INFORMATION_CLASS info_class )
 {
+    enum server_fd_type type;
     int fd, needs_close;
     struct stat st;
     static int once;
 
-    io->u.Status = server_get_unix_fd( handle, 0, &fd, &needs_close, NULL, NULL );
+    io->u.Status = server_get_unix_fd( handle, 0, &fd, &needs_close, &type, NULL );
+    if (!io->u.Status && type == FD_TYPE_PIPE)
+    {
+        /* pipes backed by a socket still report what the server says */
+        if (needs_close) close( fd );
+        io->u.Status = STATUS_BAD_DEVICE_TYPE;
+    }
     if (io->u.Status == STATUS_BAD_DEVICE_TYPE)
     {
         SERVER_START_REQ( get_volume_info )
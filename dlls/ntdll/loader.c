@@ -50,6 +50,7 @@ WINE_DECLARE_DEBUG_CHANNEL(relay);
 WINE_DECLARE_DEBUG_CHANNEL(snoop);
 WINE_DECLARE_DEBUG_CHANNEL(loaddll);
 WINE_DECLARE_DEBUG_CHANNEL(imports);
+WINE_DECLARE_DEBUG_CHANNEL(startup);
 
 #ifdef _WIN64
 #define DEFAULT_SECURITY_COOKIE_64  (((ULONGLONG)0x00002b99 << 32) | 0x2ddfa232)
@@ -137,6 +138,35 @@ static WINE_MODREF *cached_modref;
 static WINE_MODREF *current_modref;
 static WINE_MODREF *last_failed_modref;
 
+/* process startup profiling, reported on the startup debug channel */
+enum startup_stat
+{
+    STARTUP_STAT_DLL_LOAD,
+    STARTUP_STAT_DLL_MAIN,
+    STARTUP_STAT_TLS_CALLBACKS,
+    STARTUP_STAT_COUNT
+};
+
+static const char * const startup_phase_names[STARTUP_PHASE_COUNT] =
+{
+    "exec", "virtual init", "server init", "kernel32 init", "imports", "process attach"
+};
+
+static const char * const startup_stat_names[STARTUP_STAT_COUNT] =
+{
+    "dll loads", "DllMain calls", "TLS callbacks"
+};
+
+static BOOL startup_profiling;  /* set while the process starts up with +startup */
+static LARGE_INTEGER startup_exec_time;  /* system time when ntdll got control */
+static ULONGLONG startup_phase_times[STARTUP_PHASE_COUNT];  /* performance counter at the end of each phase */
+static struct
+{
+    ULONGLONG    time;   /* total time, nested calls are part of the outer one */
+    unsigned int count;  /* number of calls */
+    unsigned int depth;  /* current nesting level */
+} startup_stats[STARTUP_STAT_COUNT];
+
 static NTSTATUS load_dll( LPCWSTR load_path, LPCWSTR libname, DWORD flags, WINE_MODREF** pwm );
 static NTSTATUS process_attach( WINE_MODREF *wm, LPVOID lpReserved );
 static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
@@ -1161,6 +1191,94 @@ static NTSTATUS alloc_thread_tls(void)
 }
 
 
+/***********************************************************************
+ *           startup_phase_done
+ *
+ * Record the end of a process startup phase.
+ */
+void startup_phase_done( enum startup_phase phase )
+{
+    LARGE_INTEGER counter;
+
+    if (phase == STARTUP_PHASE_EXEC) NtQuerySystemTime( &startup_exec_time );
+    NtQueryPerformanceCounter( &counter, NULL );
+    startup_phase_times[phase] = counter.QuadPart;
+}
+
+
+/***********************************************************************
+ *           startup_stat_start
+ *
+ * Start timing an operation during process startup.
+ * The loader_section must be locked while calling this function.
+ */
+static ULONGLONG startup_stat_start( enum startup_stat stat )
+{
+    LARGE_INTEGER counter;
+
+    if (!startup_profiling) return 0;
+    if (startup_stats[stat].depth++) return 0;
+    NtQueryPerformanceCounter( &counter, NULL );
+    return counter.QuadPart;
+}
+
+
+/***********************************************************************
+ *           startup_stat_end
+ *
+ * Stop timing an operation during process startup, return its duration if timed.
+ * The loader_section must be locked while calling this function.
+ */
+static ULONGLONG startup_stat_end( enum startup_stat stat, ULONGLONG start )
+{
+    LARGE_INTEGER counter;
+
+    if (!startup_profiling) return 0;
+    startup_stats[stat].depth--;
+    startup_stats[stat].count++;
+    if (!start) return 0;
+    NtQueryPerformanceCounter( &counter, NULL );
+    startup_stats[stat].time += counter.QuadPart - start;
+    return counter.QuadPart - start;
+}
+
+
+/***********************************************************************
+ *           startup_report
+ *
+ * Print the time spent in each phase of the process startup.
+ */
+static void startup_report(void)
+{
+    KERNEL_USER_TIMES times;
+    ULONGLONG prev, time;
+    unsigned int i;
+
+    if (!startup_profiling) return;
+    startup_profiling = FALSE;
+
+    if (!NtQueryInformationProcess( GetCurrentProcess(), ProcessTimes, &times, sizeof(times), NULL ) &&
+        startup_exec_time.QuadPart > times.CreateTime.QuadPart)
+    {
+        time = startup_exec_time.QuadPart - times.CreateTime.QuadPart;
+        TRACE_(startup)( "%s: %u.%03u ms\n", startup_phase_names[STARTUP_PHASE_EXEC],
+                         (UINT)(time / 10000), (UINT)(time / 10 % 1000) );
+    }
+    prev = startup_phase_times[STARTUP_PHASE_EXEC];
+    for (i = STARTUP_PHASE_EXEC + 1; i < STARTUP_PHASE_COUNT; i++)
+    {
+        if (!startup_phase_times[i]) continue;
+        time = startup_phase_times[i] - prev;
+        prev = startup_phase_times[i];
+        TRACE_(startup)( "%s: %u.%03u ms\n", startup_phase_names[i],
+                         (UINT)(time / 10000), (UINT)(time / 10 % 1000) );
+    }
+    for (i = 0; i < STARTUP_STAT_COUNT; i++)
+        TRACE_(startup)( "%u %s: %u.%03u ms\n", startup_stats[i].count, startup_stat_names[i],
+                         (UINT)(startup_stats[i].time / 10000), (UINT)(startup_stats[i].time / 10 % 1000) );
+}
+
+
 /*************************************************************************
  *              call_tls_callbacks
  */
@@ -1168,11 +1286,13 @@ static void call_tls_callbacks( HMODULE module, UINT reason )
 {
     const IMAGE_TLS_DIRECTORY *dir;
     const PIMAGE_TLS_CALLBACK *callback;
+    ULONGLONG start;
     ULONG dirsize;
 
     dir = RtlImageDirectoryEntryToData( module, TRUE, IMAGE_DIRECTORY_ENTRY_TLS, &dirsize );
     if (!dir || !dir->AddressOfCallBacks) return;
 
+    start = startup_stat_start( STARTUP_STAT_TLS_CALLBACKS );
     for (callback = (const PIMAGE_TLS_CALLBACK *)dir->AddressOfCallBacks; *callback; callback++)
     {
         TRACE_(relay)("\1Call TLS callback (proc=%p,module=%p,reason=%s,reserved=0)\n",
@@ -1185,12 +1305,14 @@ static void call_tls_callbacks( HMODULE module, UINT reason )
         {
             TRACE_(relay)("\1exception %08x in TLS callback (proc=%p,module=%p,reason=%s,reserved=0)\n",
                           GetExceptionCode(), callback, module, reason_names[reason] );
+            startup_stat_end( STARTUP_STAT_TLS_CALLBACKS, start );
             return;
         }
         __ENDTRY
         TRACE_(relay)("\1Ret  TLS callback (proc=%p,module=%p,reason=%s,reserved=0)\n",
                       *callback, module, reason_names[reason] );
     }
+    startup_stat_end( STARTUP_STAT_TLS_CALLBACKS, start );
 }
 
 
@@ -1203,6 +1325,7 @@ static NTSTATUS MODULE_InitDLL( WINE_MODREF *wm, UINT reason, LPVOID lpReserved
     NTSTATUS status = STATUS_SUCCESS;
     DLLENTRYPROC entry = wm->ldr.EntryPoint;
     void *module = wm->ldr.BaseAddress;
+    ULONGLONG start, time;
     BOOL retv = FALSE;
 
     /* Skip calls for modules loaded with special load flags */
@@ -1222,6 +1345,7 @@ static NTSTATUS MODULE_InitDLL( WINE_MODREF *wm, UINT reason, LPVOID lpReserved
     else TRACE("(%p %s,%s,%p) - CALL\n", module, debugstr_w(wm->ldr.BaseDllName.Buffer),
                reason_names[reason], lpReserved );
 
+    start = startup_stat_start( STARTUP_STAT_DLL_MAIN );
     __TRY
     {
         retv = call_dll_entry_point( entry, module, reason, lpReserved );
@@ -1236,6 +1360,10 @@ static NTSTATUS MODULE_InitDLL( WINE_MODREF *wm, UINT reason, LPVOID lpReserved
     }
     __ENDTRY
 
+    if ((time = startup_stat_end( STARTUP_STAT_DLL_MAIN, start )))
+        TRACE_(startup)( "%s DllMain(%s): %u.%03u ms\n", debugstr_w(wm->ldr.BaseDllName.Buffer),
+                         reason_names[reason], (UINT)(time / 10000), (UINT)(time / 10 % 1000) );
+
     /* The state of the module list may have changed due to the call
        to the dll. We cannot assume that this module has not been
        deleted.  */
@@ -2706,6 +2834,7 @@ static NTSTATUS load_dll( LPCWSTR load_path, LPCWSTR libname, DWORD flags, WINE_
     struct stat st;
     void *module;
     pe_image_info_t image_info;
+    ULONGLONG start;
     NTSTATUS nts;
 
     TRACE( "looking for %s in %s\n", debugstr_w(libname), debugstr_w(load_path) );
@@ -2723,6 +2852,7 @@ static NTSTATUS load_dll( LPCWSTR load_path, LPCWSTR libname, DWORD flags, WINE_
         return STATUS_SUCCESS;
     }
 
+    start = startup_stat_start( STARTUP_STAT_DLL_LOAD );
     if (nts && nts != STATUS_DLL_NOT_FOUND && nts != STATUS_INVALID_IMAGE_NOT_MZ) goto done;
 
     main_exe = get_modref( NtCurrentTeb()->Peb->ImageBaseAddress );
@@ -2810,6 +2940,7 @@ done:
     else
         WARN("Failed to load module %s; status=%x\n", debugstr_w(libname), nts);
 
+    startup_stat_end( STARTUP_STAT_DLL_LOAD, start );
     RtlFreeUnicodeString( &nt_name );
     return nts;
 }
@@ -3529,6 +3660,7 @@ void WINAPI LdrInitializeThunk( CONTEXT *context, void **entry, ULONG_PTR unknow
             NtTerminateProcess( GetCurrentProcess(), status );
         }
         imports_fixup_done = TRUE;
+        startup_phase_done( STARTUP_PHASE_IMPORTS );
     }
 
     RtlAcquirePebLock();
@@ -3553,6 +3685,8 @@ void WINAPI LdrInitializeThunk( CONTEXT *context, void **entry, ULONG_PTR unknow
             NtTerminateProcess( GetCurrentProcess(), status );
         }
         attach_implicitly_loaded_dlls( context );
+        startup_phase_done( STARTUP_PHASE_PROCESS_ATTACH );
+        startup_report();
         virtual_release_address_space();
     }
     else
@@ -3760,7 +3894,9 @@ void __wine_process_init(void)
     BOOL force_large_address_aware = FALSE;
     void * (CDECL *init_func)(void);
 
+    startup_phase_done( STARTUP_PHASE_EXEC );
     thread_init();
+    startup_profiling = TRACE_ON(startup);
 
     /* retrieve current umask */
     FILE_umask = umask(0777);
@@ -3786,6 +3922,7 @@ void __wine_process_init(void)
     }
 
     kernel32_start_process = init_func();
+    startup_phase_done( STARTUP_PHASE_KERNEL32_INIT );
 
     wm = get_modref( NtCurrentTeb()->Peb->ImageBaseAddress );
     assert( wm );
@@ -101,6 +101,7 @@ extern unsigned int server_select( const select_op_t *select_op, data_size_t siz
                                    UINT flags, const LARGE_INTEGER *timeout ) DECLSPEC_HIDDEN;
 extern unsigned int server_queue_process_apc( HANDLE process, const apc_call_t *call, apc_result_t *result ) DECLSPEC_HIDDEN;
 extern int server_remove_fd_from_cache( HANDLE handle ) DECLSPEC_HIDDEN;
+extern void server_set_fd_completion_flags( HANDLE handle, unsigned int flags ) DECLSPEC_HIDDEN;
 extern int server_get_unix_fd( HANDLE handle, unsigned int access, int *unix_fd,
                                int *needs_close, enum server_fd_type *type, unsigned int *options ) DECLSPEC_HIDDEN;
 extern int receive_fd( obj_handle_t *handle ) DECLSPEC_HIDDEN;
@@ -108,6 +109,7 @@ extern int server_pipe( int fd[2] ) DECLSPEC_HIDDEN;
 extern NTSTATUS alloc_object_attributes( const OBJECT_ATTRIBUTES *attr, struct object_attributes **ret,
                                          data_size_t *ret_len ) DECLSPEC_HIDDEN;
 extern NTSTATUS validate_open_object_attributes( const OBJECT_ATTRIBUTES *attr ) DECLSPEC_HIDDEN;
+extern void completion_close_handle( HANDLE handle ) DECLSPEC_HIDDEN;
 extern int wait_select_reply( void *cookie ) DECLSPEC_HIDDEN;
 extern BOOL invoke_apc( const apc_call_t *call, apc_result_t *result, sigset_t *user_sigset ) DECLSPEC_HIDDEN;
 extern void *server_get_shared_memory( HANDLE thread ) DECLSPEC_HIDDEN;
@@ -124,6 +126,19 @@ extern const WCHAR system_dir[] DECLSPEC_HIDDEN;
 
 extern void (WINAPI *kernel32_start_process)(LPTHREAD_START_ROUTINE,void*) DECLSPEC_HIDDEN;
 
+/* process startup profiling, phases are listed in the order they complete */
+enum startup_phase
+{
+    STARTUP_PHASE_EXEC,            /* process creation until ntdll gets control */
+    STARTUP_PHASE_VIRTUAL_INIT,    /* address space setup */
+    STARTUP_PHASE_SERVER_INIT,     /* server connection and initial thread */
+    STARTUP_PHASE_KERNEL32_INIT,   /* kernel32 and main exe loading */
+    STARTUP_PHASE_IMPORTS,         /* main exe imports resolution */
+    STARTUP_PHASE_PROCESS_ATTACH,  /* dll attach notifications */
+    STARTUP_PHASE_COUNT
+};
+extern void startup_phase_done( enum startup_phase phase ) DECLSPEC_HIDDEN;
+
 /* redefine these to make sure we don't reference kernel symbols */
 #define GetProcessHeap()       (NtCurrentTeb()->Peb->ProcessHeap)
 #define GetCurrentProcessId()  (HandleToULong(NtCurrentTeb()->ClientId.UniqueProcess))
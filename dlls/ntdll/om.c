@@ -369,6 +369,7 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
             {
                 int fd = server_remove_fd_from_cache( source );
                 if (fd != -1) close( fd );
+                completion_close_handle( source );
             }
         }
     }
@@ -390,6 +391,7 @@ NTSTATUS close_handle( HANDLE handle )
 
     if (do_esync())
         esync_close( handle );
+    completion_close_handle( handle );
 
     SERVER_START_REQ( close_handle )
     {
@@ -479,7 +479,13 @@ NTSTATUS WINAPI NtQueryInformationProcess(
                 ret = STATUS_INVALID_HANDLE;
             else
             {
-                memset(ProcessInformation, 0, 4);
+                SERVER_START_REQ(get_process_handle_count)
+                {
+                    req->handle = wine_server_obj_handle( ProcessHandle );
+                    if ((ret = wine_server_call( req )) == STATUS_SUCCESS)
+                        *(ULONG *)ProcessInformation = reply->count;
+                }
+                SERVER_END_REQ;
                 len = 4;
             }
 
@@ -829,7 +829,8 @@ union fd_cache_entry
     struct
     {
         int fd;
-        enum server_fd_type type : 5;
+        enum server_fd_type type : 4;
+        unsigned int        skip_completion : 1;
         unsigned int        access : 3;
         unsigned int        options : 24;
     } s;
@@ -843,6 +844,10 @@ C_ASSERT( sizeof(union fd_cache_entry) == sizeof(LONG64) );
 static union fd_cache_entry *fd_cache[FD_CACHE_ENTRIES];
 static union fd_cache_entry fd_cache_initial_block[FD_CACHE_BLOCK_SIZE];
 
+/* number of times each cache entry has been removed, i.e. its handle closed */
+static LONG *fd_cache_generation[FD_CACHE_ENTRIES];
+static LONG fd_cache_initial_generation[FD_CACHE_BLOCK_SIZE];
+
 static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
 {
     unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
@@ -851,13 +856,31 @@ static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
 }
 
 
+/***********************************************************************
+ *           fd_cache_load
+ *
+ * Atomically read a cache entry without taking fd_cache_section.
+ * Aligned 64-bit loads are atomic on 64-bit platforms, so a plain load
+ * avoids the locked compare-exchange that would otherwise make
+ * concurrent lookups fight over the cache line.
+ */
+static inline LONG64 fd_cache_load( union fd_cache_entry *cache )
+{
+#ifdef _WIN64
+    return *(volatile LONG64 *)&cache->data;
+#else
+    return interlocked_cmpxchg64( &cache->data, 0, 0 );
+#endif
+}
+
+
 /***********************************************************************
  *           add_fd_to_cache
  *
  * Caller must hold fd_cache_section.
  */
 static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
-                            unsigned int access, unsigned int options )
+                            unsigned int access, unsigned int options, unsigned int comp_flags )
 {
     unsigned int entry, idx = handle_to_index( handle, &entry );
     union fd_cache_entry cache;
@@ -870,11 +893,24 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
 
     if (!fd_cache[entry])  /* do we need to allocate a new block of entries? */
     {
-        if (!entry) fd_cache[0] = fd_cache_initial_block;
+        /* the generations are allocated first, they are valid for any allocated block */
+        if (!entry)
+        {
+            fd_cache_generation[0] = fd_cache_initial_generation;
+            fd_cache[0] = fd_cache_initial_block;
+        }
         else
         {
-            void *ptr = wine_anon_mmap( NULL, FD_CACHE_BLOCK_SIZE * sizeof(union fd_cache_entry),
-                                        PROT_READ | PROT_WRITE, 0 );
+            void *ptr;
+
+            if (!fd_cache_generation[entry])
+            {
+                ptr = wine_anon_mmap( NULL, FD_CACHE_BLOCK_SIZE * sizeof(LONG), PROT_READ | PROT_WRITE, 0 );
+                if (ptr == MAP_FAILED) return FALSE;
+                fd_cache_generation[entry] = ptr;
+            }
+            ptr = wine_anon_mmap( NULL, FD_CACHE_BLOCK_SIZE * sizeof(union fd_cache_entry),
+                                  PROT_READ | PROT_WRITE, 0 );
             if (ptr == MAP_FAILED) return FALSE;
             fd_cache[entry] = ptr;
         }
@@ -885,6 +921,7 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
     cache.s.type = type;
     cache.s.access = access;
     cache.s.options = options;
+    cache.s.skip_completion = !!(comp_flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS);
     cache.data = interlocked_xchg64( &fd_cache[entry][idx].data, cache.data );
     assert( !cache.s.fd );
     return TRUE;
@@ -893,6 +930,9 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
 
 /***********************************************************************
  *           get_cached_fd
+ *
+ * Lock-free lookup; entries are only ever replaced as a whole 64-bit word,
+ * so a hit never observes a half-written entry.
  */
 static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_type *type,
                                       unsigned int *access, unsigned int *options )
@@ -902,7 +942,7 @@ static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_typ
 
     if (entry >= FD_CACHE_ENTRIES || !fd_cache[entry]) return STATUS_INVALID_HANDLE;
 
-    cache.data = interlocked_cmpxchg64( &fd_cache[entry][idx].data, 0, 0 );
+    cache.data = fd_cache_load( &fd_cache[entry][idx] );
     if (!cache.data) return STATUS_INVALID_HANDLE;
 
     /* if fd type is invalid, fd stores an error value */
@@ -911,11 +951,39 @@ static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_typ
     *fd = cache.s.fd - 1;
     if (type) *type = cache.s.type;
     if (access) *access = cache.s.access;
-    if (options) *options = cache.s.options;
+    if (options)
+    {
+        *options = cache.s.options;
+        if (cache.s.skip_completion) *options |= FILE_WINE_SKIP_COMPLETION_PORT_ON_SUCCESS;
+    }
     return STATUS_SUCCESS;
 }
 
 
+/***********************************************************************
+ *           server_set_fd_completion_flags
+ *
+ * Update the cached fd after the completion flags of a handle have been set.
+ * Completion flags can't be removed, so the entry can be updated in place.
+ */
+void server_set_fd_completion_flags( HANDLE handle, unsigned int flags )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union fd_cache_entry cache, new_cache;
+
+    if (!(flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS)) return;
+    if (entry >= FD_CACHE_ENTRIES || !fd_cache[entry]) return;
+
+    do
+    {
+        cache.data = fd_cache_load( &fd_cache[entry][idx] );
+        if (!cache.data || cache.s.type == FD_TYPE_INVALID || cache.s.skip_completion) return;
+        new_cache.data = cache.data;
+        new_cache.s.skip_completion = 1;
+    } while (interlocked_cmpxchg64( &fd_cache[entry][idx].data, new_cache.data, cache.data ) != cache.data);
+}
+
+
 /***********************************************************************
  *           server_remove_fd_from_cache
  */
@@ -929,6 +997,7 @@ int server_remove_fd_from_cache( HANDLE handle )
         union fd_cache_entry cache;
         cache.data = interlocked_xchg64( &fd_cache[entry][idx].data, 0 );
         if (cache.s.type != FD_TYPE_INVALID) fd = cache.s.fd - 1;
+        interlocked_xchg_add( &fd_cache_generation[entry][idx], 1 );
     }
 
     return fd;
@@ -965,20 +1034,25 @@ int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
             if (!(ret = wine_server_call( req )))
             {
                 if (type) *type = reply->type;
-                if (options) *options = reply->options;
+                if (options)
+                {
+                    *options = reply->options;
+                    if (reply->comp_flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS)
+                        *options |= FILE_WINE_SKIP_COMPLETION_PORT_ON_SUCCESS;
+                }
                 access = reply->access;
                 if ((fd = receive_fd( &fd_handle )) != -1)
                 {
                     assert( wine_server_ptr_handle(fd_handle) == handle );
                     *needs_close = (!reply->cacheable ||
-                                    !add_fd_to_cache( handle, fd, reply->type,
-                                                      reply->access, reply->options ));
+                                    !add_fd_to_cache( handle, fd, reply->type, reply->access,
+                                                      reply->options, reply->comp_flags ));
                 }
                 else ret = STATUS_TOO_MANY_OPENED_FILES;
             }
             else if (reply->cacheable)
             {
-                add_fd_to_cache( handle, ret, FD_TYPE_INVALID, 0, 0 );
+                add_fd_to_cache( handle, ret, FD_TYPE_INVALID, 0, 0, 0 );
             }
         }
         SERVER_END_REQ;
@@ -1137,6 +1211,27 @@ int CDECL wine_server_handle_to_fd( HANDLE handle, unsigned int access, int *uni
 }
 
 
+/***********************************************************************
+ *           wine_server_handle_generation   (NTDLL.@)
+ *
+ * Retrieve a counter that changes whenever the handle is closed, so that
+ * callers can tell that a unix fd they kept for it is stale.
+ *
+ * PARAMS
+ *     handle  [I] Wine file handle.
+ *
+ * RETURNS
+ *     The close generation of the handle value.
+ */
+unsigned int CDECL wine_server_handle_generation( HANDLE handle )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+
+    if (entry >= FD_CACHE_ENTRIES || !fd_cache_generation[entry]) return 0;
+    return *(volatile LONG *)&fd_cache_generation[entry][idx];
+}
+
+
 /***********************************************************************
  *           wine_server_release_fd   (NTDLL.@)
  *
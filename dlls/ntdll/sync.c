@@ -34,6 +34,9 @@
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #ifdef HAVE_POLL_H
 #include <poll.h>
 #endif
@@ -59,6 +62,7 @@
 #include "winternl.h"
 #include "wine/server.h"
 #include "wine/debug.h"
+#include "wine/library.h"
 
 #include "ntdll_misc.h"
 #include "esync.h"
@@ -1324,6 +1328,397 @@ NTSTATUS WINAPI NtReleaseKeyedEvent( HANDLE handle, const void *key,
     return server_select( &select_op, sizeof(select_op.keyed_event), flags, timeout );
 }
 
+/* Shared memory completion rings.
+ *
+ * The server hands out a ring buffer for each completion port, which lets
+ * threads of all processes using the port add and remove messages without
+ * a server round trip. Messages only go through the server while it still
+ * holds queued messages which didn't fit into the ring, or when threads
+ * are waiting for the port in the server (e.g. alertable waits). The ring
+ * mappings are cached per handle, the cache entries are reference counted
+ * so that closing a handle never unmaps a ring still in use by another
+ * thread. Entries record the id of the thread adding them, so that the
+ * server can release the ones claimed by threads that die before
+ * publishing them. */
+
+#ifdef __linux__
+
+struct completion_cache
+{
+    int               state;    /* COMPLETION_CACHE_* flags and reference count */
+    completion_shm_t *shm;      /* mapped ring, NULL if not supported */
+};
+
+#define COMPLETION_CACHE_VALID  0x40000000  /* shm is initialized */
+#define COMPLETION_CACHE_INIT   0x20000000  /* shm is being requested from the server */
+#define COMPLETION_CACHE_CLOSED 0x10000000  /* handle was closed, unmap with the last reference */
+#define COMPLETION_CACHE_REFS   0x0fffffff
+
+#define COMPLETION_CACHE_BLOCK_SIZE  (65536 / sizeof(struct completion_cache))
+#define COMPLETION_CACHE_ENTRIES     256
+
+static struct completion_cache *completion_cache[COMPLETION_CACHE_ENTRIES];
+static struct completion_cache completion_cache_initial_block[COMPLETION_CACHE_BLOCK_SIZE];
+
+static inline UINT_PTR completion_handle_to_index( HANDLE handle, UINT_PTR *entry )
+{
+    UINT_PTR idx = (((UINT_PTR)handle) >> 2) - 1;
+    *entry = idx / COMPLETION_CACHE_BLOCK_SIZE;
+    return idx % COMPLETION_CACHE_BLOCK_SIZE;
+}
+
+static struct completion_cache *get_completion_cache( HANDLE handle, BOOL alloc )
+{
+    UINT_PTR entry, idx = completion_handle_to_index( handle, &entry );
+
+    if (entry >= COMPLETION_CACHE_ENTRIES) return NULL;
+
+    if (!completion_cache[entry])  /* do we need to allocate a new block of entries? */
+    {
+        if (!alloc) return NULL;
+        if (!entry) completion_cache[0] = completion_cache_initial_block;
+        else
+        {
+            void *ptr = wine_anon_mmap( NULL, COMPLETION_CACHE_BLOCK_SIZE * sizeof(struct completion_cache),
+                                        PROT_READ | PROT_WRITE, 0 );
+            if (ptr == MAP_FAILED) return NULL;
+            if (interlocked_cmpxchg_ptr( (void **)&completion_cache[entry], ptr, NULL ))
+                munmap( ptr, COMPLETION_CACHE_BLOCK_SIZE * sizeof(struct completion_cache) );
+        }
+    }
+    return &completion_cache[entry][idx];
+}
+
+/* drop a reference, unmapping the ring if the handle was closed in the meantime */
+static void release_completion_cache( struct completion_cache *cache )
+{
+    int state = interlocked_xchg_add( &cache->state, -1 ) - 1;
+
+    if ((state & COMPLETION_CACHE_CLOSED) && !(state & COMPLETION_CACHE_REFS))
+    {
+        if (cache->shm) munmap( cache->shm, sizeof(*cache->shm) );
+        cache->shm = NULL;
+        interlocked_xchg( &cache->state, 0 );
+    }
+}
+
+/* called when a handle is closed, the ring is unmapped once the last user is done with it */
+void completion_close_handle( HANDLE handle )
+{
+    struct completion_cache *cache;
+    int state, tmp;
+
+    if (!(cache = get_completion_cache( handle, FALSE ))) return;
+
+    for (state = cache->state;; state = tmp)
+    {
+        if (!state || (state & COMPLETION_CACHE_CLOSED)) return;
+        if ((tmp = interlocked_cmpxchg( &cache->state, state | COMPLETION_CACHE_CLOSED, state )) == state)
+            break;
+    }
+    if (!(state & COMPLETION_CACHE_REFS))
+    {
+        if (cache->shm) munmap( cache->shm, sizeof(*cache->shm) );
+        cache->shm = NULL;
+        interlocked_xchg( &cache->state, 0 );
+    }
+}
+
+static completion_shm_t *map_completion_shm( HANDLE handle, NTSTATUS *ret )
+{
+    completion_shm_t *shm = NULL;
+    obj_handle_t dummy;
+    sigset_t sigset;
+    int fd = -1;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+
+    SERVER_START_REQ( get_completion_shm )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        if (!(*ret = wine_server_call( req )))
+        {
+            fd = receive_fd( &dummy );
+            if (fd == -1) *ret = STATUS_NOT_SUPPORTED;
+        }
+    }
+    SERVER_END_REQ;
+
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+
+    if (fd == -1) return NULL;
+    shm = mmap( NULL, sizeof(*shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if (shm == MAP_FAILED)
+    {
+        *ret = STATUS_NOT_SUPPORTED;
+        return NULL;
+    }
+    return shm;
+}
+
+/* get a referenced ring for a completion port handle, NULL to use the server */
+static completion_shm_t *acquire_completion_shm( HANDLE handle, struct completion_cache **ret_cache )
+{
+    struct completion_cache *cache;
+    completion_shm_t *shm;
+    NTSTATUS ret;
+    int state, tmp;
+
+    if (!(cache = get_completion_cache( handle, TRUE ))) return NULL;
+
+    for (state = cache->state;; state = tmp)
+    {
+        if (!(state & COMPLETION_CACHE_VALID) || (state & COMPLETION_CACHE_CLOSED)) break;
+        if ((tmp = interlocked_cmpxchg( &cache->state, state + 1, state )) == state)
+        {
+            if (!cache->shm)
+            {
+                release_completion_cache( cache );
+                return NULL;
+            }
+            *ret_cache = cache;
+            return cache->shm;
+        }
+    }
+    if (state) return NULL;  /* being set up or torn down by another thread */
+
+    if (interlocked_cmpxchg( &cache->state, COMPLETION_CACHE_INIT | 1, 0 )) return NULL;
+
+    shm = map_completion_shm( handle, &ret );
+    if (!shm && ret != STATUS_NOT_SUPPORTED)
+    {
+        /* most likely not a completion port, don't cache anything */
+        interlocked_xchg( &cache->state, 0 );
+        return NULL;
+    }
+    cache->shm = shm;
+
+    /* if the handle was closed meanwhile, the last reference unmaps the ring */
+    if (interlocked_cmpxchg( &cache->state, COMPLETION_CACHE_VALID | 1, COMPLETION_CACHE_INIT | 1 ) !=
+        (COMPLETION_CACHE_INIT | 1) || !shm)
+    {
+        release_completion_cache( cache );
+        return NULL;
+    }
+    *ret_cache = cache;
+    return shm;
+}
+
+static inline unsigned int shm_read( const unsigned int *ptr )
+{
+    return *(const volatile unsigned int *)ptr;
+}
+
+/* the futex lives in shared memory, so the non-private operations are required */
+static inline int shared_futex_wait( unsigned int *addr, unsigned int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, 0 /* FUTEX_WAIT */, val, timeout, 0, 0 );
+}
+
+static inline int shared_futex_wake( unsigned int *addr, int val )
+{
+    return syscall( __NR_futex, addr, 1 /* FUTEX_WAKE */, val, NULL, 0, 0 );
+}
+
+/* tell the server which ring the thread is changing, so that it only has
+ * to look for entries left behind in that ring if the thread dies */
+static inline void set_completion_ring( completion_shm_t *shm )
+{
+    shmlocal_t *shmlocal = NtCurrentTeb()->Reserved5[2];
+
+    if (shmlocal) *(volatile unsigned int *)&shmlocal->completion_ring = shm ? shm->id : 0;
+}
+
+/* claim the entry for the tail position pos; the owner id lets the server
+ * recover entries claimed by threads that die before publishing them */
+static BOOL completion_shm_claim( completion_shm_t *shm, completion_shm_entry_t *entry,
+                                  unsigned int pos, unsigned int owner )
+{
+    if (interlocked_cmpxchg( (int *)&entry->owner, owner, 0 )) return FALSE;
+    if (shm_read( &shm->tail ) == pos && shm_read( &entry->seq ) == pos &&
+        interlocked_cmpxchg( (int *)&shm->tail, pos + 1, pos ) == pos)
+        return TRUE;
+    interlocked_xchg( (int *)&entry->owner, 0 );
+    return FALSE;
+}
+
+static BOOL completion_shm_add( completion_shm_t *shm, ULONG_PTR key, ULONG_PTR value,
+                                NTSTATUS status, SIZE_T information )
+{
+    unsigned int owner = GetCurrentThreadId();
+    completion_shm_entry_t *entry;
+    unsigned int pos, seq;
+    BOOL ret = FALSE;
+
+    set_completion_ring( shm );
+    for (;;)
+    {
+        pos = shm_read( &shm->tail );
+        entry = &shm->entries[pos % COMPLETION_SHM_ENTRIES];
+        seq = shm_read( &entry->seq );
+        if ((int)(seq - pos) < 0) goto done;
+        if (seq != pos) continue;
+        if (completion_shm_claim( shm, entry, pos, owner )) break;
+    }
+    entry->ckey        = key;
+    entry->cvalue      = value;
+    entry->status      = status;
+    entry->information = information;
+    interlocked_xchg( (int *)&entry->seq, pos + 1 );
+    ret = TRUE;
+done:
+    set_completion_ring( NULL );
+    return ret;
+}
+
+static BOOL completion_shm_remove( completion_shm_t *shm, FILE_IO_COMPLETION_INFORMATION *info )
+{
+    unsigned int consumer = GetCurrentThreadId();
+    completion_shm_entry_t *entry;
+    unsigned int pos, seq;
+    BOOL abandoned, ret = FALSE;
+
+    set_completion_ring( shm );
+    for (;;)
+    {
+        pos = shm_read( &shm->head );
+        entry = &shm->entries[pos % COMPLETION_SHM_ENTRIES];
+        seq = shm_read( &entry->seq );
+        if ((int)(seq - (pos + 1)) < 0) break;
+        if (seq != pos + 1) continue;
+        /* the consumer id lets the server finish the removal if the thread dies */
+        if (interlocked_cmpxchg( (int *)&entry->consumer, consumer, 0 )) continue;
+        if (interlocked_cmpxchg( (int *)&shm->head, pos + 1, pos ) != pos)
+        {
+            interlocked_xchg( (int *)&entry->consumer, 0 );
+            continue;
+        }
+
+        info->CompletionKey             = entry->ckey;
+        info->CompletionValue           = entry->cvalue;
+        info->IoStatusBlock.Information = entry->information;
+        info->IoStatusBlock.u.Status    = entry->status;
+        /* entries of threads that died while adding them are published by the server to be skipped */
+        abandoned = (entry->owner == COMPLETION_SHM_OWNER_ABANDONED);
+        interlocked_xchg( (int *)&entry->owner, 0 );
+        interlocked_xchg( (int *)&entry->seq, pos + COMPLETION_SHM_ENTRIES );
+        interlocked_xchg( (int *)&entry->consumer, 0 );
+        if (abandoned) continue;
+        ret = TRUE;
+        break;
+    }
+    set_completion_ring( NULL );
+    return ret;
+}
+
+static NTSTATUS fast_set_completion( HANDLE port, ULONG_PTR key, ULONG_PTR value,
+                                     NTSTATUS status, SIZE_T information )
+{
+    struct completion_cache *cache;
+    completion_shm_t *shm;
+    NTSTATUS ret = STATUS_NOT_IMPLEMENTED;
+
+    if (!use_futexes() || !(shm = acquire_completion_shm( port, &cache )))
+        return STATUS_NOT_IMPLEMENTED;
+
+    /* keep messages ordered behind the ones queued in the server */
+    if (!shm_read( &shm->overflow ) && completion_shm_add( shm, key, value, status, information ))
+    {
+        interlocked_xchg_add( (int *)&shm->signal, 1 );
+        if (shm_read( &shm->waiters )) shared_futex_wake( &shm->signal, 1 );
+        if (shm_read( &shm->server_waiters ))
+        {
+            SERVER_START_REQ( wake_completion )
+            {
+                req->handle = wine_server_obj_handle( port );
+                wine_server_call( req );
+            }
+            SERVER_END_REQ;
+        }
+        ret = STATUS_SUCCESS;
+    }
+
+    release_completion_cache( cache );
+    return ret;
+}
+
+static NTSTATUS fast_remove_completion( HANDLE port, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
+                                        ULONG *written, const LARGE_INTEGER *timeout )
+{
+    struct completion_cache *cache;
+    completion_shm_t *shm;
+    LARGE_INTEGER now;
+    struct timespec timespec;
+    NTSTATUS ret = STATUS_NOT_IMPLEMENTED;
+    unsigned int signal;
+    ULONG i = 0;
+
+    if (!use_futexes() || !(shm = acquire_completion_shm( port, &cache )))
+        return STATUS_NOT_IMPLEMENTED;
+
+    for (;;)
+    {
+        signal = shm_read( &shm->signal );
+        while (i < count && completion_shm_remove( shm, &info[i] )) i++;
+        if (i)
+        {
+            ret = STATUS_SUCCESS;
+            break;
+        }
+        /* messages which didn't fit into the ring have to be fetched from the server */
+        if (shm_read( &shm->overflow )) break;
+
+        if (timeout)
+        {
+            if (timeout->QuadPart) NtQuerySystemTime( &now );
+            if (!timeout->QuadPart || now.QuadPart >= timeout->QuadPart)
+            {
+                ret = STATUS_TIMEOUT;
+                break;
+            }
+            timespec_from_timeout( &timespec, timeout );
+        }
+
+        interlocked_xchg_add( (int *)&shm->waiters, 1 );
+        shared_futex_wait( &shm->signal, signal, timeout ? &timespec : NULL );
+        interlocked_xchg_add( (int *)&shm->waiters, -1 );
+    }
+
+    release_completion_cache( cache );
+    *written = i;
+    return ret;
+}
+
+#else
+
+void completion_close_handle( HANDLE handle )
+{
+}
+
+static NTSTATUS fast_set_completion( HANDLE port, ULONG_PTR key, ULONG_PTR value,
+                                     NTSTATUS status, SIZE_T information )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_remove_completion( HANDLE port, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
+                                        ULONG *written, const LARGE_INTEGER *timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif
+
+/* turn a relative timeout into an absolute one, so that retrying a wait doesn't restart it */
+static LARGE_INTEGER *get_completion_deadline( LARGE_INTEGER *timeout, LARGE_INTEGER *end )
+{
+    if (!timeout || timeout->QuadPart >= 0) return timeout;
+    NtQuerySystemTime( end );
+    end->QuadPart -= timeout->QuadPart;
+    return end;
+}
+
 /******************************************************************
  *              NtCreateIoCompletion (NTDLL.@)
  *              ZwCreateIoCompletion (NTDLL.@)
@@ -1387,6 +1782,10 @@ NTSTATUS WINAPI NtSetIoCompletion( HANDLE CompletionPort, ULONG_PTR CompletionKe
     TRACE("(%p, %lx, %lx, %x, %lx)\n", CompletionPort, CompletionKey,
           CompletionValue, Status, NumberOfBytesTransferred);
 
+    if ((status = fast_set_completion( CompletionPort, CompletionKey, CompletionValue,
+                                       Status, NumberOfBytesTransferred )) != STATUS_NOT_IMPLEMENTED)
+        return status;
+
     SERVER_START_REQ( add_completion )
     {
         req->handle      = wine_server_obj_handle( CompletionPort );
@@ -1418,11 +1817,28 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE CompletionPort, PULONG_PTR Completi
                                       PULONG_PTR CompletionValue, PIO_STATUS_BLOCK iosb,
                                       PLARGE_INTEGER WaitTime )
 {
+    FILE_IO_COMPLETION_INFORMATION info;
+    LARGE_INTEGER end;
     NTSTATUS status;
+    ULONG count;
 
     TRACE("(%p, %p, %p, %p, %p)\n", CompletionPort, CompletionKey,
           CompletionValue, iosb, WaitTime);
 
+    /* the time spent on the shared ring counts when falling back to the server */
+    WaitTime = get_completion_deadline( WaitTime, &end );
+
+    if ((status = fast_remove_completion( CompletionPort, &info, 1, &count, WaitTime )) != STATUS_NOT_IMPLEMENTED)
+    {
+        if (status == STATUS_SUCCESS)
+        {
+            *CompletionKey   = info.CompletionKey;
+            *CompletionValue = info.CompletionValue;
+            *iosb            = info.IoStatusBlock;
+        }
+        return status;
+    }
+
     for(;;)
     {
         SERVER_START_REQ( remove_completion )
@@ -1452,11 +1868,23 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE CompletionPort, PULONG_PTR Completi
 NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE port, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
                                         ULONG *written, LARGE_INTEGER *timeout, BOOLEAN alertable )
 {
+    LARGE_INTEGER end;
     NTSTATUS ret;
     ULONG i = 0;
 
     TRACE("%p %p %u %p %p %u\n", port, info, count, written, timeout, alertable);
 
+    /* the time spent on the shared ring counts when falling back to the server */
+    timeout = get_completion_deadline( timeout, &end );
+
+    /* alertable waits need the server to deliver user APCs */
+    if (!alertable && (ret = fast_remove_completion( port, info, count, &i, timeout )) != STATUS_NOT_IMPLEMENTED)
+    {
+        *written = i ? i : 1;
+        return ret;
+    }
+    i = 0;
+
     for (;;)
     {
         while (i < count)
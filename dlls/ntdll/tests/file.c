@@ -757,6 +757,60 @@ static void read_file_test(void)
     CloseHandle(event);
 }
 
+#define READ_THREADS_COUNT 4
+#define READ_THREADS_LOOPS 2000
+
+static DWORD WINAPI read_thread( void *arg )
+{
+    HANDLE handle = arg;
+    IO_STATUS_BLOCK iosb;
+    LARGE_INTEGER offset;
+    NTSTATUS status;
+    unsigned char buffer[4];
+    int i, failures = 0;
+
+    for (i = 0; i < READ_THREADS_LOOPS; i++)
+    {
+        offset.QuadPart = i % 256;
+        status = pNtReadFile( handle, NULL, NULL, NULL, &iosb, buffer, 1, &offset, NULL );
+        if (status || iosb.Information != 1 || buffer[0] != (unsigned char)offset.QuadPart) failures++;
+    }
+    return failures;
+}
+
+static void read_threads_test(void)
+{
+    HANDLE handle, threads[READ_THREADS_COUNT];
+    unsigned char data[256];
+    IO_STATUS_BLOCK iosb;
+    LARGE_INTEGER offset;
+    NTSTATUS status;
+    DWORD ret, start;
+    int i;
+
+    if (!(handle = create_temp_file( 0 ))) return;
+
+    for (i = 0; i < sizeof(data); i++) data[i] = i;
+    offset.QuadPart = 0;
+    status = pNtWriteFile( handle, NULL, NULL, NULL, &iosb, data, sizeof(data), &offset, NULL );
+    ok( status == STATUS_SUCCESS, "NtWriteFile failed: %x\n", status );
+
+    start = GetTickCount();
+    for (i = 0; i < READ_THREADS_COUNT; i++)
+        threads[i] = CreateThread( NULL, 0, read_thread, handle, 0, NULL );
+    for (i = 0; i < READ_THREADS_COUNT; i++)
+    {
+        ok( !WaitForSingleObject( threads[i], 30000 ), "thread %u did not finish\n", i );
+        GetExitCodeThread( threads[i], &ret );
+        ok( !ret, "thread %u: %u reads failed\n", i, ret );
+        CloseHandle( threads[i] );
+    }
+    trace( "%u threads x %u reads took %u ms\n", READ_THREADS_COUNT, READ_THREADS_LOOPS,
+           GetTickCount() - start );
+
+    CloseHandle( handle );
+}
+
 static void append_file_test(void)
 {
     static const char text[6] = "foobar";
@@ -1054,6 +1108,101 @@ static void test_set_io_completion(void)
     pNtClose( h );
 }
 
+#define COMPLETION_THREADS_LOOPS 20000
+
+struct completion_thread_data
+{
+    HANDLE port;
+    LONG   received;
+    BOOL   ordered;
+};
+
+static DWORD WINAPI completion_thread( void *arg )
+{
+    struct completion_thread_data *data = arg;
+    FILE_IO_COMPLETION_INFORMATION info[8];
+    LARGE_INTEGER timeout;
+    ULONG i, count, done, last = 0;
+    NTSTATUS res;
+
+    timeout.QuadPart = -30000 * 10000;
+    for (;;)
+    {
+        if (pNtRemoveIoCompletionEx)
+            res = pNtRemoveIoCompletionEx( data->port, info, ARRAY_SIZE(info), &count, &timeout, FALSE );
+        else
+        {
+            count = 1;
+            res = pNtRemoveIoCompletion( data->port, &info[0].CompletionKey, &info[0].CompletionValue,
+                                         &info[0].IoStatusBlock, &timeout );
+        }
+        if (res) return res;
+
+        for (i = done = 0; i < count; i++)
+        {
+            if (!info[i].CompletionKey)
+            {
+                done++;
+                continue;
+            }
+            if (info[i].CompletionValue != last + 1) data->ordered = FALSE;
+            last = info[i].CompletionValue;
+            InterlockedIncrement( &data->received );
+        }
+        if (!done) continue;
+
+        /* hand the terminators meant for other threads back to the port */
+        while (--done) pNtSetIoCompletion( data->port, 0, 0, STATUS_SUCCESS, 0 );
+        return 0;
+    }
+}
+
+static void test_completion_threads(void)
+{
+    static const unsigned int thread_counts[] = {1, 4, 16};
+    struct completion_thread_data data;
+    HANDLE threads[16];
+    DWORD ret, start;
+    unsigned int i, j, count;
+    NTSTATUS res;
+
+    for (i = 0; i < ARRAY_SIZE(thread_counts); i++)
+    {
+        count = thread_counts[i];
+        res = pNtCreateIoCompletion( &data.port, IO_COMPLETION_ALL_ACCESS, NULL, 0 );
+        ok( res == STATUS_SUCCESS, "NtCreateIoCompletion failed: %#x\n", res );
+        data.received = 0;
+        data.ordered = TRUE;
+
+        start = GetTickCount();
+        for (j = 0; j < count; j++)
+            threads[j] = CreateThread( NULL, 0, completion_thread, &data, 0, NULL );
+        for (j = 0; j < COMPLETION_THREADS_LOOPS; j++)
+        {
+            res = pNtSetIoCompletion( data.port, 1, j + 1, STATUS_SUCCESS, j );
+            if (res) break;
+        }
+        ok( res == STATUS_SUCCESS, "NtSetIoCompletion failed: %#x\n", res );
+        for (j = 0; j < count; j++)
+            pNtSetIoCompletion( data.port, 0, 0, STATUS_SUCCESS, 0 );
+
+        for (j = 0; j < count; j++)
+        {
+            ok( !WaitForSingleObject( threads[j], 30000 ), "thread %u did not finish\n", j );
+            GetExitCodeThread( threads[j], &ret );
+            ok( !ret, "thread %u failed: %#x\n", j, ret );
+            CloseHandle( threads[j] );
+        }
+        trace( "%u threads x %u completions took %u ms\n", count, COMPLETION_THREADS_LOOPS,
+               GetTickCount() - start );
+
+        ok( data.received == COMPLETION_THREADS_LOOPS, "got %d completions\n", data.received );
+        if (count == 1) ok( data.ordered, "completions were not received in order\n" );
+        ok( !get_pending_msgs( data.port ), "port is not empty\n" );
+        pNtClose( data.port );
+    }
+}
+
 static void test_file_io_completion(void)
 {
     static const char pipe_name[] = "\\\\.\\pipe\\iocompletiontestnamedpipe";
@@ -4812,9 +4961,11 @@ START_TEST(file)
     open_file_test();
     delete_file_test();
     read_file_test();
+    read_threads_test();
     append_file_test();
     nt_mailslot_test();
     test_set_io_completion();
+    test_completion_threads();
     test_file_io_completion();
     test_file_basic_information();
     test_file_all_information();
@@ -1474,10 +1474,7 @@ static void test_query_process_handlecount(void)
 
     /* Check if we have some return values */
     trace("HandleCount : %d\n", handlecount);
-    todo_wine
-    {
-        ok( handlecount > 0, "Expected some handles, got 0\n");
-    }
+    ok( handlecount > 0, "Expected some handles, got 0\n");
 }
 
 static void test_query_process_image_file_name(void)
@@ -1203,6 +1203,148 @@ static void test_transceive(void)
     CloseHandle( callee );
 }
 
+struct flush_reader
+{
+    HANDLE pipe;
+    char data[16];
+    DWORD size;
+};
+
+static DWORD WINAPI flush_reader_thread(void *arg)
+{
+    struct flush_reader *reader = arg;
+    DWORD count;
+    BOOL ret;
+
+    Sleep(100);
+    reader->size = 0;
+    while (reader->size < sizeof(reader->data))
+    {
+        ret = ReadFile(reader->pipe, reader->data + reader->size, 4, &count, NULL);
+        ok(ret && count, "ReadFile error %u\n", GetLastError());
+        if (!ret || !count) break;
+        reader->size += count;
+        Sleep(10);
+    }
+    return 0;
+}
+
+/* Wine moves the data of byte-mode pipes through a socketpair when the wineserver
+ * runs with WINEDIRECTPIPES=1; these tests must pass with and without it */
+static void test_direct_pipes(ULONG pipe_type)
+{
+    BYTE peek_buf[FIELD_OFFSET(FILE_PIPE_PEEK_BUFFER, Data[16])];
+    FILE_PIPE_PEEK_BUFFER *peek = (FILE_PIPE_PEEK_BUFFER *)peek_buf;
+    struct flush_reader reader;
+    IO_STATUS_BLOCK iosb;
+    HANDLE server, client, thread;
+    char buffer[16];
+    DWORD count;
+    NTSTATUS status;
+    BOOL ret;
+
+    trace("WINEDIRECTPIPES is %s\n", getenv("WINEDIRECTPIPES") ? getenv("WINEDIRECTPIPES") : "unset");
+
+    if (!create_pipe_pair( &server, &client, PIPE_ACCESS_DUPLEX, pipe_type, 4096 )) return;
+
+    /* read and write */
+    ret = WriteFile( client, "abc", 3, &count, NULL );
+    ok( ret && count == 3, "WriteFile error %u\n", GetLastError() );
+    ret = WriteFile( client, "defgh", 5, &count, NULL );
+    ok( ret && count == 5, "WriteFile error %u\n", GetLastError() );
+
+    /* peek returns no more than what is available */
+    memset( peek_buf, 0xcc, sizeof(peek_buf) );
+    status = NtFsControlFile( server, NULL, NULL, NULL, &iosb, FSCTL_PIPE_PEEK, NULL, 0,
+                              peek_buf, sizeof(peek_buf) );
+    ok( status == STATUS_SUCCESS, "FSCTL_PIPE_PEEK returned %x\n", status );
+    ok( peek->ReadDataAvailable == 8, "ReadDataAvailable = %u\n", peek->ReadDataAvailable );
+    if (pipe_type & PIPE_READMODE_MESSAGE)
+    {
+        ok( peek->MessageLength == 3, "MessageLength = %u\n", peek->MessageLength );
+        ok( iosb.Information == FIELD_OFFSET(FILE_PIPE_PEEK_BUFFER, Data[3]),
+            "Information = %lu\n", iosb.Information );
+        ok( !memcmp( peek->Data, "abc", 3 ), "wrong data\n" );
+    }
+    else
+    {
+        ok( iosb.Information == FIELD_OFFSET(FILE_PIPE_PEEK_BUFFER, Data[8]),
+            "Information = %lu\n", iosb.Information );
+        ok( !memcmp( peek->Data, "abcdefgh", 8 ), "wrong data\n" );
+    }
+
+    if (pipe_type & PIPE_READMODE_MESSAGE)
+    {
+        ret = ReadFile( server, buffer, 2, &count, NULL );
+        ok( !ret && GetLastError() == ERROR_MORE_DATA, "ReadFile returned %x %u\n", ret, GetLastError() );
+        ok( count == 2, "count = %u\n", count );
+        ret = ReadFile( server, buffer + 2, sizeof(buffer) - 2, &count, NULL );
+        ok( ret && count == 1, "ReadFile returned %x %u count %u\n", ret, GetLastError(), count );
+        ret = ReadFile( server, buffer + 3, sizeof(buffer) - 3, &count, NULL );
+        ok( ret && count == 5, "ReadFile returned %x %u count %u\n", ret, GetLastError(), count );
+    }
+    else
+    {
+        ret = ReadFile( server, buffer, 2, &count, NULL );
+        ok( ret && count == 2, "ReadFile returned %x %u count %u\n", ret, GetLastError(), count );
+        ret = ReadFile( server, buffer + 2, sizeof(buffer) - 2, &count, NULL );
+        ok( ret && count == 6, "ReadFile returned %x %u count %u\n", ret, GetLastError(), count );
+    }
+    ok( !memcmp( buffer, "abcdefgh", 8 ), "wrong data\n" );
+
+    status = NtFsControlFile( server, NULL, NULL, NULL, &iosb, FSCTL_PIPE_PEEK, NULL, 0,
+                              peek_buf, sizeof(peek_buf) );
+    ok( status == STATUS_SUCCESS, "FSCTL_PIPE_PEEK returned %x\n", status );
+    ok( !peek->ReadDataAvailable, "ReadDataAvailable = %u\n", peek->ReadDataAvailable );
+    ok( iosb.Information == FIELD_OFFSET(FILE_PIPE_PEEK_BUFFER, Data), "Information = %lu\n", iosb.Information );
+
+    /* flush waits for the reader to take all the data */
+    ret = WriteFile( server, "0123456789abcdef", 16, &count, NULL );
+    ok( ret && count == 16, "WriteFile error %u\n", GetLastError() );
+    reader.pipe = client;
+    reader.size = ~0u;
+    thread = CreateThread( NULL, 0, flush_reader_thread, &reader, 0, NULL );
+    ret = FlushFileBuffers( server );
+    ok( ret, "FlushFileBuffers error %u\n", GetLastError() );
+    ok( reader.size >= 12 && reader.size <= 16, "flush returned after %u bytes\n", reader.size );
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+    ok( reader.size == 16, "read %u bytes\n", reader.size );
+    ok( !memcmp( reader.data, "0123456789abcdef", 16 ), "wrong data\n" );
+
+    /* nothing to wait for */
+    ret = FlushFileBuffers( server );
+    ok( ret, "FlushFileBuffers error %u\n", GetLastError() );
+
+    /* disconnecting drops the pending data */
+    ret = WriteFile( server, "lost", 4, &count, NULL );
+    ok( ret && count == 4, "WriteFile error %u\n", GetLastError() );
+    ret = DisconnectNamedPipe( server );
+    ok( ret, "DisconnectNamedPipe failed: %u\n", GetLastError() );
+    SetLastError( 0xdeadbeef );
+    ret = ReadFile( client, buffer, sizeof(buffer), &count, NULL );
+    ok( !ret && GetLastError() == ERROR_PIPE_NOT_CONNECTED, "ReadFile returned %x %u\n", ret, GetLastError() );
+    SetLastError( 0xdeadbeef );
+    ret = WriteFile( client, "x", 1, &count, NULL );
+    ok( !ret && GetLastError() == ERROR_PIPE_NOT_CONNECTED, "WriteFile returned %x %u\n", ret, GetLastError() );
+    CloseHandle( client );
+    CloseHandle( server );
+
+    /* closing keeps the data for the reader */
+    if (!create_pipe_pair( &server, &client, PIPE_ACCESS_DUPLEX, pipe_type, 4096 )) return;
+    ret = WriteFile( server, "kept", 4, &count, NULL );
+    ok( ret && count == 4, "WriteFile error %u\n", GetLastError() );
+    CloseHandle( server );
+    memset( buffer, 0, sizeof(buffer) );
+    ret = ReadFile( client, buffer, sizeof(buffer), &count, NULL );
+    ok( ret && count == 4, "ReadFile returned %x %u count %u\n", ret, GetLastError(), count );
+    ok( !memcmp( buffer, "kept", 4 ), "wrong data\n" );
+    SetLastError( 0xdeadbeef );
+    ret = ReadFile( client, buffer, sizeof(buffer), &count, NULL );
+    ok( !ret && GetLastError() == ERROR_BROKEN_PIPE, "ReadFile returned %x %u\n", ret, GetLastError() );
+    CloseHandle( client );
+}
+
 #define test_no_queued_completion(a) _test_no_queued_completion(__LINE__,a)
 static void _test_no_queued_completion(unsigned line, HANDLE port)
 {
@@ -2441,6 +2583,10 @@ START_TEST(pipe)
     read_pipe_test(PIPE_ACCESS_OUTBOUND, PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE);
 
     test_transceive();
+    trace("starting byte mode direct pipe tests\n");
+    test_direct_pipes(PIPE_TYPE_BYTE);
+    trace("starting message mode direct pipe tests\n");
+    test_direct_pipes(PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE);
     test_volume_info();
     test_file_info();
     test_security_info();
@@ -256,6 +256,7 @@ void thread_init(void)
     static struct debug_info debug_info;  /* debug info for initial thread */
 
     virtual_init();
+    startup_phase_done( STARTUP_PHASE_VIRTUAL_INIT );
 
     /* reserve space for shared user data */
 
@@ -339,6 +340,7 @@ void thread_init(void)
     /* setup the server connection */
     server_init_process();
     info_size = server_init_thread( peb, &suspend );
+    startup_phase_done( STARTUP_PHASE_SERVER_INIT );
 
     /* create the process heap */
     if (!(peb->ProcessHeap = RtlCreateHeap( HEAP_GROWABLE, NULL, 0, 0, NULL, NULL )))
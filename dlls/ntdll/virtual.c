@@ -1358,7 +1358,8 @@ static NTSTATUS map_pe_header( void *ptr, size_t size, int fd, BOOL *removable )
  * Map an executable (PE format) image into memory.
  */
 static NTSTATUS map_image( HANDLE hmapping, ACCESS_MASK access, int fd, SIZE_T mask,
-                           pe_image_info_t *image_info, int shared_fd, BOOL removable, PVOID *addr_ptr )
+                           pe_image_info_t *image_info, int shared_fd, int image_fd,
+                           BOOL removable, PVOID *addr_ptr )
 {
     IMAGE_DOS_HEADER *dos;
     IMAGE_NT_HEADERS *nt;
@@ -1518,20 +1519,25 @@ static NTSTATUS map_image( HANDLE hmapping, ACCESS_MASK access, int fd, SIZE_T m
 
         /* Note: if the section is not aligned properly map_file_into_view will magically
          *       fall back to read(), so we don't need to check anything here.
+         *       The server provides a page-aligned copy of such images to share it between processes.
          */
         end = file_start + file_size;
         if (sec->PointerToRawData >= st.st_size ||
             end > ((st.st_size + sector_align) & ~sector_align) ||
             end < file_start ||
-            map_file_into_view( view, fd, sec->VirtualAddress, file_size, file_start,
-                                VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY,
-                                removable ) != STATUS_SUCCESS)
+            (image_fd != -1 ?
+             map_file_into_view( view, image_fd, sec->VirtualAddress, file_size, sec->VirtualAddress,
+                                 VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY, FALSE ) :
+             map_file_into_view( view, fd, sec->VirtualAddress, file_size, file_start,
+                                 VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY,
+                                 removable )) != STATUS_SUCCESS)
         {
             ERR_(module)( "Could not map section %.8s, file probably truncated\n", sec->Name );
             goto error;
         }
 
-        if (file_size & page_mask)
+        /* the copy is already zero-filled, don't dirty its pages */
+        if ((file_size & page_mask) && image_fd == -1)
         {
             end = ROUND_SIZE( 0, file_size );
             if (end > map_size) end = map_size;
@@ -1618,7 +1624,7 @@ NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG zero_bits, S
     int unix_handle = -1, needs_close;
     unsigned int vprot, sec_flags;
     struct file_view *view;
-    HANDLE shared_file;
+    HANDLE shared_file, image_file;
     LARGE_INTEGER offset;
     sigset_t sigset;
 
@@ -1655,29 +1661,41 @@ NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG zero_bits, S
         sec_flags   = reply->flags;
         full_size   = reply->size;
         shared_file = wine_server_ptr_handle( reply->shared_file );
+        image_file  = wine_server_ptr_handle( reply->image_file );
     }
     SERVER_END_REQ;
     if (res) return res;
 
-    if ((res = server_get_unix_fd( handle, 0, &unix_handle, &needs_close, NULL, NULL ))) goto done;
+    if ((res = server_get_unix_fd( handle, 0, &unix_handle, &needs_close, NULL, NULL )))
+    {
+        if (shared_file) close_handle( shared_file );
+        if (image_file) close_handle( image_file );
+        goto done;
+    }
 
     if (sec_flags & SEC_IMAGE)
     {
-        if (shared_file)
-        {
-            int shared_fd, shared_needs_close;
+        int shared_fd = -1, shared_needs_close = FALSE;
+        int image_fd = -1, image_needs_close = FALSE;
 
-            if ((res = server_get_unix_fd( shared_file, FILE_READ_DATA|FILE_WRITE_DATA,
-                                           &shared_fd, &shared_needs_close, NULL, NULL ))) goto done;
-            res = map_image( handle, access, unix_handle, mask, image_info,
-                             shared_fd, needs_close, addr_ptr );
-            if (shared_needs_close) close( shared_fd );
-            close_handle( shared_file );
+        if (image_file)
+        {
+            /* not fatal, the sections are read from the file then */
+            if (server_get_unix_fd( image_file, FILE_READ_DATA, &image_fd, &image_needs_close, NULL, NULL ))
+                image_fd = -1;
+            close_handle( image_file );
         }
-        else
+        if (shared_file)
         {
-            res = map_image( handle, access, unix_handle, mask, image_info, -1, needs_close, addr_ptr );
+            res = server_get_unix_fd( shared_file, FILE_READ_DATA|FILE_WRITE_DATA,
+                                      &shared_fd, &shared_needs_close, NULL, NULL );
+            close_handle( shared_file );
         }
+        if (!res)
+            res = map_image( handle, access, unix_handle, mask, image_info,
+                             shared_fd, image_fd, needs_close, addr_ptr );
+        if (shared_needs_close) close( shared_fd );
+        if (image_needs_close) close( image_fd );
         if (needs_close) close( unix_handle );
         if (res >= 0) *size_ptr = image_info->map_size;
         return res;
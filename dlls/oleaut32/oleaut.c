@@ -111,6 +111,63 @@ typedef struct {
 
 static bstr_cache_entry_t bstr_cache[0x10000/BUCKET_SIZE];
 
+/* Buckets for small strings are kept per thread, so that the common case
+ * doesn't need the lock. Larger strings use the shared bstr_cache entries. */
+#define THREAD_CACHE_BUCKETS 64
+
+struct bstr_thread_cache
+{
+    bstr_cache_entry_t entries[THREAD_CACHE_BUCKETS];
+};
+
+static DWORD bstr_tls_index = TLS_OUT_OF_INDEXES;
+
+static struct bstr_thread_cache *get_thread_cache(void)
+{
+    struct bstr_thread_cache *cache;
+
+    if (bstr_tls_index == TLS_OUT_OF_INDEXES) return NULL;
+    if (!(cache = TlsGetValue(bstr_tls_index)))
+    {
+        if (!(cache = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache)))) return NULL;
+        TlsSetValue(bstr_tls_index, cache);
+    }
+    return cache;
+}
+
+static void free_thread_cache(void)
+{
+    struct bstr_thread_cache *cache;
+    unsigned i, j;
+
+    if (bstr_tls_index == TLS_OUT_OF_INDEXES) return;
+    if (!(cache = TlsGetValue(bstr_tls_index))) return;
+
+    for (i = 0; i < ARRAY_SIZE(cache->entries); i++)
+    {
+        bstr_cache_entry_t *entry = &cache->entries[i];
+        for (j = 0; j < entry->cnt; j++)
+            CoTaskMemFree(entry->buf[(entry->head + j) % BUCKET_BUFFER_SIZE]);
+    }
+    HeapFree(GetProcessHeap(), 0, cache);
+    TlsSetValue(bstr_tls_index, NULL);
+}
+
+static inline BOOL is_shared_cache_entry(const bstr_cache_entry_t *cache_entry)
+{
+    return cache_entry >= bstr_cache && cache_entry < bstr_cache + ARRAY_SIZE(bstr_cache);
+}
+
+static inline void lock_cache_entry(const bstr_cache_entry_t *cache_entry)
+{
+    if (is_shared_cache_entry(cache_entry)) EnterCriticalSection(&cs_bstr_cache);
+}
+
+static inline void unlock_cache_entry(const bstr_cache_entry_t *cache_entry)
+{
+    if (is_shared_cache_entry(cache_entry)) LeaveCriticalSection(&cs_bstr_cache);
+}
+
 static inline size_t bstr_alloc_size(size_t size)
 {
     return (FIELD_OFFSET(bstr_t, u.ptr[size]) + sizeof(WCHAR) + BUCKET_SIZE-1) & ~(BUCKET_SIZE-1);
@@ -123,7 +180,26 @@ static inline bstr_t *bstr_from_str(BSTR str)
 
 static inline bstr_cache_entry_t *get_cache_entry_from_idx(unsigned cache_idx)
 {
-    return bstr_cache_enabled && cache_idx < ARRAY_SIZE(bstr_cache) ? bstr_cache + cache_idx : NULL;
+    struct bstr_thread_cache *cache;
+
+    if (!bstr_cache_enabled || cache_idx >= ARRAY_SIZE(bstr_cache)) return NULL;
+    if (cache_idx < THREAD_CACHE_BUCKETS && (cache = get_thread_cache()))
+        return cache->entries + cache_idx;
+    return bstr_cache + cache_idx;
+}
+
+static bstr_t *get_cached_bstr(bstr_cache_entry_t *cache_entry)
+{
+    bstr_t *ret = NULL;
+
+    lock_cache_entry(cache_entry);
+    if(cache_entry->cnt) {
+        ret = cache_entry->buf[cache_entry->head++];
+        cache_entry->head %= BUCKET_BUFFER_SIZE;
+        cache_entry->cnt--;
+    }
+    unlock_cache_entry(cache_entry);
+    return ret;
 }
 
 static inline bstr_cache_entry_t *get_cache_entry(size_t size)
@@ -146,22 +222,12 @@ static bstr_t *alloc_bstr(size_t size)
     bstr_t *ret;
 
     if(cache_entry) {
-        EnterCriticalSection(&cs_bstr_cache);
-
-        if(!cache_entry->cnt) {
+        if(!(ret = get_cached_bstr(cache_entry))) {
             cache_entry = get_cache_entry(size+BUCKET_SIZE);
-            if(cache_entry && !cache_entry->cnt)
+            if(cache_entry && !(ret = get_cached_bstr(cache_entry)))
                 cache_entry = NULL;
         }
 
-        if(cache_entry) {
-            ret = cache_entry->buf[cache_entry->head++];
-            cache_entry->head %= BUCKET_BUFFER_SIZE;
-            cache_entry->cnt--;
-        }
-
-        LeaveCriticalSection(&cs_bstr_cache);
-
         if(cache_entry) {
             if(WARN_ON(heap)) {
                 size_t fill_size = (FIELD_OFFSET(bstr_t, u.ptr[size])+2*sizeof(WCHAR)-1) & ~(sizeof(WCHAR)-1);
@@ -291,14 +357,14 @@ void WINAPI DECLSPEC_HOTPATCH SysFreeString(BSTR str)
     if(cache_entry) {
         unsigned i;
 
-        EnterCriticalSection(&cs_bstr_cache);
+        lock_cache_entry(cache_entry);
 
         /* According to tests, freeing a string that's already in cache doesn't corrupt anything.
          * For that to work we need to search the cache. */
         for(i=0; i < cache_entry->cnt; i++) {
             if(cache_entry->buf[(cache_entry->head+i) % BUCKET_BUFFER_SIZE] == bstr) {
                 WARN_(heap)("String already is in cache!\n");
-                LeaveCriticalSection(&cs_bstr_cache);
+                unlock_cache_entry(cache_entry);
                 return;
             }
         }
@@ -313,11 +379,11 @@ void WINAPI DECLSPEC_HOTPATCH SysFreeString(BSTR str)
                     bstr->u.dwptr[i] = ARENA_FREE_FILLER;
             }
 
-            LeaveCriticalSection(&cs_bstr_cache);
+            unlock_cache_entry(cache_entry);
             return;
         }
 
-        LeaveCriticalSection(&cs_bstr_cache);
+        unlock_cache_entry(cache_entry);
     }
 
     CoTaskMemFree(bstr);
@@ -762,8 +828,8 @@ HRESULT WINAPI OleTranslateColor(
   return S_OK;
 }
 
+extern HMODULE hProxyDll DECLSPEC_HIDDEN;
 extern HRESULT WINAPI OLEAUTPS_DllGetClassObject(REFCLSID, REFIID, LPVOID *) DECLSPEC_HIDDEN;
-extern BOOL WINAPI OLEAUTPS_DllMain(HINSTANCE, DWORD, LPVOID) DECLSPEC_HIDDEN;
 extern HRESULT WINAPI OLEAUTPS_DllRegisterServer(void) DECLSPEC_HIDDEN;
 extern HRESULT WINAPI OLEAUTPS_DllUnregisterServer(void) DECLSPEC_HIDDEN;
 
@@ -1109,10 +1175,24 @@ BOOL WINAPI DllMain(HINSTANCE hInstDll, DWORD fdwReason, LPVOID lpvReserved)
 {
     static const WCHAR oanocacheW[] = {'o','a','n','o','c','a','c','h','e',0};
 
-    if(fdwReason == DLL_PROCESS_ATTACH)
+    switch(fdwReason) {
+    case DLL_PROCESS_ATTACH:
+        hProxyDll = hInstDll;
         bstr_cache_enabled = !GetEnvironmentVariableW(oanocacheW, NULL, 0);
-
-    return OLEAUTPS_DllMain( hInstDll, fdwReason, lpvReserved );
+        bstr_tls_index = TlsAlloc();
+        break;
+
+    case DLL_PROCESS_DETACH:
+        if (lpvReserved) break;
+        free_thread_cache();
+        if (bstr_tls_index != TLS_OUT_OF_INDEXES) TlsFree(bstr_tls_index);
+        break;
+
+    case DLL_THREAD_DETACH:
+        free_thread_cache();
+        break;
+    }
+    return TRUE;
 }
 
 /***********************************************************************
@@ -5542,7 +5542,9 @@ static void test_SetDocString(void)
 static void test_FindName(void)
 {
     static const WCHAR invalidW[] = {'i','n','v','a','l','i','d',0};
+    static const WCHAR celtW[] = {'c','e','l','t',0};
     WCHAR buffW[100];
+    BOOL is_name;
     MEMBERID memid;
     ITypeInfo *ti;
     ITypeLib *tl;
@@ -5608,6 +5610,18 @@ todo_wine {
     ok(c == 0, "got %d\n", c);
     ok(ti == (void*)0xdeadbeef, "got %p\n", ti);
 
+    is_name = FALSE;
+    lstrcpyW(buffW, celtW);
+    hr = ITypeLib_IsName(tl, buffW, 0, &is_name);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+    ok(is_name, "expected name to be found\n");
+
+    is_name = TRUE;
+    lstrcpyW(buffW, invalidW);
+    hr = ITypeLib_IsName(tl, buffW, 0, &is_name);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+    ok(!is_name, "expected name not to be found\n");
+
     ITypeLib_Release(tl);
 }
 
@@ -5944,6 +5944,51 @@ static void test_bstr_cache(void)
     SysFreeString(str2);
 }
 
+static DWORD WINAPI bstr_thread_proc(void *arg)
+{
+    static const WCHAR testW[] = {'t','e','s','t',0};
+    BSTR strs[8];
+    unsigned i, j;
+
+    for (i = 0; i < 1000; i++)
+    {
+        for (j = 0; j < ARRAY_SIZE(strs); j++)
+        {
+            strs[j] = SysAllocStringLen(testW, j % 5);
+            ok(SysStringLen(strs[j]) == j % 5, "got %u\n", SysStringLen(strs[j]));
+            ok(!memcmp(strs[j], testW, (j % 5) * sizeof(WCHAR)), "wrong string %s\n", wine_dbgstr_w(strs[j]));
+        }
+        for (j = 0; j < ARRAY_SIZE(strs); j++)
+            SysFreeString(strs[j]);
+    }
+
+    /* strings freed by another thread */
+    SysFreeString(arg);
+    return 0;
+}
+
+static void test_bstr_threads(void)
+{
+    static const WCHAR testW[] = {'t','e','s','t',0};
+    HANDLE threads[4];
+    BSTR str;
+    unsigned i;
+
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+    {
+        str = SysAllocString(testW);
+        threads[i] = CreateThread(NULL, 0, bstr_thread_proc, str, 0, NULL);
+        ok(threads[i] != NULL, "CreateThread failed: %u\n", GetLastError());
+    }
+    WaitForMultipleObjects(ARRAY_SIZE(threads), threads, TRUE, INFINITE);
+    for (i = 0; i < ARRAY_SIZE(threads); i++)
+        CloseHandle(threads[i]);
+
+    str = SysAllocString(testW);
+    ok(!lstrcmpW(str, testW), "string changed\n");
+    SysFreeString(str);
+}
+
 static void write_typelib(int res_no, const char *filename)
 {
     DWORD written;
@@ -6119,6 +6164,7 @@ START_TEST(vartype)
         GetUserDefaultLCID());
 
   test_bstr_cache();
+  test_bstr_threads();
 
   test_VarI1FromI2();
   test_VarI1FromI4();
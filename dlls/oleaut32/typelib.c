@@ -1096,6 +1096,8 @@ typedef struct tagTLBString {
     struct list entry;
 } TLBString;
 
+struct tlb_name_index;
+
 /* internal ITypeLib data */
 typedef struct tagITypeLibImpl
 {
@@ -1135,6 +1137,9 @@ typedef struct tagITypeLibImpl
     struct list ref_list;       /* list of ref types in this typelib */
     HREFTYPE dispatch_href;     /* reference to IDispatch, -1 if unused */
 
+    BOOL name_index_allowed;    /* names can't change anymore, see TLB_get_name_index */
+    struct tlb_name_index *name_index;
+
 
     /* typelibs are cached, keyed by path and index, so store the linked list info within them */
     struct list entry;
@@ -1311,6 +1316,12 @@ typedef struct tagTLBContext
 	void *mapping;        /* memory mapping */
 	MSFT_SegDir * pTblDir;
 	ITypeLibImpl* pLibInfo;
+	TLBString **names;    /* name_list, string_list and guid_list entries */
+	UINT name_count;      /* sorted by offset, for lookups while loading */
+	TLBString **strings;
+	UINT string_count;
+	TLBGuid **guids;
+	UINT guid_count;
 } TLBContext;
 
 
@@ -1746,6 +1757,158 @@ static inline ITypeInfoImpl *TLB_get_typeinfo_by_name(ITypeInfoImpl **typeinfos,
     return NULL;
 }
 
+/* Hash of all type, function, parameter and variable names of a typelib.
+ * The hash is case insensitive, so a lookup only yields candidates, which
+ * are then checked with the same comparisons as a full scan would use.
+ * Chains are kept in typelib order: by type info, then the type name,
+ * functions with their parameters and variables. */
+enum tlb_name_kind
+{
+    TLB_NAME_TYPE,
+    TLB_NAME_FUNC,
+    TLB_NAME_PARAM,
+    TLB_NAME_VAR
+};
+
+struct tlb_name_entry
+{
+    ULONG hash;
+    int next;                 /* next entry in the hash chain, -1 at the end */
+    enum tlb_name_kind kind;
+    UINT typeinfo;            /* index of the type info in the typelib */
+    UINT member;              /* index of the function or variable */
+    const TLBString *name;
+};
+
+struct tlb_name_index
+{
+    UINT size;
+    int *buckets;
+    UINT count;
+    struct tlb_name_entry entries[1];
+};
+
+static ULONG TLB_hash_name(const WCHAR *name)
+{
+    ULONG hash = 0;
+
+    if (!name) return 0;
+    while (*name) hash = hash * 31 + tolowerW(*name++);
+    return hash;
+}
+
+static void TLB_add_name_entry(struct tlb_name_index *index, int *tails, const TLBString *name,
+        enum tlb_name_kind kind, UINT typeinfo, UINT member)
+{
+    struct tlb_name_entry *entry;
+    UINT bucket;
+
+    if (!name) return;
+
+    entry = &index->entries[index->count];
+    entry->hash = TLB_hash_name(name->str);
+    entry->next = -1;
+    entry->kind = kind;
+    entry->typeinfo = typeinfo;
+    entry->member = member;
+    entry->name = name;
+
+    bucket = entry->hash % index->size;
+    if (tails[bucket] == -1) index->buckets[bucket] = index->count;
+    else index->entries[tails[bucket]].next = index->count;
+    tails[bucket] = index->count++;
+}
+
+static struct tlb_name_index *TLB_build_name_index(ITypeLibImpl *lib)
+{
+    struct tlb_name_index *index;
+    UINT i, j, k, count = 0;
+    int *tails;
+
+    for (i = 0; i < lib->TypeInfoCount; i++)
+    {
+        ITypeInfoImpl *info = lib->typeinfos[i];
+
+        count += 1 + info->typeattr.cFuncs + info->typeattr.cVars;
+        for (j = 0; j < info->typeattr.cFuncs; j++)
+            count += info->funcdescs[j].funcdesc.cParams;
+    }
+
+    if (!(index = heap_alloc(FIELD_OFFSET(struct tlb_name_index, entries[count ? count : 1]))))
+        return NULL;
+    index->size = count / 2 + 1;
+    index->count = 0;
+    index->buckets = heap_alloc(index->size * sizeof(*index->buckets));
+    tails = heap_alloc(index->size * sizeof(*tails));
+    if (!index->buckets || !tails)
+    {
+        heap_free(index->buckets);
+        heap_free(tails);
+        heap_free(index);
+        return NULL;
+    }
+    for (i = 0; i < index->size; i++) index->buckets[i] = tails[i] = -1;
+
+    for (i = 0; i < lib->TypeInfoCount; i++)
+    {
+        ITypeInfoImpl *info = lib->typeinfos[i];
+
+        TLB_add_name_entry(index, tails, info->Name, TLB_NAME_TYPE, i, 0);
+        for (j = 0; j < info->typeattr.cFuncs; j++)
+        {
+            const TLBFuncDesc *func = &info->funcdescs[j];
+
+            TLB_add_name_entry(index, tails, func->Name, TLB_NAME_FUNC, i, j);
+            for (k = 0; k < func->funcdesc.cParams; k++)
+                TLB_add_name_entry(index, tails, func->pParamDesc[k].Name, TLB_NAME_PARAM, i, j);
+        }
+        for (j = 0; j < info->typeattr.cVars; j++)
+            TLB_add_name_entry(index, tails, info->vardescs[j].Name, TLB_NAME_VAR, i, j);
+    }
+
+    heap_free(tails);
+    return index;
+}
+
+static void TLB_free_name_index(struct tlb_name_index *index)
+{
+    if (!index) return;
+    heap_free(index->buckets);
+    heap_free(index);
+}
+
+/* The index is only used for typelibs loaded from a file, and only as long
+ * as nobody asked for an ICreateTypeLib or ICreateTypeInfo interface that
+ * could be used to change the names. */
+static struct tlb_name_index *TLB_get_name_index(ITypeLibImpl *lib)
+{
+    struct tlb_name_index *index;
+
+    if (!lib->name_index_allowed) return NULL;
+    if (!(index = lib->name_index))
+    {
+        if (!(index = TLB_build_name_index(lib))) return NULL;
+        if (InterlockedCompareExchangePointer((void **)&lib->name_index, index, NULL))
+        {
+            TLB_free_name_index(index);
+            index = lib->name_index;
+        }
+    }
+    return index;
+}
+
+static inline const struct tlb_name_entry *TLB_first_name_entry(const struct tlb_name_index *index, ULONG hash)
+{
+    int i = index->buckets[hash % index->size];
+    return i == -1 ? NULL : &index->entries[i];
+}
+
+static inline const struct tlb_name_entry *TLB_next_name_entry(const struct tlb_name_index *index,
+        const struct tlb_name_entry *entry)
+{
+    return entry->next == -1 ? NULL : &index->entries[entry->next];
+}
+
 static void TLBVarDesc_Constructor(TLBVarDesc *var_desc)
 {
     list_init(&var_desc->custdata_list);
@@ -2102,15 +2265,49 @@ static HRESULT MSFT_ReadAllGuids(TLBContext *pcx)
     }
 }
 
+/* the lists are filled in file order, so their entries are sorted by offset */
+static TLBString **MSFT_IndexStrings(struct list *list, UINT *count)
+{
+    TLBString **ret, *tlbstr;
+    UINT i = 0;
+
+    *count = 0;
+    if (!(ret = heap_alloc(list_count(list) * sizeof(*ret)))) return NULL;
+    LIST_FOR_EACH_ENTRY(tlbstr, list, TLBString, entry)
+        ret[i++] = tlbstr;
+    *count = i;
+    return ret;
+}
+
+static TLBString *MSFT_FindString(TLBString **strings, UINT count, int offset)
+{
+    UINT min = 0, max = count;
+
+    while (min < max)
+    {
+        UINT i = (min + max) / 2;
+        if (strings[i]->offset == offset) return strings[i];
+        if (strings[i]->offset < (UINT)offset) min = i + 1;
+        else max = i;
+    }
+    return NULL;
+}
+
 static TLBGuid *MSFT_ReadGuid( int offset, TLBContext *pcx)
 {
-    TLBGuid *ret;
+    UINT min = 0, max = pcx->guid_count;
+
+    while (min < max)
+    {
+        UINT i = (min + max) / 2;
+        TLBGuid *ret = pcx->guids[i];
 
-    LIST_FOR_EACH_ENTRY(ret, &pcx->pLibInfo->guid_list, TLBGuid, entry){
         if(ret->offset == offset){
             TRACE_(typelib)("%s\n", debugstr_guid(&ret->guid));
             return ret;
         }
+        if (ret->offset < (UINT)offset) min = i + 1;
+        else max = i;
     }
 
     return NULL;
@@ -2181,30 +2378,18 @@ static HRESULT MSFT_ReadAllNames(TLBContext *pcx)
 
 static TLBString *MSFT_ReadName( TLBContext *pcx, int offset)
 {
-    TLBString *tlbstr;
-
-    LIST_FOR_EACH_ENTRY(tlbstr, &pcx->pLibInfo->name_list, TLBString, entry) {
-        if (tlbstr->offset == offset) {
-            TRACE_(typelib)("%s\n", debugstr_w(tlbstr->str));
-            return tlbstr;
-        }
-    }
+    TLBString *tlbstr = MSFT_FindString(pcx->names, pcx->name_count, offset);
 
-    return NULL;
+    if (tlbstr) TRACE_(typelib)("%s\n", debugstr_w(tlbstr->str));
+    return tlbstr;
 }
 
 static TLBString *MSFT_ReadString( TLBContext *pcx, int offset)
 {
-    TLBString *tlbstr;
-
-    LIST_FOR_EACH_ENTRY(tlbstr, &pcx->pLibInfo->string_list, TLBString, entry) {
-        if (tlbstr->offset == offset) {
-            TRACE_(typelib)("%s\n", debugstr_w(tlbstr->str));
-            return tlbstr;
-        }
-    }
+    TLBString *tlbstr = MSFT_FindString(pcx->strings, pcx->string_count, offset);
 
-    return NULL;
+    if (tlbstr) TRACE_(typelib)("%s\n", debugstr_w(tlbstr->str));
+    return tlbstr;
 }
 
 /*
@@ -3469,6 +3654,7 @@ static ITypeLib2* ITypeLib2_Constructor_MSFT(LPVOID pLib, DWORD dwTLBLength)
     if (!pTypeLibImpl) return NULL;
 
     /* get pointer to beginning of typelib data */
+    memset(&cx, 0, sizeof(cx));
     cx.pos = 0;
     cx.oStart=0;
     cx.mapping = pLib;
@@ -3507,6 +3693,15 @@ static ITypeLib2* ITypeLib2_Constructor_MSFT(LPVOID pLib, DWORD dwTLBLength)
     MSFT_ReadAllStrings(&cx);
     MSFT_ReadAllGuids(&cx);
 
+    cx.names = MSFT_IndexStrings(&pTypeLibImpl->name_list, &cx.name_count);
+    cx.strings = MSFT_IndexStrings(&pTypeLibImpl->string_list, &cx.string_count);
+    if ((cx.guids = heap_alloc(list_count(&pTypeLibImpl->guid_list) * sizeof(*cx.guids))))
+    {
+        TLBGuid *guid;
+        LIST_FOR_EACH_ENTRY(guid, &pTypeLibImpl->guid_list, TLBGuid, entry)
+            cx.guids[cx.guid_count++] = guid;
+    }
+
     /* now fill our internal data */
     /* TLIBATTR fields */
     pTypeLibImpl->guid = MSFT_ReadGuid(tlbHeader.posguid, &cx);
@@ -3666,6 +3861,12 @@ static ITypeLib2* ITypeLib2_Constructor_MSFT(LPVOID pLib, DWORD dwTLBLength)
     }
 #endif
 
+    heap_free(cx.names);
+    heap_free(cx.strings);
+    heap_free(cx.guids);
+
+    pTypeLibImpl->name_index_allowed = TRUE;
+
     TRACE("(%p)\n", pTypeLibImpl);
     return &pTypeLibImpl->ITypeLib2_iface;
 }
@@ -4688,6 +4889,7 @@ static ITypeLib2* ITypeLib2_Constructor_SLTG(LPVOID pLib, DWORD dwTLBLength)
     }
 
     heap_free(pOtherTypeInfoBlks);
+    pTypeLibImpl->name_index_allowed = TRUE;
     return &pTypeLibImpl->ITypeLib2_iface;
 }
 
@@ -4706,6 +4908,7 @@ static HRESULT WINAPI ITypeLib2_fnQueryInterface(ITypeLib2 *iface, REFIID riid,
     else if(IsEqualIID(riid, &IID_ICreateTypeLib) ||
              IsEqualIID(riid, &IID_ICreateTypeLib2))
     {
+        This->name_index_allowed = FALSE;
         *ppv = &This->ICreateTypeLib2_iface;
     }
     else
@@ -4773,6 +4976,8 @@ static ULONG WINAPI ITypeLib2_fnRelease( ITypeLib2 *iface)
           heap_free(tlbguid);
       }
 
+      TLB_free_name_index(This->name_index);
+
       TLB_FreeCustData(&This->custdata_list);
 
       for (i = 0; i < This->ctTypeDesc; i++)
@@ -5047,6 +5252,7 @@ static HRESULT WINAPI ITypeLib2_fnIsName(
 	BOOL *pfName)
 {
     ITypeLibImpl *This = impl_from_ITypeLib2(iface);
+    const struct tlb_name_index *index;
     int tic;
     UINT nNameBufLen = (lstrlenW(szNameBuf)+1)*sizeof(WCHAR), fdc, vrc;
 
@@ -5054,6 +5260,18 @@ static HRESULT WINAPI ITypeLib2_fnIsName(
 	  pfName);
 
     *pfName=TRUE;
+    if ((index = TLB_get_name_index(This)))
+    {
+        ULONG hash = TLB_hash_name(szNameBuf);
+        const struct tlb_name_entry *entry;
+
+        for (entry = TLB_first_name_entry(index, hash); entry; entry = TLB_next_name_entry(index, entry))
+            if (entry->hash == hash && !TLB_str_memcmp(szNameBuf, entry->name, nNameBufLen))
+                goto ITypeLib2_fnIsName_exit;
+        *pfName=FALSE;
+        goto ITypeLib2_fnIsName_exit;
+    }
+
     for(tic = 0; tic < This->TypeInfoCount; ++tic){
         ITypeInfoImpl *pTInfo = This->typeinfos[tic];
         if(!TLB_str_memcmp(szNameBuf, pTInfo->Name, nNameBufLen)) goto ITypeLib2_fnIsName_exit;
@@ -5075,7 +5293,7 @@ static HRESULT WINAPI ITypeLib2_fnIsName(
     *pfName=FALSE;
 
 ITypeLib2_fnIsName_exit:
-    TRACE("(%p)slow! search for %s: %sfound!\n", This,
+    TRACE("(%p) search for %s: %sfound!\n", This,
           debugstr_w(szNameBuf), *pfName ? "" : "NOT ");
 
     return S_OK;
@@ -5096,6 +5314,7 @@ static HRESULT WINAPI ITypeLib2_fnFindName(
 	UINT16 *found)
 {
     ITypeLibImpl *This = impl_from_ITypeLib2(iface);
+    const struct tlb_name_index *index;
     int tic;
     UINT count = 0;
     UINT len;
@@ -5106,6 +5325,50 @@ static HRESULT WINAPI ITypeLib2_fnFindName(
         return E_INVALIDARG;
 
     len = (lstrlenW(name) + 1)*sizeof(WCHAR);
+    if (name && (index = TLB_get_name_index(This)))
+    {
+        const struct tlb_name_entry *entry;
+        ULONG name_hash = TLB_hash_name(name);
+        int last = -1;
+
+        /* same priorities as the scan below: type name, then functions,
+         * then variables, which are compared case insensitively */
+        for (entry = TLB_first_name_entry(index, name_hash); entry && count < *found;
+             entry = TLB_next_name_entry(index, entry))
+        {
+            ITypeInfoImpl *pTInfo = This->typeinfos[entry->typeinfo];
+
+            if (entry->hash != name_hash || (int)entry->typeinfo == last) continue;
+
+            switch (entry->kind)
+            {
+            case TLB_NAME_TYPE:
+                if (TLB_str_memcmp(name, entry->name, len)) continue;
+                memid[count] = MEMBERID_NIL;
+                break;
+            case TLB_NAME_FUNC:
+                if (TLB_str_memcmp(name, entry->name, len)) continue;
+                memid[count] = pTInfo->funcdescs[entry->member].funcdesc.memid;
+                break;
+            case TLB_NAME_VAR:
+                if (lstrcmpiW(entry->name->str, name)) continue;
+                memid[count] = pTInfo->vardescs[entry->member].vardesc.memid;
+                break;
+            default:
+                continue;
+            }
+
+            last = entry->typeinfo;
+            ITypeInfo2_AddRef(&pTInfo->ITypeInfo2_iface);
+            ppTInfo[count] = (ITypeInfo *)&pTInfo->ITypeInfo2_iface;
+            count++;
+        }
+        TRACE("found %d typeinfos\n", count);
+
+        *found = count;
+        return S_OK;
+    }
+
     for(tic = 0; count < *found && tic < This->TypeInfoCount; ++tic) {
         ITypeInfoImpl *pTInfo = This->typeinfos[tic];
         TLBVarDesc *var;
@@ -5571,7 +5834,10 @@ static HRESULT WINAPI ITypeInfo_fnQueryInterface(
         *ppvObject = &This->ITypeInfo2_iface;
     else if(IsEqualIID(riid, &IID_ICreateTypeInfo) ||
              IsEqualIID(riid, &IID_ICreateTypeInfo2))
+    {
+        if (This->pTypeLib) This->pTypeLib->name_index_allowed = FALSE;
         *ppvObject = &This->ICreateTypeInfo2_iface;
+    }
     else if(IsEqualIID(riid, &IID_ITypeComp))
         *ppvObject = &This->ITypeComp_iface;
 
@@ -6262,6 +6528,8 @@ static HRESULT WINAPI ITypeInfo_fnGetIDsOfNames( ITypeInfo2 *iface,
         LPOLESTR  *rgszNames, UINT cNames, MEMBERID  *pMemId)
 {
     ITypeInfoImpl *This = impl_from_ITypeInfo2(iface);
+    const struct tlb_name_index *index;
+    const struct tlb_name_entry *entry;
     const TLBVarDesc *pVDesc;
     HRESULT ret=S_OK;
     UINT i, fdc;
@@ -6273,7 +6541,32 @@ static HRESULT WINAPI ITypeInfo_fnGetIDsOfNames( ITypeInfo2 *iface,
     for (i = 0; i < cNames; i++)
         pMemId[i] = MEMBERID_NIL;
 
-    for (fdc = 0; fdc < This->typeattr.cFuncs; ++fdc) {
+    if (!This->not_attached_to_typelib && (index = TLB_get_name_index(This->pTypeLib)))
+    {
+        ULONG hash = TLB_hash_name(*rgszNames);
+
+        /* functions come before variables in the chains, so the first match
+         * is the one the scan below would find */
+        for (entry = TLB_first_name_entry(index, hash); entry; entry = TLB_next_name_entry(index, entry))
+        {
+            if (entry->hash != hash || entry->typeinfo != (UINT)This->index) continue;
+            if (entry->kind != TLB_NAME_FUNC && entry->kind != TLB_NAME_VAR) continue;
+            if (!lstrcmpiW(*rgszNames, TLB_get_bstr(entry->name))) break;
+        }
+        if (entry && entry->kind == TLB_NAME_VAR)
+        {
+            if (cNames) *pMemId = This->vardescs[entry->member].vardesc.memid;
+            return ret;
+        }
+        fdc = entry ? entry->member : This->typeattr.cFuncs;
+    }
+    else
+    {
+        index = NULL;
+        fdc = 0;
+    }
+
+    for (; fdc < This->typeattr.cFuncs; ++fdc) {
         int j;
         const TLBFuncDesc *pFDesc = &This->funcdescs[fdc];
         if(!lstrcmpiW(*rgszNames, TLB_get_bstr(pFDesc->Name))) {
@@ -6291,7 +6584,7 @@ static HRESULT WINAPI ITypeInfo_fnGetIDsOfNames( ITypeInfo2 *iface,
             return ret;
         }
     }
-    pVDesc = TLB_get_vardesc_by_name(This->vardescs, This->typeattr.cVars, *rgszNames);
+    pVDesc = index ? NULL : TLB_get_vardesc_by_name(This->vardescs, This->typeattr.cVars, *rgszNames);
     if(pVDesc){
         if(cNames)
             *pMemId = pVDesc->vardesc.memid;
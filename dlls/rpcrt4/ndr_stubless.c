@@ -530,6 +530,120 @@ void client_do_args( PMIDL_STUB_MESSAGE pStubMsg, PFORMAT_STRING pFormat, enum s
     }
 }
 
+static void client_check_ref_args( PMIDL_STUB_MESSAGE pStubMsg, PFORMAT_STRING pFormat,
+                                   unsigned short number_of_params )
+{
+    const NDR_PARAM_OIF *params = (const NDR_PARAM_OIF *)pFormat;
+    unsigned int i;
+
+    for (i = 0; i < number_of_params; i++)
+    {
+        unsigned char *pArg = pStubMsg->StackTop + params[i].stack_offset;
+
+        if (params[i].attr.IsSimpleRef && !*(unsigned char **)pArg)
+            RpcRaiseException(RPC_X_NULL_REF_POINTER);
+    }
+}
+
+static void client_calc_size( PMIDL_STUB_MESSAGE pStubMsg, PFORMAT_STRING pFormat,
+                              const struct ndr_proc_plan *plan, void **fpu_args,
+                              unsigned short number_of_params, unsigned char *pRetVal )
+{
+    if (plan && !plan->client_must_size)
+    {
+        if (plan->check_ref_args) client_check_ref_args( pStubMsg, pFormat, number_of_params );
+        pStubMsg->BufferLength = plan->client_buffer_size;
+        return;
+    }
+    client_do_args( pStubMsg, pFormat, STUBLESS_CALCSIZE, fpu_args, number_of_params, pRetVal );
+}
+
+/* same size and alignment as used by NdrBaseTypeBufferSize */
+static int basetype_buffer_size( unsigned char fc )
+{
+    switch (fc)
+    {
+    case FC_BYTE:
+    case FC_CHAR:
+    case FC_SMALL:
+    case FC_USMALL:
+        return sizeof(UCHAR);
+    case FC_WCHAR:
+    case FC_SHORT:
+    case FC_USHORT:
+    case FC_ENUM16:
+        return sizeof(USHORT);
+    case FC_LONG:
+    case FC_ULONG:
+    case FC_ENUM32:
+    case FC_INT3264:
+    case FC_UINT3264:
+    case FC_FLOAT:
+    case FC_ERROR_STATUS_T:
+        return sizeof(ULONG);
+    case FC_DOUBLE:
+    case FC_HYPER:
+        return sizeof(ULONGLONG);
+    case FC_IGNORE:
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+static BOOL plan_add_param( ULONG *size, const NDR_PARAM_OIF *param )
+{
+    int len;
+
+    if (!param->attr.IsBasetype) return FALSE;
+    if ((len = basetype_buffer_size( param->u.type_format_char )) < 0) return FALSE;
+    if (len) *size = ((*size + len - 1) & ~(len - 1)) + len;
+    return TRUE;
+}
+
+/* Precompute the buffer sizes of a -Oicf procedure. Only fixed size base
+ * types are handled, anything else still goes through the sizing pass. */
+void ndr_init_proc_plan( struct ndr_proc_plan *plan, PFORMAT_STRING pFormat )
+{
+    const NDR_PROC_HEADER *pProcHeader = (const NDR_PROC_HEADER *)pFormat;
+    const NDR_PROC_PARTIAL_OIF_HEADER *pOIFHeader;
+    const NDR_PARAM_OIF *params;
+    unsigned int i;
+
+    memset( plan, 0, sizeof(*plan) );
+    plan->client_must_size = plan->server_must_size = TRUE;
+
+    /* explicit handles are described by the format string and are sized by the interpreter */
+    if (!pProcHeader->handle_type) return;
+
+    if (pProcHeader->Oi_flags & Oi_HAS_RPCFLAGS)
+        pFormat += sizeof(NDR_PROC_HEADER_RPC);
+    else
+        pFormat += sizeof(NDR_PROC_HEADER);
+
+    pOIFHeader = (const NDR_PROC_PARTIAL_OIF_HEADER *)pFormat;
+    if (pOIFHeader->Oi2Flags.HasPipes) return;
+    pFormat += sizeof(NDR_PROC_PARTIAL_OIF_HEADER);
+    if (pOIFHeader->Oi2Flags.HasExtensions)
+        pFormat += ((const NDR_PROC_HEADER_EXTS *)pFormat)->Size;
+    params = (const NDR_PARAM_OIF *)pFormat;
+
+    plan->client_must_size = plan->server_must_size = FALSE;
+    for (i = 0; i < pOIFHeader->number_of_params; i++)
+    {
+        if (params[i].attr.IsSimpleRef) plan->check_ref_args = TRUE;
+        if (params[i].attr.IsIn && !plan_add_param( &plan->client_buffer_size, &params[i] ))
+            plan->client_must_size = TRUE;
+        if ((params[i].attr.IsOut || params[i].attr.IsReturn) &&
+            !plan_add_param( &plan->server_buffer_size, &params[i] ))
+            plan->server_must_size = TRUE;
+    }
+
+    TRACE( "client size %u%s, server size %u%s\n",
+           plan->client_buffer_size, plan->client_must_size ? " (must size)" : "",
+           plan->server_buffer_size, plan->server_must_size ? " (must size)" : "" );
+}
+
 static unsigned int type_stack_size(unsigned char fc)
 {
     switch (fc)
@@ -675,6 +789,8 @@ LONG_PTR CDECL DECLSPEC_HIDDEN ndr_client_call( PMIDL_STUB_DESC pStubDesc, PFORM
     PFORMAT_STRING pHandleFormat;
     /* correlation cache */
     ULONG_PTR NdrCorrCache[256];
+    /* precomputed buffer sizes, if available */
+    const struct ndr_proc_plan *plan = NULL;
 
     TRACE("pStubDesc %p, pFormat %p, ...\n", pStubDesc, pFormat);
 
@@ -734,6 +850,9 @@ LONG_PTR CDECL DECLSPEC_HIDDEN ndr_client_call( PMIDL_STUB_DESC pStubDesc, PFORM
 
         TRACE("Oif_flags = %s\n", debugstr_INTERPRETER_OPT_FLAGS(Oif_flags) );
 
+        if (is_typelib_stub_desc(pStubDesc))
+            plan = get_typelib_proc_plan(pStubDesc, procedure_number);
+
         if (Oif_flags.HasExtensions)
         {
             const NDR_PROC_HEADER_EXTS *pExtensions = (const NDR_PROC_HEADER_EXTS *)pFormat;
@@ -811,8 +930,8 @@ LONG_PTR CDECL DECLSPEC_HIDDEN ndr_client_call( PMIDL_STUB_DESC pStubDesc, PFORM
         {
             /* 2. CALCSIZE */
             TRACE( "CALCSIZE\n" );
-            client_do_args(&stubMsg, pFormat, STUBLESS_CALCSIZE, fpu_stack,
-                           number_of_params, (unsigned char *)&RetVal);
+            client_calc_size(&stubMsg, pFormat, plan, fpu_stack,
+                             number_of_params, (unsigned char *)&RetVal);
 
             /* 3. GETBUFFER */
             TRACE( "GETBUFFER\n" );
@@ -925,8 +1044,8 @@ LONG_PTR CDECL DECLSPEC_HIDDEN ndr_client_call( PMIDL_STUB_DESC pStubDesc, PFORM
     {
         /* 2. CALCSIZE */
         TRACE( "CALCSIZE\n" );
-        client_do_args(&stubMsg, pFormat, STUBLESS_CALCSIZE, fpu_stack,
-                       number_of_params, (unsigned char *)&RetVal);
+        client_calc_size(&stubMsg, pFormat, plan, fpu_stack,
+                         number_of_params, (unsigned char *)&RetVal);
 
         /* 3. GETBUFFER */
         TRACE( "GETBUFFER\n" );
@@ -1303,6 +1422,8 @@ LONG WINAPI NdrStubCall2(
     LONG_PTR *retval_ptr = NULL;
     /* correlation cache */
     ULONG_PTR NdrCorrCache[256];
+    /* precomputed buffer sizes, if available */
+    const struct ndr_proc_plan *plan = NULL;
 
     TRACE("pThis %p, pChannel %p, pRpcMsg %p, pdwStubPhase %p\n", pThis, pChannel, pRpcMsg, pdwStubPhase);
 
@@ -1405,6 +1526,9 @@ LONG WINAPI NdrStubCall2(
 
         TRACE("Oif_flags = %s\n", debugstr_INTERPRETER_OPT_FLAGS(Oif_flags) );
 
+        if (is_typelib_stub_desc(pStubDesc))
+            plan = get_typelib_proc_plan(pStubDesc, pRpcMsg->ProcNum);
+
         if (Oif_flags.HasExtensions)
         {
             const NDR_PROC_HEADER_EXTS *pExtensions = (const NDR_PROC_HEADER_EXTS *)pFormat;
@@ -1493,9 +1617,14 @@ LONG WINAPI NdrStubCall2(
                 stubMsg.Buffer = pRpcMsg->Buffer;
             }
             break;
+        case STUBLESS_CALCSIZE:
+            if (plan && !plan->server_must_size)
+                stubMsg.BufferLength = plan->server_buffer_size;
+            else
+                retval_ptr = stub_do_args(&stubMsg, pFormat, phase, number_of_params);
+            break;
         case STUBLESS_UNMARSHAL:
         case STUBLESS_INITOUT:
-        case STUBLESS_CALCSIZE:
         case STUBLESS_MARSHAL:
         case STUBLESS_MUSTFREE:
         case STUBLESS_FREE:
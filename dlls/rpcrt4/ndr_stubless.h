@@ -236,6 +236,17 @@ enum stubless_phase
     STUBLESS_FREE
 };
 
+/* precomputed per-procedure data, so that the interpreter can skip the
+ * sizing passes of procedures that only use fixed size base types */
+struct ndr_proc_plan
+{
+    ULONG client_buffer_size;   /* size of the [in] parameters */
+    ULONG server_buffer_size;   /* size of the [out] parameters and return value */
+    BOOL  client_must_size;     /* the client needs a sizing pass */
+    BOOL  server_must_size;     /* the server needs a sizing pass */
+    BOOL  check_ref_args;       /* some [in] base types are passed by reference */
+};
+
 LONG_PTR CDECL ndr_client_call( PMIDL_STUB_DESC pStubDesc, PFORMAT_STRING pFormat,
                                 void **stack_top, void **fpu_stack ) DECLSPEC_HIDDEN;
 LONG_PTR CDECL ndr_async_client_call( PMIDL_STUB_DESC pStubDesc, PFORMAT_STRING pFormat,
@@ -246,3 +257,13 @@ PFORMAT_STRING convert_old_args( PMIDL_STUB_MESSAGE pStubMsg, PFORMAT_STRING pFo
                                  unsigned int stack_size, BOOL object_proc,
                                  void *buffer, unsigned int size, unsigned int *count ) DECLSPEC_HIDDEN;
 RPC_STATUS NdrpCompleteAsyncClientCall(RPC_ASYNC_STATE *pAsync, void *Reply) DECLSPEC_HIDDEN;
+void ndr_init_proc_plan( struct ndr_proc_plan *plan, PFORMAT_STRING pFormat ) DECLSPEC_HIDDEN;
+const struct ndr_proc_plan *get_typelib_proc_plan( PMIDL_STUB_DESC pStubDesc,
+                                                   unsigned short proc_num ) DECLSPEC_HIDDEN;
+
+/* stub descriptors built from a type info point to themselves in Reserved5,
+ * MIDL generated ones leave it zero */
+static inline BOOL is_typelib_stub_desc( PMIDL_STUB_DESC pStubDesc )
+{
+    return pStubDesc->Reserved5 == (ULONG_PTR)pStubDesc;
+}
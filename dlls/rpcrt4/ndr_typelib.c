@@ -27,6 +27,7 @@
 #include "ndrtypes.h"
 #include "wine/debug.h"
 #include "wine/heap.h"
+#include "wine/list.h"
 
 #include "cpsf.h"
 #include "initguid.h"
@@ -933,14 +934,135 @@ static void init_stub_desc(MIDL_STUB_DESC *desc)
     /* type format string is initialized with proc format string and offset table */
 }
 
+/* The format strings of an interface are shared between all of its proxies
+ * and stubs, together with the precomputed buffer sizes of its methods. They
+ * are keyed on the type info they were built from, which is kept alive. */
+struct typelib_format
+{
+    struct list entry;
+    LONG refcount;
+    ITypeInfo *typeinfo;
+    WORD funcs;
+    WORD parentfuncs;
+    MIDL_STUB_DESC stub_desc;
+    const unsigned char *proc;
+    unsigned short *offset_table;
+    struct ndr_proc_plan *plans;
+};
+
+static struct list typelib_formats = LIST_INIT(typelib_formats);
+static SRWLOCK typelib_formats_lock = SRWLOCK_INIT;
+
+static void free_typelib_format(struct typelib_format *format)
+{
+    ITypeInfo_Release(format->typeinfo);
+    heap_free((void *)format->stub_desc.pFormatTypes);
+    heap_free((void *)format->proc);
+    heap_free(format->offset_table);
+    heap_free(format->plans);
+    heap_free(format);
+}
+
+/* typelib_formats_lock must be held */
+static struct typelib_format *find_typelib_format(ITypeInfo *typeinfo)
+{
+    struct typelib_format *format;
+
+    LIST_FOR_EACH_ENTRY(format, &typelib_formats, struct typelib_format, entry)
+    {
+        if (format->typeinfo == typeinfo)
+        {
+            InterlockedIncrement(&format->refcount);
+            return format;
+        }
+    }
+    return NULL;
+}
+
+static HRESULT get_typelib_format(ITypeInfo *typeinfo, WORD funcs, WORD parentfuncs,
+        struct typelib_format **ret)
+{
+    struct typelib_format *format, *existing;
+    HRESULT hr;
+    WORD i;
+
+    AcquireSRWLockShared(&typelib_formats_lock);
+    format = find_typelib_format(typeinfo);
+    ReleaseSRWLockShared(&typelib_formats_lock);
+    if ((*ret = format)) return S_OK;
+
+    if (!(format = heap_alloc_zero(sizeof(*format))))
+    {
+        ERR("Failed to allocate format strings.\n");
+        return E_OUTOFMEMORY;
+    }
+    format->refcount = 1;
+    format->funcs = funcs;
+    format->parentfuncs = parentfuncs;
+    init_stub_desc(&format->stub_desc);
+    /* tells the interpreter where to find the plans, see get_typelib_proc_plan() */
+    format->stub_desc.Reserved5 = (ULONG_PTR)&format->stub_desc;
+
+    hr = build_format_strings(typeinfo, funcs, parentfuncs, &format->stub_desc.pFormatTypes,
+            &format->proc, &format->offset_table);
+    if (FAILED(hr))
+    {
+        heap_free(format);
+        return hr;
+    }
+    ITypeInfo_AddRef(format->typeinfo = typeinfo);
+
+    if (!(format->plans = heap_alloc(funcs * sizeof(*format->plans))))
+    {
+        free_typelib_format(format);
+        return E_OUTOFMEMORY;
+    }
+    for (i = 0; i < funcs; i++)
+        ndr_init_proc_plan(&format->plans[i], format->proc + format->offset_table[parentfuncs + i - 3]);
+
+    AcquireSRWLockExclusive(&typelib_formats_lock);
+    if ((existing = find_typelib_format(typeinfo)))
+    {
+        free_typelib_format(format);
+        format = existing;
+    }
+    else
+        list_add_head(&typelib_formats, &format->entry);
+    ReleaseSRWLockExclusive(&typelib_formats_lock);
+
+    *ret = format;
+    return S_OK;
+}
+
+static void release_typelib_format(struct typelib_format *format)
+{
+    AcquireSRWLockExclusive(&typelib_formats_lock);
+    if (!InterlockedDecrement(&format->refcount))
+        list_remove(&format->entry);
+    else
+        format = NULL;
+    ReleaseSRWLockExclusive(&typelib_formats_lock);
+
+    if (format) free_typelib_format(format);
+}
+
+/* the caller holds a proxy or stub, which keeps the format alive */
+const struct ndr_proc_plan *get_typelib_proc_plan(PMIDL_STUB_DESC desc, unsigned short proc_num)
+{
+    const struct typelib_format *format = CONTAINING_RECORD(desc, struct typelib_format, stub_desc);
+
+    if (proc_num < format->parentfuncs || proc_num >= format->parentfuncs + format->funcs)
+        return NULL;
+    return &format->plans[proc_num - format->parentfuncs];
+}
+
 struct typelib_proxy
 {
     StdProxyImpl proxy;
     IID iid;
-    MIDL_STUB_DESC stub_desc;
+    struct typelib_format *format;
     MIDL_STUBLESS_PROXY_INFO proxy_info;
     CInterfaceProxyVtbl *proxy_vtbl;
-    unsigned short *offset_table;
 };
 
 static ULONG WINAPI typelib_proxy_Release(IRpcProxyBuffer *iface)
@@ -958,9 +1080,7 @@ static ULONG WINAPI typelib_proxy_Release(IRpcProxyBuffer *iface)
             IUnknown_Release(proxy->proxy.base_object);
         if (proxy->proxy.base_proxy)
             IRpcProxyBuffer_Release(proxy->proxy.base_proxy);
-        heap_free((void *)proxy->stub_desc.pFormatTypes);
-        heap_free((void *)proxy->proxy_info.ProcFormatString);
-        heap_free(proxy->offset_table);
+        release_typelib_format(proxy->format);
         heap_free(proxy->proxy_vtbl);
         heap_free(proxy);
     }
@@ -1025,9 +1145,6 @@ HRESULT WINAPI CreateProxyFromTypeInfo(ITypeInfo *typeinfo, IUnknown *outer,
         return E_OUTOFMEMORY;
     }
 
-    init_stub_desc(&proxy->stub_desc);
-    proxy->proxy_info.pStubDesc = &proxy->stub_desc;
-
     proxy->proxy_vtbl = heap_alloc_zero(sizeof(proxy->proxy_vtbl->header) + (funcs + parentfuncs) * sizeof(void *));
     if (!proxy->proxy_vtbl)
     {
@@ -1042,22 +1159,21 @@ HRESULT WINAPI CreateProxyFromTypeInfo(ITypeInfo *typeinfo, IUnknown *outer,
     for (i = 0; i < funcs; i++)
         proxy->proxy_vtbl->Vtbl[parentfuncs + i] = (void *)-1;
 
-    hr = build_format_strings(typeinfo, funcs, parentfuncs, &proxy->stub_desc.pFormatTypes,
-            &proxy->proxy_info.ProcFormatString, &proxy->offset_table);
+    hr = get_typelib_format(typeinfo, funcs, parentfuncs, &proxy->format);
     if (FAILED(hr))
     {
         heap_free(proxy->proxy_vtbl);
         heap_free(proxy);
         return hr;
     }
-    proxy->proxy_info.FormatStringOffset = &proxy->offset_table[-3];
+    proxy->proxy_info.pStubDesc = &proxy->format->stub_desc;
+    proxy->proxy_info.ProcFormatString = proxy->format->proc;
+    proxy->proxy_info.FormatStringOffset = &proxy->format->offset_table[-3];
 
     hr = typelib_proxy_init(proxy, outer, funcs + parentfuncs, &parentiid, proxy_buffer, out);
     if (FAILED(hr))
     {
-        heap_free((void *)proxy->stub_desc.pFormatTypes);
-        heap_free((void *)proxy->proxy_info.ProcFormatString);
-        heap_free((void *)proxy->offset_table);
+        release_typelib_format(proxy->format);
         heap_free(proxy->proxy_vtbl);
         heap_free(proxy);
     }
@@ -1069,10 +1185,9 @@ struct typelib_stub
 {
     cstdstubbuffer_delegating_t stub;
     IID iid;
-    MIDL_STUB_DESC stub_desc;
+    struct typelib_format *format;
     MIDL_SERVER_INFO server_info;
     CInterfaceStubVtbl stub_vtbl;
-    unsigned short *offset_table;
     PRPC_STUB_FUNCTION *dispatch_table;
 };
 
@@ -1096,9 +1211,7 @@ static ULONG WINAPI typelib_stub_Release(IRpcStubBuffer *iface)
             heap_free(stub->dispatch_table);
         }
 
-        heap_free((void *)stub->stub_desc.pFormatTypes);
-        heap_free((void *)stub->server_info.ProcString);
-        heap_free(stub->offset_table);
+        release_typelib_format(stub->format);
         heap_free(stub);
     }
 
@@ -1160,17 +1273,15 @@ HRESULT WINAPI CreateStubFromTypeInfo(ITypeInfo *typeinfo, REFIID iid,
         return E_OUTOFMEMORY;
     }
 
-    init_stub_desc(&stub->stub_desc);
-    stub->server_info.pStubDesc = &stub->stub_desc;
-
-    hr = build_format_strings(typeinfo, funcs, parentfuncs, &stub->stub_desc.pFormatTypes,
-            &stub->server_info.ProcString, &stub->offset_table);
+    hr = get_typelib_format(typeinfo, funcs, parentfuncs, &stub->format);
     if (FAILED(hr))
     {
         heap_free(stub);
         return hr;
     }
-    stub->server_info.FmtStringOffset = &stub->offset_table[-3];
+    stub->server_info.pStubDesc = &stub->format->stub_desc;
+    stub->server_info.ProcString = stub->format->proc;
+    stub->server_info.FmtStringOffset = &stub->format->offset_table[-3];
 
     stub->iid = *iid;
     stub->stub_vtbl.header.piid = &stub->iid;
@@ -1194,9 +1305,7 @@ HRESULT WINAPI CreateStubFromTypeInfo(ITypeInfo *typeinfo, REFIID iid,
     hr = typelib_stub_init(stub, server, &parentiid, stub_buffer);
     if (FAILED(hr))
     {
-        heap_free((void *)stub->stub_desc.pFormatTypes);
-        heap_free((void *)stub->server_info.ProcString);
-        heap_free(stub->offset_table);
+        release_typelib_format(stub->format);
         heap_free(stub);
     }
 
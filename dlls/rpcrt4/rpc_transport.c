@@ -60,6 +60,8 @@ static RpcConnection *rpcrt4_spawn_connection(RpcConnection *old_connection);
 
 /**** ncacn_np support ****/
 
+struct lrpc_shm;
+
 typedef struct _RpcConnection_np
 {
     RpcConnection common;
@@ -69,8 +71,14 @@ typedef struct _RpcConnection_np
     IO_STATUS_BLOCK io_status;
     HANDLE event_cache;
     BOOL read_closed;
+    /* ncalrpc only */
+    HANDLE shm_marker;
+    struct lrpc_shm *shm;
+    BOOL shm_checked;
 } RpcConnection_np;
 
+static void rpcrt4_ncalrpc_shm_connect(RpcConnection_np *npc);
+
 static RpcConnection *rpcrt4_conn_np_alloc(void)
 {
   RpcConnection_np *npc = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(RpcConnection_np));
@@ -186,6 +194,14 @@ static char *ncalrpc_pipe_name(const char *endpoint)
   return pipe_name;
 }
 
+/* Named object created by servers that accept shared memory connections on
+ * an ncalrpc endpoint. */
+static BOOL ncalrpc_shm_marker_name(const char *endpoint, char *name, size_t size)
+{
+  int len = snprintf(name, size, "__wine_lrpc_shm_%s", endpoint);
+  return len > 0 && len < size && !strchr(endpoint, '\\');
+}
+
 static RPC_STATUS rpcrt4_ncalrpc_open(RpcConnection* Connection)
 {
   RpcConnection_np *npc = (RpcConnection_np *) Connection;
@@ -200,6 +216,10 @@ static RPC_STATUS rpcrt4_ncalrpc_open(RpcConnection* Connection)
   r = rpcrt4_conn_open_pipe(Connection, pname, TRUE);
   I_RpcFree(pname);
 
+  /* try to move the data path to shared memory, the pipe is kept otherwise */
+  if (r == RPC_S_OK)
+    rpcrt4_ncalrpc_shm_connect(npc);
+
   return r;
 }
 
@@ -227,6 +247,14 @@ static RPC_STATUS rpcrt4_protseq_ncalrpc_open_endpoint(RpcServerProtseq* protseq
   ((RpcConnection_np*)Connection)->listen_pipe = ncalrpc_pipe_name(Connection->Endpoint);
   r = rpcrt4_conn_create_pipe(Connection);
 
+  if (r == RPC_S_OK)
+  {
+    char marker[MAX_PATH];
+
+    if (ncalrpc_shm_marker_name(Connection->Endpoint, marker, sizeof(marker)))
+      ((RpcConnection_np*)Connection)->shm_marker = CreateEventA(NULL, TRUE, FALSE, marker);
+  }
+
   EnterCriticalSection(&protseq->cs);
   list_add_head(&protseq->listeners, &Connection->protseq_entry);
   Connection->protseq = protseq;
@@ -446,6 +474,11 @@ static int rpcrt4_conn_np_close(RpcConnection *conn)
         CloseHandle(connection->event_cache);
         connection->event_cache = 0;
     }
+    if (connection->shm_marker)
+    {
+        CloseHandle(connection->shm_marker);
+        connection->shm_marker = 0;
+    }
     return 0;
 }
 
@@ -470,6 +503,402 @@ static int rpcrt4_conn_np_wait_for_incoming_data(RpcConnection *Connection)
     return -1;
 }
 
+/**** ncalrpc shared memory support ****/
+
+/* Once an ncalrpc pipe is connected, the client may move the data path to a
+ * shared memory section holding one ring buffer per direction. The packets
+ * going through the rings are the same as on the pipe, which stays open to
+ * track the connection and to impersonate the client. The switch is
+ * requested with a private packet, sent only to servers that created the
+ * endpoint marker; anything that fails leaves the connection on the pipe. */
+
+#define PKT_WINE_LRPC_SHM   0x7f
+#define LRPC_SHM_RING_SIZE  0x10000
+
+struct lrpc_ring
+{
+    LONG read_pos;
+    LONG write_pos;
+    LONG reader_waiting;
+    LONG writer_waiting;
+    LONG closed;
+    unsigned char data[LRPC_SHM_RING_SIZE];
+};
+
+/* ring 0 carries data from the client to the server, ring 1 the replies */
+struct lrpc_shm_view
+{
+    struct lrpc_ring ring[2];
+};
+
+struct lrpc_shm
+{
+    HANDLE mapping;
+    struct lrpc_shm_view *view;
+    HANDLE data_event[2];
+    HANDLE space_event[2];
+    HANDLE peer;
+    unsigned int in;
+    unsigned int out;
+    BOOL cancelled;
+    CRITICAL_SECTION write_cs;
+};
+
+#include "pshpack1.h"
+struct lrpc_shm_packet
+{
+    RpcPktCommonHdr common;
+    ULONG status;
+    ULONG id;
+};
+#include "poppack.h"
+
+/* The section is created by the client. Its name is built from the client
+ * process id, which the server gets from the pipe rather than from the
+ * client, so that a client can't make the server open some other section. */
+static void lrpc_shm_name(char *name, size_t size, ULONG pid, ULONG id)
+{
+    snprintf(name, size, "__wine_lrpc_%08x_%08x", pid, id);
+}
+
+static void lrpc_shm_free(struct lrpc_shm *shm)
+{
+    unsigned int i;
+
+    if (shm->view)
+    {
+        shm->view->ring[0].closed = shm->view->ring[1].closed = TRUE;
+        for (i = 0; i < 2; i++)
+        {
+            if (shm->data_event[i]) SetEvent(shm->data_event[i]);
+            if (shm->space_event[i]) SetEvent(shm->space_event[i]);
+        }
+        UnmapViewOfFile(shm->view);
+    }
+    for (i = 0; i < 2; i++)
+    {
+        if (shm->data_event[i]) CloseHandle(shm->data_event[i]);
+        if (shm->space_event[i]) CloseHandle(shm->space_event[i]);
+    }
+    if (shm->peer) CloseHandle(shm->peer);
+    if (shm->mapping) CloseHandle(shm->mapping);
+    shm->write_cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection(&shm->write_cs);
+    HeapFree(GetProcessHeap(), 0, shm);
+}
+
+static HANDLE lrpc_shm_event(const char *name, const char *suffix, BOOL create)
+{
+    char event_name[64];
+
+    snprintf(event_name, sizeof(event_name), "%s%s", name, suffix);
+    if (create) return CreateEventA(NULL, FALSE, FALSE, event_name);
+    return OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, event_name);
+}
+
+/* The client creates the shared objects, the server opens them by name. */
+static struct lrpc_shm *lrpc_shm_open(const char *name, BOOL create, ULONG peer_pid)
+{
+    struct lrpc_shm *shm;
+
+    if (!(shm = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*shm))))
+        return NULL;
+    InitializeCriticalSection(&shm->write_cs);
+    shm->write_cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": lrpc_shm.write_cs");
+    shm->out = create ? 0 : 1;
+    shm->in = create ? 1 : 0;
+
+    if (create)
+    {
+        shm->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+                                          sizeof(struct lrpc_shm_view), name);
+        if (shm->mapping && GetLastError() == ERROR_ALREADY_EXISTS)
+        {
+            CloseHandle(shm->mapping);
+            shm->mapping = NULL;
+        }
+    }
+    else
+        shm->mapping = OpenFileMappingA(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, name);
+    if (!shm->mapping) goto fail;
+
+    if (!(shm->view = MapViewOfFile(shm->mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0,
+                                    sizeof(struct lrpc_shm_view))))
+        goto fail;
+
+    if (!(shm->data_event[0] = lrpc_shm_event(name, "_d0", create)) ||
+        !(shm->data_event[1] = lrpc_shm_event(name, "_d1", create)) ||
+        !(shm->space_event[0] = lrpc_shm_event(name, "_s0", create)) ||
+        !(shm->space_event[1] = lrpc_shm_event(name, "_s1", create)))
+        goto fail;
+
+    if (!(shm->peer = OpenProcess(SYNCHRONIZE, FALSE, peer_pid)))
+        goto fail;
+
+    return shm;
+
+fail:
+    WARN("failed to set up shared memory %s, error %u\n", debugstr_a(name), GetLastError());
+    /* don't mark the rings closed, the peer might still fall back to the pipe */
+    if (shm->view)
+    {
+        UnmapViewOfFile(shm->view);
+        shm->view = NULL;
+    }
+    lrpc_shm_free(shm);
+    return NULL;
+}
+
+/* Wait for one of our events, or for the peer to go away. */
+static BOOL lrpc_shm_wait(struct lrpc_shm *shm, HANDLE event)
+{
+    HANDLE handles[2] = { event, shm->peer };
+
+    return WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0;
+}
+
+static int lrpc_shm_read(RpcConnection_np *npc, void *buffer, unsigned int count)
+{
+    struct lrpc_shm *shm = npc->shm;
+    struct lrpc_ring *ring = &shm->view->ring[shm->in];
+    unsigned char *data = buffer;
+    unsigned int done = 0;
+
+    while (done < count)
+    {
+        ULONG read_pos = ring->read_pos;
+        /* interlocked read, so that the data is read after the position */
+        ULONG avail = (ULONG)InterlockedCompareExchange(&ring->write_pos, 0, 0) - read_pos;
+
+        if (avail)
+        {
+            ULONG offset = read_pos % LRPC_SHM_RING_SIZE;
+            ULONG len = min(avail, count - done);
+
+            if (offset + len > LRPC_SHM_RING_SIZE)
+            {
+                ULONG first = LRPC_SHM_RING_SIZE - offset;
+                memcpy(data + done, ring->data + offset, first);
+                memcpy(data + done + first, ring->data, len - first);
+            }
+            else
+                memcpy(data + done, ring->data + offset, len);
+            InterlockedExchange(&ring->read_pos, read_pos + len);
+            if (ring->writer_waiting && InterlockedExchange(&ring->writer_waiting, 0))
+                SetEvent(shm->space_event[shm->in]);
+            done += len;
+            continue;
+        }
+
+        if (npc->read_closed || ring->closed) return -1;
+        if (shm->cancelled)
+        {
+            shm->cancelled = FALSE;
+            return -1;
+        }
+
+        InterlockedExchange(&ring->reader_waiting, 1);
+        if ((ULONG)*(volatile LONG *)&ring->write_pos != read_pos) continue;
+        if (!lrpc_shm_wait(shm, shm->data_event[shm->in])) return -1;
+    }
+    return count;
+}
+
+static int lrpc_shm_write(RpcConnection_np *npc, const void *buffer, unsigned int count)
+{
+    struct lrpc_shm *shm = npc->shm;
+    struct lrpc_ring *ring = &shm->view->ring[shm->out];
+    const unsigned char *data = buffer;
+    unsigned int done = 0;
+
+    EnterCriticalSection(&shm->write_cs);
+    while (done < count)
+    {
+        ULONG write_pos = ring->write_pos;
+        ULONG space = LRPC_SHM_RING_SIZE - (write_pos - (ULONG)*(volatile LONG *)&ring->read_pos);
+
+        if (ring->closed) break;
+
+        if (space)
+        {
+            ULONG offset = write_pos % LRPC_SHM_RING_SIZE;
+            ULONG len = min(space, count - done);
+
+            if (offset + len > LRPC_SHM_RING_SIZE)
+            {
+                ULONG first = LRPC_SHM_RING_SIZE - offset;
+                memcpy(ring->data + offset, data + done, first);
+                memcpy(ring->data, data + done + first, len - first);
+            }
+            else
+                memcpy(ring->data + offset, data + done, len);
+            InterlockedExchange(&ring->write_pos, write_pos + len);
+            if (ring->reader_waiting && InterlockedExchange(&ring->reader_waiting, 0))
+                SetEvent(shm->data_event[shm->out]);
+            done += len;
+            continue;
+        }
+
+        InterlockedExchange(&ring->writer_waiting, 1);
+        if ((ULONG)*(volatile LONG *)&ring->read_pos != write_pos - LRPC_SHM_RING_SIZE) continue;
+        if (!lrpc_shm_wait(shm, shm->space_event[shm->out])) break;
+    }
+    LeaveCriticalSection(&shm->write_cs);
+    return done == count ? count : -1;
+}
+
+static void init_lrpc_shm_packet(struct lrpc_shm_packet *packet)
+{
+    memset(packet, 0, sizeof(*packet));
+    packet->common.rpc_ver = RPC_VER_MAJOR;
+    packet->common.rpc_ver_minor = RPC_VER_MINOR;
+    packet->common.ptype = PKT_WINE_LRPC_SHM;
+    packet->common.flags = RPC_FLG_FIRST | RPC_FLG_LAST;
+    packet->common.drep[0] = (NDR_LOCAL_DATA_REPRESENTATION >> 0) & 0xff;
+    packet->common.drep[1] = (NDR_LOCAL_DATA_REPRESENTATION >> 8) & 0xff;
+    packet->common.frag_len = sizeof(*packet);
+}
+
+static void rpcrt4_ncalrpc_shm_connect(RpcConnection_np *npc)
+{
+    static LONG lrpc_shm_id;
+    struct lrpc_shm_packet packet;
+    struct lrpc_shm *shm;
+    char marker[MAX_PATH], name[32];
+    HANDLE event;
+    ULONG pid;
+
+    if (!ncalrpc_shm_marker_name(npc->common.Endpoint, marker, sizeof(marker)))
+        return;
+    if (!(event = OpenEventA(SYNCHRONIZE, FALSE, marker)))
+        return;
+    CloseHandle(event);
+
+    if (!GetNamedPipeServerProcessId(npc->pipe, &pid))
+        return;
+
+    init_lrpc_shm_packet(&packet);
+    packet.id = InterlockedIncrement(&lrpc_shm_id);
+    lrpc_shm_name(name, sizeof(name), GetCurrentProcessId(), packet.id);
+    if (!(shm = lrpc_shm_open(name, TRUE, pid)))
+        return;
+
+    if (rpcrt4_conn_np_write(&npc->common, &packet, sizeof(packet)) != sizeof(packet) ||
+        rpcrt4_conn_np_read(&npc->common, &packet, sizeof(packet)) != sizeof(packet) ||
+        packet.common.ptype != PKT_WINE_LRPC_SHM || packet.status != RPC_S_OK)
+    {
+        TRACE("server refused shared memory, using the pipe\n");
+        lrpc_shm_free(shm);
+        return;
+    }
+
+    TRACE("using shared memory for %s\n", debugstr_a(npc->common.Endpoint));
+    npc->shm = shm;
+}
+
+/* Called for the first header read of a server connection, to check for a
+ * request to switch to shared memory. */
+static int rpcrt4_ncalrpc_shm_accept(RpcConnection_np *npc, void *buffer, unsigned int count)
+{
+    const RpcPktCommonHdr *hdr = buffer;
+    struct lrpc_shm_packet packet;
+    struct lrpc_shm *shm = NULL;
+    char name[32];
+    int ret;
+    ULONG pid;
+
+    ret = rpcrt4_conn_np_read(&npc->common, buffer, count);
+    if (count != sizeof(RpcPktCommonHdr) || ret != sizeof(RpcPktCommonHdr) ||
+        hdr->rpc_ver != RPC_VER_MAJOR || hdr->ptype != PKT_WINE_LRPC_SHM ||
+        hdr->frag_len != sizeof(packet))
+        return ret;
+
+    packet.common = *hdr;
+    if (rpcrt4_conn_np_read(&npc->common, &packet.status, sizeof(packet) - sizeof(*hdr)) !=
+        sizeof(packet) - sizeof(*hdr))
+        return -1;
+
+    if (GetNamedPipeClientProcessId(npc->pipe, &pid))
+    {
+        lrpc_shm_name(name, sizeof(name), pid, packet.id);
+        shm = lrpc_shm_open(name, FALSE, pid);
+    }
+
+    init_lrpc_shm_packet(&packet);
+    packet.status = shm ? RPC_S_OK : RPC_S_OUT_OF_RESOURCES;
+    if (rpcrt4_conn_np_write(&npc->common, &packet, sizeof(packet)) != sizeof(packet))
+    {
+        if (shm) lrpc_shm_free(shm);
+        return -1;
+    }
+    npc->shm = shm;
+
+    /* the actual packet follows on the new data path */
+    if (shm) return lrpc_shm_read(npc, buffer, count);
+    return rpcrt4_conn_np_read(&npc->common, buffer, count);
+}
+
+static int rpcrt4_conn_lrpc_read(RpcConnection *conn, void *buffer, unsigned int count)
+{
+    RpcConnection_np *npc = (RpcConnection_np *)conn;
+
+    if (conn->server && !npc->shm_checked)
+    {
+        npc->shm_checked = TRUE;
+        return rpcrt4_ncalrpc_shm_accept(npc, buffer, count);
+    }
+    if (npc->shm)
+        return lrpc_shm_read(npc, buffer, count);
+    return rpcrt4_conn_np_read(conn, buffer, count);
+}
+
+static int rpcrt4_conn_lrpc_write(RpcConnection *conn, const void *buffer, unsigned int count)
+{
+    RpcConnection_np *npc = (RpcConnection_np *)conn;
+
+    if (npc->shm)
+        return lrpc_shm_write(npc, buffer, count);
+    return rpcrt4_conn_np_write(conn, buffer, count);
+}
+
+static int rpcrt4_conn_lrpc_close(RpcConnection *conn)
+{
+    RpcConnection_np *npc = (RpcConnection_np *)conn;
+
+    if (npc->shm)
+    {
+        lrpc_shm_free(npc->shm);
+        npc->shm = NULL;
+    }
+    return rpcrt4_conn_np_close(conn);
+}
+
+static void rpcrt4_conn_lrpc_close_read(RpcConnection *conn)
+{
+    RpcConnection_np *npc = (RpcConnection_np *)conn;
+
+    if (npc->shm)
+    {
+        npc->read_closed = TRUE;
+        SetEvent(npc->shm->data_event[npc->shm->in]);
+    }
+    else
+        rpcrt4_conn_np_close_read(conn);
+}
+
+static void rpcrt4_conn_lrpc_cancel_call(RpcConnection *conn)
+{
+    RpcConnection_np *npc = (RpcConnection_np *)conn;
+
+    if (npc->shm)
+    {
+        npc->shm->cancelled = TRUE;
+        SetEvent(npc->shm->data_event[npc->shm->in]);
+    }
+    else
+        rpcrt4_conn_np_cancel_call(conn);
+}
+
 static size_t rpcrt4_ncacn_np_get_top_of_tower(unsigned char *tower_data,
                                                const char *networkaddr,
                                                const char *endpoint)
@@ -3160,11 +3589,11 @@ static const struct connection_ops conn_protseq_list[] = {
     rpcrt4_conn_np_alloc,
     rpcrt4_ncalrpc_open,
     rpcrt4_ncalrpc_handoff,
-    rpcrt4_conn_np_read,
-    rpcrt4_conn_np_write,
-    rpcrt4_conn_np_close,
-    rpcrt4_conn_np_close_read,
-    rpcrt4_conn_np_cancel_call,
+    rpcrt4_conn_lrpc_read,
+    rpcrt4_conn_lrpc_write,
+    rpcrt4_conn_lrpc_close,
+    rpcrt4_conn_lrpc_close_read,
+    rpcrt4_conn_lrpc_cancel_call,
     rpcrt4_ncalrpc_np_is_server_listening,
     rpcrt4_conn_np_wait_for_incoming_data,
     rpcrt4_ncalrpc_get_top_of_tower,
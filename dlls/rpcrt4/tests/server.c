@@ -1845,6 +1845,30 @@ static void test_handle_return(void)
     test_handle(handle2);
 }
 
+/* Between processes, ncalrpc may carry the data through a shared memory
+ * ring; make the requests larger than it, and make a lot of small calls. */
+static void lrpc_shm_tests(void)
+{
+  static const int sizes[] = {100000, 16383, 16384, 16385};
+  int *x, i, j, sum, failures = 0;
+
+  x = HeapAlloc(GetProcessHeap(), 0, sizes[0] * sizeof(*x));
+  for (i = 0; i < ARRAY_SIZE(sizes); i++)
+  {
+    for (j = sum = 0; j < sizes[i]; j++)
+    {
+      x[j] = (j + i) % 1000;
+      sum += x[j];
+    }
+    ok(sum_conf_array(x, sizes[i]) == sum, "RPC sum_conf_array(%d)\n", sizes[i]);
+  }
+  HeapFree(GetProcessHeap(), 0, x);
+
+  for (i = 0; i < 1000; i++)
+    if (int_return() != INT_CODE) failures++;
+  ok(!failures, "%d calls failed\n", failures);
+}
+
 static void
 run_tests(void)
 {
@@ -1936,6 +1960,7 @@ client(const char *test)
     ok(RPC_S_OK == RpcBindingFromStringBindingA(binding, &IMixedServer_IfHandle), "RpcBindingFromStringBinding\n");
 
     run_tests(); /* can cause RPC_X_BAD_STUB_DATA exception */
+    lrpc_shm_tests();
     authinfo_test(RPC_PROTSEQ_LRPC, 0);
     test_is_server_listening(IMixedServer_IfHandle, RPC_S_OK);
 
@@ -452,12 +452,35 @@ SHORT WINAPI DECLSPEC_HOTPATCH GetAsyncKeyState( INT key )
 }
 
 
+/***********************************************************************
+ *		get_shm_queue_bits
+ *
+ * Read a consistent copy of the queue bits published by the server.
+ */
+static BOOL get_shm_queue_bits( const shmlocal_t *shm, DWORD *wake_bits, DWORD *changed_bits )
+{
+    const volatile shmlocal_t *vshm = shm;
+    unsigned int seq;
+    int i;
+
+    for (i = 0; i < 16; i++)
+    {
+        if ((seq = vshm->queue_seq) & 1) continue;  /* being updated */
+        *wake_bits    = vshm->queue_bits;
+        *changed_bits = vshm->changed_bits;
+        if (vshm->queue_seq == seq) return TRUE;
+    }
+    return FALSE;
+}
+
+
 /***********************************************************************
  *		GetQueueStatus (USER32.@)
  */
 DWORD WINAPI GetQueueStatus( UINT flags )
 {
-    DWORD ret;
+    shmlocal_t *shm = wine_get_shmlocal();
+    DWORD ret, wake_bits, changed_bits, cached_bits;
 
     if (flags & ~(QS_ALLINPUT | QS_ALLPOSTMESSAGE | QS_SMRESULT))
     {
@@ -466,12 +489,18 @@ DWORD WINAPI GetQueueStatus( UINT flags )
     }
 
     check_for_events( flags );
+    cached_bits = get_cached_queue_bits();
+
+    /* nothing to clear in the server if none of the requested bits changed; the server
+     * resets the esync queue fd by itself whenever the queue stops being signaled */
+    if (shm && get_shm_queue_bits( shm, &wake_bits, &changed_bits ) && !(changed_bits & flags))
+        return MAKELONG( 0, (wake_bits | cached_bits) & flags );
 
     SERVER_START_REQ( get_queue_status )
     {
         req->clear_bits = flags;
         wine_server_call( req );
-        ret = MAKELONG( reply->changed_bits & flags, reply->wake_bits & flags );
+        ret = MAKELONG( reply->changed_bits & flags, (reply->wake_bits | cached_bits) & flags );
     }
     SERVER_END_REQ;
     return ret;
@@ -264,6 +264,15 @@ struct received_message_info
     UINT              flags;  /* InSendMessageEx return flags */
 };
 
+/* posted messages returned by the server along with the one that was requested */
+#define POSTED_CACHE_SIZE 8
+
+struct posted_message_cache
+{
+    unsigned int     count;   /* number of messages in the cache */
+    posted_message_t msgs[POSTED_CACHE_SIZE];
+};
+
 /* structure to group all parameters for sent messages of the various kinds */
 struct send_message_info
 {
@@ -2740,6 +2749,122 @@ static inline void call_sendmsg_callback( SENDASYNCPROC callback, HWND hwnd, UIN
 }
 
 
+static inline unsigned int get_cached_message_count( const struct user_thread_info *thread_info )
+{
+    const struct posted_message_cache *cache = thread_info->posted_cache;
+    return cache ? cache->count : 0;
+}
+
+
+/***********************************************************************
+ *           get_cached_queue_bits
+ *
+ * Return the queue bits for the posted messages that have already been
+ * removed from the server queue but not yet returned to the application.
+ */
+DWORD get_cached_queue_bits(void)
+{
+    if (!get_cached_message_count( get_user_thread_info() )) return 0;
+    return QS_POSTMESSAGE | QS_ALLPOSTMESSAGE;
+}
+
+
+static struct posted_message_cache *get_posted_cache( struct user_thread_info *thread_info )
+{
+    if (!thread_info->posted_cache)
+        thread_info->posted_cache = HeapAlloc( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                               sizeof(*thread_info->posted_cache) );
+    return thread_info->posted_cache;
+}
+
+
+/***********************************************************************
+ *           remove_cached_message
+ */
+static void remove_cached_message( struct posted_message_cache *cache, unsigned int index )
+{
+    cache->count--;
+    memmove( &cache->msgs[index], &cache->msgs[index + 1],
+             (cache->count - index) * sizeof(cache->msgs[0]) );
+}
+
+
+/***********************************************************************
+ *           match_cached_window
+ *
+ * Same check as match_window in the server: the filter matches the window
+ * itself and every window below it in the parent chain, whatever its style.
+ */
+static BOOL match_cached_window( HWND filter, HWND win )
+{
+    if (!filter) return TRUE;
+    if (filter == HWND_TOPMOST || filter == HWND_BOTTOM) return !win;
+    if (win == filter) return TRUE;
+    if (!win) return FALSE;
+    while ((win = GetAncestor( win, GA_PARENT )))
+        if (win == filter) return TRUE;
+    return FALSE;
+}
+
+
+/***********************************************************************
+ *           peek_cached_message
+ *
+ * Return the first cached posted message matching the given parameters.
+ */
+static BOOL peek_cached_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags )
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    struct posted_message_cache *cache = thread_info->posted_cache;
+    shmlocal_t *shm = wine_get_shmlocal();
+    UINT filter = flags >> 16;
+    unsigned int i;
+
+    if (!get_cached_message_count( thread_info )) return FALSE;
+    if (filter && !(filter & QS_POSTMESSAGE)) return FALSE;
+    /* pending sent messages have to be processed first */
+    if (!shm || (shm->queue_bits & QS_SENDMESSAGE)) return FALSE;
+    /* cached entries carry full handles */
+    if (hwnd && hwnd != HWND_TOPMOST && hwnd != HWND_BOTTOM) hwnd = WIN_GetFullHandle( hwnd );
+
+    for (i = 0; i < cache->count; i++)
+    {
+        const posted_message_t *posted = &cache->msgs[i];
+        HWND win = wine_server_ptr_handle( posted->win );
+
+        if (win && !IsWindow( win ))
+        {
+            /* the window was destroyed after the message was fetched */
+            remove_cached_message( cache, i-- );
+            continue;
+        }
+        if (posted->msg < first || posted->msg > last) continue;
+        if (!match_cached_window( hwnd, win )) continue;
+
+        msg->hwnd    = win;
+        msg->message = posted->msg;
+        msg->wParam  = posted->wparam;
+        msg->lParam  = posted->lparam;
+        msg->time    = posted->time;
+        msg->pt.x    = posted->x;
+        msg->pt.y    = posted->y;
+        if (flags & PM_REMOVE) remove_cached_message( cache, i );
+
+        TRACE( "got cached msg %x (%s) hwnd %p wp %lx lp %lx\n", msg->message,
+               SPY_GetMsgName( msg->message, msg->hwnd ), msg->hwnd, msg->wParam, msg->lParam );
+
+        msg->pt = point_phys_to_win_dpi( msg->hwnd, msg->pt );
+        thread_info->GetMessagePosVal = MAKELONG( msg->pt.x, msg->pt.y );
+        thread_info->GetMessageTimeVal = msg->time;
+        thread_info->GetMessageExtraInfoVal = 0;
+        thread_info->msg_source = msg_source_unavailable;
+        HOOK_CallHooks( WH_GETMESSAGE, HC_ACTION, flags & PM_REMOVE, (LPARAM)msg, TRUE );
+        return TRUE;
+    }
+    return FALSE;
+}
+
+
 /***********************************************************************
  *           peek_message
  *
@@ -2759,7 +2884,7 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
 
     /* From time to time we are forced to do a wineserver call in
      * order to update last_msg_time stored for each server thread. */
-    if (shm && GetTickCount() - thread_info->last_get_msg < 500)
+    if (shm && GetTickCount() - thread_info->last_get_msg < 500 && !get_cached_message_count( thread_info ))
     {
         int filter = flags >> 16;
         if (!filter) filter = QS_ALLINPUT;
@@ -2777,10 +2902,23 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
     {
         NTSTATUS res;
         size_t size = 0;
+        unsigned int prefetch = 0, prefetched = 0;
         const message_data_t *msg_data = buffer;
 
         thread_info->msg_source = prev_source;
 
+        if (peek_cached_message( msg, hwnd, first, last, flags ))
+        {
+            HeapFree( GetProcessHeap(), 0, buffer );
+            return TRUE;
+        }
+
+        /* an unfiltered GetMessage loop can take several posted messages at once */
+        if (shm && (flags & PM_REMOVE) && !hwnd && !first && last == ~0U &&
+            (!HIWORD(flags) || (HIWORD(flags) & QS_POSTMESSAGE)) &&
+            !get_cached_message_count( thread_info ) && get_posted_cache( thread_info ))
+            prefetch = min( POSTED_CACHE_SIZE, buffer_size / sizeof(posted_message_t) );
+
         if (shm) thread_info->last_get_msg = GetTickCount();
 
         SERVER_START_REQ( get_message )
@@ -2792,6 +2930,7 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
             req->hw_id     = hw_id;
             req->wake_mask = changed_mask & (QS_SENDMESSAGE | QS_SMRESULT);
             req->changed_mask = changed_mask;
+            req->prefetch  = prefetch;
             wine_server_set_reply( req, buffer, buffer_size );
             if (!(res = wine_server_call( req )))
             {
@@ -2805,6 +2944,7 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
                 info.msg.pt.x    = reply->x;
                 info.msg.pt.y    = reply->y;
                 hw_id            = 0;
+                prefetched       = reply->prefetched;
                 thread_info->active_hooks = reply->active_hooks;
             }
             else buffer_size = reply->total;
@@ -2969,6 +3109,11 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
                                          &info.msg.lParam, &buffer, size ))
                     continue;  /* ignore it */
 	    }
+            if (prefetched && size >= prefetched * sizeof(posted_message_t))
+            {
+                memcpy( thread_info->posted_cache->msgs, buffer, prefetched * sizeof(posted_message_t) );
+                thread_info->posted_cache->count = prefetched;
+            }
             *msg = info.msg;
             msg->pt = point_phys_to_win_dpi( info.msg.hwnd, info.msg.pt );
             thread_info->GetMessagePosVal = MAKELONG( msg->pt.x, msg->pt.y );
@@ -3087,6 +3232,9 @@ static DWORD wait_objects( DWORD count, const HANDLE *handles, DWORD timeout,
 
     flush_window_surfaces( TRUE );
 
+    /* posted messages already fetched from the server don't signal the queue */
+    if (wake_mask & get_cached_queue_bits()) return WAIT_OBJECT_0 + count - 1;
+
     if (thread_info->wake_mask != wake_mask || thread_info->changed_mask != changed_mask)
     {
         SERVER_START_REQ( set_queue_mask )
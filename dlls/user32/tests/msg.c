@@ -12473,6 +12473,49 @@ static const struct message WmStopQuitSeq[] = {
     { 0 }
 };
 
+static void test_posted_message_order(void)
+{
+    DWORD status;
+    MSG msg;
+    BOOL ret;
+    int i;
+
+    flush_events();
+    for (i = 0; i < 5; i++)
+    {
+        ret = PostThreadMessageA(GetCurrentThreadId(), WM_USER + i, i, 0);
+        ok(ret, "PostThreadMessage failed with error %d\n", GetLastError());
+    }
+    PostQuitMessage(0xbeef);
+
+    ret = GetMessageA(&msg, NULL, 0, 0);
+    ok(ret > 0, "GetMessage failed with error %d\n", GetLastError());
+    ok(msg.message == WM_USER, "Received message 0x%04x instead of WM_USER\n", msg.message);
+
+    status = GetQueueStatus(QS_POSTMESSAGE);
+    ok(HIWORD(status) & QS_POSTMESSAGE, "wrong status %08x\n", status);
+    status = MsgWaitForMultipleObjectsEx(0, NULL, 0, QS_POSTMESSAGE, MWMO_INPUTAVAILABLE);
+    ok(status == WAIT_OBJECT_0, "MsgWaitForMultipleObjectsEx returned %x\n", status);
+
+    ret = PeekMessageA(&msg, NULL, WM_USER + 3, WM_USER + 3, PM_REMOVE);
+    ok(ret, "PeekMessage failed with error %d\n", GetLastError());
+    ok(msg.message == WM_USER + 3, "Received message 0x%04x instead of WM_USER+3\n", msg.message);
+
+    for (i = 1; i < 5; i++)
+    {
+        if (i == 3) continue;
+        ret = PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE);
+        ok(ret, "%d: PeekMessage failed with error %d\n", i, GetLastError());
+        ok(msg.message == WM_USER + i, "%d: Received message 0x%04x\n", i, msg.message);
+        ok(msg.wParam == i, "%d: wParam was 0x%lx\n", i, msg.wParam);
+    }
+
+    ret = GetMessageA(&msg, NULL, 0, 0);
+    ok(!ret, "GetMessage return %d with error %d instead of FALSE\n", ret, GetLastError());
+    ok(msg.message == WM_QUIT, "Received message 0x%04x instead of WM_QUIT\n", msg.message);
+    ok(msg.wParam == 0xbeef, "wParam was 0x%lx instead of 0xbeef\n", msg.wParam);
+}
+
 static void test_quit_message(void)
 {
     MSG msg;
@@ -17686,6 +17729,7 @@ START_TEST(msg)
     test_SendMessageTimeout();
     test_edit_messages();
     test_quit_message();
+    test_posted_message_order();
     test_notify_message();
     test_SetActiveWindow();
 
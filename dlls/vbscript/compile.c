@@ -65,6 +65,7 @@ typedef struct {
     function_decl_t *func_decls;
 
     class_desc_t *classes;
+    class_decl_t *class_decl;
 } compile_ctx_t;
 
 static HRESULT compile_expression(compile_ctx_t*,expression_t*);
@@ -1324,6 +1325,93 @@ static HRESULT fill_array_desc(compile_ctx_t *ctx, dim_decl_t *dim_decl, array_d
     return S_OK;
 }
 
+static BOOL lookup_local_slot(compile_ctx_t *ctx, function_t *func, const WCHAR *name, unsigned *ret)
+{
+    dim_decl_t *prop_decl;
+    unsigned i;
+
+    /* Assigning to the function name sets its return value, leave it to run time lookup. */
+    if(!strcmpiW(name, func->name))
+        return FALSE;
+
+    for(i=0; i < func->var_cnt; i++) {
+        if(!strcmpiW(func->vars[i].name, name)) {
+            *ret = MAKE_SLOT(SLOT_VAR, i);
+            return TRUE;
+        }
+    }
+
+    for(i=0; i < func->arg_cnt; i++) {
+        if(!strcmpiW(func->args[i].name, name)) {
+            *ret = MAKE_SLOT(SLOT_ARG, i);
+            return TRUE;
+        }
+    }
+
+    if(ctx->class_decl) {
+        for(prop_decl = ctx->class_decl->props, i=0; prop_decl; prop_decl = prop_decl->next, i++) {
+            if(!strcmpiW(prop_decl->name, name)) {
+                *ret = MAKE_SLOT(SLOT_PROP, i);
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+/* Replaces identifiers referring to local variables, arguments and class properties
+ * with instructions addressing them directly, so that they don't need to be looked
+ * up by name on each access. */
+static void bind_identifiers(compile_ctx_t *ctx, function_t *func)
+{
+    instr_t *instr;
+    unsigned slot;
+
+    for(instr = ctx->code->instrs+func->code_off; instr < ctx->code->instrs+ctx->instr_cnt; instr++) {
+        switch(instr->op) {
+        case OP_icall:
+            if(lookup_local_slot(ctx, func, instr->arg1.bstr, &slot)) {
+                instr->op = OP_local;
+                instr->arg1.uint = slot;
+            }
+            break;
+        case OP_assign_ident:
+            if(lookup_local_slot(ctx, func, instr->arg1.bstr, &slot)) {
+                instr->op = OP_assign_local;
+                instr->arg1.uint = slot;
+            }
+            break;
+        case OP_set_ident:
+            if(lookup_local_slot(ctx, func, instr->arg1.bstr, &slot)) {
+                instr->op = OP_set_local;
+                instr->arg1.uint = slot;
+            }
+            break;
+        case OP_incc:
+            if(lookup_local_slot(ctx, func, instr->arg1.bstr, &slot)) {
+                instr->op = OP_incc_local;
+                instr->arg1.uint = slot;
+            }
+            break;
+        case OP_step:
+            if(lookup_local_slot(ctx, func, instr->arg2.bstr, &slot)) {
+                instr->op = OP_step_local;
+                instr->arg2.uint = slot;
+            }
+            break;
+        case OP_enumnext:
+            if(lookup_local_slot(ctx, func, instr->arg2.bstr, &slot)) {
+                instr->op = OP_enumnext_local;
+                instr->arg2.uint = slot;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
 static HRESULT compile_func(compile_ctx_t *ctx, statement_t *stat, function_t *func)
 {
     HRESULT hres;
@@ -1436,6 +1524,9 @@ static HRESULT compile_func(compile_ctx_t *ctx, statement_t *stat, function_t *f
         assert(array_id == func->array_cnt);
     }
 
+    if(func->type != FUNC_GLOBAL)
+        bind_identifiers(ctx, func);
+
     return S_OK;
 }
 
@@ -1611,6 +1702,8 @@ static HRESULT compile_class(compile_ctx_t *ctx, class_decl_t *class_decl)
         return E_OUTOFMEMORY;
     memset(class_desc->funcs, 0, class_desc->func_cnt*sizeof(*class_desc->funcs));
 
+    ctx->class_decl = class_decl;
+
     for(func_decl = class_decl->funcs, i=1; func_decl; func_decl = func_decl->next, i++) {
         for(func_prop_decl = func_decl; func_prop_decl; func_prop_decl = func_prop_decl->next_prop_func) {
             if(func_prop_decl->type == FUNC_DEFGET) {
@@ -1622,6 +1715,7 @@ static HRESULT compile_class(compile_ctx_t *ctx, class_decl_t *class_decl)
         if(!strcmpiW(class_initializeW, func_decl->name)) {
             if(func_decl->type != FUNC_SUB) {
                 FIXME("class initializer is not sub\n");
+                ctx->class_decl = NULL;
                 return E_FAIL;
             }
 
@@ -1629,6 +1723,7 @@ static HRESULT compile_class(compile_ctx_t *ctx, class_decl_t *class_decl)
         }else  if(!strcmpiW(class_terminateW, func_decl->name)) {
             if(func_decl->type != FUNC_SUB) {
                 FIXME("class terminator is not sub\n");
+                ctx->class_decl = NULL;
                 return E_FAIL;
             }
 
@@ -1636,10 +1731,14 @@ static HRESULT compile_class(compile_ctx_t *ctx, class_decl_t *class_decl)
         }
 
         hres = create_class_funcprop(ctx, func_decl, class_desc->funcs + (func_prop_decl ? 0 : i));
-        if(FAILED(hres))
+        if(FAILED(hres)) {
+            ctx->class_decl = NULL;
             return hres;
+        }
     }
 
+    ctx->class_decl = NULL;
+
     for(prop_decl = class_decl->props; prop_decl; prop_decl = prop_decl->next)
         class_desc->prop_cnt++;
 
@@ -1686,18 +1785,9 @@ static HRESULT compile_class(compile_ctx_t *ctx, class_decl_t *class_decl)
 static BOOL lookup_script_identifier(script_ctx_t *script, const WCHAR *identifier)
 {
     class_desc_t *class;
-    dynamic_var_t *var;
-    function_t *func;
 
-    for(var = script->global_vars; var; var = var->next) {
-        if(!strcmpiW(var->name, identifier))
-            return TRUE;
-    }
-
-    for(func = script->global_funcs; func; func = func->next) {
-        if(!strcmpiW(func->name, identifier))
-            return TRUE;
-    }
+    if(lookup_global_var(script, identifier) || lookup_global_func(script, identifier))
+        return TRUE;
 
     for(class = script->classes; class; class = class->next) {
         if(!strcmpiW(class->name, identifier))
@@ -1818,6 +1908,7 @@ HRESULT compile_script(script_ctx_t *script, const WCHAR *src, const WCHAR *deli
     ctx.func_decls = NULL;
     ctx.global_vars = NULL;
     ctx.classes = NULL;
+    ctx.class_decl = NULL;
     ctx.labels = NULL;
     ctx.global_consts = NULL;
     ctx.stat_ctx = NULL;
@@ -1859,6 +1950,8 @@ HRESULT compile_script(script_ctx_t *script, const WCHAR *src, const WCHAR *deli
     if(ctx.global_vars) {
         dynamic_var_t *var;
 
+        add_global_vars(script, ctx.global_vars);
+
         for(var = ctx.global_vars; var->next; var = var->next);
 
         var->next = script->global_vars;
@@ -1866,6 +1959,8 @@ HRESULT compile_script(script_ctx_t *script, const WCHAR *src, const WCHAR *deli
     }
 
     if(ctx.funcs) {
+        add_global_funcs(script, ctx.funcs);
+
         for(new_func = ctx.funcs; new_func->next; new_func = new_func->next);
 
         new_func->next = script->global_funcs;
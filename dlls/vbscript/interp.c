@@ -39,6 +39,8 @@ typedef struct {
     SAFEARRAY **arrays;
 
     dynamic_var_t *dynamic_vars;
+    dynamic_var_t **dynamic_vars_hash;
+    unsigned dynamic_var_cnt;
     heap_pool_t heap;
 
     BOOL resume_next;
@@ -80,19 +82,94 @@ typedef struct {
     BOOL owned;
 } variant_val_t;
 
-static BOOL lookup_dynamic_vars(dynamic_var_t *var, const WCHAR *name, ref_t *ref)
+/* Procedures that create more dynamic variables than this get a hash table for them. */
+#define DYNAMIC_VARS_HASH_MIN 8
+
+static BOOL lookup_dynamic_vars(exec_ctx_t *ctx, const WCHAR *name, ref_t *ref)
 {
-    while(var) {
-        if(!strcmpiW(var->name, name)) {
-            ref->type = var->is_const ? REF_CONST : REF_VAR;
-            ref->u.v = &var->v;
-            return TRUE;
+    dynamic_var_t *var;
+
+    if(ctx->dynamic_vars_hash) {
+        for(var = ctx->dynamic_vars_hash[name_hash(name)]; var; var = var->hash_next) {
+            if(!strcmpiW(var->name, name))
+                break;
+        }
+    }else {
+        for(var = ctx->dynamic_vars; var; var = var->next) {
+            if(!strcmpiW(var->name, name))
+                break;
         }
+    }
 
-        var = var->next;
+    if(!var)
+        return FALSE;
+
+    ref->type = var->is_const ? REF_CONST : REF_VAR;
+    ref->u.v = &var->v;
+    return TRUE;
+}
+
+static void add_dynamic_var_hash(exec_ctx_t *ctx, dynamic_var_t *var)
+{
+    dynamic_var_t **bucket;
+
+    if(!ctx->dynamic_vars_hash) {
+        if(++ctx->dynamic_var_cnt < DYNAMIC_VARS_HASH_MIN)
+            return;
+
+        /* Without a table lookups fall back to walking the list. */
+        ctx->dynamic_vars_hash = heap_pool_alloc(&ctx->heap, GLOBAL_HASH_SIZE*sizeof(*ctx->dynamic_vars_hash));
+        if(!ctx->dynamic_vars_hash)
+            return;
+
+        memset(ctx->dynamic_vars_hash, 0, GLOBAL_HASH_SIZE*sizeof(*ctx->dynamic_vars_hash));
+        for(var = ctx->dynamic_vars; var; var = var->next) {
+            bucket = ctx->dynamic_vars_hash + name_hash(var->name);
+            var->hash_next = *bucket;
+            *bucket = var;
+        }
+        return;
     }
 
-    return FALSE;
+    bucket = ctx->dynamic_vars_hash + name_hash(var->name);
+    var->hash_next = *bucket;
+    *bucket = var;
+}
+
+static BOOL lookup_global_vars(script_ctx_t *script, const WCHAR *name, ref_t *ref)
+{
+    dynamic_var_t *var;
+
+    var = lookup_global_var(script, name);
+    if(!var)
+        return FALSE;
+
+    ref->type = var->is_const ? REF_CONST : REF_VAR;
+    ref->u.v = &var->v;
+    return TRUE;
+}
+
+static void lookup_slot(exec_ctx_t *ctx, unsigned slot, ref_t *ref)
+{
+    const unsigned idx = slot & SLOT_IDX_MASK;
+
+    ref->type = REF_VAR;
+
+    switch(slot >> SLOT_TYPE_SHIFT) {
+    case SLOT_VAR:
+        assert(idx < ctx->func->var_cnt);
+        ref->u.v = ctx->vars+idx;
+        break;
+    case SLOT_ARG:
+        assert(idx < ctx->func->arg_cnt);
+        ref->u.v = ctx->args+idx;
+        break;
+    case SLOT_PROP:
+        assert(ctx->vbthis && idx < ctx->vbthis->desc->prop_cnt);
+        ref->u.v = ctx->vbthis->props+idx;
+        break;
+    DEFAULT_UNREACHABLE;
+    }
 }
 
 static HRESULT lookup_identifier(exec_ctx_t *ctx, BSTR name, vbdisp_invoke_type_t invoke_type, ref_t *ref)
@@ -130,8 +207,12 @@ static HRESULT lookup_identifier(exec_ctx_t *ctx, BSTR name, vbdisp_invoke_type_
         }
     }
 
-    if(lookup_dynamic_vars(ctx->func->type == FUNC_GLOBAL ? ctx->script->global_vars : ctx->dynamic_vars, name, ref))
+    if(ctx->func->type == FUNC_GLOBAL) {
+        if(lookup_global_vars(ctx->script, name, ref))
+            return S_OK;
+    }else if(lookup_dynamic_vars(ctx, name, ref)) {
         return S_OK;
+    }
 
     if(ctx->func->type != FUNC_GLOBAL) {
         if(ctx->vbthis) {
@@ -164,15 +245,14 @@ static HRESULT lookup_identifier(exec_ctx_t *ctx, BSTR name, vbdisp_invoke_type_
         }
     }
 
-    if(ctx->func->type != FUNC_GLOBAL && lookup_dynamic_vars(ctx->script->global_vars, name, ref))
+    if(ctx->func->type != FUNC_GLOBAL && lookup_global_vars(ctx->script, name, ref))
         return S_OK;
 
-    for(func = ctx->script->global_funcs; func; func = func->next) {
-        if(!strcmpiW(func->name, name)) {
-            ref->type = REF_FUNC;
-            ref->u.f = func;
-            return S_OK;
-        }
+    func = lookup_global_func(ctx->script, name);
+    if(func) {
+        ref->type = REF_FUNC;
+        ref->u.f = func;
+        return S_OK;
     }
 
     if(!strcmpiW(name, errW)) {
@@ -238,9 +318,11 @@ static HRESULT add_dynamic_var(exec_ctx_t *ctx, const WCHAR *name,
     if(ctx->func->type == FUNC_GLOBAL) {
         new_var->next = ctx->script->global_vars;
         ctx->script->global_vars = new_var;
+        add_global_var(ctx->script, new_var);
     }else {
         new_var->next = ctx->dynamic_vars;
         ctx->dynamic_vars = new_var;
+        add_dynamic_var_hash(ctx, new_var);
     }
 
     *out_var = &new_var->v;
@@ -514,18 +596,11 @@ static HRESULT array_access(exec_ctx_t *ctx, SAFEARRAY *array, DISPPARAMS *dp, V
     return hres;
 }
 
-static HRESULT do_icall(exec_ctx_t *ctx, VARIANT *res)
+static HRESULT call_ref(exec_ctx_t *ctx, ref_t ref, BSTR identifier, unsigned arg_cnt, VARIANT *res)
 {
-    BSTR identifier = ctx->instr->arg1.bstr;
-    const unsigned arg_cnt = ctx->instr->arg2.uint;
     DISPPARAMS dp;
-    ref_t ref;
     HRESULT hres;
 
-    hres = lookup_identifier(ctx, identifier, VBDISP_CALLGET, &ref);
-    if(FAILED(hres))
-        return hres;
-
     switch(ref.type) {
     case REF_VAR:
     case REF_CONST: {
@@ -614,6 +689,20 @@ static HRESULT do_icall(exec_ctx_t *ctx, VARIANT *res)
     return S_OK;
 }
 
+static HRESULT do_icall(exec_ctx_t *ctx, VARIANT *res)
+{
+    BSTR identifier = ctx->instr->arg1.bstr;
+    const unsigned arg_cnt = ctx->instr->arg2.uint;
+    ref_t ref;
+    HRESULT hres;
+
+    hres = lookup_identifier(ctx, identifier, VBDISP_CALLGET, &ref);
+    if(FAILED(hres))
+        return hres;
+
+    return call_ref(ctx, ref, identifier, arg_cnt, res);
+}
+
 static HRESULT interp_icall(exec_ctx_t *ctx)
 {
     VARIANT v;
@@ -634,6 +723,24 @@ static HRESULT interp_icallv(exec_ctx_t *ctx)
     return do_icall(ctx, NULL);
 }
 
+static HRESULT interp_local(exec_ctx_t *ctx)
+{
+    const unsigned slot = ctx->instr->arg1.uint;
+    const unsigned arg_cnt = ctx->instr->arg2.uint;
+    VARIANT v;
+    ref_t ref;
+    HRESULT hres;
+
+    TRACE("%x\n", slot);
+
+    lookup_slot(ctx, slot, &ref);
+    hres = call_ref(ctx, ref, NULL, arg_cnt, &v);
+    if(FAILED(hres))
+        return hres;
+
+    return stack_push(ctx, &v);
+}
+
 static HRESULT do_mcall(exec_ctx_t *ctx, VARIANT *res)
 {
     const BSTR identifier = ctx->instr->arg1.bstr;
@@ -708,15 +815,10 @@ static HRESULT assign_value(exec_ctx_t *ctx, VARIANT *dst, VARIANT *src, WORD fl
     return S_OK;
 }
 
-static HRESULT assign_ident(exec_ctx_t *ctx, BSTR name, WORD flags, DISPPARAMS *dp)
+static HRESULT assign_ref(exec_ctx_t *ctx, ref_t ref, BSTR name, WORD flags, DISPPARAMS *dp)
 {
-    ref_t ref;
     HRESULT hres;
 
-    hres = lookup_identifier(ctx, name, VBDISP_LET, &ref);
-    if(FAILED(hres))
-        return hres;
-
     switch(ref.type) {
     case REF_VAR: {
         VARIANT *v = ref.u.v;
@@ -794,6 +896,18 @@ static HRESULT assign_ident(exec_ctx_t *ctx, BSTR name, WORD flags, DISPPARAMS *
     return hres;
 }
 
+static HRESULT assign_ident(exec_ctx_t *ctx, BSTR name, WORD flags, DISPPARAMS *dp)
+{
+    ref_t ref;
+    HRESULT hres;
+
+    hres = lookup_identifier(ctx, name, VBDISP_LET, &ref);
+    if(FAILED(hres))
+        return hres;
+
+    return assign_ref(ctx, ref, name, flags, dp);
+}
+
 static HRESULT interp_assign_ident(exec_ctx_t *ctx)
 {
     const BSTR arg = ctx->instr->arg1.bstr;
@@ -812,6 +926,26 @@ static HRESULT interp_assign_ident(exec_ctx_t *ctx)
     return S_OK;
 }
 
+static HRESULT interp_assign_local(exec_ctx_t *ctx)
+{
+    const unsigned slot = ctx->instr->arg1.uint;
+    const unsigned arg_cnt = ctx->instr->arg2.uint;
+    DISPPARAMS dp;
+    ref_t ref;
+    HRESULT hres;
+
+    TRACE("%x\n", slot);
+
+    lookup_slot(ctx, slot, &ref);
+    vbstack_to_dp(ctx, arg_cnt, TRUE, &dp);
+    hres = assign_ref(ctx, ref, NULL, DISPATCH_PROPERTYPUT, &dp);
+    if(FAILED(hres))
+        return hres;
+
+    stack_popn(ctx, arg_cnt+1);
+    return S_OK;
+}
+
 static HRESULT interp_set_ident(exec_ctx_t *ctx)
 {
     const BSTR arg = ctx->instr->arg1.bstr;
@@ -839,6 +973,35 @@ static HRESULT interp_set_ident(exec_ctx_t *ctx)
     return S_OK;
 }
 
+static HRESULT interp_set_local(exec_ctx_t *ctx)
+{
+    const unsigned slot = ctx->instr->arg1.uint;
+    const unsigned arg_cnt = ctx->instr->arg2.uint;
+    DISPPARAMS dp;
+    ref_t ref;
+    HRESULT hres;
+
+    TRACE("%x\n", slot);
+
+    if(arg_cnt) {
+        FIXME("arguments not supported\n");
+        return E_NOTIMPL;
+    }
+
+    hres = stack_assume_disp(ctx, 0, NULL);
+    if(FAILED(hres))
+        return hres;
+
+    lookup_slot(ctx, slot, &ref);
+    vbstack_to_dp(ctx, 0, TRUE, &dp);
+    hres = assign_ref(ctx, ref, NULL, DISPATCH_PROPERTYPUTREF, &dp);
+    if(FAILED(hres))
+        return hres;
+
+    stack_popn(ctx, 1);
+    return S_OK;
+}
+
 static HRESULT interp_assign_member(exec_ctx_t *ctx)
 {
     BSTR identifier = ctx->instr->arg1.bstr;
@@ -1060,16 +1223,12 @@ static HRESULT interp_dim(exec_ctx_t *ctx)
     return S_OK;
 }
 
-static HRESULT interp_step(exec_ctx_t *ctx)
+static HRESULT do_step(exec_ctx_t *ctx, ref_t ref)
 {
-    const BSTR ident = ctx->instr->arg2.bstr;
     BOOL gteq_zero;
     VARIANT zero;
-    ref_t ref;
     HRESULT hres;
 
-    TRACE("%s\n", debugstr_w(ident));
-
     V_VT(&zero) = VT_I2;
     V_I2(&zero) = 0;
     hres = VarCmp(stack_top(ctx, 0), &zero, ctx->script->lcid, 0);
@@ -1078,15 +1237,6 @@ static HRESULT interp_step(exec_ctx_t *ctx)
 
     gteq_zero = hres == VARCMP_GT || hres == VARCMP_EQ;
 
-    hres = lookup_identifier(ctx, ident, VBDISP_ANY, &ref);
-    if(FAILED(hres))
-        return hres;
-
-    if(ref.type != REF_VAR) {
-        FIXME("%s is not REF_VAR\n", debugstr_w(ident));
-        return E_FAIL;
-    }
-
     hres = VarCmp(ref.u.v, stack_top(ctx, 1), ctx->script->lcid, 0);
     if(FAILED(hres))
         return hres;
@@ -1100,6 +1250,37 @@ static HRESULT interp_step(exec_ctx_t *ctx)
     return S_OK;
 }
 
+static HRESULT interp_step(exec_ctx_t *ctx)
+{
+    const BSTR ident = ctx->instr->arg2.bstr;
+    ref_t ref;
+    HRESULT hres;
+
+    TRACE("%s\n", debugstr_w(ident));
+
+    hres = lookup_identifier(ctx, ident, VBDISP_ANY, &ref);
+    if(FAILED(hres))
+        return hres;
+
+    if(ref.type != REF_VAR) {
+        FIXME("%s is not REF_VAR\n", debugstr_w(ident));
+        return E_FAIL;
+    }
+
+    return do_step(ctx, ref);
+}
+
+static HRESULT interp_step_local(exec_ctx_t *ctx)
+{
+    const unsigned slot = ctx->instr->arg2.uint;
+    ref_t ref;
+
+    TRACE("%x\n", slot);
+
+    lookup_slot(ctx, slot, &ref);
+    return do_step(ctx, ref);
+}
+
 static HRESULT interp_newenum(exec_ctx_t *ctx)
 {
     variant_val_t v;
@@ -1162,18 +1343,15 @@ static HRESULT interp_newenum(exec_ctx_t *ctx)
     return S_OK;
 }
 
-static HRESULT interp_enumnext(exec_ctx_t *ctx)
+static HRESULT do_enumnext(exec_ctx_t *ctx, const ref_t *ref, BSTR ident)
 {
     const unsigned loop_end = ctx->instr->arg1.uint;
-    const BSTR ident = ctx->instr->arg2.bstr;
     VARIANT v;
     DISPPARAMS dp = {&v, &propput_dispid, 1, 1};
     IEnumVARIANT *iter;
     BOOL do_continue;
     HRESULT hres;
 
-    TRACE("\n");
-
     if(V_VT(stack_top(ctx, 0)) == VT_EMPTY) {
         FIXME("uninitialized\n");
         return E_FAIL;
@@ -1188,7 +1366,10 @@ static HRESULT interp_enumnext(exec_ctx_t *ctx)
         return hres;
 
     do_continue = hres == S_OK;
-    hres = assign_ident(ctx, ident, DISPATCH_PROPERTYPUT|DISPATCH_PROPERTYPUTREF, &dp);
+    if(ref)
+        hres = assign_ref(ctx, *ref, NULL, DISPATCH_PROPERTYPUT|DISPATCH_PROPERTYPUTREF, &dp);
+    else
+        hres = assign_ident(ctx, ident, DISPATCH_PROPERTYPUT|DISPATCH_PROPERTYPUTREF, &dp);
     VariantClear(&v);
     if(FAILED(hres))
         return hres;
@@ -1202,6 +1383,24 @@ static HRESULT interp_enumnext(exec_ctx_t *ctx)
     return S_OK;
 }
 
+static HRESULT interp_enumnext(exec_ctx_t *ctx)
+{
+    TRACE("\n");
+
+    return do_enumnext(ctx, NULL, ctx->instr->arg2.bstr);
+}
+
+static HRESULT interp_enumnext_local(exec_ctx_t *ctx)
+{
+    const unsigned slot = ctx->instr->arg2.uint;
+    ref_t ref;
+
+    TRACE("%x\n", slot);
+
+    lookup_slot(ctx, slot, &ref);
+    return do_enumnext(ctx, &ref, NULL);
+}
+
 static HRESULT interp_jmp(exec_ctx_t *ctx)
 {
     const unsigned arg = ctx->instr->arg1.uint;
@@ -1974,10 +2173,23 @@ static HRESULT interp_neg(exec_ctx_t *ctx)
     return stack_push(ctx, &v);
 }
 
+static HRESULT do_incc(exec_ctx_t *ctx, ref_t ref)
+{
+    VARIANT v;
+    HRESULT hres;
+
+    hres = VarAdd(stack_top(ctx, 0), ref.u.v, &v);
+    if(FAILED(hres))
+        return hres;
+
+    VariantClear(ref.u.v);
+    *ref.u.v = v;
+    return S_OK;
+}
+
 static HRESULT interp_incc(exec_ctx_t *ctx)
 {
     const BSTR ident = ctx->instr->arg1.bstr;
-    VARIANT v;
     ref_t ref;
     HRESULT hres;
 
@@ -1992,13 +2204,18 @@ static HRESULT interp_incc(exec_ctx_t *ctx)
         return E_FAIL;
     }
 
-    hres = VarAdd(stack_top(ctx, 0), ref.u.v, &v);
-    if(FAILED(hres))
-        return hres;
+    return do_incc(ctx, ref);
+}
 
-    VariantClear(ref.u.v);
-    *ref.u.v = v;
-    return S_OK;
+static HRESULT interp_incc_local(exec_ctx_t *ctx)
+{
+    const unsigned slot = ctx->instr->arg1.uint;
+    ref_t ref;
+
+    TRACE("%x\n", slot);
+
+    lookup_slot(ctx, slot, &ref);
+    return do_incc(ctx, ref);
 }
 
 static HRESULT interp_catch(exec_ctx_t *ctx)
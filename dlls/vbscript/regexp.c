@@ -3070,6 +3070,52 @@ good:
     return x;
 }
 
+/*
+ * Returns the first position at or after cp where a match may start, or NULL if
+ * there is none. Programs starting with a literal or a character class let us
+ * scan for the first character instead of running the bytecode at every position.
+ */
+static const WCHAR *FindMatchStart(REGlobalData *gData, const WCHAR *cp)
+{
+    regexp_t *re = gData->regexp;
+    jsbytecode *pc = re->program;
+    RECharSet *charSet;
+    size_t offset, index;
+    WCHAR ch;
+
+    switch ((REOp)*pc++) {
+      case REOP_BOL:
+        if (cp != gData->cpbegin && !(re->flags & REG_MULTILINE))
+            return NULL;
+        return cp;
+      case REOP_FLAT:
+        ReadCompactIndex(pc, &offset);
+        ch = re->source[offset];
+        break;
+      case REOP_FLAT1:
+        ch = *pc;
+        break;
+      case REOP_UCFLAT1:
+        ch = GET_ARG(pc);
+        break;
+      case REOP_CLASS:
+        ReadCompactIndex(pc, &index);
+        charSet = &re->classList[index];
+        if (!charSet->length)
+            return NULL;
+        for (; cp < gData->cpend; cp++) {
+            ch = *cp;
+            if (ch <= charSet->length && (charSet->u.bits[ch >> 3] & (1 << (ch & 0x7))))
+                return cp;
+        }
+        return NULL;
+      default:
+        return cp;
+    }
+
+    return memchrW(cp, ch, gData->cpend - cp);
+}
+
 static match_state_t *MatchRegExp(REGlobalData *gData, match_state_t *x)
 {
     match_state_t *result;
@@ -3082,6 +3128,11 @@ static match_state_t *MatchRegExp(REGlobalData *gData, match_state_t *x)
      * in order to detect end-of-input/line condition.
      */
     for (cp2 = cp; cp2 <= gData->cpend; cp2++) {
+        if (!(gData->regexp->flags & REG_STICKY)) {
+            cp2 = FindMatchStart(gData, cp2);
+            if (!cp2)
+                return NULL;
+        }
         gData->skipped = cp2 - cp;
         x->cp = cp2;
         for (j = 0; j < gData->regexp->parenCount; j++)
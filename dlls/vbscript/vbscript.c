@@ -99,6 +99,69 @@ static void exec_queued_code(script_ctx_t *ctx)
     }
 }
 
+void add_global_var(script_ctx_t *ctx, dynamic_var_t *var)
+{
+    dynamic_var_t **bucket = ctx->global_vars_hash + name_hash(var->name);
+
+    var->hash_next = *bucket;
+    *bucket = var;
+}
+
+/* Lookups have to find names in the same order as a walk of the global_vars and
+ * global_funcs lists would, so a list of newly compiled entries is inserted in front
+ * of older entries, but keeping its own order. */
+void add_global_vars(script_ctx_t *ctx, dynamic_var_t *vars)
+{
+    dynamic_var_t **tails[GLOBAL_HASH_SIZE] = {NULL}, **tail;
+    unsigned hash;
+
+    for(; vars; vars = vars->next) {
+        hash = name_hash(vars->name);
+        tail = tails[hash] ? tails[hash] : ctx->global_vars_hash + hash;
+        vars->hash_next = *tail;
+        *tail = vars;
+        tails[hash] = &vars->hash_next;
+    }
+}
+
+void add_global_funcs(script_ctx_t *ctx, function_t *funcs)
+{
+    function_t **tails[GLOBAL_HASH_SIZE] = {NULL}, **tail;
+    unsigned hash;
+
+    for(; funcs; funcs = funcs->next) {
+        hash = name_hash(funcs->name);
+        tail = tails[hash] ? tails[hash] : ctx->global_funcs_hash + hash;
+        funcs->hash_next = *tail;
+        *tail = funcs;
+        tails[hash] = &funcs->hash_next;
+    }
+}
+
+dynamic_var_t *lookup_global_var(script_ctx_t *ctx, const WCHAR *name)
+{
+    dynamic_var_t *var;
+
+    for(var = ctx->global_vars_hash[name_hash(name)]; var; var = var->hash_next) {
+        if(!strcmpiW(var->name, name))
+            return var;
+    }
+
+    return NULL;
+}
+
+function_t *lookup_global_func(script_ctx_t *ctx, const WCHAR *name)
+{
+    function_t *func;
+
+    for(func = ctx->global_funcs_hash[name_hash(name)]; func; func = func->hash_next) {
+        if(!strcmpiW(func->name, name))
+            return func;
+    }
+
+    return NULL;
+}
+
 IDispatch *lookup_named_item(script_ctx_t *ctx, const WCHAR *name, unsigned flags)
 {
     named_item_t *item;
@@ -156,6 +219,7 @@ static void release_script(script_ctx_t *ctx)
 
     release_dynamic_vars(ctx->global_vars);
     ctx->global_vars = NULL;
+    memset(ctx->global_vars_hash, 0, sizeof(ctx->global_vars_hash));
 
     while(!list_empty(&ctx->named_items)) {
         named_item_t *iter = LIST_ENTRY(list_head(&ctx->named_items), named_item_t, entry);
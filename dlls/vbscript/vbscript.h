@@ -170,11 +170,23 @@ static inline VARIANT *get_arg(DISPPARAMS *dp, DWORD i)
 
 typedef struct _dynamic_var_t {
     struct _dynamic_var_t *next;
+    struct _dynamic_var_t *hash_next;
     VARIANT v;
     const WCHAR *name;
     BOOL is_const;
 } dynamic_var_t;
 
+#define GLOBAL_HASH_SIZE 128
+
+static inline unsigned name_hash(const WCHAR *name)
+{
+    unsigned h = 0;
+
+    for(; *name; name++)
+        h = (h>>(sizeof(unsigned)*8-4)) ^ (h<<4) ^ tolowerW(*name);
+    return h % GLOBAL_HASH_SIZE;
+}
+
 struct _script_ctx_t {
     IActiveScriptSite *site;
     LCID lcid;
@@ -196,6 +208,8 @@ struct _script_ctx_t {
 
     dynamic_var_t *global_vars;
     function_t *global_funcs;
+    dynamic_var_t *global_vars_hash[GLOBAL_HASH_SIZE];
+    function_t *global_funcs_hash[GLOBAL_HASH_SIZE];
     class_desc_t *classes;
     class_desc_t *procs;
 
@@ -209,6 +223,12 @@ struct _script_ctx_t {
 HRESULT init_global(script_ctx_t*) DECLSPEC_HIDDEN;
 HRESULT init_err(script_ctx_t*) DECLSPEC_HIDDEN;
 
+void add_global_var(script_ctx_t*,dynamic_var_t*) DECLSPEC_HIDDEN;
+void add_global_vars(script_ctx_t*,dynamic_var_t*) DECLSPEC_HIDDEN;
+void add_global_funcs(script_ctx_t*,function_t*) DECLSPEC_HIDDEN;
+dynamic_var_t *lookup_global_var(script_ctx_t*,const WCHAR*) DECLSPEC_HIDDEN;
+function_t *lookup_global_func(script_ctx_t*,const WCHAR*) DECLSPEC_HIDDEN;
+
 IUnknown *create_ax_site(script_ctx_t*) DECLSPEC_HIDDEN;
 
 typedef enum {
@@ -225,6 +245,7 @@ typedef enum {
     X(add,            1, 0,           0)          \
     X(and,            1, 0,           0)          \
     X(assign_ident,   1, ARG_BSTR,    ARG_UINT)   \
+    X(assign_local,   1, ARG_UINT,    ARG_UINT)   \
     X(assign_member,  1, ARG_BSTR,    ARG_UINT)   \
     X(bool,           1, ARG_INT,     0)          \
     X(catch,          1, ARG_ADDR,    ARG_UINT)    \
@@ -236,6 +257,7 @@ typedef enum {
     X(double,         1, ARG_DOUBLE,  0)          \
     X(empty,          1, 0,           0)          \
     X(enumnext,       0, ARG_ADDR,    ARG_BSTR)   \
+    X(enumnext_local, 0, ARG_ADDR,    ARG_UINT)   \
     X(equal,          1, 0,           0)          \
     X(hres,           1, ARG_UINT,    0)          \
     X(errmode,        1, ARG_INT,     0)          \
@@ -248,11 +270,13 @@ typedef enum {
     X(idiv,           1, 0,           0)          \
     X(imp,            1, 0,           0)          \
     X(incc,           1, ARG_BSTR,    0)          \
+    X(incc_local,     1, ARG_UINT,    0)          \
     X(is,             1, 0,           0)          \
     X(jmp,            0, ARG_ADDR,    0)          \
     X(jmp_false,      0, ARG_ADDR,    0)          \
     X(jmp_true,       0, ARG_ADDR,    0)          \
     X(long,           1, ARG_INT,     0)          \
+    X(local,          1, ARG_UINT,    ARG_UINT)   \
     X(lt,             1, 0,           0)          \
     X(lteq,           1, 0,           0)          \
     X(mcall,          1, ARG_BSTR,    ARG_UINT)   \
@@ -271,9 +295,11 @@ typedef enum {
     X(pop,            1, ARG_UINT,    0)          \
     X(ret,            0, 0,           0)          \
     X(set_ident,      1, ARG_BSTR,    ARG_UINT)   \
+    X(set_local,      1, ARG_UINT,    ARG_UINT)   \
     X(set_member,     1, ARG_BSTR,    ARG_UINT)   \
     X(short,          1, ARG_INT,     0)          \
     X(step,           0, ARG_ADDR,    ARG_BSTR)   \
+    X(step_local,     0, ARG_ADDR,    ARG_UINT)   \
     X(stop,           1, 0,           0)          \
     X(string,         1, ARG_STR,     0)          \
     X(sub,            1, 0,           0)          \
@@ -301,6 +327,17 @@ typedef struct {
     instr_arg_t arg2;
 } instr_t;
 
+/* Identifiers bound at compile time by *_local instructions. */
+typedef enum {
+    SLOT_VAR,
+    SLOT_ARG,
+    SLOT_PROP
+} slot_type_t;
+
+#define SLOT_TYPE_SHIFT 30
+#define SLOT_IDX_MASK   ((1u << SLOT_TYPE_SHIFT) - 1)
+#define MAKE_SLOT(type,idx) (((unsigned)(type) << SLOT_TYPE_SHIFT) | (idx))
+
 typedef struct {
     const WCHAR *name;
     BOOL by_ref;
@@ -333,6 +370,7 @@ struct _function_t {
     unsigned code_off;
     vbscode_t *code_ctx;
     function_t *next;
+    function_t *hash_next;
 };
 
 struct _vbscode_t {
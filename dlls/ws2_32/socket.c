@@ -131,6 +131,12 @@
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
 
 #define NONAMELESSUNION
 #define NONAMELESSSTRUCT
@@ -159,6 +165,7 @@
 #include "wine/exception.h"
 #include "wine/unicode.h"
 #include "wine/heap.h"
+#include "wine/list.h"
 
 #if defined(linux) && !defined(IP_UNICAST_IF)
 #define IP_UNICAST_IF 50
@@ -631,6 +638,7 @@ struct per_thread_data
     struct WS_protoent *pe_buffer;
     struct pollfd *fd_cache;
     unsigned int fd_count;
+    struct poll_set *poll_set;
     int he_len;
     int se_len;
     int pe_len;
@@ -658,6 +666,8 @@ int WSAIOCTL_GetInterfaceCount(void);
 int WSAIOCTL_GetInterfaceName(int intNumber, char *intName);
 
 static void WS_AddCompletion( SOCKET sock, ULONG_PTR CompletionValue, NTSTATUS CompletionStatus, ULONG Information, BOOL force );
+static void free_poll_set( struct poll_set *set );
+static void release_poll_set_socket( SOCKET s );
 
 #define MAP_OPTION(opt) { WS_##opt, opt }
 
@@ -1352,6 +1362,7 @@ static void free_per_thread_data(void)
     HeapFree( GetProcessHeap(), 0, ptb->se_buffer );
     HeapFree( GetProcessHeap(), 0, ptb->pe_buffer );
     HeapFree( GetProcessHeap(), 0, ptb->fd_cache );
+    free_poll_set( ptb->poll_set );
 
     HeapFree( GetProcessHeap(), 0, ptb );
     NtCurrentTeb()->WinSockData = NULL;
@@ -3447,6 +3458,7 @@ int WINAPI WS_closesocket(SOCKET s)
         if (fd >= 0)
         {
             release_sock_fd(s, fd);
+            release_poll_set_socket(s);
             if (CloseHandle(SOCKET2HANDLE(s)))
                 res = 0;
         }
@@ -5215,23 +5227,10 @@ int WINAPI WS_recvfrom(SOCKET s, char *buf, INT len, int flags,
         return n;
 }
 
-/* allocate a poll array for the corresponding fd sets */
-static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set *writefds,
-                                       const WS_fd_set *exceptfds, int *count_ptr )
+/* get the per-thread poll array, large enough for count descriptors */
+static struct pollfd *get_poll_fds( struct per_thread_data *ptb, unsigned int count )
 {
-    unsigned int i, j = 0, count = 0;
     struct pollfd *fds;
-    struct per_thread_data *ptb = get_per_thread_data();
-
-    if (readfds) count += readfds->fd_count;
-    if (writefds) count += writefds->fd_count;
-    if (exceptfds) count += exceptfds->fd_count;
-    *count_ptr = count;
-    if (!count)
-    {
-        SetLastError(WSAEINVAL);
-        return NULL;
-    }
 
     /* check if the cache can hold all descriptors, if not do the resizing */
     if (ptb->fd_count < count)
@@ -5245,8 +5244,35 @@ static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set
         ptb->fd_cache = fds;
         ptb->fd_count = count;
     }
-    else
-        fds = ptb->fd_cache;
+    return ptb->fd_cache;
+}
+
+static unsigned int fd_sets_count( const WS_fd_set *readfds, const WS_fd_set *writefds,
+                                   const WS_fd_set *exceptfds )
+{
+    unsigned int count = 0;
+
+    if (readfds) count += readfds->fd_count;
+    if (writefds) count += writefds->fd_count;
+    if (exceptfds) count += exceptfds->fd_count;
+    return count;
+}
+
+/* allocate a poll array for the corresponding fd sets */
+static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set *writefds,
+                                       const WS_fd_set *exceptfds, int *count_ptr )
+{
+    unsigned int i, j = 0, count;
+    struct pollfd *fds;
+
+    *count_ptr = count = fd_sets_count( readfds, writefds, exceptfds );
+    if (!count)
+    {
+        SetLastError(WSAEINVAL);
+        return NULL;
+    }
+
+    if (!(fds = get_poll_fds( get_per_thread_data(), count ))) return NULL;
 
     if (readfds)
         for (i = 0; i < readfds->fd_count; i++, j++)
@@ -5430,6 +5456,513 @@ static int get_poll_results( WS_fd_set *readfds, WS_fd_set *writefds, WS_fd_set
     return total;
 }
 
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+
+/* Persistent per-thread epoll set used by select() and WSAPoll() on large
+ * socket sets. Applications usually poll the same sockets over and over, so
+ * the unix fds and the socket state needed to build the poll events are kept
+ * across calls, and only the differences from the previous call are passed
+ * on to the kernel. */
+
+#define POLL_SET_MIN_COUNT 16  /* smaller sets are handled with a plain poll() */
+
+#define POLL_ENTRY_BOUND      0x01  /* socket is known to be bound */
+#define POLL_ENTRY_TYPE       0x02  /* socket type is known */
+#define POLL_ENTRY_DGRAM      0x04  /* socket is a datagram socket */
+#define POLL_ENTRY_OOB        0x08  /* SO_OOBINLINE state is known */
+#define POLL_ENTRY_OOBINLINE  0x10  /* SO_OOBINLINE is set */
+
+struct poll_set_entry
+{
+    SOCKET       socket;   /* INVALID_SOCKET for removed entries */
+    int          fd;       /* our own unix fd for the socket, -1 if released */
+    unsigned int generation; /* close generation of the handle, to detect reused handles */
+    DWORD        access;   /* access rights already checked for the handle */
+    unsigned int flags;    /* POLL_ENTRY_* flags */
+    unsigned int stamp;    /* last call that used this entry */
+    int          events;   /* events registered with epoll */
+    int          want;     /* events requested by the current call */
+    int          revents;  /* events returned for the current call */
+};
+
+struct poll_set
+{
+    struct list            entry;      /* entry in poll_sets list */
+    CRITICAL_SECTION       cs;         /* protects the entries against release_poll_set_socket */
+    int                    epoll_fd;
+    unsigned int           stamp;      /* current call number */
+    unsigned int           count;      /* number of entries, including removed ones */
+    unsigned int           size;       /* allocated size of entries and events */
+    unsigned int           removed;    /* number of removed entries */
+    struct poll_set_entry *entries;
+    unsigned int          *hash;       /* entry index + 1, 0 for unused slots */
+    unsigned int           hash_size;  /* always a power of two */
+    struct epoll_event    *events;
+};
+
+static struct list poll_sets = LIST_INIT( poll_sets );
+
+static CRITICAL_SECTION poll_sets_cs;
+static CRITICAL_SECTION_DEBUG poll_sets_cs_debug =
+{
+    0, 0, &poll_sets_cs,
+    { &poll_sets_cs_debug.ProcessLocksList, &poll_sets_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": poll_sets_cs") }
+};
+static CRITICAL_SECTION poll_sets_cs = { &poll_sets_cs_debug, -1, 0, 0, 0, 0 };
+
+static inline unsigned int poll_set_hash( const struct poll_set *set, SOCKET s )
+{
+    return ((ULONG_PTR)s >> 2) & (set->hash_size - 1);
+}
+
+static struct poll_set_entry *poll_set_find( struct poll_set *set, SOCKET s )
+{
+    unsigned int i, idx;
+
+    if (!set->hash_size) return NULL;
+    for (i = poll_set_hash( set, s ); (idx = set->hash[i]); i = (i + 1) & (set->hash_size - 1))
+        if (set->entries[idx - 1].socket == s) return &set->entries[idx - 1];
+    return NULL;
+}
+
+static void poll_set_hash_entry( struct poll_set *set, unsigned int idx )
+{
+    unsigned int i = poll_set_hash( set, set->entries[idx].socket );
+
+    while (set->hash[i]) i = (i + 1) & (set->hash_size - 1);
+    set->hash[i] = idx + 1;
+}
+
+/* drop the removed entries; must not be called while slots refer to entries */
+static void poll_set_compact( struct poll_set *set )
+{
+    unsigned int i, j;
+
+    for (i = j = 0; i < set->count; i++)
+        if (set->entries[i].socket != INVALID_SOCKET) set->entries[j++] = set->entries[i];
+    set->count = j;
+    set->removed = 0;
+
+    memset( set->hash, 0, set->hash_size * sizeof(set->hash[0]) );
+    for (i = 0; i < set->count; i++) poll_set_hash_entry( set, i );
+}
+
+static BOOL poll_set_grow( struct poll_set *set )
+{
+    unsigned int size = max( 64, set->size * 2 );
+    struct poll_set_entry *entries;
+    struct epoll_event *events;
+    unsigned int *hash;
+
+    if (!(entries = heap_realloc( set->entries, size * sizeof(*entries) ))) return FALSE;
+    set->entries = entries;
+    if (!(events = heap_realloc( set->events, size * sizeof(*events) ))) return FALSE;
+    set->events = events;
+    if (!(hash = heap_realloc( set->hash, 2 * size * sizeof(*hash) ))) return FALSE;
+    set->hash = hash;
+    set->hash_size = 2 * size;
+    set->size = size;
+    poll_set_compact( set );
+    return TRUE;
+}
+
+/* close our fd for an entry, the caller must hold the set lock */
+static void poll_set_release_entry( struct poll_set *set, struct poll_set_entry *entry )
+{
+    if (entry->fd == -1) return;
+    if (entry->events) epoll_ctl( set->epoll_fd, EPOLL_CTL_DEL, entry->fd, NULL );
+    close( entry->fd );
+    entry->fd = -1;
+    entry->flags = 0;
+    entry->events = 0;
+}
+
+static struct poll_set *get_poll_set( struct per_thread_data *ptb )
+{
+    struct poll_set *set;
+
+    if (ptb->poll_set) return ptb->poll_set;
+
+    if (!(set = heap_alloc_zero( sizeof(*set) ))) return NULL;
+    if ((set->epoll_fd = epoll_create( 64 )) == -1)
+    {
+        heap_free( set );
+        return NULL;
+    }
+    fcntl( set->epoll_fd, F_SETFD, FD_CLOEXEC );
+    InitializeCriticalSection( &set->cs );
+    set->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": poll_set.cs");
+
+    EnterCriticalSection( &poll_sets_cs );
+    list_add_tail( &poll_sets, &set->entry );
+    LeaveCriticalSection( &poll_sets_cs );
+    return ptb->poll_set = set;
+}
+
+static void free_poll_set( struct poll_set *set )
+{
+    unsigned int i;
+
+    if (!set) return;
+
+    EnterCriticalSection( &poll_sets_cs );
+    list_remove( &set->entry );
+    LeaveCriticalSection( &poll_sets_cs );
+
+    for (i = 0; i < set->count; i++)
+        if (set->entries[i].fd != -1) close( set->entries[i].fd );
+    close( set->epoll_fd );
+    set->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection( &set->cs );
+    heap_free( set->entries );
+    heap_free( set->events );
+    heap_free( set->hash );
+    heap_free( set );
+}
+
+/* release a socket from all poll sets, so that closing it is not delayed by our fds */
+static void release_poll_set_socket( SOCKET s )
+{
+    struct poll_set_entry *entry;
+    struct poll_set *set;
+
+    EnterCriticalSection( &poll_sets_cs );
+    LIST_FOR_EACH_ENTRY( set, &poll_sets, struct poll_set, entry )
+    {
+        EnterCriticalSection( &set->cs );
+        if ((entry = poll_set_find( set, s ))) poll_set_release_entry( set, entry );
+        LeaveCriticalSection( &set->cs );
+    }
+    LeaveCriticalSection( &poll_sets_cs );
+}
+
+/* start a new call on the set, the caller must hold the set lock */
+static void poll_set_begin( struct poll_set *set )
+{
+    if (set->removed) poll_set_compact( set );
+    set->stamp++;
+}
+
+/* get the entry for a socket polled by the current call, creating it if needed */
+static struct poll_set_entry *poll_set_get( struct poll_set *set, SOCKET s, DWORD access )
+{
+    struct poll_set_entry *entry = poll_set_find( set, s );
+    unsigned int generation;
+    int fd;
+
+    /* the handle may have been closed with CloseHandle() and reused since the
+     * previous call; this is read before getting a new fd, so that a close
+     * racing with it is caught by the next call */
+    generation = wine_server_handle_generation( SOCKET2HANDLE(s) );
+
+    if (!entry || entry->fd == -1 || entry->generation != generation || (access & ~entry->access))
+    {
+        if ((fd = get_sock_fd( s, access, NULL )) == -1) return NULL;
+        if (!entry)
+        {
+            if (set->count == set->size && !poll_set_grow( set ))
+            {
+                release_sock_fd( s, fd );
+                SetLastError( WSAENOBUFS );
+                return NULL;
+            }
+            entry = &set->entries[set->count];
+            memset( entry, 0, sizeof(*entry) );
+            entry->socket = s;
+            poll_set_hash_entry( set, set->count++ );
+        }
+        else if (entry->fd != -1 && entry->generation == generation)
+        {
+            /* same socket, only the access rights needed checking */
+            release_sock_fd( s, fd );
+            fd = -1;
+        }
+        else poll_set_release_entry( set, entry );
+
+        if (fd != -1)
+        {
+            fcntl( fd, F_SETFD, FD_CLOEXEC );
+            entry->fd = fd;
+            entry->generation = generation;
+            entry->access = 0;
+        }
+        entry->access |= access;
+    }
+    if (entry->stamp != set->stamp)
+    {
+        entry->stamp = set->stamp;
+        entry->want = 0;
+        entry->revents = 0;
+    }
+    return entry;
+}
+
+static BOOL poll_entry_is_bound( struct poll_set_entry *entry )
+{
+    /* sockets can't become unbound again, so only unbound ones need to be checked again */
+    if (!(entry->flags & POLL_ENTRY_BOUND) && is_fd_bound( entry->fd, NULL, NULL ) == 1)
+        entry->flags |= POLL_ENTRY_BOUND;
+    return entry->flags & POLL_ENTRY_BOUND;
+}
+
+static BOOL poll_entry_is_dgram( struct poll_set_entry *entry )
+{
+    if (!(entry->flags & POLL_ENTRY_TYPE))
+    {
+        entry->flags |= POLL_ENTRY_TYPE;
+        if (_get_fd_type( entry->fd ) == SOCK_DGRAM) entry->flags |= POLL_ENTRY_DGRAM;
+    }
+    return entry->flags & POLL_ENTRY_DGRAM;
+}
+
+static BOOL poll_entry_is_oobinline( struct poll_set_entry *entry )
+{
+    if (!(entry->flags & POLL_ENTRY_OOB))
+    {
+        int oob_inlined = 0;
+        socklen_t olen = sizeof(oob_inlined);
+
+        getsockopt( entry->fd, SOL_SOCKET, SO_OOBINLINE, (char *)&oob_inlined, &olen );
+        entry->flags |= POLL_ENTRY_OOB;
+        if (oob_inlined) entry->flags |= POLL_ENTRY_OOBINLINE;
+    }
+    return entry->flags & POLL_ENTRY_OOBINLINE;
+}
+
+/* pass the changes since the previous call on to epoll, the caller must hold the set lock */
+static BOOL poll_set_update( struct poll_set *set )
+{
+    struct epoll_event event;
+    unsigned int i;
+    int op;
+
+    for (i = 0; i < set->count; i++)
+    {
+        struct poll_set_entry *entry = &set->entries[i];
+
+        if (entry->socket == INVALID_SOCKET) continue;
+        if (entry->stamp != set->stamp)  /* no longer polled */
+        {
+            poll_set_release_entry( set, entry );
+            entry->socket = INVALID_SOCKET;
+            set->removed++;
+            continue;
+        }
+        if (entry->want == entry->events) continue;
+
+        if (!entry->want) op = EPOLL_CTL_DEL;
+        else if (!entry->events) op = EPOLL_CTL_ADD;
+        else op = EPOLL_CTL_MOD;
+
+        /* the poll and epoll event flags have the same values */
+        event.events = entry->want;
+        event.data.u64 = entry->socket;
+        if (epoll_ctl( set->epoll_fd, op, entry->fd, &event ) == -1)
+        {
+            WARN( "epoll_ctl %d failed for socket %04lx: %s\n", op, entry->socket, strerror(errno) );
+            SetLastError( wsaErrno() );
+            return FALSE;
+        }
+        entry->events = entry->want;
+    }
+    return TRUE;
+}
+
+/* wait on the set; the set lock must not be held, so that sockets can be closed meanwhile */
+static int poll_set_wait( struct poll_set *set, int timeout )
+{
+    struct timeval tv1, tv2;
+    int ret, torig = timeout;
+
+    if (timeout > 0) gettimeofday( &tv1, 0 );
+
+    while ((ret = epoll_wait( set->epoll_fd, set->events, set->size, timeout )) < 0)
+    {
+        if (errno != EINTR) break;
+        if (timeout < 0) continue;
+        if (timeout == 0) return 0;
+
+        gettimeofday( &tv2, 0 );
+
+        tv2.tv_sec  -= tv1.tv_sec;
+        tv2.tv_usec -= tv1.tv_usec;
+        if (tv2.tv_usec < 0)
+        {
+            tv2.tv_usec += 1000000;
+            tv2.tv_sec  -= 1;
+        }
+
+        timeout = torig - (tv2.tv_sec * 1000) - (tv2.tv_usec + 999) / 1000;
+        if (timeout <= 0) return 0;
+    }
+    return ret;
+}
+
+/* store the results of poll_set_wait in the entries, the caller must hold the set lock */
+static void poll_set_results( struct poll_set *set, int count )
+{
+    struct poll_set_entry *entry;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (!(entry = poll_set_find( set, (SOCKET)set->events[i].data.u64 ))) continue;
+        if (entry->fd == -1 || entry->stamp != set->stamp) continue;
+        entry->revents = set->events[i].events;
+    }
+}
+
+/* get the events of a poll slot; fd is the entry index, or -1 if the slot is not polled.
+ * Like poll(), errors and hangups are reported even if no events were requested. */
+static inline int poll_set_slot_revents( struct poll_set *set, const struct pollfd *pfd )
+{
+    const struct poll_set_entry *entry;
+
+    if (pfd->fd == -1) return 0;
+    entry = &set->entries[pfd->fd];
+    if (entry->fd == -1) return POLLNVAL;  /* closed while waiting */
+    return entry->revents & (pfd->events | POLLHUP | POLLERR);
+}
+
+/* select() on a poll set; returns -1 with the last error set on failure */
+static int poll_set_select( struct poll_set *set, WS_fd_set *readfds, WS_fd_set *writefds,
+                            WS_fd_set *exceptfds, struct pollfd *fds, int timeout )
+{
+    struct poll_set_entry *entry;
+    unsigned int i, j = 0;
+    int ret;
+
+    EnterCriticalSection( &set->cs );
+    poll_set_begin( set );
+
+    if (readfds)
+        for (i = 0; i < readfds->fd_count; i++, j++)
+        {
+            if (!(entry = poll_set_get( set, readfds->fd_array[i], FILE_READ_DATA ))) goto failed;
+            fds[j].fd = entry - set->entries;
+            fds[j].events = poll_entry_is_bound( entry ) ? POLLIN : 0;
+            entry->want |= fds[j].events;
+            if (!fds[j].events) fds[j].fd = -1;  /* not polled, as for unbound sockets */
+        }
+    if (writefds)
+        for (i = 0; i < writefds->fd_count; i++, j++)
+        {
+            if (!(entry = poll_set_get( set, writefds->fd_array[i], FILE_WRITE_DATA ))) goto failed;
+            fds[j].fd = entry - set->entries;
+            fds[j].events = (poll_entry_is_bound( entry ) || poll_entry_is_dgram( entry )) ? POLLOUT : 0;
+            entry->want |= fds[j].events;
+            if (!fds[j].events) fds[j].fd = -1;  /* not polled, as for unbound sockets */
+        }
+    if (exceptfds)
+        for (i = 0; i < exceptfds->fd_count; i++, j++)
+        {
+            if (!(entry = poll_set_get( set, exceptfds->fd_array[i], 0 ))) goto failed;
+            fds[j].fd = entry - set->entries;
+            fds[j].events = 0;
+            if (poll_entry_is_bound( entry ))
+            {
+                fds[j].events = POLLHUP;
+                /* Check if we need to test for urgent data or not */
+                if (!poll_entry_is_oobinline( entry )) fds[j].events |= POLLPRI;
+            }
+            entry->want |= fds[j].events;
+            if (!fds[j].events) fds[j].fd = -1;  /* not polled, as for unbound sockets */
+        }
+
+    if (!poll_set_update( set )) goto failed;
+    LeaveCriticalSection( &set->cs );
+
+    if ((ret = poll_set_wait( set, timeout )) == -1)
+    {
+        SetLastError( wsaErrno() );
+        return -1;
+    }
+
+    EnterCriticalSection( &set->cs );
+    poll_set_results( set, ret );
+    while (j--)
+    {
+        fds[j].revents = poll_set_slot_revents( set, &fds[j] );
+        if (fds[j].revents & POLLNVAL) fds[j].revents = 0;
+    }
+    LeaveCriticalSection( &set->cs );
+
+    return get_poll_results( readfds, writefds, exceptfds, fds );
+
+failed:
+    LeaveCriticalSection( &set->cs );
+    return -1;
+}
+
+/* WSAPoll() on a poll set; returns -1 with the last error set on failure */
+static int poll_set_poll( struct poll_set *set, WSAPOLLFD *wfds, ULONG count,
+                          struct pollfd *fds, int timeout )
+{
+    struct poll_set_entry *entry;
+    int i, ret;
+
+    EnterCriticalSection( &set->cs );
+    poll_set_begin( set );
+
+    for (i = 0; i < count; i++)
+    {
+        fds[i].fd = -1;
+        fds[i].events = convert_poll_w2u( wfds[i].events );
+        if (!(entry = poll_set_get( set, wfds[i].fd, 0 ))) continue;
+        fds[i].fd = entry - set->entries;
+        /* epoll reports these anyway, but the socket must be registered to get them */
+        entry->want |= fds[i].events | POLLERR | POLLHUP;
+    }
+
+    if (!poll_set_update( set ))
+    {
+        LeaveCriticalSection( &set->cs );
+        return -1;
+    }
+    LeaveCriticalSection( &set->cs );
+
+    if ((ret = poll_set_wait( set, timeout )) == -1)
+    {
+        SetLastError( wsaErrno() );
+        return -1;
+    }
+
+    EnterCriticalSection( &set->cs );
+    poll_set_results( set, ret );
+    for (i = ret = 0; i < count; i++)
+    {
+        if (fds[i].fd == -1)
+        {
+            wfds[i].revents = WS_POLLNVAL;
+            continue;
+        }
+        if ((fds[i].revents = poll_set_slot_revents( set, &fds[i] )) & POLLNVAL)
+            wfds[i].revents = WS_POLLNVAL;
+        else if (fds[i].revents & POLLHUP)
+            wfds[i].revents = WS_POLLHUP;
+        else
+            wfds[i].revents = convert_poll_u2w( fds[i].revents );
+        if (fds[i].revents) ret++;
+    }
+    LeaveCriticalSection( &set->cs );
+    return ret;
+}
+
+#else  /* HAVE_SYS_EPOLL_H && HAVE_EPOLL_CREATE */
+
+struct poll_set;
+
+static void free_poll_set( struct poll_set *set )
+{
+}
+
+static void release_poll_set_socket( SOCKET s )
+{
+}
+
+#endif  /* HAVE_SYS_EPOLL_H && HAVE_EPOLL_CREATE */
+
 /***********************************************************************
  *		select			(WS2_32.18)
  */
@@ -5443,12 +5976,27 @@ int WINAPI WS_select(int nfds, WS_fd_set *ws_readfds,
     TRACE("read %p, write %p, excp %p timeout %p\n",
           ws_readfds, ws_writefds, ws_exceptfds, ws_timeout);
 
-    if (!(pollfds = fd_sets_to_poll( ws_readfds, ws_writefds, ws_exceptfds, &count )))
-        return SOCKET_ERROR;
-
     if (ws_timeout)
         timeout = (ws_timeout->tv_sec * 1000) + (ws_timeout->tv_usec + 999) / 1000;
 
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+    if ((count = fd_sets_count( ws_readfds, ws_writefds, ws_exceptfds )) >= POLL_SET_MIN_COUNT)
+    {
+        struct per_thread_data *ptb = get_per_thread_data();
+        struct poll_set *set;
+
+        if ((set = get_poll_set( ptb )) && (pollfds = get_poll_fds( ptb, count )))
+        {
+            if ((ret = poll_set_select( set, ws_readfds, ws_writefds, ws_exceptfds, pollfds, timeout )) == -1)
+                return SOCKET_ERROR;
+            return ret;
+        }
+    }
+#endif
+
+    if (!(pollfds = fd_sets_to_poll( ws_readfds, ws_writefds, ws_exceptfds, &count )))
+        return SOCKET_ERROR;
+
     ret = do_poll(pollfds, count, timeout);
     release_poll_fds( ws_readfds, ws_writefds, ws_exceptfds, pollfds );
 
@@ -5476,6 +6024,21 @@ int WINAPI WSAPoll(WSAPOLLFD *wfds, ULONG count, int timeout)
         return SOCKET_ERROR;
     }
 
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+    if (count >= POLL_SET_MIN_COUNT)
+    {
+        struct per_thread_data *ptb = get_per_thread_data();
+        struct poll_set *set;
+
+        if ((set = get_poll_set( ptb )) && (ufds = get_poll_fds( ptb, count )))
+        {
+            if ((ret = poll_set_poll( set, wfds, count, ufds, timeout )) == -1)
+                return SOCKET_ERROR;
+            return ret;
+        }
+    }
+#endif
+
     if (!(ufds = HeapAlloc(GetProcessHeap(), 0, count * sizeof(ufds[0]))))
     {
         SetLastError(WSAENOBUFS);
@@ -5674,7 +6237,9 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
         if (lpNumberOfBytesSent) *lpNumberOfBytesSent = n;
         if (!wsa->completion_func)
         {
-            if (cvalue) WS_AddCompletion( s, cvalue, STATUS_SUCCESS, n, FALSE );
+            /* the server would drop the completion anyway */
+            if (cvalue && !(options & FILE_WINE_SKIP_COMPLETION_PORT_ON_SUCCESS))
+                WS_AddCompletion( s, cvalue, STATUS_SUCCESS, n, FALSE );
             if (lpOverlapped->hEvent) SetEvent( lpOverlapped->hEvent );
             HeapFree( GetProcessHeap(), 0, wsa );
         }
@@ -5870,11 +6435,16 @@ int WINAPI WS_setsockopt(SOCKET s, int level, int optname,
         /* The options listed here don't need any special handling. Thanks to
          * the conversion happening above, options from there will fall through
          * to this, too.*/
+        /* select() caches the SO_OOBINLINE state of polled sockets */
+        case WS_SO_OOBINLINE:
+            release_poll_set_socket(s);
+            convert_sockopt(&level, &optname);
+            break;
+
         case WS_SO_ACCEPTCONN:
         case WS_SO_BROADCAST:
         case WS_SO_ERROR:
         case WS_SO_KEEPALIVE:
-        case WS_SO_OOBINLINE:
         /* BSD socket SO_REUSEADDR is not 100% compatible to winsock semantics.
          * however, using it the BSD way fixes bug 8513 and seems to be what
          * most programmers assume, anyway */
@@ -8087,7 +8657,9 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
             iosb->Information = n;
             if (!wsa->completion_func)
             {
-                if (cvalue) WS_AddCompletion( s, cvalue, STATUS_SUCCESS, n, FALSE );
+                /* the server would drop the completion anyway */
+                if (cvalue && !(options & FILE_WINE_SKIP_COMPLETION_PORT_ON_SUCCESS))
+                    WS_AddCompletion( s, cvalue, STATUS_SUCCESS, n, FALSE );
                 if (lpOverlapped->hEvent) SetEvent( lpOverlapped->hEvent );
                 HeapFree( GetProcessHeap(), 0, wsa );
             }
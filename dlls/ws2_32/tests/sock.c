@@ -91,6 +91,7 @@ static DWORD (WINAPI *pGetIpForwardTable)(PMIB_IPFORWARDTABLE,PULONG,BOOL);
 
 /* Function pointers from ntdll */
 static DWORD (WINAPI *pNtClose)(HANDLE);
+static BOOL (WINAPI *pSetFileCompletionNotificationModes)(HANDLE,UCHAR);
 
 /**************** Structs and typedefs ***************/
 
@@ -1312,6 +1313,9 @@ static void Init (void)
     if (ntdll)
         pNtClose = (void *)GetProcAddress(ntdll, "NtClose");
 
+    pSetFileCompletionNotificationModes = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"),
+                                                                 "SetFileCompletionNotificationModes");
+
     ok ( WSAStartup ( ver, &data ) == 0, "WSAStartup failed\n" );
     tls = TlsAlloc();
 }
@@ -7122,6 +7126,134 @@ static BOOL poll_isset(WSAPOLLFD *fds, int max, SOCKET s, int rev)
     return FALSE;
 }
 
+#define SELECT_MANY_COUNT 256
+
+static DWORD WINAPI select_many_reopen_thread(void *arg)
+{
+    struct sockaddr_in address;
+    SOCKET *sock = arg;
+
+    CloseHandle((HANDLE)*sock);
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = inet_addr("127.0.0.1");
+    *sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (*sock != INVALID_SOCKET) bind(*sock, (struct sockaddr *)&address, sizeof(address));
+    return 0;
+}
+
+static void test_select_many(void)
+{
+    struct
+    {
+        u_int  fd_count;
+        SOCKET fd_array[SELECT_MANY_COUNT];
+    } readfds, writefds;
+    SOCKET sockets[SELECT_MANY_COUNT];
+    struct timeval select_timeout;
+    struct sockaddr_in address;
+    int i, ret, len;
+    HANDLE thread;
+    DWORD start;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = inet_addr("127.0.0.1");
+    for (i = 0; i < SELECT_MANY_COUNT; i++)
+    {
+        sockets[i] = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        ok(sockets[i] != INVALID_SOCKET, "socket failed: %d\n", WSAGetLastError());
+        ret = bind(sockets[i], (struct sockaddr *)&address, sizeof(address));
+        ok(!ret, "bind failed: %d\n", WSAGetLastError());
+    }
+
+    /* repeated calls on the same sockets */
+    select_timeout.tv_sec = 0;
+    select_timeout.tv_usec = 0;
+    start = GetTickCount();
+    for (i = 0; i < 1000; i++)
+    {
+        readfds.fd_count = SELECT_MANY_COUNT;
+        memcpy(readfds.fd_array, sockets, sizeof(sockets));
+        ret = select(0, (fd_set *)&readfds, NULL, NULL, &select_timeout);
+        if (ret) break;
+    }
+    ok(!ret, "expected 0, got %d\n", ret);
+    trace("1000 select() calls on %u sockets took %u ms\n", SELECT_MANY_COUNT, GetTickCount() - start);
+
+    writefds.fd_count = SELECT_MANY_COUNT;
+    memcpy(writefds.fd_array, sockets, sizeof(sockets));
+    ret = select(0, NULL, (fd_set *)&writefds, NULL, &select_timeout);
+    ok(ret == SELECT_MANY_COUNT, "expected %u, got %d\n", SELECT_MANY_COUNT, ret);
+
+    len = sizeof(address);
+    ret = getsockname(sockets[SELECT_MANY_COUNT - 1], (struct sockaddr *)&address, &len);
+    ok(!ret, "getsockname failed: %d\n", WSAGetLastError());
+    ret = sendto(sockets[0], "x", 1, 0, (struct sockaddr *)&address, len);
+    ok(ret == 1, "sendto failed: %d\n", WSAGetLastError());
+
+    select_timeout.tv_sec = 1;
+    readfds.fd_count = SELECT_MANY_COUNT;
+    memcpy(readfds.fd_array, sockets, sizeof(sockets));
+    ret = select(0, (fd_set *)&readfds, NULL, NULL, &select_timeout);
+    ok(ret == 1, "expected 1, got %d\n", ret);
+    ok(readfds.fd_array[0] == sockets[SELECT_MANY_COUNT - 1], "wrong socket %lx\n", readfds.fd_array[0]);
+
+    /* a socket closed since the previous call is no longer accepted */
+    closesocket(sockets[1]);
+    readfds.fd_count = SELECT_MANY_COUNT;
+    memcpy(readfds.fd_array, sockets, sizeof(sockets));
+    SetLastError(0xdeadbeef);
+    ret = select(0, (fd_set *)&readfds, NULL, NULL, &select_timeout);
+    ok(ret == SOCKET_ERROR, "expected -1, got %d\n", ret);
+    ok(GetLastError() == WSAENOTSOCK, "expected 10038, got %d\n", GetLastError());
+
+    /* a socket handle closed and reused in another thread refers to the new socket */
+    sockets[1] = sockets[0];
+    thread = CreateThread(NULL, 0, select_many_reopen_thread, &sockets[2], 0, NULL);
+    ok(WaitForSingleObject(thread, 5000) == WAIT_OBJECT_0, "thread did not finish\n");
+    CloseHandle(thread);
+    ok(sockets[2] != INVALID_SOCKET, "socket failed\n");
+
+    len = sizeof(address);
+    ret = getsockname(sockets[2], (struct sockaddr *)&address, &len);
+    ok(!ret, "getsockname failed: %d\n", WSAGetLastError());
+    ret = sendto(sockets[0], "x", 1, 0, (struct sockaddr *)&address, len);
+    ok(ret == 1, "sendto failed: %d\n", WSAGetLastError());
+
+    readfds.fd_count = SELECT_MANY_COUNT;
+    memcpy(readfds.fd_array, sockets, sizeof(sockets));
+    ret = select(0, (fd_set *)&readfds, NULL, NULL, &select_timeout);
+    ok(ret == 2, "expected 2, got %d\n", ret);
+    ok(readfds.fd_array[0] == sockets[2] || readfds.fd_array[1] == sockets[2],
+       "socket %lx not readable\n", sockets[2]);
+
+    /* hangups are reported even if no events were requested */
+    if (pWSAPoll)
+    {
+        WSAPOLLFD pollfds[SELECT_MANY_COUNT];
+        SOCKET src, dst;
+
+        ok(!tcp_socketpair(&src, &dst), "creating socket pair failed\n");
+        closesocket(src);
+        shutdown(dst, SD_SEND);
+        for (i = 0; i < SELECT_MANY_COUNT; i++)
+        {
+            pollfds[i].fd = i == 1 ? dst : sockets[i];
+            pollfds[i].events = 0;
+            pollfds[i].revents = 0xdead;
+        }
+        ret = pWSAPoll(pollfds, SELECT_MANY_COUNT, 1000);
+        ok(ret == 1, "expected 1, got %d\n", ret);
+        ok(pollfds[1].revents & POLLHUP, "got events %x\n", pollfds[1].revents);
+        ok(!pollfds[0].revents, "got events %x\n", pollfds[0].revents);
+        closesocket(dst);
+    }
+
+    for (i = 0; i < SELECT_MANY_COUNT; i++)
+        if (i != 1) closesocket(sockets[i]);
+}
+
 static void test_WSAPoll(void)
 {
     int ix, ret, err, poll_timeout;
@@ -9653,6 +9785,83 @@ end:
     return ret;
 }
 
+#define SKIP_ON_SUCCESS_PACKETS 1000
+
+static void test_completion_skip_on_success(void)
+{
+    struct sockaddr_in address;
+    SOCKET src, dst;
+    HANDLE port;
+    WSAOVERLAPPED ov, *povl;
+    WSABUF wsabuf;
+    DWORD num_bytes, flags, start;
+    ULONG_PTR key;
+    char buf[64];
+    int i, ret, len, immediate = 0;
+    BOOL bret;
+
+    if (!pSetFileCompletionNotificationModes)
+    {
+        win_skip("SetFileCompletionNotificationModes not available\n");
+        return;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = inet_addr("127.0.0.1");
+    src = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    ok(src != INVALID_SOCKET, "socket failed: %d\n", WSAGetLastError());
+    dst = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    ok(dst != INVALID_SOCKET, "socket failed: %d\n", WSAGetLastError());
+    ret = bind(dst, (struct sockaddr *)&address, sizeof(address));
+    ok(!ret, "bind failed: %d\n", WSAGetLastError());
+    len = sizeof(address);
+    ret = getsockname(dst, (struct sockaddr *)&address, &len);
+    ok(!ret, "getsockname failed: %d\n", WSAGetLastError());
+
+    port = CreateIoCompletionPort((HANDLE)dst, NULL, 125, 0);
+    ok(port != NULL, "CreateIoCompletionPort failed: %u\n", GetLastError());
+    bret = pSetFileCompletionNotificationModes((HANDLE)dst, FILE_SKIP_COMPLETION_PORT_ON_SUCCESS);
+    ok(bret, "SetFileCompletionNotificationModes failed: %u\n", GetLastError());
+
+    wsabuf.buf = buf;
+    wsabuf.len = sizeof(buf);
+    start = GetTickCount();
+    for (i = 0; i < SKIP_ON_SUCCESS_PACKETS; i++)
+    {
+        ret = sendto(src, "packet", 6, 0, (struct sockaddr *)&address, len);
+        ok(ret == 6, "sendto failed: %d\n", WSAGetLastError());
+
+        memset(&ov, 0, sizeof(ov));
+        flags = 0;
+        num_bytes = 0xdeadbeef;
+        ret = WSARecv(dst, &wsabuf, 1, &num_bytes, &flags, &ov, NULL);
+        if (!ret)
+        {
+            /* successful immediate completions must not be queued */
+            ok(num_bytes == 6, "got %u bytes\n", num_bytes);
+            immediate++;
+            continue;
+        }
+        ok(WSAGetLastError() == ERROR_IO_PENDING, "WSARecv failed: %d\n", WSAGetLastError());
+        bret = GetQueuedCompletionStatus(port, &num_bytes, &key, &povl, 1000);
+        ok(bret, "GetQueuedCompletionStatus failed: %u\n", GetLastError());
+        ok(povl == &ov, "got overlapped %p\n", povl);
+        ok(num_bytes == 6, "got %u bytes\n", num_bytes);
+    }
+    trace("received %u packets (%u immediately) in %u ms\n", SKIP_ON_SUCCESS_PACKETS,
+          immediate, GetTickCount() - start);
+
+    SetLastError(0xdeadbeef);
+    bret = GetQueuedCompletionStatus(port, &num_bytes, &key, &povl, 0);
+    ok(!bret, "got unexpected completion for %p\n", povl);
+    ok(GetLastError() == WAIT_TIMEOUT, "got error %u\n", GetLastError());
+
+    closesocket(src);
+    closesocket(dst);
+    CloseHandle(port);
+}
+
 static void test_completion_port(void)
 {
     HANDLE previous_port, io_port;
@@ -11555,6 +11764,7 @@ START_TEST( sock )
     test_errors();
     test_listen();
     test_select();
+    test_select_many();
     test_accept();
     test_getpeername();
     test_getsockname();
@@ -11596,6 +11806,7 @@ START_TEST( sock )
     test_WSAAsyncGetServByName();
 
     test_completion_port();
+    test_completion_skip_on_success();
     test_address_list_query();
 
     /* this is an io heavy test, do it at the end so the kernel doesn't start dropping packets */
@@ -54,6 +54,11 @@ extern void CDECL wine_server_send_fd( int fd );
 extern int CDECL wine_server_fd_to_handle( int fd, unsigned int access, unsigned int attributes, HANDLE *handle );
 extern int CDECL wine_server_handle_to_fd( HANDLE handle, unsigned int access, int *unix_fd, unsigned int *options );
 extern void CDECL wine_server_release_fd( HANDLE handle, int unix_fd );
+extern unsigned int CDECL wine_server_handle_generation( HANDLE handle );
+
+/* flag set in the options returned by wine_server_handle_to_fd() when successful
+ * synchronous I/O must not be queued to the completion port */
+#define FILE_WINE_SKIP_COMPLETION_PORT_ON_SUCCESS 0x80000000
 
 /* do a server call and set the last error code */
 static inline unsigned int wine_server_call_err( void *req_ptr )
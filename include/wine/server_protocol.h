@@ -64,8 +64,42 @@ typedef struct
     user_handle_t   input_focus;
     user_handle_t   input_capture;
     user_handle_t   input_active;
+    unsigned int    queue_seq;
+    int             changed_bits;
+    unsigned int    completion_ring;
 } shmlocal_t;
 
+#define COMPLETION_SHM_ENTRIES 1024
+
+#define COMPLETION_SHM_OWNER_SERVER    0xfffffffe
+#define COMPLETION_SHM_OWNER_ABANDONED 0xffffffff
+
+typedef struct
+{
+    unsigned int    seq;
+    unsigned int    status;
+    unsigned int    owner;
+    unsigned int    consumer;
+    apc_param_t     ckey;
+    apc_param_t     cvalue;
+    apc_param_t     information;
+} completion_shm_entry_t;
+
+typedef struct
+{
+    unsigned int    head;
+    unsigned int    __pad1[15];
+    unsigned int    tail;
+    unsigned int    __pad2[15];
+    unsigned int    signal;
+    unsigned int    waiters;
+    unsigned int    server_waiters;
+    unsigned int    overflow;
+    unsigned int    id;
+    unsigned int    __pad3[11];
+    completion_shm_entry_t entries[COMPLETION_SHM_ENTRIES];
+} completion_shm_t;
+
 
 typedef union
 {
@@ -362,6 +396,19 @@ typedef union
 } message_data_t;
 
 
+typedef struct
+{
+    user_handle_t   win;
+    unsigned int    msg;
+    lparam_t        wparam;
+    lparam_t        lparam;
+    int             x;
+    int             y;
+    unsigned int    time;
+    int             __pad;
+} posted_message_t;
+
+
 typedef struct
 {
     WCHAR          ch;
@@ -945,6 +992,20 @@ struct get_process_vm_counters_reply
 
 
 
+struct get_process_handle_count_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_process_handle_count_reply
+{
+    struct reply_header __header;
+    unsigned int count;
+    char __pad_12[4];
+};
+
+
+
 struct set_process_info_request
 {
     struct request_header __header;
@@ -1548,6 +1609,8 @@ struct get_handle_fd_reply
     int          cacheable;
     unsigned int access;
     unsigned int options;
+    unsigned int comp_flags;
+    char __pad_28[4];
 };
 enum server_fd_type
 {
@@ -2332,7 +2395,9 @@ struct get_mapping_info_reply
     mem_size_t   size;
     unsigned int flags;
     obj_handle_t shared_file;
+    obj_handle_t image_file;
     /* VARARG(image,pe_image_info); */
+    char __pad_28[4];
 };
 
 
@@ -3199,6 +3264,8 @@ struct get_message_request
     unsigned int    hw_id;
     unsigned int    wake_mask;
     unsigned int    changed_mask;
+    unsigned int    prefetch;
+    char __pad_44[4];
 };
 struct get_message_reply
 {
@@ -3213,7 +3280,9 @@ struct get_message_reply
     unsigned int    time;
     unsigned int    active_hooks;
     data_size_t     total;
+    unsigned int    prefetched;
     /* VARARG(data,message_data); */
+    char __pad_60[4];
 };
 
 
@@ -5391,6 +5460,30 @@ struct remove_completion_reply
 
 
 
+struct get_completion_shm_request
+{
+    struct request_header __header;
+    obj_handle_t  handle;
+};
+struct get_completion_shm_reply
+{
+    struct reply_header __header;
+};
+
+
+
+struct wake_completion_request
+{
+    struct request_header __header;
+    obj_handle_t  handle;
+};
+struct wake_completion_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct query_completion_request
 {
     struct request_header __header;
@@ -5825,6 +5918,7 @@ enum request
     REQ_terminate_thread,
     REQ_get_process_info,
     REQ_get_process_vm_counters,
+    REQ_get_process_handle_count,
     REQ_set_process_info,
     REQ_get_thread_info,
     REQ_get_thread_times,
@@ -6086,6 +6180,8 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_get_completion_shm,
+    REQ_wake_completion,
     REQ_query_completion,
     REQ_set_completion_info,
     REQ_add_fd_completion,
@@ -6131,6 +6227,7 @@ union generic_request
     struct terminate_thread_request terminate_thread_request;
     struct get_process_info_request get_process_info_request;
     struct get_process_vm_counters_request get_process_vm_counters_request;
+    struct get_process_handle_count_request get_process_handle_count_request;
     struct set_process_info_request set_process_info_request;
     struct get_thread_info_request get_thread_info_request;
     struct get_thread_times_request get_thread_times_request;
@@ -6392,6 +6489,8 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct get_completion_shm_request get_completion_shm_request;
+    struct wake_completion_request wake_completion_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
@@ -6435,6 +6534,7 @@ union generic_reply
     struct terminate_thread_reply terminate_thread_reply;
     struct get_process_info_reply get_process_info_reply;
     struct get_process_vm_counters_reply get_process_vm_counters_reply;
+    struct get_process_handle_count_reply get_process_handle_count_reply;
     struct set_process_info_reply set_process_info_reply;
     struct get_thread_info_reply get_thread_info_reply;
     struct get_thread_times_reply get_thread_times_reply;
@@ -6696,6 +6796,8 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct get_completion_shm_reply get_completion_shm_reply;
+    struct wake_completion_reply wake_completion_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
@@ -6725,6 +6827,6 @@ union generic_reply
     struct esync_msgwait_reply esync_msgwait_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 579
+#define SERVER_PROTOCOL_VERSION 587
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
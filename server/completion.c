@@ -31,6 +31,10 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#include <unistd.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -46,13 +50,22 @@
 
 struct completion
 {
-    struct object  obj;
-    struct list    queue;
-    unsigned int   depth;
+    struct object     obj;
+    struct list       queue;
+    unsigned int      depth;    /* number of messages in queue, not counting the ring */
+    int               shm_fd;   /* fd of the shared message ring */
+    completion_shm_t *shm;      /* shared message ring, NULL until requested by a client */
+    struct list       shm_entry; /* entry in completion_shm_list */
 };
 
+/* completion ports with a shared message ring */
+static struct list completion_shm_list = LIST_INIT( completion_shm_list );
+static unsigned int next_ring_id;
+
 static void completion_dump( struct object*, int );
 static struct object_type *completion_get_type( struct object *obj );
+static int completion_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void completion_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int completion_signaled( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int completion_map_access( struct object *obj, unsigned int access );
 static void completion_destroy( struct object * );
@@ -62,8 +75,8 @@ static const struct object_ops completion_ops =
     sizeof(struct completion), /* size */
     completion_dump,           /* dump */
     completion_get_type,       /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    completion_add_queue,      /* add_queue */
+    completion_remove_queue,   /* remove_queue */
     completion_signaled,       /* signaled */
     NULL,                      /* get_esync_fd */
     no_satisfied,              /* satisfied */
@@ -89,6 +102,195 @@ struct comp_msg
     unsigned int  status;
 };
 
+/* the ring entries are shared with the clients, so never trust them to make progress */
+#define COMPLETION_SHM_SPIN 64
+
+static inline unsigned int shm_read( const unsigned int *ptr )
+{
+    return *(const volatile unsigned int *)ptr;
+}
+
+/* claim the entry for the tail position pos; the owner id lets the server
+ * recover entries claimed by threads that die before publishing them */
+static int completion_shm_claim( completion_shm_t *shm, completion_shm_entry_t *entry,
+                                 unsigned int pos, unsigned int owner )
+{
+    if (interlocked_cmpxchg( (int *)&entry->owner, owner, 0 )) return 0;
+    if (shm_read( &shm->tail ) == pos && shm_read( &entry->seq ) == pos &&
+        interlocked_cmpxchg( (int *)&shm->tail, pos + 1, pos ) == pos)
+        return 1;
+    interlocked_xchg( (int *)&entry->owner, 0 );
+    return 0;
+}
+
+/* add a message to the shared ring, fails if the ring is full */
+static int completion_shm_add( completion_shm_t *shm, apc_param_t ckey, apc_param_t cvalue,
+                               unsigned int status, apc_param_t information )
+{
+    completion_shm_entry_t *entry;
+    unsigned int pos, seq;
+    int i;
+
+    for (i = 0; i < COMPLETION_SHM_SPIN; i++)
+    {
+        pos = shm_read( &shm->tail );
+        entry = &shm->entries[pos % COMPLETION_SHM_ENTRIES];
+        seq = shm_read( &entry->seq );
+        if ((int)(seq - pos) < 0) return 0;
+        if (seq != pos) continue;
+        if (!completion_shm_claim( shm, entry, pos, COMPLETION_SHM_OWNER_SERVER )) continue;
+
+        entry->ckey        = ckey;
+        entry->cvalue      = cvalue;
+        entry->status      = status;
+        entry->information = information;
+        interlocked_xchg( (int *)&entry->seq, pos + 1 );
+        return 1;
+    }
+    return 0;
+}
+
+/* remove a message from the shared ring, fails if the ring is empty */
+static int completion_shm_remove( completion_shm_t *shm, struct comp_msg *msg )
+{
+    completion_shm_entry_t *entry;
+    unsigned int pos, seq;
+    int i, abandoned;
+
+    for (i = 0; i < COMPLETION_SHM_SPIN; i++)
+    {
+        pos = shm_read( &shm->head );
+        entry = &shm->entries[pos % COMPLETION_SHM_ENTRIES];
+        seq = shm_read( &entry->seq );
+        if ((int)(seq - (pos + 1)) < 0) return 0;
+        if (seq != pos + 1) continue;
+        /* the consumer id lets the server finish removals of threads that die */
+        if (interlocked_cmpxchg( (int *)&entry->consumer, COMPLETION_SHM_OWNER_SERVER, 0 )) continue;
+        if (interlocked_cmpxchg( (int *)&shm->head, pos + 1, pos ) != pos)
+        {
+            interlocked_xchg( (int *)&entry->consumer, 0 );
+            continue;
+        }
+
+        msg->ckey        = entry->ckey;
+        msg->cvalue      = entry->cvalue;
+        msg->status      = entry->status;
+        msg->information = entry->information;
+        abandoned = (entry->owner == COMPLETION_SHM_OWNER_ABANDONED);
+        interlocked_xchg( (int *)&entry->owner, 0 );
+        interlocked_xchg( (int *)&entry->seq, pos + COMPLETION_SHM_ENTRIES );
+        interlocked_xchg( (int *)&entry->consumer, 0 );
+        if (!abandoned) return 1;
+    }
+    return 0;
+}
+
+/* number of messages currently in the shared ring */
+static unsigned int completion_shm_count( completion_shm_t *shm )
+{
+    unsigned int count = shm_read( &shm->tail ) - shm_read( &shm->head );
+
+    return min( count, COMPLETION_SHM_ENTRIES );
+}
+
+/* notify the client threads waiting on the ring futex */
+static void completion_shm_signal( completion_shm_t *shm )
+{
+    interlocked_xchg_add( (int *)&shm->signal, 1 );
+#if defined(__linux__) && defined(__NR_futex)
+    if (shm_read( &shm->waiters ))
+        syscall( __NR_futex, &shm->signal, 1 /* FUTEX_WAKE */, 1, NULL, 0, 0 );
+#endif
+}
+
+/* move as many server queued messages as possible to the shared ring */
+static void completion_flush_queue( struct completion *completion )
+{
+    struct comp_msg *msg, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE( msg, next, &completion->queue, struct comp_msg, queue_entry )
+    {
+        if (!completion_shm_add( completion->shm, msg->ckey, msg->cvalue, msg->status, msg->information ))
+            break;
+        list_remove( &msg->queue_entry );
+        completion->depth--;
+        free( msg );
+        completion_shm_signal( completion->shm );
+    }
+    completion->shm->overflow = completion->depth;
+}
+
+/* release the ring entries of a thread that died while adding or removing them */
+static void release_ring_slots( completion_shm_t *shm, unsigned int id )
+{
+    completion_shm_entry_t *entry;
+    unsigned int i, seq;
+
+    for (i = 0; i < COMPLETION_SHM_ENTRIES; i++)
+    {
+        entry = &shm->entries[i];
+
+        if (shm_read( &entry->consumer ) == id)
+        {
+            seq = shm_read( &entry->seq );
+            /* published entry whose head position was taken, finish removing it */
+            if ((seq - 1) % COMPLETION_SHM_ENTRIES == i && (int)(shm_read( &shm->head ) - seq) >= 0)
+            {
+                interlocked_xchg( (int *)&entry->owner, 0 );
+                interlocked_xchg( (int *)&entry->seq, seq - 1 + COMPLETION_SHM_ENTRIES );
+            }
+            interlocked_xchg( (int *)&entry->consumer, 0 );
+            continue;
+        }
+
+        if (shm_read( &entry->owner ) != id) continue;
+        seq = shm_read( &entry->seq );
+        if (seq % COMPLETION_SHM_ENTRIES != i) continue;  /* published, freed when removed */
+
+        if ((int)(shm_read( &shm->tail ) - seq) > 0)
+        {
+            /* the tail position was taken, publish the entry as a message to skip */
+            interlocked_xchg( (int *)&entry->owner, COMPLETION_SHM_OWNER_ABANDONED );
+            interlocked_xchg( (int *)&entry->seq, seq + 1 );
+            completion_shm_signal( shm );
+        }
+        else interlocked_xchg( (int *)&entry->owner, 0 );
+    }
+}
+
+/* release the ring entries a thread was adding or removing when it died */
+void release_completion_slots( struct thread *thread )
+{
+    struct completion *completion;
+    unsigned int ring = 0;
+
+    /* threads with shared memory tell which ring they were changing, if any */
+    if (thread->shm && !(ring = thread->shm->completion_ring)) return;
+
+    LIST_FOR_EACH_ENTRY( completion, &completion_shm_list, struct completion, shm_entry )
+    {
+        if (ring && completion->shm->id != ring) continue;
+        release_ring_slots( completion->shm, thread->id );
+        if (ring) break;
+    }
+}
+
+static int init_completion_shm( struct completion *completion )
+{
+    unsigned int i;
+
+    if (!allocate_shared_memory( &completion->shm_fd, (void **)&completion->shm, sizeof(*completion->shm) ))
+        return 0;
+    list_add_tail( &completion_shm_list, &completion->shm_entry );
+
+    for (i = 0; i < COMPLETION_SHM_ENTRIES; i++) completion->shm->entries[i].seq = i;
+    if (!++next_ring_id) next_ring_id++;
+    completion->shm->id = next_ring_id;
+    completion->shm->server_waiters = list_count( &completion->obj.wait_queue );
+    completion_flush_queue( completion );
+    return 1;
+}
+
 static void completion_destroy( struct object *obj)
 {
     struct completion *completion = (struct completion *) obj;
@@ -98,6 +300,11 @@ static void completion_destroy( struct object *obj)
     {
         free( tmp );
     }
+    if (completion->shm)
+    {
+        list_remove( &completion->shm_entry );
+        release_shared_memory( completion->shm_fd, completion->shm, sizeof(*completion->shm) );
+    }
 }
 
 static void completion_dump( struct object *obj, int verbose )
@@ -105,7 +312,8 @@ static void completion_dump( struct object *obj, int verbose )
     struct completion *completion = (struct completion *) obj;
 
     assert( obj->ops == &completion_ops );
-    fprintf( stderr, "Completion depth=%u\n", completion->depth );
+    fprintf( stderr, "Completion depth=%u\n",
+             completion->depth + (completion->shm ? completion_shm_count( completion->shm ) : 0) );
 }
 
 static struct object_type *completion_get_type( struct object *obj )
@@ -115,10 +323,27 @@ static struct object_type *completion_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int completion_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct completion *completion = (struct completion *)obj;
+
+    if (completion->shm) interlocked_xchg_add( (int *)&completion->shm->server_waiters, 1 );
+    return add_queue( obj, entry );
+}
+
+static void completion_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct completion *completion = (struct completion *)obj;
+
+    if (completion->shm) interlocked_xchg_add( (int *)&completion->shm->server_waiters, -1 );
+    remove_queue( obj, entry );
+}
+
 static int completion_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct completion *completion = (struct completion *)obj;
 
+    if (completion->shm && completion_shm_count( completion->shm )) return 1;
     return !list_empty( &completion->queue );
 }
 
@@ -143,6 +368,8 @@ static struct completion *create_completion( struct object *root, const struct u
         {
             list_init( &completion->queue );
             completion->depth = 0;
+            completion->shm_fd = -1;
+            completion->shm = NULL;
         }
     }
 
@@ -157,9 +384,18 @@ struct completion *get_completion_obj( struct process *process, obj_handle_t han
 void add_completion( struct completion *completion, apc_param_t ckey, apc_param_t cvalue,
                      unsigned int status, apc_param_t information )
 {
-    struct comp_msg *msg = mem_alloc( sizeof( *msg ) );
+    struct comp_msg *msg;
+
+    /* keep messages ordered: the ring is only used directly while nothing is queued in the server */
+    if (completion->shm && list_empty( &completion->queue ) &&
+        completion_shm_add( completion->shm, ckey, cvalue, status, information ))
+    {
+        completion_shm_signal( completion->shm );
+        wake_up( &completion->obj, 1 );
+        return;
+    }
 
-    if (!msg)
+    if (!(msg = mem_alloc( sizeof( *msg ) )))
         return;
 
     msg->ckey = ckey;
@@ -169,6 +405,11 @@ void add_completion( struct completion *completion, apc_param_t ckey, apc_param_
 
     list_add_tail( &completion->queue, &msg->queue_entry );
     completion->depth++;
+    if (completion->shm)
+    {
+        completion->shm->overflow = completion->depth;
+        completion_shm_signal( completion->shm );
+    }
     wake_up( &completion->obj, 1 );
 }
 
@@ -219,12 +460,18 @@ DECL_HANDLER(remove_completion)
 {
     struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
     struct list *entry;
-    struct comp_msg *msg;
+    struct comp_msg *msg, shm_msg;
 
     if (!completion) return;
 
-    entry = list_head( &completion->queue );
-    if (!entry)
+    if (completion->shm && completion_shm_remove( completion->shm, &shm_msg ))
+    {
+        reply->ckey = shm_msg.ckey;
+        reply->cvalue = shm_msg.cvalue;
+        reply->status = shm_msg.status;
+        reply->information = shm_msg.information;
+    }
+    else if (!(entry = list_head( &completion->queue )))
         set_error( STATUS_PENDING );
     else
     {
@@ -237,6 +484,36 @@ DECL_HANDLER(remove_completion)
         reply->information = msg->information;
         free( msg );
     }
+    if (completion->shm) completion_flush_queue( completion );
+
+    release_object( completion );
+}
+
+/* get the shared memory ring of a completion port */
+DECL_HANDLER(get_completion_shm)
+{
+    struct completion *completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
+
+    if (!completion) return;
+
+    if (completion->shm || init_completion_shm( completion ))
+        send_client_fd( current->process, completion->shm_fd, req->handle );
+    else
+        set_error( STATUS_NOT_SUPPORTED );
+
+    release_object( completion );
+}
+
+/* wake up the server waiters after a client added messages to the ring */
+DECL_HANDLER(wake_completion)
+{
+    struct completion *completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
+    unsigned int count;
+
+    if (!completion) return;
+
+    if (completion->shm && (count = completion_shm_count( completion->shm )))
+        wake_up( &completion->obj, count );
 
     release_object( completion );
 }
@@ -249,6 +526,7 @@ DECL_HANDLER(query_completion)
     if (!completion) return;
 
     reply->depth = completion->depth;
+    if (completion->shm) reply->depth += completion_shm_count( completion->shm );
 
     release_object( completion );
 }
@@ -1932,6 +1932,33 @@ struct fd *create_anonymous_fd( const struct fd_ops *fd_user_ops, int unix_fd, s
     return NULL;
 }
 
+/* attach a unix fd to a pseudo-fd, or detach it again if unix_fd is -1 */
+/* clients may only cache the fd while a unix fd is attached */
+int set_pseudo_fd_unix_fd( struct fd *fd, int unix_fd )
+{
+    assert( !fd->inode );
+
+    if (fd->unix_fd != -1)
+    {
+        remove_poll_user( fd, fd->poll_index );
+        fd->poll_index = -1;
+        close( fd->unix_fd );
+    }
+    fd->unix_fd = unix_fd;
+    fd->cacheable = 0;
+    if (unix_fd == -1) return 1;
+
+    if ((fd->poll_index = add_poll_user( fd )) == -1)
+    {
+        close( unix_fd );
+        fd->unix_fd = -1;
+        set_error( STATUS_NO_MEMORY );
+        return 0;
+    }
+    fd->cacheable = 1;
+    return 1;
+}
+
 /* retrieve the object that is using an fd */
 void *get_fd_user( struct fd *fd )
 {
@@ -2549,6 +2576,7 @@ DECL_HANDLER(get_handle_fd)
         {
             reply->type = fd->fd_ops->get_fd_type( fd );
             reply->options = fd->options;
+            reply->comp_flags = fd->comp_flags;
             reply->access = get_handle_access( current->process, req->handle );
             send_client_fd( current->process, unix_fd, req->handle );
         }
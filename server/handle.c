@@ -41,8 +41,8 @@
 
 struct handle_entry
 {
-    struct object *ptr;       /* object */
-    unsigned int   access;    /* access rights */
+    struct object *ptr;       /* object, NULL for a free entry */
+    unsigned int   access;    /* access rights, or index of the next free entry */
 };
 
 struct handle_table
@@ -50,8 +50,9 @@ struct handle_table
     struct object        obj;         /* object header */
     struct process      *process;     /* process owning this table */
     int                  count;       /* number of allocated entries */
-    int                  last;        /* last used entry */
-    int                  free;        /* first entry that may be free */
+    int                  last;        /* highest entry used so far */
+    int                  free;        /* head of the list of free entries up to last, -1 if empty */
+    int                  used;        /* number of used entries */
     struct handle_entry *entries;     /* handle entries */
 };
 
@@ -147,8 +148,8 @@ static void handle_table_dump( struct object *obj, int verbose )
 
     assert( obj->ops == &handle_table_ops );
 
-    fprintf( stderr, "Handle table last=%d count=%d process=%p\n",
-             table->last, table->count, table->process );
+    fprintf( stderr, "Handle table last=%d count=%d used=%d process=%p\n",
+             table->last, table->count, table->used, table->process );
     if (!verbose) return;
     entry = table->entries;
     for (i = 0; i <= table->last; i++, entry++)
@@ -209,7 +210,8 @@ struct handle_table *alloc_handle_table( struct process *process, int count )
     table->process = process;
     table->count   = count;
     table->last    = -1;
-    table->free    = 0;
+    table->free    = -1;
+    table->used    = 0;
     if ((table->entries = mem_alloc( count * sizeof(*table->entries) ))) return table;
     release_object( table );
     return NULL;
@@ -232,23 +234,31 @@ static int grow_handle_table( struct handle_table *table )
     return 1;
 }
 
-/* allocate the first free entry in the handle table */
+/* add an entry to the free list of the handle table */
+static inline void free_entry( struct handle_table *table, int index )
+{
+    table->entries[index].ptr    = NULL;
+    table->entries[index].access = table->free;
+    table->free = index;
+}
+
+/* allocate a free entry in the handle table, the most recently freed one first */
 static obj_handle_t alloc_entry( struct handle_table *table, void *obj, unsigned int access )
 {
-    struct handle_entry *entry = table->entries + table->free;
+    struct handle_entry *entry;
     int i;
 
-    for (i = table->free; i <= table->last; i++, entry++) if (!entry->ptr) goto found;
-    if (i >= table->count)
+    if ((i = table->free) != -1) table->free = table->entries[i].access;
+    else
     {
-        if (!grow_handle_table( table )) return 0;
-        entry = table->entries + i;  /* the entries may have moved */
+        i = table->last + 1;
+        if (i >= table->count && !grow_handle_table( table )) return 0;
+        table->last = i;
     }
-    table->last = i;
- found:
-    table->free = i + 1;
+    entry = table->entries + i;
     entry->ptr    = grab_object_for_handle( obj );
     entry->access = access;
+    table->used++;
     return index_to_handle(i);
 }
 
@@ -332,19 +342,12 @@ static struct handle_entry *get_handle( struct process *process, obj_handle_t ha
     return entry;
 }
 
-/* attempt to shrink a table */
+/* attempt to shrink a table, the free list must not extend beyond the last entry */
 static void shrink_handle_table( struct handle_table *table )
 {
-    struct handle_entry *entry = table->entries + table->last;
     struct handle_entry *new_entries;
     int count = table->count;
 
-    while (table->last >= 0)
-    {
-        if (entry->ptr) break;
-        table->last--;
-        entry--;
-    }
     if (table->last >= count / 4) return;  /* no need to shrink */
     if (count < MIN_HANDLE_ENTRIES * 2) return;  /* too small to shrink */
     count /= 2;
@@ -367,16 +370,24 @@ struct handle_table *copy_handle_table( struct process *process, struct process
     if (!(table = alloc_handle_table( process, parent_table->count )))
         return NULL;
 
-    if ((table->last = parent_table->last) >= 0)
+    if (parent_table->last >= 0)
     {
         struct handle_entry *ptr = table->entries;
-        memcpy( ptr, parent_table->entries, (table->last + 1) * sizeof(struct handle_entry) );
-        for (i = 0; i <= table->last; i++, ptr++)
+        memcpy( ptr, parent_table->entries, (parent_table->last + 1) * sizeof(struct handle_entry) );
+        for (i = 0; i <= parent_table->last; i++, ptr++)
         {
             if (!ptr->ptr) continue;
-            if (ptr->access & RESERVED_INHERIT) grab_object_for_handle( ptr->ptr );
+            if (ptr->access & RESERVED_INHERIT)
+            {
+                grab_object_for_handle( ptr->ptr );
+                table->last = i;
+                table->used++;
+            }
             else ptr->ptr = NULL; /* don't inherit this entry */
         }
+        /* rebuild the free list so that the lowest entries get used first */
+        for (i = table->last - 1; i >= 0; i--)
+            if (!table->entries[i].ptr) free_entry( table, i );
     }
     /* attempt to shrink the table */
     shrink_handle_table( table );
@@ -394,10 +405,9 @@ unsigned int close_handle( struct process *process, obj_handle_t handle )
     if (entry->access & RESERVED_CLOSE_PROTECT) return STATUS_HANDLE_NOT_CLOSABLE;
     obj = entry->ptr;
     if (!obj->ops->close_handle( obj, process, handle )) return STATUS_HANDLE_NOT_CLOSABLE;
-    entry->ptr = NULL;
     table = handle_is_global(handle) ? global_table : process->handles;
-    if (entry < table->entries + table->free) table->free = entry - table->entries;
-    if (entry == table->entries + table->last) shrink_handle_table( table );
+    free_entry( table, entry - table->entries );
+    table->used--;
     release_object_from_handle( obj );
     return STATUS_SUCCESS;
 }
@@ -612,11 +622,23 @@ obj_handle_t open_object( struct process *process, obj_handle_t parent, unsigned
     return handle;
 }
 
-/* return the size of the handle table of a given process */
+/* return the number of handles of a given process */
 unsigned int get_handle_table_count( struct process *process )
 {
     if (!process->handles) return 0;
-    return process->handles->count;
+    return process->handles->used;
+}
+
+/* return the number of handles of a process */
+DECL_HANDLER(get_process_handle_count)
+{
+    struct process *process;
+
+    if ((process = get_process_from_handle( req->handle, PROCESS_QUERY_LIMITED_INFORMATION )))
+    {
+        reply->count = get_handle_table_count( process );
+        release_object( process );
+    }
 }
 
 /* close a handle */
@@ -117,6 +117,8 @@ struct shared_map
     struct fd      *fd;              /* file descriptor of the mapped PE file */
     struct file    *file;            /* temp file holding the shared data */
     struct list     entry;           /* entry in global shared maps list */
+    file_pos_t      size;            /* size of the PE file when the data was copied */
+    time_t          mtime;           /* modification time of the PE file when the data was copied */
 };
 
 static void shared_map_dump( struct object *obj, int verbose );
@@ -146,6 +148,10 @@ static const struct object_ops shared_map_ops =
 };
 
 static struct list shared_map_list = LIST_INIT( shared_map_list );
+static struct list image_map_list = LIST_INIT( image_map_list );
+
+/* larger images are left for the loader to read, copying them would stall the server */
+#define MAX_IMAGE_MAP_SIZE (16 * 1024 * 1024)
 
 /* memory view mapped in client address space */
 struct memory_view
@@ -154,6 +160,7 @@ struct memory_view
     struct fd      *fd;              /* fd for mapped file */
     struct ranges  *committed;       /* list of committed ranges in this mapping */
     struct shared_map *shared;       /* temp file for shared PE mapping */
+    struct shared_map *image_map;    /* temp file for page-aligned PE image */
     unsigned int    flags;           /* SEC_* flags */
     client_ptr_t    base;            /* view base address (in process addr space) */
     mem_size_t      size;            /* view size */
@@ -169,6 +176,9 @@ struct mapping
     pe_image_info_t image;           /* image info (for PE image mapping) */
     struct ranges  *committed;       /* list of committed ranges in this mapping */
     struct shared_map *shared;       /* temp file for shared PE mapping */
+    struct shared_map *image_map;    /* temp file for page-aligned PE image */
+    IMAGE_SECTION_HEADER *image_sec; /* section headers for building image_map on first use */
+    unsigned int    image_nb_sec;    /* number of entries in image_sec */
 };
 
 static void mapping_dump( struct object *obj, int verbose );
@@ -394,6 +404,7 @@ static void free_memory_view( struct memory_view *view )
     if (view->fd) release_object( view->fd );
     if (view->committed) release_object( view->committed );
     if (view->shared) release_object( view->shared );
+    if (view->image_map) release_object( view->image_map );
     list_remove( &view->entry );
     free( view );
 }
@@ -408,16 +419,44 @@ void free_mapped_views( struct process *process )
 }
 
 /* find the shared PE mapping for a given mapping */
-static struct shared_map *get_shared_file( struct fd *fd )
+static struct shared_map *get_shared_file( struct list *list, struct fd *fd, int unix_fd )
 {
     struct shared_map *ptr;
+    struct stat st;
 
-    LIST_FOR_EACH_ENTRY( ptr, &shared_map_list, struct shared_map, entry )
-        if (is_same_file_fd( ptr->fd, fd ))
+    LIST_FOR_EACH_ENTRY( ptr, list, struct shared_map, entry )
+    {
+        if (!is_same_file_fd( ptr->fd, fd )) continue;
+        if (!fstat( unix_fd, &st ) && st.st_size == ptr->size && st.st_mtime == ptr->mtime)
             return (struct shared_map *)grab_object( ptr );
+        /* the file was modified since the copy was made, existing views keep using it */
+        list_remove( &ptr->entry );
+        list_init( &ptr->entry );
+        return NULL;
+    }
     return NULL;
 }
 
+/* add a new shared PE mapping to the list */
+static struct shared_map *add_shared_file( struct list *list, struct fd *fd, int unix_fd, struct file *file )
+{
+    struct shared_map *shared;
+    struct stat st;
+
+    if (fstat( unix_fd, &st ) == -1)
+    {
+        file_set_error();
+        return NULL;
+    }
+    if (!(shared = alloc_object( &shared_map_ops ))) return NULL;
+    shared->fd = (struct fd *)grab_object( fd );
+    shared->file = file;
+    shared->size = st.st_size;
+    shared->mtime = st.st_mtime;
+    list_add_head( list, &shared->entry );
+    return shared;
+}
+
 /* return the size of the memory mapping and file range of a given section */
 static inline void get_section_sizes( const IMAGE_SECTION_HEADER *sec, size_t *map_size,
                                       off_t *file_start, size_t *file_size )
@@ -553,7 +592,7 @@ static int build_shared_mapping( struct mapping *mapping, int fd,
     }
     if (!total_size) return 1;  /* nothing to do */
 
-    if ((mapping->shared = get_shared_file( mapping->fd ))) return 1;
+    if ((mapping->shared = get_shared_file( &shared_map_list, mapping->fd, fd ))) return 1;
 
     /* create a temp file for the mapping */
 
@@ -589,10 +628,7 @@ static int build_shared_mapping( struct mapping *mapping, int fd,
         if (pwrite( shared_fd, buffer, file_size, write_pos ) != file_size) goto error;
     }
 
-    if (!(shared = alloc_object( &shared_map_ops ))) goto error;
-    shared->fd = (struct fd *)grab_object( mapping->fd );
-    shared->file = file;
-    list_add_head( &shared_map_list, &shared->entry );
+    if (!(shared = add_shared_file( &shared_map_list, mapping->fd, fd, file ))) goto error;
     mapping->shared = shared;
     free( buffer );
     return 1;
@@ -603,6 +639,114 @@ static int build_shared_mapping( struct mapping *mapping, int fd,
     return 0;
 }
 
+/* check whether the sections of a PE image can be mapped directly from its file;
+ * if not, keep the section headers for building a copy once the image is mapped */
+static void check_image_mapping( struct mapping *mapping, IMAGE_SECTION_HEADER *sec, unsigned int nb_sec )
+{
+    unsigned int i;
+    size_t file_size, map_size, total_size = 0;
+    off_t read_pos;
+    int unaligned = 0;
+
+    /* fake dlls are unmapped right away, and flat images are mapped as they are */
+    if (mapping->image.image_flags & (IMAGE_FLAGS_ImageMappedFlat | IMAGE_FLAGS_WineFakeDll)) return;
+    if (mapping->image.map_size > MAX_IMAGE_MAP_SIZE) return;
+
+    for (i = 0; i < nb_sec; i++)
+    {
+        if ((sec[i].Characteristics & IMAGE_SCN_MEM_SHARED) &&
+            (sec[i].Characteristics & IMAGE_SCN_MEM_WRITE)) continue;
+        get_section_sizes( &sec[i], &map_size, &read_pos, &file_size );
+        if (!sec[i].PointerToRawData || !file_size) continue;
+        if ((read_pos & page_mask) || (sec[i].VirtualAddress & page_mask)) unaligned = 1;
+        total_size += file_size;
+    }
+    if (!unaligned) return;  /* the file itself can be mapped */
+    if (total_size > MAX_IMAGE_MAP_SIZE) return;
+
+    if ((mapping->image_sec = memdup( sec, nb_sec * sizeof(*sec) ))) mapping->image_nb_sec = nb_sec;
+    else clear_error();  /* not fatal, the loader reads the sections in itself */
+}
+
+/* lay out the sections of a PE image that can't be mapped directly from its file
+ * (offsets not page-aligned) in a temp file, so that all processes mapping that
+ * image share the same pages instead of each reading in a private copy */
+static void build_image_mapping( struct mapping *mapping )
+{
+    IMAGE_SECTION_HEADER *sec = mapping->image_sec;
+    unsigned int i, nb_sec = mapping->image_nb_sec;
+    struct shared_map *image;
+    struct file *file;
+    size_t file_size, map_size, max_size = 0;
+    off_t read_pos, write_pos;
+    char *buffer = NULL;
+    int fd, image_fd;
+    long toread;
+
+    /* only the first mapping of the image tries to build it */
+    mapping->image_sec = NULL;
+    mapping->image_nb_sec = 0;
+
+    if ((fd = get_unix_fd( mapping->fd )) == -1) goto failed;
+    if ((mapping->image_map = get_shared_file( &image_map_list, mapping->fd, fd ))) goto done;
+
+    for (i = 0; i < nb_sec; i++)
+    {
+        get_section_sizes( &sec[i], &map_size, &read_pos, &file_size );
+        if (file_size > max_size) max_size = file_size;
+    }
+
+    /* create a temp file for the mapping */
+
+    if ((image_fd = create_temp_file( mapping->image.map_size )) == -1) goto failed;
+    if (!(file = create_file_for_fd( image_fd, FILE_GENERIC_READ|FILE_GENERIC_WRITE, 0 ))) goto failed;
+
+    if (!(buffer = malloc( max_size ))) goto error;
+
+    /* copy the sections data at their virtual address, the loader checks their validity */
+
+    for (i = 0; i < nb_sec; i++)
+    {
+        if ((sec[i].Characteristics & IMAGE_SCN_MEM_SHARED) &&
+            (sec[i].Characteristics & IMAGE_SCN_MEM_WRITE)) continue;
+        get_section_sizes( &sec[i], &map_size, &read_pos, &file_size );
+        if (!sec[i].PointerToRawData || !file_size) continue;
+        write_pos = sec[i].VirtualAddress;
+        if (write_pos >= mapping->image.map_size || file_size > mapping->image.map_size - write_pos)
+            continue;
+        toread = file_size;
+        while (toread)
+        {
+            long res = pread( fd, buffer + file_size - toread, toread, read_pos );
+            if (!res && toread < 0x200)  /* partial sector at EOF is not an error */
+            {
+                file_size -= toread;
+                break;
+            }
+            /* truncated file, the loader reports it when reading the sections in itself */
+            if (res <= 0) goto error;
+            toread -= res;
+            read_pos += res;
+        }
+        if (pwrite( image_fd, buffer, file_size, write_pos ) != file_size) goto error;
+    }
+
+    if (!(image = add_shared_file( &image_map_list, mapping->fd, fd, file ))) goto error;
+    mapping->image_map = image;
+    free( buffer );
+ done:
+    free( sec );
+    return;
+
+ error:
+    release_object( file );
+    free( buffer );
+ failed:
+    /* not fatal, the loader reads the sections in itself */
+    free( sec );
+    clear_error();
+}
+
 /* load the CLR header from its section */
 static int load_clr_header( IMAGE_COR20_HEADER *hdr, size_t va, size_t size, int unix_fd,
                             IMAGE_SECTION_HEADER *sec, unsigned int nb_sec )
@@ -812,6 +956,7 @@ static unsigned int get_image_params( struct mapping *mapping, file_pos_t file_s
 
     if (!build_shared_mapping( mapping, unix_fd, sec, nt.FileHeader.NumberOfSections ))
         return STATUS_INVALID_FILE_FOR_SECTION;
+    check_image_mapping( mapping, sec, nt.FileHeader.NumberOfSections );
 
     return STATUS_SUCCESS;
 }
@@ -874,6 +1019,9 @@ static struct object *create_mapping( struct object *root, const struct unicode_
     mapping->size        = size;
     mapping->fd          = NULL;
     mapping->shared      = NULL;
+    mapping->image_map   = NULL;
+    mapping->image_sec   = NULL;
+    mapping->image_nb_sec = 0;
     mapping->committed   = NULL;
 
     if (!(mapping->flags = get_mapping_flags( handle, flags ))) goto error;
@@ -976,9 +1124,9 @@ static void mapping_dump( struct object *obj, int verbose )
 {
     struct mapping *mapping = (struct mapping *)obj;
     assert( obj->ops == &mapping_ops );
-    fprintf( stderr, "Mapping size=%08x%08x flags=%08x fd=%p shared=%p\n",
+    fprintf( stderr, "Mapping size=%08x%08x flags=%08x fd=%p shared=%p image=%p\n",
              (unsigned int)(mapping->size >> 32), (unsigned int)mapping->size,
-             mapping->flags, mapping->fd, mapping->shared );
+             mapping->flags, mapping->fd, mapping->shared, mapping->image_map );
 }
 
 static struct object_type *mapping_get_type( struct object *obj )
@@ -1010,6 +1158,8 @@ static void mapping_destroy( struct object *obj )
     if (mapping->fd) release_object( mapping->fd );
     if (mapping->committed) release_object( mapping->committed );
     if (mapping->shared) release_object( mapping->shared );
+    if (mapping->image_map) release_object( mapping->image_map );
+    free( mapping->image_sec );
 }
 
 static enum server_fd_type mapping_get_fd_type( struct fd *fd )
@@ -1078,6 +1228,9 @@ DECL_HANDLER(get_mapping_info)
     if (mapping->shared)
         reply->shared_file = alloc_handle( current->process, mapping->shared->file,
                                            GENERIC_READ|GENERIC_WRITE, 0 );
+    if (mapping->image_sec) build_image_mapping( mapping );
+    if (mapping->image_map)
+        reply->image_file = alloc_handle( current->process, mapping->image_map->file, GENERIC_READ, 0 );
     release_object( mapping );
 }
 
@@ -1129,6 +1282,7 @@ DECL_HANDLER(map_view)
         view->fd        = !is_fd_removable( mapping->fd ) ? (struct fd *)grab_object( mapping->fd ) : NULL;
         view->committed = mapping->committed ? (struct ranges *)grab_object( mapping->committed ) : NULL;
         view->shared    = mapping->shared ? (struct shared_map *)grab_object( mapping->shared ) : NULL;
+        view->image_map = mapping->image_map ? (struct shared_map *)grab_object( mapping->image_map ) : NULL;
         list_add_tail( &current->process->views, &view->entry );
     }
 
@@ -24,10 +24,29 @@
 #include "wine/port.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/types.h>
+#ifdef HAVE_POLL_H
+# include <poll.h>
+#endif
+#ifdef HAVE_SYS_SOCKET_H
+# include <sys/socket.h>
+#endif
+#ifdef HAVE_SYS_IOCTL_H
+# include <sys/ioctl.h>
+#endif
+#ifdef HAVE_SYS_FILIO_H
+# include <sys/filio.h>
+#endif
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+# include <sys/epoll.h>
+#endif
+#include <unistd.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -56,6 +75,8 @@ struct pipe_end
 {
     struct object        obj;        /* object header */
     struct fd           *fd;         /* pipe file descriptor */
+    int                  direct;     /* data goes through a socket attached to the fd */
+    struct fd           *flush_wait; /* notified when the peer reads from a direct connection */
     unsigned int         flags;      /* pipe flags */
     unsigned int         state;      /* pipe state */
     struct named_pipe   *pipe;
@@ -135,6 +156,8 @@ static const struct object_ops named_pipe_ops =
 
 /* common server and client pipe end functions */
 static void pipe_end_destroy( struct object *obj );
+static int pipe_end_get_poll_events( struct fd *fd );
+static void pipe_end_poll_event( struct fd *fd, int event );
 static enum server_fd_type pipe_end_get_fd_type( struct fd *fd );
 static struct fd *pipe_end_get_fd( struct object *obj );
 static struct security_descriptor *pipe_end_get_sd( struct object *obj );
@@ -144,6 +167,7 @@ static int pipe_end_read( struct fd *fd, struct async *async, file_pos_t pos );
 static int pipe_end_write( struct fd *fd, struct async *async_data, file_pos_t pos );
 static int pipe_end_flush( struct fd *fd, struct async *async );
 static void pipe_end_get_volume_info( struct fd *fd, unsigned int info_class );
+static void pipe_end_queue_async( struct fd *fd, struct async *async, int type, int count );
 static void pipe_end_reselect_async( struct fd *fd, struct async_queue *queue );
 static void pipe_end_get_file_info( struct fd *fd, obj_handle_t handle, unsigned int info_class );
 
@@ -177,8 +201,8 @@ static const struct object_ops pipe_server_ops =
 
 static const struct fd_ops pipe_server_fd_ops =
 {
-    default_fd_get_poll_events,   /* get_poll_events */
-    default_poll_event,           /* poll_event */
+    pipe_end_get_poll_events,     /* get_poll_events */
+    pipe_end_poll_event,          /* poll_event */
     pipe_end_get_fd_type,         /* get_fd_type */
     pipe_end_read,                /* read */
     pipe_end_write,               /* write */
@@ -186,7 +210,7 @@ static const struct fd_ops pipe_server_fd_ops =
     pipe_end_get_file_info,       /* get_file_info */
     pipe_end_get_volume_info,     /* get_volume_info */
     pipe_server_ioctl,            /* ioctl */
-    no_fd_queue_async,            /* queue_async */
+    pipe_end_queue_async,         /* queue_async */
     pipe_end_reselect_async       /* reselect_async */
 };
 
@@ -219,8 +243,8 @@ static const struct object_ops pipe_client_ops =
 
 static const struct fd_ops pipe_client_fd_ops =
 {
-    default_fd_get_poll_events,   /* get_poll_events */
-    default_poll_event,           /* poll_event */
+    pipe_end_get_poll_events,     /* get_poll_events */
+    pipe_end_poll_event,          /* poll_event */
     pipe_end_get_fd_type,         /* get_fd_type */
     pipe_end_read,                /* read */
     pipe_end_write,               /* write */
@@ -228,7 +252,7 @@ static const struct fd_ops pipe_client_fd_ops =
     pipe_end_get_file_info,       /* get_file_info */
     pipe_end_get_volume_info,     /* get_volume_info */
     pipe_client_ioctl,            /* ioctl */
-    no_fd_queue_async,            /* queue_async */
+    pipe_end_queue_async,         /* queue_async */
     pipe_end_reselect_async       /* reselect_async */
 };
 
@@ -383,6 +407,173 @@ static void free_message( struct pipe_message *message )
     free( message );
 }
 
+/* byte-mode pipes may move their data through a socketpair instead of the server,
+ * at the cost of only approximating the buffer quotas of Windows pipes; flushing
+ * needs edge-triggered epoll to find out when the peer has read the data */
+static int use_direct_pipes(void)
+{
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+    static int direct_pipes = -1;
+
+    if (direct_pipes == -1)
+        direct_pipes = getenv( "WINEDIRECTPIPES" ) && atoi( getenv( "WINEDIRECTPIPES" ) );
+    return direct_pipes;
+#else
+    return 0;
+#endif
+}
+
+/* amount of data waiting in the socket of a direct connection */
+static data_size_t direct_data_avail( struct pipe_end *pipe_end )
+{
+    int avail;
+
+    if (!pipe_end->direct || ioctl( get_unix_fd( pipe_end->fd ), FIONREAD, &avail ) == -1) return 0;
+    return avail;
+}
+
+static void direct_flush_poll_event( struct fd *fd, int event );
+
+static const struct fd_ops direct_flush_fd_ops =
+{
+    default_fd_get_poll_events,   /* get_poll_events */
+    direct_flush_poll_event,      /* poll_event */
+    NULL,                         /* get_fd_type */
+    NULL,                         /* read */
+    NULL,                         /* write */
+    NULL,                         /* flush */
+    NULL,                         /* get_file_info */
+    NULL,                         /* get_volume_info */
+    NULL,                         /* ioctl */
+    NULL,                         /* queue_async */
+    NULL                          /* reselect_async */
+};
+
+/* The peer reads straight from its socket, but every read that frees some of
+ * the send buffer of this end wakes up its writers. An edge-triggered epoll
+ * instance turns each of these wake-ups into one event, so a pending flush is
+ * checked once per read of the peer instead of polling for it. */
+static int start_direct_flush_wait( struct pipe_end *pipe_end )
+{
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+    struct epoll_event ev;
+    int unix_fd;
+
+    if (pipe_end->flush_wait) return 1;
+
+    if ((unix_fd = epoll_create( 1 )) == -1)
+    {
+        file_set_error();
+        return 0;
+    }
+    memset( &ev, 0, sizeof(ev) );
+    ev.events = EPOLLOUT | EPOLLET;
+    if (epoll_ctl( unix_fd, EPOLL_CTL_ADD, get_unix_fd( pipe_end->fd ), &ev ) == -1)
+    {
+        file_set_error();
+        close( unix_fd );
+        return 0;
+    }
+    if (!(pipe_end->flush_wait = create_anonymous_fd( &direct_flush_fd_ops, unix_fd, &pipe_end->obj, 0 )))
+        return 0;
+    set_fd_events( pipe_end->flush_wait, POLLIN );
+    return 1;
+#else
+    set_error( STATUS_NOT_SUPPORTED );
+    return 0;
+#endif
+}
+
+static void stop_direct_flush_wait( struct pipe_end *pipe_end )
+{
+    if (!pipe_end->flush_wait) return;
+    release_object( pipe_end->flush_wait );
+    pipe_end->flush_wait = NULL;
+}
+
+static void direct_flush_poll_event( struct fd *fd, int event )
+{
+    struct pipe_end *pipe_end = get_fd_user( fd );
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+    struct epoll_event ev;
+
+    /* consume the event, the next read of the peer reports a new one */
+    epoll_wait( get_unix_fd( fd ), &ev, 1, 0 );
+#endif
+    if (pipe_end->connection && direct_data_avail( pipe_end->connection )) return;
+
+    stop_direct_flush_wait( pipe_end );
+    fd_async_wake_up( pipe_end->fd, ASYNC_TYPE_WAIT, STATUS_SUCCESS );
+}
+
+/* give both ends a socket that their processes read and write directly,
+ * only the connection state is left to the server */
+static void connect_direct( struct pipe_end *server, struct pipe_end *client )
+{
+    struct named_pipe *pipe = server->pipe;
+    int fds[2];
+
+    if (pipe->message_mode || !use_direct_pipes()) return;
+    if (socketpair( PF_UNIX, SOCK_STREAM, 0, fds )) return;
+
+    fcntl( fds[0], F_SETFL, O_NONBLOCK );
+    fcntl( fds[1], F_SETFL, O_NONBLOCK );
+    /* a writer blocks on its send buffer, which stands in for the quota of the reader */
+    if (pipe->insize) setsockopt( fds[1], SOL_SOCKET, SO_SNDBUF, &pipe->insize, sizeof(pipe->insize) );
+    if (pipe->outsize) setsockopt( fds[0], SOL_SOCKET, SO_SNDBUF, &pipe->outsize, sizeof(pipe->outsize) );
+
+    if (!set_pseudo_fd_unix_fd( server->fd, fds[0] ))
+    {
+        close( fds[1] );
+        clear_error();
+        return;
+    }
+    if (!set_pseudo_fd_unix_fd( client->fd, fds[1] ))
+    {
+        set_pseudo_fd_unix_fd( server->fd, -1 );
+        clear_error();
+        return;
+    }
+    server->direct = client->direct = 1;
+}
+
+/* stop using the socket, clients that cached it will only see it shut down */
+static void detach_direct( struct pipe_end *pipe_end, unsigned int status )
+{
+    stop_direct_flush_wait( pipe_end );
+    fd_async_wake_up( pipe_end->fd, ASYNC_TYPE_READ, status );
+    fd_async_wake_up( pipe_end->fd, ASYNC_TYPE_WRITE, status );
+    set_pseudo_fd_unix_fd( pipe_end->fd, -1 );
+    pipe_end->direct = 0;
+}
+
+static void disconnect_direct( struct pipe_end *pipe_end, unsigned int status )
+{
+    int unix_fd = get_unix_fd( pipe_end->fd );
+    char buffer[4096];
+
+    async_wake_up( &pipe_end->write_q, status );
+
+    /* on close the reader may still drain what is left in its socket, but writes can't complete */
+    if (status != STATUS_PIPE_DISCONNECTED)
+    {
+        fd_async_wake_up( pipe_end->fd, ASYNC_TYPE_WRITE, status );
+        return;
+    }
+
+    /* all data is lost on disconnection; shutting the socket down also wakes clients polling it */
+    shutdown( unix_fd, SHUT_RDWR );
+    while (recv( unix_fd, buffer, sizeof(buffer), MSG_DONTWAIT ) > 0);
+
+    /* the server end may be reconnected, the client end keeps its socket until it is closed */
+    if (pipe_end->obj.ops == &pipe_server_ops) detach_direct( pipe_end, status );
+    else
+    {
+        fd_async_wake_up( pipe_end->fd, ASYNC_TYPE_READ, status );
+        fd_async_wake_up( pipe_end->fd, ASYNC_TYPE_WRITE, status );
+    }
+}
+
 static void pipe_end_disconnect( struct pipe_end *pipe_end, unsigned int status )
 {
     struct pipe_end *connection = pipe_end->connection;
@@ -404,6 +595,8 @@ static void pipe_end_disconnect( struct pipe_end *pipe_end, unsigned int status
         release_object( async );
     }
     if (status == STATUS_PIPE_DISCONNECTED) set_fd_signaled( pipe_end->fd, 0 );
+    stop_direct_flush_wait( pipe_end );
+    if (pipe_end->direct) disconnect_direct( pipe_end, status );
 
     if (connection)
     {
@@ -428,6 +621,8 @@ static void pipe_end_destroy( struct object *obj )
 
     free_async_queue( &pipe_end->read_q );
     free_async_queue( &pipe_end->write_q );
+    stop_direct_flush_wait( pipe_end );
+    if (pipe_end->direct) detach_direct( pipe_end, STATUS_HANDLES_CLOSED );
     if (pipe_end->fd) release_object( pipe_end->fd );
     if (pipe_end->pipe) release_object( pipe_end->pipe );
 }
@@ -497,7 +692,7 @@ static void named_pipe_device_destroy( struct object *obj )
 {
     struct named_pipe_device *device = (struct named_pipe_device*)obj;
     assert( obj->ops == &named_pipe_device_ops );
-    free( device->pipes );
+    free_namespace( device->pipes );
 }
 
 struct object *create_named_pipe_device( struct object *root, const struct unicode_str *name )
@@ -553,7 +748,16 @@ static int pipe_end_flush( struct fd *fd, struct async *async )
         return 0;
     }
 
-    if (pipe_end->connection && !list_empty( &pipe_end->connection->message_queue ))
+    if (pipe_end->direct)
+    {
+        if (pipe_end->connection && direct_data_avail( pipe_end->connection ))
+        {
+            if (!start_direct_flush_wait( pipe_end )) return 0;
+            fd_queue_async( pipe_end->fd, async, ASYNC_TYPE_WAIT );
+            set_error( STATUS_PENDING );
+        }
+    }
+    else if (pipe_end->connection && !list_empty( &pipe_end->connection->message_queue ))
     {
         fd_queue_async( pipe_end->fd, async, ASYNC_TYPE_WAIT );
         set_error( STATUS_PENDING );
@@ -787,12 +991,87 @@ static int ignore_reselect;
 
 static void reselect_write_queue( struct pipe_end *pipe_end );
 
+/* read whatever is available from the socket of a direct connection */
+static int direct_read( struct pipe_end *pipe_end, struct iosb *iosb )
+{
+    data_size_t avail = direct_data_avail( pipe_end ), size = min( iosb->out_size, avail );
+    void *data = NULL;
+    int ret = 0;
+
+    if (!avail) return 0;
+
+    if (size)
+    {
+        if (!(data = malloc( size )))
+        {
+            iosb->status = STATUS_NO_MEMORY;
+            iosb->out_size = iosb->result = 0;
+            return 1;
+        }
+        /* a client may have read the data from its own copy of the socket first */
+        if ((ret = recv( get_unix_fd( pipe_end->fd ), data, size, MSG_DONTWAIT )) <= 0)
+        {
+            free( data );
+            return 0;
+        }
+    }
+    iosb->status = STATUS_SUCCESS;
+    iosb->out_data = data;
+    iosb->out_size = iosb->result = ret;
+    return 1;
+}
+
+/* write as much as the socket of a direct connection accepts */
+static int direct_write( struct pipe_end *pipe_end, struct iosb *iosb )
+{
+    int ret = send( get_unix_fd( pipe_end->fd ), (const char *)iosb->in_data + iosb->result,
+                    iosb->in_size - iosb->result, MSG_DONTWAIT );
+
+    if (ret < 0)
+    {
+        if (errno == EAGAIN || errno == EINTR) return 0;
+        iosb->status = STATUS_PIPE_CLOSING;
+        return 1;
+    }
+    if ((iosb->result += ret) < iosb->in_size) return 0;
+    iosb->status = STATUS_SUCCESS;
+    return 1;
+}
+
+static void reselect_direct_queue( struct pipe_end *pipe_end, struct async_queue *queue,
+                                   int (*transfer)( struct pipe_end *, struct iosb * ) )
+{
+    struct async *async;
+    struct iosb *iosb;
+    int done;
+
+    ignore_reselect = 1;
+    while ((async = find_pending_async( queue )))
+    {
+        iosb = async_get_iosb( async );
+        if ((done = transfer( pipe_end, iosb )))
+            async_terminate( async, iosb->result ? STATUS_ALERTED : iosb->status );
+        release_object( async );
+        release_object( iosb );
+        if (!done) break;
+    }
+    ignore_reselect = 0;
+
+    set_fd_events( pipe_end->fd, pipe_end_get_poll_events( pipe_end->fd ) );
+}
+
 static void reselect_read_queue( struct pipe_end *pipe_end )
 {
     struct async *async;
     struct iosb *iosb;
     int read_done = 0;
 
+    if (pipe_end->direct)
+    {
+        reselect_direct_queue( pipe_end, &pipe_end->read_q, direct_read );
+        return;
+    }
+
     ignore_reselect = 1;
     while (!list_empty( &pipe_end->message_queue ) && (async = find_pending_async( &pipe_end->read_q )))
     {
@@ -820,6 +1099,11 @@ static void reselect_write_queue( struct pipe_end *pipe_end )
     struct pipe_end *reader = pipe_end->connection;
     data_size_t avail = 0;
 
+    if (pipe_end->direct)
+    {
+        reselect_direct_queue( pipe_end, &pipe_end->write_q, direct_write );
+        return;
+    }
     if (!reader) return;
 
     ignore_reselect = 1;
@@ -859,7 +1143,7 @@ static int pipe_end_read( struct fd *fd, struct async *async, file_pos_t pos )
         set_error( STATUS_PIPE_LISTENING );
         return 0;
     case FILE_PIPE_CLOSING_STATE:
-        if (!list_empty( &pipe_end->message_queue )) break;
+        if (!list_empty( &pipe_end->message_queue ) || direct_data_avail( pipe_end )) break;
         set_error( STATUS_PIPE_BROKEN );
         return 0;
     }
@@ -893,6 +1177,14 @@ static int pipe_end_write( struct fd *fd, struct async *async, file_pos_t pos )
 
     if (!pipe_end->pipe->message_mode && !get_req_data_size()) return 1;
 
+    if (pipe_end->direct)
+    {
+        queue_async( &pipe_end->write_q, async );
+        reselect_write_queue( pipe_end );
+        set_error( STATUS_PENDING );
+        return 1;
+    }
+
     iosb = async_get_iosb( async );
     message = queue_message( pipe_end->connection, iosb );
     release_object( iosb );
@@ -909,12 +1201,56 @@ static void pipe_end_reselect_async( struct fd *fd, struct async_queue *queue )
 {
     struct pipe_end *pipe_end = get_fd_user( fd );
 
-    if (ignore_reselect) return;
-
     if (&pipe_end->write_q == queue)
-        reselect_write_queue( pipe_end );
+    {
+        if (!ignore_reselect) reselect_write_queue( pipe_end );
+    }
     else if (&pipe_end->read_q == queue)
-        reselect_read_queue( pipe_end );
+    {
+        if (!ignore_reselect) reselect_read_queue( pipe_end );
+    }
+    else if (pipe_end->direct)
+        default_fd_reselect_async( fd, queue );
+}
+
+static int pipe_end_get_poll_events( struct fd *fd )
+{
+    struct pipe_end *pipe_end = get_fd_user( fd );
+    int events = default_fd_get_poll_events( fd );
+
+    if (pipe_end->direct)
+    {
+        if (async_waiting( &pipe_end->read_q )) events |= POLLIN;
+        if (async_waiting( &pipe_end->write_q )) events |= POLLOUT;
+    }
+    return events;
+}
+
+static void pipe_end_poll_event( struct fd *fd, int event )
+{
+    struct pipe_end *pipe_end = get_fd_user( fd );
+
+    if (pipe_end->direct)
+    {
+        if (event & (POLLIN | POLLERR | POLLHUP)) reselect_read_queue( pipe_end );
+        if (event & POLLOUT) reselect_write_queue( pipe_end );
+        /* nothing more will arrive, fail whatever is still waiting */
+        if (event & (POLLERR | POLLHUP))
+        {
+            async_wake_up( &pipe_end->read_q, STATUS_PIPE_BROKEN );
+            async_wake_up( &pipe_end->write_q, STATUS_PIPE_CLOSING );
+        }
+    }
+    default_poll_event( fd, event );
+}
+
+static void pipe_end_queue_async( struct fd *fd, struct async *async, int type, int count )
+{
+    struct pipe_end *pipe_end = get_fd_user( fd );
+
+    /* only direct connections have a socket that clients can wait on */
+    if (pipe_end->direct) default_fd_queue_async( fd, async, type, count );
+    else no_fd_queue_async( fd, async, type, count );
 }
 
 static enum server_fd_type pipe_end_get_fd_type( struct fd *fd )
@@ -942,7 +1278,7 @@ static int pipe_end_peek( struct pipe_end *pipe_end )
     case FILE_PIPE_CONNECTED_STATE:
         break;
     case FILE_PIPE_CLOSING_STATE:
-        if (!list_empty( &pipe_end->message_queue )) break;
+        if (!list_empty( &pipe_end->message_queue ) || direct_data_avail( pipe_end )) break;
         set_error( STATUS_PIPE_BROKEN );
         return 0;
     default:
@@ -950,6 +1286,7 @@ static int pipe_end_peek( struct pipe_end *pipe_end )
         return 0;
     }
 
+    if (pipe_end->direct) avail = direct_data_avail( pipe_end );
     LIST_FOR_EACH_ENTRY( message, &pipe_end->message_queue, struct pipe_message, entry )
         avail += message->iosb->in_size - message->read_pos;
     reply_size = min( reply_size, avail );
@@ -961,13 +1298,31 @@ static int pipe_end_peek( struct pipe_end *pipe_end )
         reply_size = min( reply_size, message_length );
     }
 
-    if (!(buffer = set_reply_data_size( offsetof( FILE_PIPE_PEEK_BUFFER, Data[reply_size] )))) return 0;
+    if (pipe_end->direct)
+    {
+        int ret = 0;
+
+        if (!(buffer = mem_alloc( offsetof( FILE_PIPE_PEEK_BUFFER, Data[reply_size] )))) return 0;
+        if (reply_size)
+            ret = recv( get_unix_fd( pipe_end->fd ), buffer->Data, reply_size, MSG_PEEK | MSG_DONTWAIT );
+        if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            file_set_error();
+            free( buffer );
+            return 0;
+        }
+        /* a client may have read some of the data from its own copy of the socket meanwhile */
+        if (ret < 0) ret = 0;
+        if (ret < reply_size) avail = reply_size = ret;
+        set_reply_data_ptr( buffer, offsetof( FILE_PIPE_PEEK_BUFFER, Data[reply_size] ) );
+    }
+    else if (!(buffer = set_reply_data_size( offsetof( FILE_PIPE_PEEK_BUFFER, Data[reply_size] )))) return 0;
     buffer->NamedPipeState    = pipe_end->state;
     buffer->ReadDataAvailable = avail;
     buffer->NumberOfMessages  = 0;  /* FIXME */
     buffer->MessageLength     = message_length;
 
-    if (reply_size)
+    if (reply_size && !pipe_end->direct)
     {
         data_size_t write_pos = 0, writing;
         LIST_FOR_EACH_ENTRY( message, &pipe_end->message_queue, struct pipe_message, entry )
@@ -1147,6 +1502,8 @@ static void init_pipe_end( struct pipe_end *pipe_end, struct named_pipe *pipe,
 {
     pipe_end->pipe = (struct named_pipe *)grab_object( pipe );
     pipe_end->fd = NULL;
+    pipe_end->direct = 0;
+    pipe_end->flush_wait = NULL;
     pipe_end->flags = pipe_flags;
     pipe_end->connection = NULL;
     pipe_end->buffer_size = buffer_size;
@@ -1176,7 +1533,8 @@ static struct pipe_server *create_pipe_server( struct named_pipe *pipe, unsigned
         release_object( server );
         return NULL;
     }
-    allow_fd_caching( server->pipe_end.fd );
+    /* byte-mode servers get a unix fd once connected, the client must not cache its absence */
+    if (pipe->message_mode || !use_direct_pipes()) allow_fd_caching( server->pipe_end.fd );
     set_fd_signaled( server->pipe_end.fd, 1 );
     async_wake_up( &pipe->waiters, STATUS_SUCCESS );
     return server;
@@ -1252,6 +1610,7 @@ static struct object *named_pipe_open_file( struct object *obj, unsigned int acc
         server->pipe_end.client_pid = client->client_pid;
         client->server_pid = server->pipe_end.server_pid;
         list_remove( &server->entry );
+        connect_direct( &server->pipe_end, client );
     }
     return &client->obj;
 }
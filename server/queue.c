@@ -35,6 +35,7 @@
 #include "winbase.h"
 #include "wingdi.h"
 #include "winuser.h"
+#include "dde.h"
 #include "winternl.h"
 
 #include "handle.h"
@@ -499,13 +500,29 @@ static inline int is_signaled( struct msg_queue *queue )
     return ((queue->wake_bits & queue->wake_mask) || (queue->changed_bits & queue->changed_mask));
 }
 
+/* reset the esync eventfd once the queue is no longer signaled; this has to happen
+ * on every change of the bits or masks, since clients read the bits from the shared
+ * memory without asking the server to do it */
+static inline void update_esync_queue( struct msg_queue *queue )
+{
+    if (do_esync() && !is_signaled( queue ))
+        esync_clear( queue->esync_fd );
+}
+
 /* synchronize the queue state with the shared memory */
 static inline void update_shm_queue_bits( struct msg_queue *queue )
 {
     shmlocal_t *shm;
     if (!queue->thread) return;
     if ((shm = queue->thread->shm))
-        shm->queue_bits = queue->wake_bits;
+    {
+        /* an odd sequence number tells clients that the bits are being updated */
+        interlocked_xchg_add( (int *)&shm->queue_seq, 1 );
+        shm->queue_bits   = queue->wake_bits;
+        shm->changed_bits = queue->changed_bits;
+        interlocked_xchg_add( (int *)&shm->queue_seq, 1 );
+    }
+    update_esync_queue( queue );
 }
 
 /* set some queue bits */
@@ -523,9 +540,6 @@ static inline void clear_queue_bits( struct msg_queue *queue, unsigned int bits
     queue->wake_bits &= ~bits;
     queue->changed_bits &= ~bits;
     update_shm_queue_bits( queue );
-
-    if (do_esync() && !is_signaled( queue ))
-        esync_clear( queue->esync_fd );
 }
 
 /* check whether msg is a keyboard message */
@@ -864,10 +878,53 @@ static int match_window( user_handle_t win, user_handle_t msg_win )
     return is_child_window( win, msg_win );
 }
 
+/* check if a posted message can be returned to the client ahead of time */
+static inline int can_prefetch_message( const struct message *msg )
+{
+    if (msg->type != MSG_POSTED || msg->data_size) return 0;
+    if (msg->msg & 0x80000000) return 0;  /* internal message */
+    if (msg->msg == WM_HOTKEY) return 0;
+    return (msg->msg < WM_DDE_FIRST || msg->msg > WM_DDE_LAST);
+}
+
+/* remove the posted messages following the returned one and append them to the reply */
+static unsigned int prefetch_posted_messages( struct msg_queue *queue, struct message *first,
+                                              unsigned int max )
+{
+    struct message *msg;
+    struct list *ptr;
+    posted_message_t *data;
+    unsigned int i, count = 0;
+
+    max = min( max, get_reply_max_size() / sizeof(*data) );
+    for (ptr = list_next( &queue->msg_list[POST_MESSAGE], &first->entry ); ptr && count < max;
+         ptr = list_next( &queue->msg_list[POST_MESSAGE], ptr ))
+    {
+        if (!can_prefetch_message( LIST_ENTRY( ptr, struct message, entry ))) break;
+        count++;
+    }
+    if (!count || !(data = set_reply_data_size( count * sizeof(*data) ))) return 0;
+
+    for (i = 0; i < count; i++)
+    {
+        msg = LIST_ENTRY( list_next( &queue->msg_list[POST_MESSAGE], &first->entry ), struct message, entry );
+        data[i].win    = msg->win;
+        data[i].msg    = msg->msg;
+        data[i].wparam = msg->wparam;
+        data[i].lparam = msg->lparam;
+        data[i].x      = msg->x;
+        data[i].y      = msg->y;
+        data[i].time   = msg->time;
+        data[i].__pad  = 0;
+        remove_queue_message( queue, msg, POST_MESSAGE );
+    }
+    return count;
+}
+
 /* retrieve a posted message */
 static int get_posted_message( struct msg_queue *queue, unsigned int ignore_msg, user_handle_t win,
                                unsigned int first, unsigned int last, unsigned int flags,
-                               struct get_message_reply *reply )
+                               unsigned int prefetch, struct get_message_reply *reply )
 {
     struct message *msg;
 
@@ -906,6 +963,9 @@ found:
             msg->data = NULL;
             msg->data_size = 0;
         }
+        else if (prefetch && can_prefetch_message( msg ) &&
+                 msg == LIST_ENTRY( list_head( &queue->msg_list[POST_MESSAGE] ), struct message, entry ))
+            reply->prefetched = prefetch_posted_messages( queue, msg, prefetch );
         remove_queue_message( queue, msg, POST_MESSAGE );
     }
     else if (msg->data) set_reply_data( msg->data, msg->data_size );
@@ -2360,6 +2420,7 @@ DECL_HANDLER(set_queue_mask)
             if (req->skip_wait) queue->wake_mask = queue->changed_mask = 0;
             else wake_up( &queue->obj, 0 );
         }
+        else update_esync_queue( queue );
     }
 }
 
@@ -2373,9 +2434,7 @@ DECL_HANDLER(get_queue_status)
         reply->wake_bits    = queue->wake_bits;
         reply->changed_bits = queue->changed_bits;
         queue->changed_bits &= ~req->clear_bits;
-
-        if (do_esync() && !is_signaled( queue ))
-            esync_clear( queue->esync_fd );
+        update_shm_queue_bits( queue );
     }
     else reply->wake_bits = reply->changed_bits = 0;
 }
@@ -2560,15 +2619,17 @@ DECL_HANDLER(get_message)
     }
     if (filter & QS_INPUT) queue->changed_bits &= ~QS_INPUT;
     if (filter & QS_PAINT) queue->changed_bits &= ~QS_PAINT;
+    update_shm_queue_bits( queue );
 
     /* then check for posted messages */
     if ((filter & QS_POSTMESSAGE) &&
-        get_posted_message( queue, queue->ignore_post_msg, get_win, req->get_first, req->get_last, req->flags, reply ))
+        get_posted_message( queue, queue->ignore_post_msg, get_win, req->get_first, req->get_last,
+                            req->flags, req->prefetch, reply ))
         return;
 
     if ((filter & QS_HOTKEY) && queue->hotkey_count &&
         req->get_first <= WM_HOTKEY && req->get_last >= WM_HOTKEY &&
-        get_posted_message( queue, queue->ignore_post_msg, get_win, WM_HOTKEY, WM_HOTKEY, req->flags, reply ))
+        get_posted_message( queue, queue->ignore_post_msg, get_win, WM_HOTKEY, WM_HOTKEY, req->flags, 0, reply ))
         return;
 
     /* only check for quit messages if not posted messages pending */
@@ -2613,17 +2674,18 @@ DECL_HANDLER(get_message)
 
     /* if we previously skipped posted messages then check again */
     if (queue->ignore_post_msg && (filter & QS_POSTMESSAGE) &&
-        get_posted_message( queue, 0, get_win, req->get_first, req->get_last, req->flags, reply ))
+        get_posted_message( queue, 0, get_win, req->get_first, req->get_last, req->flags, req->prefetch, reply ))
         return;
 
     if (queue->ignore_post_msg && (filter & QS_HOTKEY) && queue->hotkey_count &&
         req->get_first <= WM_HOTKEY && req->get_last >= WM_HOTKEY &&
-        get_posted_message( queue, 0, get_win, WM_HOTKEY, WM_HOTKEY, req->flags, reply ))
+        get_posted_message( queue, 0, get_win, WM_HOTKEY, WM_HOTKEY, req->flags, 0, reply ))
         return;
 
     if (get_win == -1 && current->process->idle_event) set_event( current->process->idle_event );
     queue->wake_mask = req->wake_mask;
     queue->changed_mask = req->changed_mask;
+    update_esync_queue( queue );
     set_error( STATUS_PENDING );  /* FIXME */
     return;
 
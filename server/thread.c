@@ -336,6 +336,7 @@ static void cleanup_thread( struct thread *thread )
     destroy_thread_windows( thread );
     free_msg_queue( thread );
     close_thread_desktop( thread );
+    release_completion_slots( thread );
     for (i = 0; i < MAX_INFLIGHT_FDS; i++)
     {
         if (thread->inflight[i].client != -1)